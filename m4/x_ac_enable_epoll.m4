@@ -0,0 +1,34 @@
+###############################################################################
+# SYNOPSIS:
+#   X_AC_ENABLE_EPOLL
+#
+# DESCRIPTION:
+#   Check if epoll can/should be used for multiplexing I/O.
+#   Define WITH_EPOLL accordingly.
+#
+# NOTES:
+#   The daemon falls back to poll() at runtime if the epoll instance cannot
+#     be created.
+###############################################################################
+
+AC_DEFUN_ONCE([X_AC_ENABLE_EPOLL],
+  [AC_ARG_ENABLE([epoll],
+    [AS_HELP_STRING([--disable-epoll],
+      [use poll@{:@@:}@ instead of epoll for multiplexing I/O])])
+  AS_IF(
+    [test "x${enable_epoll}" != xno],
+    [AC_CHECK_HEADER([sys/epoll.h], [have_sys_epoll_h=yes])
+      AC_CHECK_FUNC([epoll_create1], [have_epoll_create1=yes])
+      AS_IF(
+        [test "x${have_sys_epoll_h}" = xyes \
+            && test "x${have_epoll_create1}" = xyes],
+        [have_epoll=yes])])
+  AS_IF(
+    [test "x${have_epoll}" = xyes],
+    [AC_DEFINE([WITH_EPOLL], [1],
+      [Define to 1 if using epoll for multiplexing I/O.])],
+    [test "x${enable_epoll}" = xyes],
+    [AC_MSG_FAILURE([failed check for --enable-epoll])])
+  AC_MSG_CHECKING([whether to use epoll])
+  AC_MSG_RESULT([${have_epoll=no}])
+])
@@ -0,0 +1,36 @@
+###############################################################################
+# SYNOPSIS:
+#   X_AC_ENABLE_IO_URING
+#
+# DESCRIPTION:
+#   Check if io_uring can/should be used for multiplexing I/O.
+#   Define WITH_IO_URING accordingly.
+#
+# NOTES:
+#   This is disabled by default.  The io_uring instance is set up via raw
+#     syscalls, so liburing is not required.  The daemon falls back to epoll
+#     (or poll()) at runtime if the io_uring instance cannot be created.
+###############################################################################
+
+AC_DEFUN_ONCE([X_AC_ENABLE_IO_URING],
+  [AC_ARG_ENABLE([io-uring],
+    [AS_HELP_STRING([--enable-io-uring],
+      [use io_uring for multiplexing I/O when supported by the kernel])])
+  AS_IF(
+    [test "x${enable_io_uring}" = xyes],
+    [AC_CHECK_HEADER([linux/io_uring.h], [have_linux_io_uring_h=yes])
+      AC_CHECK_DECL([__NR_io_uring_setup], [have_nr_io_uring_setup=yes], [],
+        [#include <sys/syscall.h>])
+      AS_IF(
+        [test "x${have_linux_io_uring_h}" = xyes \
+            && test "x${have_nr_io_uring_setup}" = xyes],
+        [have_io_uring=yes])])
+  AS_IF(
+    [test "x${have_io_uring}" = xyes],
+    [AC_DEFINE([WITH_IO_URING], [1],
+      [Define to 1 if using io_uring for multiplexing I/O.])],
+    [test "x${enable_io_uring}" = xyes],
+    [AC_MSG_FAILURE([failed check for --enable-io-uring])])
+  AC_MSG_CHECKING([whether to use io_uring])
+  AC_MSG_RESULT([${have_io_uring=no}])
+])
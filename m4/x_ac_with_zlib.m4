@@ -0,0 +1,31 @@
+###############################################################################
+# SYNOPSIS:
+#   X_AC_WITH_ZLIB
+#
+# DESCRIPTION:
+#   Check if zlib can/should be used for compressing console logfiles.
+#   Define ZLIBLIBS and the WITH_ZLIB conditional accordingly.
+###############################################################################
+
+AC_DEFUN_ONCE([X_AC_WITH_ZLIB],
+  [AC_ARG_WITH([zlib],
+    [AS_HELP_STRING([--with-zlib],
+      [use zlib for compressing console logfiles])])
+  AS_IF(
+    [test "x${with_zlib}" != xno],
+    [AC_CHECK_HEADER([zlib.h], [have_zlib_h=yes])
+      AC_CHECK_LIB([z], [deflateBound], [have_libz=yes])
+      AS_IF(
+        [test "x${have_zlib_h}" = xyes && test "x${have_libz}" = xyes],
+        [have_zlib=yes])])
+  AS_IF(
+    [test "x${have_zlib}" = xyes],
+    [AC_SUBST([ZLIBLIBS], ["-lz"])
+      AC_DEFINE([WITH_ZLIB], [1],
+        [Define to 1 if using zlib for compressing console logfiles.])],
+    [test "x${with_zlib}" = xyes],
+    [AC_MSG_FAILURE([failed check for --with-zlib])])
+  AM_CONDITIONAL([WITH_ZLIB], [test "x${have_zlib}" = xyes])
+  AC_MSG_CHECKING([whether to use zlib])
+  AC_MSG_RESULT([${have_zlib=no}])
+])
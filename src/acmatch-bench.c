@@ -0,0 +1,231 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The acmatch-bench utility measures the throughput of the trigger engine's
+ *    multi-pattern matcher.  It compiles a set of random patterns and scans
+ *    a buffer of random console-like text (seeded with occurrences of the
+ *    patterns) in chunks the size of a console read, reporting the rate at
+ *    which the text is matched.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "acmatch.h"
+#include "common.h"
+#include "log.h"
+#include "util.h"
+
+
+#define BENCH_CHUNK_LEN         4096
+#define BENCH_MAX_PAT_LEN       24
+#define BENCH_MIN_PAT_LEN       6
+
+
+static void display_help(const char *prog);
+static void gen_string(char *dst, int len);
+static void count_match(void *arg, int id);
+static double get_secs(void);
+
+
+int main(int argc, char *argv[])
+{
+    int c;
+    int numPats = 1000;
+    int numMB = 64;
+    int numPasses = 3;
+    char **pats;
+    int *lens;
+    char *text;
+    long textLen;
+    acm_t acm;
+    long numMatches;
+    double t0, t1;
+    double best = 0;
+    long off;
+    int state;
+    int i, n;
+
+    log_set_file(stderr, LOG_WARNING, 0);
+
+    opterr = 0;
+    while ((c = getopt(argc, argv, "hm:n:p:")) != -1) {
+        switch(c) {
+        case 'h':
+            display_help(argv[0]);
+            exit(0);
+        case 'm':
+            if ((numMB = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid size \"%s\"", optarg);
+            }
+            break;
+        case 'n':
+            if ((numPasses = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid count \"%s\"", optarg);
+            }
+            break;
+        case 'p':
+            if ((numPats = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid count \"%s\"", optarg);
+            }
+            break;
+        case '?':                       /* invalid option */
+            log_err(0, "CMDLINE: invalid option \"%c\"", optopt);
+            exit(1);
+        default:
+            log_err(0, "CMDLINE: option \"%c\" not implemented", c);
+            exit(1);
+        }
+    }
+    if (optind != argc) {
+        display_help(argv[0]);
+        exit(1);
+    }
+    srandom(1);
+
+    pats = malloc(numPats * sizeof(char *));
+    lens = malloc(numPats * sizeof(int));
+    textLen = (long) numMB * 1024 * 1024;
+    text = malloc(textLen);
+    if (!pats || !lens || !text) {
+        out_of_memory();
+    }
+    acm = acm_create();
+    for (i = 0; i < numPats; i++) {
+        lens[i] = BENCH_MIN_PAT_LEN
+            + random() % (BENCH_MAX_PAT_LEN - BENCH_MIN_PAT_LEN + 1);
+        if (!(pats[i] = malloc(lens[i]))) {
+            out_of_memory();
+        }
+        gen_string(pats[i], lens[i]);
+        (void) acm_add(acm, pats[i], lens[i], i);
+    }
+    t0 = get_secs();
+    (void) acm_compile(acm);
+    t1 = get_secs();
+    printf("patterns: %d\n", numPats);
+    printf("states:   %d\n", acm_num_states(acm));
+    printf("dfa size: %ldKB\n", (acm_size(acm) + 1023) / 1024);
+    printf("compile:  %.3f ms\n", (t1 - t0) * 1000);
+
+    /*  Seed the text with a pattern roughly every 64KB.
+     */
+    gen_string(text, textLen);
+    for (off = 0; off + BENCH_MAX_PAT_LEN <= textLen; off += 65536) {
+        i = random() % numPats;
+        memcpy(text + off + random() % (65536 - BENCH_MAX_PAT_LEN),
+            pats[i], lens[i]);
+    }
+    for (n = 0; n < numPasses; n++) {
+        state = 0;
+        numMatches = 0;
+        t0 = get_secs();
+        for (off = 0; off < textLen; off += BENCH_CHUNK_LEN) {
+            i = (textLen - off < BENCH_CHUNK_LEN)
+                ? textLen - off : BENCH_CHUNK_LEN;
+            (void) acm_scan(acm, &state, text + off, i, count_match,
+                &numMatches);
+        }
+        t1 = get_secs();
+        if ((t1 > t0) && (numMB / (t1 - t0) > best)) {
+            best = numMB / (t1 - t0);
+        }
+    }
+    printf("text:     %d MB in %d-byte chunks\n", numMB, BENCH_CHUNK_LEN);
+    printf("matches:  %ld\n", numMatches);
+    printf("scan:     %.1f MB/s (best of %d)\n", best, numPasses);
+
+    acm_destroy(acm);
+    for (i = 0; i < numPats; i++) {
+        free(pats[i]);
+    }
+    free(pats);
+    free(lens);
+    free(text);
+    return(0);
+}
+
+
+static void display_help(const char *prog)
+{
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("\n");
+    printf("  -h        Display this help message.\n");
+    printf("  -m MB     Specify size of text to scan (default: 64).\n");
+    printf("  -n N      Specify number of passes over the text (default: 3).\n");
+    printf("  -p N      Specify number of patterns (default: 1000).\n");
+    printf("\n");
+    return;
+}
+
+
+static void gen_string(char *dst, int len)
+{
+/*  Fills (dst) with (len) bytes of random console-like text:
+ *    printable characters separated by spaces
+ *    and the occasional CR/LF.
+ */
+    static const char chars[] =
+        "abcdefghijklmnopqrstuvwxyz0123456789"
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZ:[]()-_.= ";
+    long r;
+    int i;
+
+    for (i = 0; i < len; i++) {
+        r = random();
+        if ((r & 0x3f) == 0) {
+            dst[i] = '\n';
+        }
+        else {
+            dst[i] = chars[(r >> 6) % (sizeof(chars) - 1)];
+        }
+    }
+    return;
+}
+
+
+static void count_match(void *arg, int id)
+{
+    (*(long *) arg)++;
+    return;
+}
+
+
+static double get_secs(void)
+{
+    struct timeval tv;
+
+    if (gettimeofday(&tv, NULL) < 0) {
+        log_err(errno, "Unable to get time of day");
+    }
+    return(tv.tv_sec + tv.tv_usec / 1e6);
+}
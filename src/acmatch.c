@@ -0,0 +1,316 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "acmatch.h"
+#include "util.h"
+
+
+struct acm {
+    unsigned char  **pats;              /* patterns added before compiling   */
+    int             *lens;              /* lengths of patterns               */
+    int             *ids;               /* ids of patterns                   */
+    int              numPats;           /* num patterns added                */
+    int              maxPats;           /* num patterns allocated            */
+    int              numClasses;        /* num byte classes in alphabet      */
+    int              numStates;         /* num states in DFA                 */
+    int             *delta;             /* transitions [state * numClasses]  */
+    int             *out;               /* first pattern ending at state     */
+    int             *outNext;           /* next pattern ending at same state */
+    int             *dict;              /* nearest suffix state w/ output    */
+    unsigned char    classes[256];      /* byte to class map                 */
+    unsigned         gotCompiled:1;     /* true once DFA has been compiled   */
+};
+
+
+acm_t acm_create(void)
+{
+    acm_t acm;
+
+    if (!(acm = malloc(sizeof(struct acm)))) {
+        out_of_memory();
+    }
+    memset(acm, 0, sizeof(struct acm));
+    return(acm);
+}
+
+
+void acm_destroy(acm_t acm)
+{
+    int i;
+
+    if (!acm) {
+        return;
+    }
+    if (acm->pats) {
+        for (i = 0; i < acm->numPats; i++) {
+            free(acm->pats[i]);
+        }
+        free(acm->pats);
+    }
+    free(acm->lens);
+    free(acm->ids);
+    free(acm->delta);
+    free(acm->out);
+    free(acm->outNext);
+    free(acm->dict);
+    free(acm);
+    return;
+}
+
+
+int acm_add(acm_t acm, const void *pat, int len, int id)
+{
+    int n;
+
+    assert(acm != NULL);
+    assert(pat != NULL);
+
+    if ((len <= 0) || acm->gotCompiled) {
+        return(-1);
+    }
+    if (acm->numPats == acm->maxPats) {
+        n = (acm->maxPats > 0) ? acm->maxPats * 2 : 16;
+        if (!(acm->pats = realloc(acm->pats, n * sizeof(*acm->pats)))
+                || !(acm->lens = realloc(acm->lens, n * sizeof(int)))
+                || !(acm->ids = realloc(acm->ids, n * sizeof(int)))) {
+            out_of_memory();
+        }
+        acm->maxPats = n;
+    }
+    if (!(acm->pats[acm->numPats] = malloc(len))) {
+        out_of_memory();
+    }
+    memcpy(acm->pats[acm->numPats], pat, len);
+    acm->lens[acm->numPats] = len;
+    acm->ids[acm->numPats] = id;
+    acm->numPats++;
+    return(0);
+}
+
+
+int acm_compile(acm_t acm)
+{
+/*  The patterns are inserted into a trie whose missing transitions are then
+ *    filled in breadth-first from each state's failure state, turning it into
+ *    a DFA.  The trie is built directly within the DFA's transition table
+ *    (sized for the worst case and trimmed afterwards), with -1 marking
+ *    transitions not yet defined.
+ */
+    int maxStates;
+    int nc;
+    int *fail;
+    int *queue;
+    int head, tail;
+    int i, j, c;
+    int s, t, u;
+
+    assert(acm != NULL);
+
+    if (acm->gotCompiled) {
+        return(-1);
+    }
+    /*  Class 0 holds all bytes not occurring in any pattern.
+     */
+    nc = 1;
+    maxStates = 1;
+    for (i = 0; i < acm->numPats; i++) {
+        for (j = 0; j < acm->lens[i]; j++) {
+            if (acm->classes[acm->pats[i][j]] == 0) {
+                acm->classes[acm->pats[i][j]] = nc++;
+            }
+        }
+        maxStates += acm->lens[i];
+    }
+    acm->numClasses = nc;
+
+    if (!(acm->delta = malloc((size_t) maxStates * nc * sizeof(int)))
+            || !(acm->out = malloc(maxStates * sizeof(int)))
+            || !(acm->dict = malloc(maxStates * sizeof(int)))
+            || !(acm->outNext = malloc((acm->numPats + 1) * sizeof(int)))) {
+        out_of_memory();
+    }
+    /*  Every state's failure state starts out as the root.
+     */
+    if (!(fail = calloc(maxStates, sizeof(int)))) {
+        out_of_memory();
+    }
+    if (!(queue = malloc(maxStates * sizeof(int)))) {
+        out_of_memory();
+    }
+    memset(acm->delta, -1, (size_t) maxStates * nc * sizeof(int));
+    acm->out[0] = -1;
+    acm->numStates = 1;
+
+    /*  Insert the patterns into the trie, listing each pattern at the state
+     *    where it ends.  Patterns are prepended so that those added first
+     *    are listed first.
+     */
+    for (i = acm->numPats - 1; i >= 0; i--) {
+        s = 0;
+        for (j = 0; j < acm->lens[i]; j++) {
+            c = acm->classes[acm->pats[i][j]];
+            if ((t = acm->delta[s * nc + c]) < 0) {
+                t = acm->numStates++;
+                acm->delta[s * nc + c] = t;
+                acm->out[t] = -1;
+            }
+            s = t;
+        }
+        acm->outNext[i] = acm->out[s];
+        acm->out[s] = i;
+    }
+    /*  Compute the failure state of each state breadth-first, since it is
+     *    always shallower, and replace each missing transition with that of
+     *    the failure state.  The dictionary link of a state is the nearest
+     *    state along its failure chain having an output (or 0 for none,
+     *    since the root never does).
+     */
+    head = tail = 0;
+    fail[0] = acm->dict[0] = 0;
+    for (c = 0; c < nc; c++) {
+        if ((t = acm->delta[c]) < 0) {
+            acm->delta[c] = 0;
+        }
+        else {
+            fail[t] = acm->dict[t] = 0;
+            queue[tail++] = t;
+        }
+    }
+    while (head < tail) {
+        s = queue[head++];
+        for (c = 0; c < nc; c++) {
+            t = acm->delta[s * nc + c];
+            u = acm->delta[fail[s] * nc + c];
+            if (t < 0) {
+                acm->delta[s * nc + c] = u;
+            }
+            else {
+                fail[t] = u;
+                acm->dict[t] = (acm->out[u] >= 0) ? u : acm->dict[u];
+                queue[tail++] = t;
+            }
+        }
+    }
+    free(fail);
+    free(queue);
+
+    /*  Each transition is replaced by the offset of its target state's row
+     *    so the scan need not multiply, and that offset is complemented
+     *    (making it negative) if a pattern ends at the target state or any
+     *    of its suffixes, so the scan need only test its sign.
+     */
+    for (i = 0; i < acm->numStates * nc; i++) {
+        t = acm->delta[i];
+        acm->delta[i] = ((acm->out[t] >= 0) || (acm->dict[t] > 0))
+            ? ~(t * nc) : t * nc;
+    }
+    /*  Trim the tables to the number of states actually used.
+     */
+    if (acm->numStates < maxStates) {
+        if (!(acm->delta = realloc(acm->delta,
+                (size_t) acm->numStates * nc * sizeof(int)))
+                || !(acm->out = realloc(acm->out,
+                    acm->numStates * sizeof(int)))
+                || !(acm->dict = realloc(acm->dict,
+                    acm->numStates * sizeof(int)))) {
+            out_of_memory();
+        }
+    }
+    /*  The patterns are no longer needed once they are in the DFA.
+     */
+    for (i = 0; i < acm->numPats; i++) {
+        free(acm->pats[i]);
+    }
+    free(acm->pats);
+    free(acm->lens);
+    acm->pats = NULL;
+    acm->lens = NULL;
+    acm->gotCompiled = 1;
+    return(0);
+}
+
+
+int acm_scan(acm_t acm, int *statep, const void *src, int len,
+    acm_match_f fn, void *arg)
+{
+    const int *delta;
+    const unsigned char *classes;
+    const unsigned char *p;
+    const unsigned char *q;
+    int nc;
+    int s;
+    int u;
+    int i;
+    int n = 0;
+
+    assert(acm != NULL);
+    assert(acm->gotCompiled);
+    assert(statep != NULL);
+    assert((*statep >= 0) && (*statep < acm->numStates));
+
+    delta = acm->delta;
+    classes = acm->classes;
+    nc = acm->numClasses;
+    s = *statep * nc;
+
+    for (p = src, q = p + len; p < q; p++) {
+        s = delta[s + classes[*p]];
+        if (s < 0) {
+            s = ~s;
+            for (u = s / nc; u > 0; u = acm->dict[u]) {
+                for (i = acm->out[u]; i >= 0; i = acm->outNext[i]) {
+                    if (fn) {
+                        fn(arg, acm->ids[i]);
+                    }
+                    n++;
+                }
+            }
+        }
+    }
+    *statep = s / nc;
+    return(n);
+}
+
+
+int acm_num_states(acm_t acm)
+{
+    assert(acm != NULL);
+    return(acm->numStates);
+}
+
+
+long acm_size(acm_t acm)
+{
+    assert(acm != NULL);
+    return((long) acm->numStates
+        * (acm->numClasses * sizeof(int) + 2 * sizeof(int))
+        + (long) acm->numPats * 2 * sizeof(int));
+}
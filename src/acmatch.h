@@ -0,0 +1,95 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#ifndef _ACMATCH_H
+#define _ACMATCH_H
+
+
+/*  An Aho-Corasick multi-pattern matcher compiled into a DFA.
+ *  Bytes are mapped onto a compact alphabet of the bytes occurring in the
+ *    patterns (plus one class for all others), and every state holds a
+ *    transition for each class, so scanning costs one table lookup per
+ *    byte regardless of the number of patterns.  The scan state is kept by
+ *    the caller, so a match may span any number of successive scans.
+ */
+typedef struct acm * acm_t;
+
+typedef void (*acm_match_f)(void *arg, int id);
+/*
+ *  Function prototype for the callback invoked for each match found by
+ *    acm_scan(), where (id) is the id of the pattern matched and (arg) is
+ *    the argument passed to acm_scan().
+ */
+
+
+acm_t acm_create(void);
+/*
+ *  Creates a matcher without any patterns.
+ *  Returns the new matcher, which must be destroyed via acm_destroy().
+ */
+
+void acm_destroy(acm_t acm);
+/*
+ *  Destroys the matcher (acm).
+ */
+
+int acm_add(acm_t acm, const void *pat, int len, int id);
+/*
+ *  Adds the pattern (pat) of length (len) to the matcher (acm), to be
+ *    reported via the given (id).  Several patterns may share an id, and
+ *    a pattern may be added more than once with different ids.
+ *  Returns 0 on success, or -1 if the pattern is empty or the matcher
+ *    has already been compiled.
+ */
+
+int acm_compile(acm_t acm);
+/*
+ *  Compiles the patterns of the matcher (acm) into its DFA.
+ *  Returns 0 on success, or -1 if it has already been compiled.
+ */
+
+int acm_scan(acm_t acm, int *statep, const void *src, int len,
+    acm_match_f fn, void *arg);
+/*
+ *  Scans the (len) bytes of (src) with the compiled matcher (acm),
+ *    resuming from and updating the scan state (*statep), which must be
+ *    initialized to 0 before the first scan of a stream.
+ *  The callback (fn) is invoked with (arg) for each pattern ending within
+ *    (src); if several end at the same byte, the longest is reported first.
+ *  Returns the number of matches found.
+ */
+
+int acm_num_states(acm_t acm);
+/*
+ *  Returns the number of states in the DFA of the compiled matcher (acm).
+ */
+
+long acm_size(acm_t acm);
+/*
+ *  Returns the number of bytes allocated for the DFA of the compiled
+ *    matcher (acm).
+ */
+
+
+#endif /* !_ACMATCH_H */
@@ -30,12 +30,15 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <pwd.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 #include "client.h"
 #include "common.h"
@@ -47,6 +50,9 @@
 
 
 static void read_consoles_from_file(List consoles, char *file);
+static void parse_replay(req_t *req, const char *str);
+static void parse_time_range(req_t *req, char *str);
+static time_t parse_time(const char *str);
 static void display_client_help(client_conf_t *conf);
 
 
@@ -162,7 +168,7 @@ void process_client_cmd_line(int argc, char *argv[], client_conf_t *conf)
         conf->prog = create_string(argv[0]);
 
     opterr = 0;
-    while ((c = getopt(argc, argv, "bd:e:fF:hjl:LmqQrvV")) != -1) {
+    while ((c = getopt(argc, argv, "bd:e:fF:hjl:LmqQrR:s:S:t:T:vV")) != -1) {
         switch(c) {
         case 'b':
             conf->req->enableBroadcast = 1;
@@ -216,6 +222,28 @@ void process_client_cmd_line(int argc, char *argv[], client_conf_t *conf)
         case 'r':
             conf->req->enableRegex = 1;
             break;
+        case 'R':
+            parse_replay(conf->req, optarg);
+            break;
+        case 's':
+        case 'S':
+            conf->req->command = CONMAN_CMD_SEARCH;
+            conf->req->enableLiteral = (c == 'S');
+            if (conf->req->pattern)
+                free(conf->req->pattern);
+            conf->req->pattern = create_string(optarg);
+            break;
+        case 't':
+            conf->req->command = CONMAN_CMD_QUERY;
+            if ((i = atoi(optarg)) <= 0)
+                log_err(0, "CMDLINE: invalid tail amount \"%s\"", optarg);
+            conf->req->tailLines = i;
+            break;
+        case 'T':
+            if (conf->req->command != CONMAN_CMD_SEARCH)
+                conf->req->command = CONMAN_CMD_QUERY;
+            parse_time_range(conf->req, optarg);
+            break;
         case 'v':
             conf->enableVerbose = 1;
             break;
@@ -257,6 +285,7 @@ void process_client_cmd_line(int argc, char *argv[], client_conf_t *conf)
 
     if (gotHelp
         || ((conf->req->command != CONMAN_CMD_QUERY)
+            && (conf->req->command != CONMAN_CMD_SEARCH)
             && list_is_empty(conf->req->consoles))) {
         display_client_help(conf);
         exit(0);
@@ -312,6 +341,137 @@ static void read_consoles_from_file(List consoles, char *file)
 }
 
 
+static void parse_replay(req_t *req, const char *str)
+{
+/*  Parses 'str' for the amount of console log to replay upon connecting:
+ *    either "<int>" lines, or "<int>s|m|h|d" of time before now.
+ */
+    char buf[MAX_LINE];
+    char *q;
+    long l;
+
+    assert(req != NULL);
+    assert(str != NULL);
+
+    errno = 0;
+    l = strtol(str, &q, 10);
+    if ((q == str) || (errno == ERANGE) || (l <= 0) || (l > INT_MAX))
+        log_err(0, "CMDLINE: invalid replay amount \"%s\"", str);
+    if (*q == '\0') {
+        req->replayLines = l;
+        req->timeSince = 0;
+        return;
+    }
+    snprintf(buf, sizeof(buf), "-%s", str);
+    if ((req->timeSince = parse_time(buf)) <= 0)
+        log_err(0, "CMDLINE: invalid replay amount \"%s\"", str);
+    req->replayLines = 0;
+    return;
+}
+
+
+static void parse_time_range(req_t *req, char *str)
+{
+/*  Parses 'str' for a log time range of the form "[START][,END]",
+ *    setting the request's SINCE and UNTIL times accordingly.
+ */
+    char *p;
+
+    assert(req != NULL);
+    assert(str != NULL);
+
+    if ((p = strchr(str, ',')))
+        *p++ = '\0';
+    if ((*str != '\0') && ((req->timeSince = parse_time(str)) <= 0))
+        log_err(0, "CMDLINE: invalid time \"%s\"", str);
+    if (p && (*p != '\0') && ((req->timeUntil = parse_time(p)) <= 0))
+        log_err(0, "CMDLINE: invalid time \"%s\"", p);
+    if ((req->timeSince == 0) && (req->timeUntil == 0))
+        log_err(0, "CMDLINE: invalid time range");
+    return;
+}
+
+
+static time_t parse_time(const char *str)
+{
+/*  Parses 'str' for a time of the form "YYYY-MM-DD[ HH:MM[:SS]]",
+ *    "HH:MM[:SS]" (today), "-<int>[s|m|h|d]" (ago, defaulting to minutes),
+ *    "@<int>" (seconds since the epoch), or "now".
+ *  Returns the time, or -1 on error.
+ */
+    time_t now;
+    struct tm tm;
+    const char *p = str;
+    char *q;
+    long l;
+    int year, mon, day, hour, min, sec;
+    int n;
+
+    now = time(NULL);
+
+    if (!strcasecmp(p, "now"))
+        return(now);
+    if ((*p == '@') || (*p == '-')) {
+        errno = 0;
+        l = strtol(p + 1, &q, 10);
+        if ((q == p + 1) || (errno == ERANGE) || (l < 0))
+            return(-1);
+        if (*p == '@')
+            return((*q == '\0') ? (time_t) l : -1);
+        if ((*q != '\0') && (q[1] != '\0'))
+            return(-1);
+        if ((*q == 's') || (*q == 'S'))
+            ;
+        else if ((*q == '\0') || (*q == 'm') || (*q == 'M'))
+            l *= 60;
+        else if ((*q == 'h') || (*q == 'H'))
+            l *= 60 * 60;
+        else if ((*q == 'd') || (*q == 'D'))
+            l *= 60 * 60 * 24;
+        else
+            return(-1);
+        return(now - l);
+    }
+    if (!localtime_r(&now, &tm))
+        return(-1);
+    n = -1;
+    if ((sscanf(p, "%d-%d-%d%n", &year, &mon, &day, &n) == 3) && (n > 0)) {
+        if ((mon < 1) || (mon > 12) || (day < 1) || (day > 31))
+            return(-1);
+        tm.tm_year = year - 1900;
+        tm.tm_mon = mon - 1;
+        tm.tm_mday = day;
+        tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+        p += n;
+        if ((*p == ' ') || (*p == 'T'))
+            p++;
+        else if (*p != '\0')
+            return(-1);
+    }
+    if ((*p != '\0') || (p == str)) {
+        n = -1;
+        if ((sscanf(p, "%d:%d%n", &hour, &min, &n) != 2) || (n < 0))
+            return(-1);
+        p += n;
+        sec = 0;
+        if (*p == ':') {
+            n = -1;
+            if ((sscanf(++p, "%d%n", &sec, &n) != 1) || (n < 0))
+                return(-1);
+            p += n;
+        }
+        if ((*p != '\0') || (hour < 0) || (hour > 23) || (min < 0)
+          || (min > 59) || (sec < 0) || (sec > 60))
+            return(-1);
+        tm.tm_hour = hour;
+        tm.tm_min = min;
+        tm.tm_sec = sec;
+    }
+    tm.tm_isdst = -1;
+    return(mktime(&tm));
+}
+
+
 static void display_client_help(client_conf_t *conf)
 {
     char esc[3];
@@ -334,6 +494,11 @@ static void display_client_help(client_conf_t *conf)
     printf("  -q        Query server about specified console(s).\n");
     printf("  -Q        Be quiet and suppress informational messages.\n");
     printf("  -r        Match console names via regex instead of globbing.\n");
+    printf("  -R N      Replay last N lines (or N[s|m|h|d]) of the log.\n");
+    printf("  -s REGEX  Search console logs for lines matching REGEX.\n");
+    printf("  -S TEXT   Search console logs for lines containing TEXT.\n");
+    printf("  -t N      Display last N lines of console output.\n");
+    printf("  -T RANGE  Display console log written in [START][,END] range.\n");
     printf("  -v        Be verbose.\n");
     printf("  -V        Display version information.\n");
     printf("\n");
@@ -42,6 +42,7 @@
 #include "util-file.h"
 #include "util-net.h"
 #include "util-str.h"
+#include "util.h"
 
 
 static void parse_rsp_ok(Lex l, client_conf_t *conf);
@@ -167,6 +168,9 @@ int send_req(client_conf_t *conf)
     case CONMAN_CMD_CONNECT:
         cmd = LEX_TOK2STR(proto_strs, CONMAN_TOK_CONNECT);
         break;
+    case CONMAN_CMD_SEARCH:
+        cmd = LEX_TOK2STR(proto_strs, CONMAN_TOK_SEARCH);
+        break;
     default:
         log_err(0, "INTERNAL: Invalid command=%d", conf->req->command);
         break;
@@ -184,6 +188,39 @@ int send_req(client_conf_t *conf)
             LEX_TOK2STR(proto_strs, CONMAN_TOK_OPTION),
             LEX_TOK2STR(proto_strs, CONMAN_TOK_REGEX));
     }
+    if (conf->req->timeSince != 0) {
+        n = append_format_string(buf, sizeof(buf), " %s=%ld",
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_SINCE),
+            (long) conf->req->timeSince);
+    }
+    if (conf->req->command == CONMAN_CMD_SEARCH) {
+        n = append_format_string(buf, sizeof(buf), " %s='%s'",
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_PATTERN),
+            lex_encode(conf->req->pattern));
+        if (conf->req->enableLiteral) {
+            n = append_format_string(buf, sizeof(buf), " %s=%s",
+                LEX_TOK2STR(proto_strs, CONMAN_TOK_OPTION),
+                LEX_TOK2STR(proto_strs, CONMAN_TOK_LITERAL));
+        }
+    }
+    if ((conf->req->command == CONMAN_CMD_QUERY)
+      || (conf->req->command == CONMAN_CMD_SEARCH)) {
+        if (conf->req->timeUntil != 0) {
+            n = append_format_string(buf, sizeof(buf), " %s=%ld",
+                LEX_TOK2STR(proto_strs, CONMAN_TOK_UNTIL),
+                (long) conf->req->timeUntil);
+        }
+        if (conf->req->tailLines > 0) {
+            n = append_format_string(buf, sizeof(buf), " %s=%d",
+                LEX_TOK2STR(proto_strs, CONMAN_TOK_TAIL),
+                conf->req->tailLines);
+        }
+    }
+    else if (conf->req->replayLines > 0) {
+        n = append_format_string(buf, sizeof(buf), " %s=%d",
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_REPLAY),
+            conf->req->replayLines);
+    }
     if (conf->req->command == CONMAN_CMD_CONNECT) {
         if (conf->req->enableForce) {
             n = append_format_string(buf, sizeof(buf), " %s=%s",
@@ -246,7 +283,9 @@ int send_req(client_conf_t *conf)
 
 int recv_rsp(client_conf_t *conf)
 {
-    char buf[MAX_SOCK_LINE];
+    char *buf;
+    size_t size = MAX_SOCK_LINE;
+    size_t len = 0;
     int n;
     Lex l;
     int done = 0;
@@ -254,18 +293,34 @@ int recv_rsp(client_conf_t *conf)
 
     assert(conf->req->sd >= 0);
 
-    if ((n = read_line(conf->req->sd, buf, sizeof(buf))) < 0) {
-        conf->errnum = CONMAN_ERR_LOCAL;
-        conf->errmsg = create_format_string("Unable to read response"
-            " from <%s:%d>:\n  %s (blocked by TCP-Wrappers?)",
-            conf->req->host, conf->req->port, strerror(errno));
-        return(-1);
-    }
-    else if (n == 0) {
-        conf->errnum = CONMAN_ERR_LOCAL;
-        conf->errmsg = create_format_string("Connection terminated by <%s:%d>",
-            conf->req->host, conf->req->port);
-        return(-1);
+    /*  The response line may exceed MAX_SOCK_LINE when listing many consoles,
+     *    so the buffer is doubled until the newline is read.
+     */
+    if (!(buf = malloc(size)))
+        out_of_memory();
+    for (;;) {
+        if ((n = read_line(conf->req->sd, buf + len, size - len)) < 0) {
+            conf->errnum = CONMAN_ERR_LOCAL;
+            conf->errmsg = create_format_string("Unable to read response"
+                " from <%s:%d>:\n  %s (blocked by TCP-Wrappers?)",
+                conf->req->host, conf->req->port, strerror(errno));
+            free(buf);
+            return(-1);
+        }
+        else if ((n == 0) && (len == 0)) {
+            conf->errnum = CONMAN_ERR_LOCAL;
+            conf->errmsg = create_format_string(
+                "Connection terminated by <%s:%d>",
+                conf->req->host, conf->req->port);
+            free(buf);
+            return(-1);
+        }
+        len += n;
+        if ((n == 0) || (buf[len - 1] == '\n') || (len < size - 1))
+            break;
+        size *= 2;
+        if (!(buf = realloc(buf, size)))
+            out_of_memory();
     }
 
     l = lex_create(buf, proto_strs);
@@ -289,6 +344,7 @@ int recv_rsp(client_conf_t *conf)
         }
     }
     lex_destroy(l);
+    free(buf);
 
     if (done == 1)
         return(0);
@@ -386,6 +442,7 @@ void display_error(client_conf_t *conf)
         display_data(conf, STDERR_FILENO);
 
     if ((conf->errnum == CONMAN_ERR_TOO_MANY_CONSOLES)
+      && (conf->req->command != CONMAN_CMD_QUERY)
       && (!conf->req->enableBroadcast))
         p = "\nDo you want to broadcast (-b) to multiple consoles?\n\n";
     else if ((conf->errnum == CONMAN_ERR_BUSY_CONSOLES)
@@ -198,6 +198,7 @@ static int read_from_stdin(client_conf_t *conf)
         case ESC_CHAR_JOIN:
             return(perform_join_esc(conf, c));
         case ESC_CHAR_REPLAY:
+        case ESC_CHAR_DEEP_REPLAY:
             return(perform_log_replay_esc(conf, c));
         case ESC_CHAR_MONITOR:
             return(perform_monitor_esc(conf, c));
@@ -451,6 +452,22 @@ static int perform_help_esc(client_conf_t *conf, char c)
         (void) append_format_string(buf, sizeof(buf),
             "  %2s%-2s -  Replay up to the last %d bytes of the log.\r\n",
             esc, tmp, LOG_REPLAY_LEN);
+        write_esc_char(ESC_CHAR_DEEP_REPLAY, tmp);
+        if (conf->req->replayLines > 0) {
+            (void) append_format_string(buf, sizeof(buf),
+                "  %2s%-2s -  Replay the last %d lines of the log.\r\n",
+                esc, tmp, conf->req->replayLines);
+        }
+        else if (conf->req->timeSince > 0) {
+            (void) append_format_string(buf, sizeof(buf),
+                "  %2s%-2s -  Replay the log since the -R time.\r\n",
+                esc, tmp);
+        }
+        else {
+            (void) append_format_string(buf, sizeof(buf),
+                "  %2s%-2s -  Replay the last %d lines of the log.\r\n",
+                esc, tmp, LOG_DEEP_REPLAY_LINES);
+        }
     }
 
     if ((conf->req->command == CONMAN_CMD_CONNECT) &&
@@ -55,6 +55,12 @@ int main(int argc, char *argv[])
         display_error(conf);
     else if (recv_rsp(conf) < 0)
         display_error(conf);
+    else if ((conf->req->command == CONMAN_CMD_QUERY)
+      && ((conf->req->timeSince != 0) || (conf->req->timeUntil != 0)
+        || (conf->req->tailLines > 0)))
+        display_data(conf, STDOUT_FILENO);
+    else if (conf->req->command == CONMAN_CMD_SEARCH)
+        display_data(conf, STDOUT_FILENO);
     else if (conf->req->command == CONMAN_CMD_QUERY)
         display_consoles(conf, STDOUT_FILENO);
     else if ((conf->req->command == CONMAN_CMD_CONNECT)
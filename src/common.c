@@ -65,15 +65,23 @@ char *proto_strs[] = {
     "FORCE",
     "HELLO",
     "JOIN",
+    "LITERAL",
     "MESSAGE",
     "MONITOR",
     "OK",
     "OPTION",
+    "PATTERN",
+    "PROTOCOL",
     "QUERY",
     "QUIET",
     "REGEX",
+    "REPLAY",
     "RESET",
+    "SEARCH",
+    "SINCE",
+    "TAIL",
     "TTY",
+    "UNTIL",
     "USER",
     NULL
 };
@@ -95,11 +103,18 @@ req_t * create_req(void)
     req->ip = NULL;
     req->port = 0;
     req->consoles = list_create((ListDelF) destroy_string);
+    req->timeSince = 0;
+    req->timeUntil = 0;
+    req->replayLines = 0;
+    req->tailLines = 0;
+    req->pattern = NULL;
+    req->protocol = CONMAN_PROTOCOL_LINE;
     req->command = CONMAN_CMD_NONE;
     req->enableBroadcast = 0;
     req->enableEcho = 0;
     req->enableForce = 0;
     req->enableJoin = 0;
+    req->enableLiteral = 0;
     req->enableQuiet = 0;
     req->enableRegex = 0;
     req->enableReset = 0;
@@ -131,6 +146,8 @@ void destroy_req(req_t *req)
         free(req->ip);
     if (req->consoles)
         list_destroy(req->consoles);
+    if (req->pattern)
+        free(req->pattern);
 
     free(req);
     return;
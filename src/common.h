@@ -26,6 +26,7 @@
 #define _COMMON_H
 
 #include <termios.h>
+#include <time.h>
 #include "lex.h"
 #include "list.h"
 
@@ -77,11 +78,49 @@
  *
  *    - OBJ_BUF_SIZE >= LOG_REPLAY_LEN * 2
  *    - OBJ_BUF_SIZE >= MAX_LINE
+ *    - OBJ_BUF_MIN_SIZE >= MAX_LINE
  *    - MAX_BUF_SIZE >= MAX_LINE
  *    - MAX_SOCK_LINE >= MAX_LINE
+ *
+ *  An obj's circular-buffer is allocated on demand starting at
+ *    OBJ_BUF_MIN_SIZE bytes, and doubles in size as needed up to a
+ *    per-obj limit (OBJ_BUF_SIZE by default).
+ *
+ *  A readable console fd is drained until it would block or until
+ *    OBJ_READ_BUDGET bytes have been read, whichever comes first;
+ *    the budget bounds the time one busy console can starve the others.
+ *
+ *  Logfile writes are coalesced: buffered log data is written out once
+ *    LOG_FLUSH_LEN bytes (or half the logfile's buffer) have accumulated,
+ *    or LOG_FLUSH_MSECS after the first byte was buffered.
+ *
+ *  A compressed logfile accumulates log data into a frame that is
+ *    compressed & written out once it holds LOG_FRAME_LEN bytes,
+ *    or LOG_FRAME_MSECS after its first byte was accumulated.
+ *
+ *  A logfile's sidecar index gains an entry mapping the current time to
+ *    the logfile offset of the next write (or frame) if LOG_INDEX_SECS
+ *    have elapsed or LOG_INDEX_LEN bytes have been written since the
+ *    previous entry.
+ *
+ *  A deep log replay streams the console's on-disk logfile to the client
+ *    as its buffer drains, replaying the last LOG_DEEP_REPLAY_LINES lines
+ *    unless the client requested otherwise.
  */
 #define OBJ_BUF_SIZE            16384
+#define OBJ_BUF_MIN_SIZE        4096
+#define OBJ_BUF_MAX_SIZE        67108864
+#define OBJ_CHUNK_SIZE          8192
+#define OBJ_CHUNK_IOV_MAX       16
+#define OBJ_READ_BUDGET         65536
 #define LOG_REPLAY_LEN          4096
+#define LOG_DEEP_REPLAY_LINES   1000
+#define LOG_FLUSH_LEN           8192
+#define LOG_FLUSH_MSECS         100
+#define LOG_FRAME_LEN           65536
+#define LOG_FRAME_MSECS         1000
+#define LOG_INDEX_LEN           262144
+#define LOG_INDEX_SECS          10
 #define MAX_BUF_SIZE            4096
 #define MAX_SOCK_LINE           131072
 #define MAX_LINE                1024
@@ -99,10 +138,62 @@
 #define ESC_CHAR_JOIN           'J'
 #define ESC_CHAR_REPLAY         'L'
 #define ESC_CHAR_MONITOR        'M'
+#define ESC_CHAR_DEEP_REPLAY    'P'
 #define ESC_CHAR_QUIET          'Q'
 #define ESC_CHAR_RESET          'R'
 #define ESC_CHAR_SUSPEND        'Z'
 
+/*  Versions of the client-server protocol negotiated via the greeting.
+ *
+ *  A client requests the multiplexed protocol by adding PROTOCOL=2 to its
+ *    HELLO; a server supporting it adds PROTOCOL=2 to its OK response.
+ *    (An older server ignores the option and responds with a plain OK.)
+ *  Once negotiated, no request line follows.  Instead, the connection
+ *    carries frames in both directions, each consisting of an 8-byte
+ *    header followed by up to MUX_FRAME_MAX_LEN bytes of payload:
+ *
+ *      byte 0:     frame type (CONMAN_FRAME_*)
+ *      byte 1:     flags (CONMAN_FRAME_FLAG_*)
+ *      bytes 2-3:  payload length (network byte order)
+ *      bytes 4-7:  channel id (network byte order)
+ *
+ *  A channel is a client's session with a single console, and its id is
+ *    that console's id on the server.  Any number of channels can be open
+ *    over one connection.
+ *
+ *  OPEN    c->s: request a MONITOR or CONNECT of the consoles matching the
+ *                  request line in the payload (eg, "MONITOR CONSOLE='x*'");
+ *                  each console becomes a R/O or R/W channel, respectively
+ *          s->c: a channel has been opened for the console named in the
+ *                  payload; FLAG_WRITE is set if the channel is R/W
+ *  RSP     s->c: the OK or ERROR response line to an OPEN request, sent
+ *                  after its channels have been opened (if any)
+ *  DATA    c->s: input for the channel's console (including escapes)
+ *          s->c: output from the channel's console
+ *  WINDOW  c->s: grant the channel another (32-bit) number of bytes
+ *  CLOSE   c->s: close the channel, discarding its pending output
+ *          s->c: the channel has been closed (eg, its session was stolen)
+ *
+ *  Output is flow-controlled per channel: the server sends no more DATA
+ *    on a channel than it has been granted, starting with MUX_WINDOW_SIZE
+ *    bytes.  While a channel awaits its next WINDOW, its console's output
+ *    is held (up to its buffer size) just as for a suspended client.
+ */
+#define CONMAN_PROTOCOL_LINE    1
+#define CONMAN_PROTOCOL_MUX     2
+
+#define MUX_FRAME_HDR_LEN       8
+#define MUX_FRAME_MAX_LEN       8192
+#define MUX_WINDOW_SIZE         65536
+
+#define CONMAN_FRAME_OPEN       1
+#define CONMAN_FRAME_RSP        2
+#define CONMAN_FRAME_DATA       3
+#define CONMAN_FRAME_WINDOW     4
+#define CONMAN_FRAME_CLOSE      5
+
+#define CONMAN_FRAME_FLAG_WRITE 0x01
+
 /*  Version string information
  */
 #ifndef NDEBUG
@@ -111,6 +202,18 @@
 #  define FEATURE_DEBUG ""
 #endif /* !NDEBUG */
 
+#if WITH_EPOLL
+#  define FEATURE_EPOLL " EPOLL"
+#else
+#  define FEATURE_EPOLL ""
+#endif /* WITH_EPOLL */
+
+#if WITH_IO_URING
+#  define FEATURE_IO_URING " IO-URING"
+#else
+#  define FEATURE_IO_URING ""
+#endif /* WITH_IO_URING */
+
 #if WITH_FREEIPMI
 #  define FEATURE_FREEIPMI " FREEIPMI"
 #else
@@ -123,21 +226,29 @@
 #  define FEATURE_TCP_WRAPPERS ""
 #endif /* WITH_TCP_WRAPPERS */
 
+#if WITH_ZLIB
+#  define FEATURE_ZLIB " ZLIB"
+#else
+#  define FEATURE_ZLIB ""
+#endif /* WITH_ZLIB */
+
 #define CLIENT_FEATURES \
     (FEATURE_DEBUG)
 #define SERVER_FEATURES \
-    (FEATURE_DEBUG FEATURE_FREEIPMI FEATURE_TCP_WRAPPERS)
+    (FEATURE_DEBUG FEATURE_EPOLL FEATURE_IO_URING FEATURE_FREEIPMI \
+    FEATURE_TCP_WRAPPERS FEATURE_ZLIB)
 
 #if ! HAVE_SOCKLEN_T
 typedef int socklen_t;                  /* socklen_t is uint32_t in Posix.1g */
 #endif /* !HAVE_SOCKLEN_T */
 
 
-typedef enum cmd_type {                 /* ConMan command (2 bits)           */
+typedef enum cmd_type {                 /* ConMan command (3 bits)           */
     CONMAN_CMD_NONE,
     CONMAN_CMD_CONNECT,
     CONMAN_CMD_MONITOR,
-    CONMAN_CMD_QUERY
+    CONMAN_CMD_QUERY,
+    CONMAN_CMD_SEARCH
 } cmd_t;
 
 typedef struct request {
@@ -149,11 +260,18 @@ typedef struct request {
     char     *ip;                       /* queried remote ip addr string     */
     int       port;                     /* remote port number                */
     List      consoles;                 /* list of consoles affected by cmd  */
-    unsigned  command:2;                /* ConMan command to perform (cmd_t) */
+    time_t    timeSince;                /* start of log range/replay, or 0   */
+    time_t    timeUntil;                /* end of log range query, or 0      */
+    int       replayLines;              /* num log lines to replay, or 0     */
+    int       tailLines;                /* num lines for tail query, or 0    */
+    char     *pattern;                  /* pattern for search cmd, or NULL   */
+    int       protocol;                 /* protocol version for connection   */
+    unsigned  command:3;                /* ConMan command to perform (cmd_t) */
     unsigned  enableBroadcast:1;        /* true if b-casting to >1 consoles  */
     unsigned  enableEcho:1;             /* true if echoing standard input    */
     unsigned  enableForce:1;            /* true if forcing console conn      */
     unsigned  enableJoin:1;             /* true if joining console conn      */
+    unsigned  enableLiteral:1;          /* true if search pattern is literal */
     unsigned  enableQuiet:1;            /* true if suppressing info messages */
     unsigned  enableRegex:1;            /* true if regex console matching    */
     unsigned  enableReset:1;            /* true if server supports reset cmd */
@@ -168,7 +286,8 @@ enum err_type {
     CONMAN_ERR_AUTHENTICATE,
     CONMAN_ERR_NO_CONSOLES,
     CONMAN_ERR_TOO_MANY_CONSOLES,
-    CONMAN_ERR_BUSY_CONSOLES
+    CONMAN_ERR_BUSY_CONSOLES,
+    CONMAN_ERR_NO_LOGFILE
 };
 
 enum proto_toks {
@@ -183,15 +302,23 @@ enum proto_toks {
     CONMAN_TOK_FORCE,
     CONMAN_TOK_HELLO,
     CONMAN_TOK_JOIN,
+    CONMAN_TOK_LITERAL,
     CONMAN_TOK_MESSAGE,
     CONMAN_TOK_MONITOR,
     CONMAN_TOK_OK,
     CONMAN_TOK_OPTION,
+    CONMAN_TOK_PATTERN,
+    CONMAN_TOK_PROTOCOL,
     CONMAN_TOK_QUERY,
     CONMAN_TOK_QUIET,
     CONMAN_TOK_REGEX,
+    CONMAN_TOK_REPLAY,
     CONMAN_TOK_RESET,
+    CONMAN_TOK_SEARCH,
+    CONMAN_TOK_SINCE,
+    CONMAN_TOK_TAIL,
     CONMAN_TOK_TTY,
+    CONMAN_TOK_UNTIL,
     CONMAN_TOK_USER
 };
 
@@ -0,0 +1,174 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The confload-bench utility measures how long the daemon takes to read its
+ *    configuration.  For each requested number of consoles, it writes a
+ *    synthetic config (alternating telnet and test consoles, each logging to
+ *    its own file) and times process_config() on it, as done at startup.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "common.h"
+#include "list.h"
+#include "log.h"
+#include "server.h"
+#include "tpoll.h"
+#include "util-str.h"
+#include "util.h"
+
+
+/*  Required by the server objs for setting timers.
+ */
+tpoll_t tp_global = NULL;
+
+
+static void display_help(const char *prog);
+static void write_config(const char *path, int numConsoles);
+static double get_secs(void);
+
+
+int main(int argc, char *argv[])
+{
+    int c;
+    int sizes[] = { 1000, 10000, 40000, 100000 };
+    int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+    int numConsoles = 0;
+    char path[] = "/tmp/confload-bench.XXXXXX";
+    int fd;
+    server_conf_t *conf;
+    double t0, t1;
+    int i;
+
+    log_set_file(stderr, LOG_WARNING, 0);
+
+    opterr = 0;
+    while ((c = getopt(argc, argv, "hn:")) != -1) {
+        switch(c) {
+        case 'h':
+            display_help(argv[0]);
+            exit(0);
+        case 'n':
+            if ((numConsoles = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid count \"%s\"", optarg);
+            }
+            break;
+        case '?':                       /* invalid option */
+            log_err(0, "CMDLINE: invalid option \"%c\"", optopt);
+            exit(1);
+        default:
+            log_err(0, "CMDLINE: option \"%c\" not implemented", c);
+            exit(1);
+        }
+    }
+    if (optind != argc) {
+        display_help(argv[0]);
+        exit(1);
+    }
+    if (numConsoles > 0) {
+        sizes[0] = numConsoles;
+        numSizes = 1;
+    }
+    if ((fd = mkstemp(path)) < 0) {
+        log_err(errno, "Unable to create \"%s\"", path);
+    }
+    (void) close(fd);
+
+    printf("%10s %12s %18s\n", "consoles", "load (ms)", "per console (us)");
+    for (i = 0; i < numSizes; i++) {
+        write_config(path, sizes[i]);
+        conf = create_server_conf();
+        tp_global = conf->tp;
+        replace_string(&conf->confFileName, path);
+        t0 = get_secs();
+        process_config(conf);
+        t1 = get_secs();
+        printf("%10d %12.1f %18.2f\n", sizes[i], (t1 - t0) * 1e3,
+            (t1 - t0) * 1e6 / sizes[i]);
+        destroy_server_conf(conf);
+        tp_global = NULL;
+    }
+    (void) unlink(path);
+    return(0);
+}
+
+
+static void display_help(const char *prog)
+{
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("\n");
+    printf("  -h        Display this help message.\n");
+    printf("  -n N      Specify number of consoles "
+        "(default: 1000, 10000, 40000, 100000).\n");
+    printf("\n");
+    return;
+}
+
+
+static void write_config(const char *path, int numConsoles)
+{
+/*  Writes a synthetic config of (numConsoles) consoles to (path).
+ */
+    FILE *fp;
+    int i;
+
+    if (!(fp = fopen(path, "w"))) {
+        log_err(errno, "Unable to open \"%s\"", path);
+    }
+    fprintf(fp, "server logdir=\"/tmp\"\n");
+    fprintf(fp, "global log=\"confload-bench/%%N.log\"\n");
+    for (i = 0; i < numConsoles; i++) {
+        if (i % 2) {
+            fprintf(fp, "console name=\"node%06d\" dev=\"test:\"\n", i);
+        }
+        else {
+            fprintf(fp, "console name=\"node%06d\" dev=\"ts%04d:%d\"\n",
+                i, i / 48, 7001 + i % 48);
+        }
+    }
+    if (fclose(fp) == EOF) {
+        log_err(errno, "Unable to close \"%s\"", path);
+    }
+    return;
+}
+
+
+static double get_secs(void)
+{
+    struct timeval tv;
+
+    if (gettimeofday(&tv, NULL) < 0) {
+        log_err(errno, "Unable to get time of day");
+    }
+    return(tv.tv_sec + tv.tv_usec / 1e6);
+}
@@ -0,0 +1,377 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The conmanlog utility writes the contents of a console logfile to stdout,
+ *    decompressing it if it was written with the "compress" logopt.
+ *  Since each frame records its own length, the start of the output can
+ *    be located by seeking from frame to frame without decompressing them.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "common.h"
+#include "log.h"
+#include "logframe.h"
+#include "util.h"
+
+
+#define LOGCAT_FOLLOW_SECS      1
+
+
+static void display_help(const char *prog);
+static off_t parse_size(const char *str);
+static off_t find_frame_tail(int fd, const char *name, off_t tail);
+static void cat_frames(int fd, const char *name, off_t off, int follow);
+static void cat_plain(int fd, const char *name, off_t tail, int follow);
+static int read_at(int fd, const char *name, void *dst, int len, off_t off);
+static void write_all(const void *src, int len);
+
+
+int main(int argc, char *argv[])
+{
+    int c;
+    int follow = 0;
+    off_t tail = -1;
+    const char *name;
+    int fd;
+    unsigned char hdr[LOGFRAME_HDR_LEN];
+    int framelen;
+    int datalen;
+    int n;
+
+    log_set_file(stderr, LOG_WARNING, 0);
+
+    opterr = 0;
+    while ((c = getopt(argc, argv, "fhLt:V")) != -1) {
+        switch(c) {
+        case 'f':
+            follow = 1;
+            break;
+        case 'h':
+            display_help(argv[0]);
+            exit(0);
+        case 'L':
+            printf("%s", conman_license);
+            exit(0);
+        case 't':
+            if ((tail = parse_size(optarg)) < 0) {
+                log_err(0, "CMDLINE: invalid size \"%s\"", optarg);
+            }
+            break;
+        case 'V':
+            printf("%s-%s\n", PACKAGE, VERSION);
+            exit(0);
+        case '?':                       /* invalid option */
+            log_err(0, "CMDLINE: invalid option \"%c\"", optopt);
+            exit(1);
+        default:
+            log_err(0, "CMDLINE: option \"%c\" not implemented", c);
+            exit(1);
+        }
+    }
+    if (optind != argc - 1) {
+        display_help(argv[0]);
+        exit(1);
+    }
+    name = argv[optind];
+    if ((fd = open(name, O_RDONLY)) < 0) {
+        log_err(errno, "Unable to open \"%s\"", name);
+    }
+    /*  A logfile whose first frame header cannot be parsed is plain text
+     *    (or is empty, in which case the first frame has yet to be written).
+     */
+    n = read_at(fd, name, hdr, sizeof(hdr), 0);
+    if ((n == sizeof(hdr))
+            && (logframe_parse_header(hdr, n, &framelen, &datalen) == 0)) {
+        cat_frames(fd, name, (tail < 0) ? 0 : find_frame_tail(fd, name, tail),
+            follow);
+    }
+    else if ((n == 0) && follow) {
+        while ((n = read_at(fd, name, hdr, sizeof(hdr), 0)) < (int) sizeof(hdr))
+            sleep(LOGCAT_FOLLOW_SECS);
+        if (logframe_parse_header(hdr, n, &framelen, &datalen) == 0) {
+            cat_frames(fd, name, 0, follow);
+        }
+        else {
+            cat_plain(fd, name, tail, follow);
+        }
+    }
+    else {
+        cat_plain(fd, name, tail, follow);
+    }
+    (void) close(fd);
+    return(0);
+}
+
+
+static void display_help(const char *prog)
+{
+    printf("Usage: %s [OPTIONS] FILE\n", prog);
+    printf("\n");
+    printf("  -f        Follow the logfile as it grows.\n");
+    printf("  -h        Display this help.\n");
+    printf("  -L        Display license information.\n");
+    printf("  -t SIZE   Display at least the last SIZE[k|m|g] bytes.\n");
+    printf("  -V        Display version information.\n");
+    printf("\n");
+    return;
+}
+
+
+static off_t parse_size(const char *str)
+{
+/*  Parses 'str' for a size of the form "<int>[k|m|g]".
+ *  Returns the size in bytes, or -1 on error.
+ */
+    long l;
+    off_t n;
+    char *endp;
+
+    errno = 0;
+    l = strtol(str, &endp, 10);
+    if ((endp == str) || (errno == ERANGE) || (l < 0)) {
+        return(-1);
+    }
+    n = l;
+    if ((*endp == 'k') || (*endp == 'K')) {
+        n *= 1024;
+        endp++;
+    }
+    else if ((*endp == 'm') || (*endp == 'M')) {
+        n *= 1024 * 1024;
+        endp++;
+    }
+    else if ((*endp == 'g') || (*endp == 'G')) {
+        n *= 1024 * 1024 * 1024;
+        endp++;
+    }
+    if ((*endp != '\0') || (n < l)) {
+        return(-1);
+    }
+    return(n);
+}
+
+
+static off_t find_frame_tail(int fd, const char *name, off_t tail)
+{
+/*  Returns the offset of the last frame in the compressed logfile (fd)
+ *    from which at least (tail) bytes of data remain.
+ *  Only the frame headers are read, skipping from one to the next.
+ */
+    unsigned char hdr[LOGFRAME_HDR_LEN];
+    off_t off;
+    off_t total = 0;
+    int framelen;
+    int datalen;
+
+    for (off = 0; read_at(fd, name, hdr, sizeof(hdr), off) == sizeof(hdr);
+            off += framelen) {
+        if (logframe_parse_header(hdr, sizeof(hdr), &framelen, &datalen) < 0) {
+            break;
+        }
+        total += datalen;
+    }
+    for (off = 0; total > tail; off += framelen) {
+        if (read_at(fd, name, hdr, sizeof(hdr), off) != sizeof(hdr)) {
+            break;
+        }
+        if (logframe_parse_header(hdr, sizeof(hdr), &framelen, &datalen) < 0) {
+            break;
+        }
+        if (total - datalen < tail) {
+            break;
+        }
+        total -= datalen;
+    }
+    return(off);
+}
+
+
+static void cat_frames(int fd, const char *name, off_t off, int follow)
+{
+/*  Decompresses the frames of the logfile (fd) starting at offset (off),
+ *    writing their data to stdout.
+ *  If (follow) is set, frames appended to the logfile are awaited
+ *    indefinitely; o/w, this returns once the end of the logfile is reached.
+ */
+    z_stream zs;
+    unsigned char *src = NULL;
+    unsigned char *dst = NULL;
+    int srclen = 0;
+    int dstlen = 0;
+    int framelen;
+    int datalen;
+    int n;
+
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+        log_err(0, "Unable to initialize zlib");
+    }
+    for (;;) {
+        if (!src) {
+            srclen = LOGFRAME_HDR_LEN;
+            if (!(src = malloc(srclen))) {
+                out_of_memory();
+            }
+        }
+        n = read_at(fd, name, src, LOGFRAME_HDR_LEN, off);
+        if (n == 0) {
+            if (!follow) {
+                break;
+            }
+            sleep(LOGCAT_FOLLOW_SECS);
+            continue;
+        }
+        if ((n == LOGFRAME_HDR_LEN)
+                && (logframe_parse_header(src, n, &framelen, &datalen) < 0)) {
+            log_err(0, "Invalid frame at offset %lld in \"%s\"",
+                (long long) off, name);
+        }
+        if ((n == LOGFRAME_HDR_LEN) && (framelen > srclen)) {
+            if (!(src = realloc(src, framelen))) {
+                out_of_memory();
+            }
+            srclen = framelen;
+        }
+        if ((n == LOGFRAME_HDR_LEN) && (datalen > dstlen)) {
+            if (!(dst = realloc(dst, datalen))) {
+                out_of_memory();
+            }
+            dstlen = datalen;
+        }
+        if ((n < LOGFRAME_HDR_LEN)
+                || (read_at(fd, name, src, framelen, off) < framelen)) {
+            /*
+             *  The frame is incomplete: either it is still being written,
+             *    or the daemon was interrupted while writing it.
+             */
+            if (!follow) {
+                log_msg(LOG_WARNING, "Truncated frame at offset %lld in \"%s\"",
+                    (long long) off, name);
+                break;
+            }
+            sleep(LOGCAT_FOLLOW_SECS);
+            continue;
+        }
+        if (logframe_decode(&zs, dst, dstlen, src, framelen) != datalen) {
+            log_err(0, "Corrupted frame at offset %lld in \"%s\"",
+                (long long) off, name);
+        }
+        write_all(dst, datalen);
+        off += framelen;
+    }
+    (void) inflateEnd(&zs);
+    free(src);
+    free(dst);
+    return;
+}
+
+
+static void cat_plain(int fd, const char *name, off_t tail, int follow)
+{
+/*  Writes the uncompressed logfile (fd) to stdout, starting (tail) bytes
+ *    from the end if (tail) is non-negative.
+ *  If (follow) is set, data appended to the logfile is awaited
+ *    indefinitely; o/w, this returns once the end of the logfile is reached.
+ */
+    unsigned char buf[MAX_BUF_SIZE];
+    struct stat st;
+    off_t off = 0;
+    int n;
+
+    if ((tail >= 0) && (fstat(fd, &st) == 0) && (st.st_size > tail)) {
+        off = st.st_size - tail;
+    }
+    for (;;) {
+        n = read_at(fd, name, buf, sizeof(buf), off);
+        if (n == 0) {
+            if (!follow) {
+                break;
+            }
+            sleep(LOGCAT_FOLLOW_SECS);
+            continue;
+        }
+        write_all(buf, n);
+        off += n;
+    }
+    return;
+}
+
+
+static int read_at(int fd, const char *name, void *dst, int len, off_t off)
+{
+/*  Reads up to (len) bytes at offset (off) of the logfile (fd) into (dst).
+ *  Returns the number of bytes read (which is less than (len) only at EOF).
+ */
+    int n;
+    int m = 0;
+
+    while (m < len) {
+        n = pread(fd, (unsigned char *) dst + m, len - m, off + m);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_err(errno, "Unable to read from \"%s\"", name);
+        }
+        if (n == 0) {
+            break;
+        }
+        m += n;
+    }
+    return(m);
+}
+
+
+static void write_all(const void *src, int len)
+{
+/*  Writes (len) bytes of (src) to stdout.
+ */
+    int n;
+
+    while (len > 0) {
+        n = write(STDOUT_FILENO, src, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_err(errno, "Unable to write to stdout");
+        }
+        src = (const unsigned char *) src + n;
+        len -= n;
+    }
+    return;
+}
@@ -0,0 +1,392 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The connburst-bench utility measures how a running daemon copes with a
+ *    burst of clients, such as a cron job running "conman -q" on every node
+ *    at once.  It opens the requested number of connections concurrently
+ *    from a single thread, performs the greeting and a QUERY over each
+ *    (optionally restricted to console patterns given via -p, which
+ *    exercises the daemon's console name matching), and reports how many
+ *    completed and how long they took.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <sys/types.h>                  /* include before in.h for bsd */
+#include <netinet/in.h>                 /* include before inet.h for bsd */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "common.h"
+#include "lex.h"
+#include "log.h"
+#include "util-file.h"
+#include "util-net.h"
+#include "util-str.h"
+#include "util.h"
+
+
+typedef enum conn_state {
+    CONN_CONNECTING,                    /* awaiting non-blocking connect()   */
+    CONN_GREETING,                      /* awaiting response to greeting     */
+    CONN_QUERY,                         /* awaiting response to query        */
+    CONN_DONE,                          /* query response received           */
+    CONN_FAILED                         /* connection failed                 */
+} conn_state_t;
+
+typedef struct conn {
+    int              sd;                /* socket descriptor                 */
+    conn_state_t     state;             /* state of connection               */
+    double           tStart;            /* time connect() was initiated      */
+    double           tDone;             /* time query response was received  */
+} conn_t;
+
+
+static void display_help(const char *prog);
+static void start_conn(conn_t *c, struct sockaddr_in *addr);
+static void advance_conn(conn_t *c, const char *greeting, const char *query);
+static void finish_conn(conn_t *c, conn_state_t state);
+static int compare_doubles(const void *p1, const void *p2);
+static double get_secs(void);
+
+
+int main(int argc, char *argv[])
+{
+    int c;
+    char *host = "127.0.0.1";
+    int port = atoi(CONMAN_PORT);
+    int numConns = 2000;
+    int numActive = 0;
+    char *p;
+    struct sockaddr_in addr;
+    struct rlimit limit;
+    char greeting[MAX_LINE];
+    char *query;
+    int enableRegex = 0;
+    conn_t *conns;
+    struct pollfd *pfds;
+    int *idx;
+    double *lat;
+    double t0, t1;
+    int numDone = 0;
+    int numFailed = 0;
+    int i, n;
+
+    log_set_file(stderr, LOG_WARNING, 0);
+
+    if (!(query = malloc(MAX_SOCK_LINE))) {
+        out_of_memory();
+    }
+    snprintf(query, MAX_SOCK_LINE, "%s",
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_QUERY));
+
+    opterr = 0;
+    while ((c = getopt(argc, argv, "d:hn:p:r")) != -1) {
+        switch(c) {
+        case 'd':
+            host = optarg;
+            if ((p = strchr(host, ':'))) {
+                *p++ = '\0';
+                if ((port = atoi(p)) <= 0) {
+                    log_err(0, "CMDLINE: invalid port \"%s\"", p);
+                }
+            }
+            break;
+        case 'h':
+            display_help(argv[0]);
+            exit(0);
+        case 'n':
+            if ((numConns = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid count \"%s\"", optarg);
+            }
+            break;
+        case 'p':
+            if (append_format_string(query, MAX_SOCK_LINE, " %s='%s'",
+                    LEX_TOK2STR(proto_strs, CONMAN_TOK_CONSOLE),
+                    lex_encode(optarg)) < 0) {
+                log_err(0, "CMDLINE: too many console patterns");
+            }
+            break;
+        case 'r':
+            enableRegex = 1;
+            break;
+        case '?':                       /* invalid option */
+            log_err(0, "CMDLINE: invalid option \"%c\"", optopt);
+            exit(1);
+        default:
+            log_err(0, "CMDLINE: option \"%c\" not implemented", c);
+            exit(1);
+        }
+    }
+    if (optind != argc) {
+        display_help(argv[0]);
+        exit(1);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (host_name_to_addr4(host, &addr.sin_addr) < 0) {
+        log_err(0, "Unable to resolve \"%s\"", host);
+    }
+    /*  Each connection needs its own fd.
+     */
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+        log_err(errno, "Unable to get open file limit");
+    }
+    if (limit.rlim_cur < (rlim_t) numConns + 16) {
+        limit.rlim_cur = numConns + 16;
+        if (limit.rlim_max < limit.rlim_cur) {
+            limit.rlim_max = limit.rlim_cur;
+        }
+        if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+            log_err(errno, "Unable to set open file limit to %d",
+                numConns + 16);
+        }
+    }
+    snprintf(greeting, sizeof(greeting), "%s %s='bench'\n",
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_HELLO),
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_USER));
+    if (enableRegex) {
+        append_format_string(query, MAX_SOCK_LINE, " %s=%s",
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_OPTION),
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_REGEX));
+    }
+    if (append_format_string(query, MAX_SOCK_LINE, "\n") < 0) {
+        log_err(0, "CMDLINE: too many console patterns");
+    }
+
+    conns = malloc(numConns * sizeof(conn_t));
+    pfds = malloc(numConns * sizeof(struct pollfd));
+    idx = malloc(numConns * sizeof(int));
+    lat = malloc(numConns * sizeof(double));
+    if (!conns || !pfds || !idx || !lat) {
+        out_of_memory();
+    }
+    /*  Open every connection at once, then drive them all to completion.
+     */
+    t0 = get_secs();
+    for (i = 0; i < numConns; i++) {
+        start_conn(&conns[i], &addr);
+    }
+    for (;;) {
+        for (i = 0, numActive = 0; i < numConns; i++) {
+            if ((conns[i].state == CONN_DONE)
+                    || (conns[i].state == CONN_FAILED)) {
+                continue;
+            }
+            pfds[numActive].fd = conns[i].sd;
+            pfds[numActive].events = (conns[i].state == CONN_CONNECTING)
+                ? POLLOUT : POLLIN;
+            pfds[numActive].revents = 0;
+            idx[numActive] = i;
+            numActive++;
+        }
+        if (numActive == 0) {
+            break;
+        }
+        while ((n = poll(pfds, numActive, 60 * 1000)) < 0) {
+            if (errno != EINTR) {
+                log_err(errno, "Unable to poll connections");
+            }
+        }
+        if (n == 0) {
+            log_msg(LOG_WARNING, "Timed out with %d connection%s pending",
+                numActive, (numActive == 1) ? "" : "s");
+            for (i = 0; i < numActive; i++) {
+                finish_conn(&conns[idx[i]], CONN_FAILED);
+            }
+            break;
+        }
+        for (i = 0; i < numActive; i++) {
+            if (pfds[i].revents) {
+                advance_conn(&conns[idx[i]], greeting, query);
+            }
+        }
+    }
+    t1 = get_secs();
+
+    for (i = 0; i < numConns; i++) {
+        if (conns[i].state == CONN_DONE) {
+            lat[numDone++] = conns[i].tDone - conns[i].tStart;
+        }
+        else {
+            numFailed++;
+        }
+    }
+    qsort(lat, numDone, sizeof(double), compare_doubles);
+
+    printf("connections: %d\n", numConns);
+    printf("completed:   %d\n", numDone);
+    printf("failed:      %d\n", numFailed);
+    printf("elapsed:     %.3f s (%.0f conn/s)\n",
+        t1 - t0, (t1 > t0) ? numDone / (t1 - t0) : 0.0);
+    if (numDone > 0) {
+        printf("latency:     p50 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+            lat[numDone / 2] * 1e3, lat[(numDone - 1) * 99 / 100] * 1e3,
+            lat[numDone - 1] * 1e3);
+    }
+    free(conns);
+    free(pfds);
+    free(idx);
+    free(lat);
+    free(query);
+    return(numFailed ? 1 : 0);
+}
+
+
+static void display_help(const char *prog)
+{
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("\n");
+    printf("  -d HOST   Specify daemon location [host:port] "
+        "(default: 127.0.0.1:%s).\n", CONMAN_PORT);
+    printf("  -h        Display this help message.\n");
+    printf("  -n N      Specify number of connections (default: 2000).\n");
+    printf("  -p PAT    Query consoles matching PAT (may be repeated).\n");
+    printf("  -r        Match console patterns as regular expressions.\n");
+    printf("\n");
+    return;
+}
+
+
+static void start_conn(conn_t *c, struct sockaddr_in *addr)
+{
+/*  Initiates a non-blocking connect() for the connection (c) to (addr).
+ */
+    c->tStart = get_secs();
+    c->tDone = 0;
+    if ((c->sd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        log_err(errno, "Unable to create socket");
+    }
+    set_fd_nonblocking(c->sd);
+    c->state = CONN_CONNECTING;
+    if (connect(c->sd, (struct sockaddr *) addr, sizeof(*addr)) < 0) {
+        if (errno != EINPROGRESS) {
+            finish_conn(c, CONN_FAILED);
+        }
+    }
+    return;
+}
+
+
+static void advance_conn(conn_t *c, const char *greeting, const char *query)
+{
+/*  Advances the connection (c) through the client protocol once its socket
+ *    is ready.  The responses are short, so each is expected to arrive in
+ *    a single read; the query response is read until EOF.
+ */
+    char buf[MAX_SOCK_LINE];
+    int err;
+    socklen_t len = sizeof(err);
+    int n;
+
+    switch(c->state) {
+    case CONN_CONNECTING:
+        if ((getsockopt(c->sd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+                || (err != 0)) {
+            finish_conn(c, CONN_FAILED);
+        }
+        else if (write_n(c->sd, (void *) greeting, strlen(greeting)) < 0) {
+            finish_conn(c, CONN_FAILED);
+        }
+        else {
+            c->state = CONN_GREETING;
+        }
+        break;
+    case CONN_GREETING:
+        if ((n = read(c->sd, buf, sizeof(buf) - 1)) <= 0) {
+            if ((n < 0) && (errno == EAGAIN)) {
+                break;
+            }
+            finish_conn(c, CONN_FAILED);
+        }
+        else if (strncmp(buf, LEX_TOK2STR(proto_strs, CONMAN_TOK_OK), 2)) {
+            finish_conn(c, CONN_FAILED);
+        }
+        else if (write_n(c->sd, (void *) query, strlen(query)) < 0) {
+            finish_conn(c, CONN_FAILED);
+        }
+        else {
+            c->state = CONN_QUERY;
+        }
+        break;
+    case CONN_QUERY:
+        if ((n = read(c->sd, buf, sizeof(buf))) < 0) {
+            if (errno != EAGAIN) {
+                finish_conn(c, CONN_FAILED);
+            }
+        }
+        else if (n == 0) {
+            finish_conn(c, CONN_DONE);
+        }
+        break;
+    default:
+        break;
+    }
+    return;
+}
+
+
+static void finish_conn(conn_t *c, conn_state_t state)
+{
+/*  Closes the connection (c), marking it with (state).
+ */
+    c->tDone = get_secs();
+    c->state = state;
+    if (c->sd >= 0) {
+        (void) close(c->sd);
+        c->sd = -1;
+    }
+    return;
+}
+
+
+static int compare_doubles(const void *p1, const void *p2)
+{
+    double d1 = *(const double *) p1;
+    double d2 = *(const double *) p2;
+
+    return((d1 > d2) - (d1 < d2));
+}
+
+
+static double get_secs(void)
+{
+    struct timeval tv;
+
+    if (gettimeofday(&tv, NULL) < 0) {
+        log_err(errno, "Unable to get time of day");
+    }
+    return(tv.tv_sec + tv.tv_usec / 1e6);
+}
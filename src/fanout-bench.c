@@ -0,0 +1,230 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The fanout-bench utility measures the cost of fanning out console data
+ *    to the objs reading from a console.  It creates a test console with a
+ *    logfile and a number of (suspended) client readers, and times repeated
+ *    calls to forward_obj_data() with small chunks as would be read from a
+ *    chatty console.  The logfile (written to /dev/null by default) is
+ *    flushed between batches of chunks as the logfile reactor would, but
+ *    only the forwarding is timed.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "common.h"
+#include "list.h"
+#include "log.h"
+#include "server.h"
+#include "tpoll.h"
+#include "util-str.h"
+#include "util.h"
+
+
+/*  Required by the server objs for setting timers.
+ */
+tpoll_t tp_global = NULL;
+
+
+#define BENCH_BATCH_CHUNKS      64
+
+
+static void display_help(const char *prog);
+static obj_t * create_bench_client(server_conf_t *conf, int i);
+static double get_secs(void);
+
+
+int main(int argc, char *argv[])
+{
+    int c;
+    int numChunks = 2000000;
+    int numClients = 4;
+    int chunkLen = 64;
+    char *path = "/dev/null";
+    server_conf_t *conf;
+    obj_t *console;
+    obj_t *logfile;
+    obj_t *client;
+    char errbuf[MAX_LINE];
+    char *buf;
+    double t0, t1;
+    double t = 0;
+    int i, j, n;
+
+    log_set_file(stderr, LOG_WARNING, 0);
+
+    opterr = 0;
+    while ((c = getopt(argc, argv, "c:f:hl:n:")) != -1) {
+        switch(c) {
+        case 'c':
+            if ((numClients = atoi(optarg)) < 0) {
+                log_err(0, "CMDLINE: invalid count \"%s\"", optarg);
+            }
+            break;
+        case 'f':
+            if (optarg[0] != '/') {
+                log_err(0, "CMDLINE: logfile \"%s\" is not absolute", optarg);
+            }
+            path = optarg;
+            break;
+        case 'h':
+            display_help(argv[0]);
+            exit(0);
+        case 'l':
+            if ((chunkLen = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid length \"%s\"", optarg);
+            }
+            break;
+        case 'n':
+            if ((numChunks = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid count \"%s\"", optarg);
+            }
+            break;
+        case '?':                       /* invalid option */
+            log_err(0, "CMDLINE: invalid option \"%c\"", optopt);
+            exit(1);
+        default:
+            log_err(0, "CMDLINE: option \"%c\" not implemented", c);
+            exit(1);
+        }
+    }
+    if (optind != argc) {
+        display_help(argv[0]);
+        exit(1);
+    }
+    if (!(buf = malloc(chunkLen))) {
+        out_of_memory();
+    }
+    for (i = 0; i < chunkLen; i++) {
+        buf[i] = (i % 80 == 79) ? '\n' : 'a' + (i % 26);
+    }
+    conf = create_server_conf();
+    tp_global = conf->tp;
+
+    if (!(console = create_test_obj(conf, "fanout", &conf->globalTestOpts,
+            errbuf, sizeof(errbuf)))) {
+        log_err(0, "Unable to create console: %s", errbuf);
+    }
+    if (!(logfile = create_logfile_obj(conf, path,
+            console, &conf->globalLogOpts, errbuf, sizeof(errbuf)))) {
+        log_err(0, "Unable to create logfile: %s", errbuf);
+    }
+    if (open_logfile_obj(logfile) < 0) {
+        log_err(0, "Unable to open logfile \"%s\"", path);
+    }
+    link_objs(console, logfile);
+
+    for (i = 0; i < numClients; i++) {
+        client = create_bench_client(conf, i);
+        link_objs(console, client);
+    }
+    for (i = 0; i < numChunks; i += n) {
+        n = MIN(numChunks - i, BENCH_BATCH_CHUNKS);
+        t0 = get_secs();
+        for (j = 0; j < n; j++) {
+            forward_obj_data(console, buf, chunkLen);
+        }
+        t1 = get_secs();
+        t += t1 - t0;
+        if (write_to_obj(logfile) < 0) {
+            log_err(0, "Unable to write logfile \"%s\"", path);
+        }
+    }
+
+    printf("readers:  1 logfile, %d client%s\n",
+        numClients, (numClients == 1 ? "" : "s"));
+    printf("chunks:   %d of %d bytes\n", numChunks, chunkLen);
+    printf("forward:  %.1f ns/chunk\n", t * 1e9 / numChunks);
+
+    destroy_server_conf(conf);
+    tp_global = NULL;
+    free(buf);
+    return(0);
+}
+
+
+static void display_help(const char *prog)
+{
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("\n");
+    printf("  -c N      Specify number of client readers (default: 4).\n");
+    printf("  -f FILE   Specify logfile (default: /dev/null).\n");
+    printf("  -h        Display this help message.\n");
+    printf("  -l N      Specify length of each chunk (default: 64).\n");
+    printf("  -n N      Specify number of chunks (default: 2000000).\n");
+    printf("\n");
+    return;
+}
+
+
+static obj_t * create_bench_client(server_conf_t *conf, int i)
+{
+/*  Creates the (i)th client obj over one end of a socketpair.
+ *  The client is suspended so its socket is never polled for writing.
+ */
+    int sv[2];
+    char buf[MAX_LINE];
+    req_t *req;
+    obj_t *client;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        log_err(errno, "Unable to create socketpair");
+    }
+    (void) close(sv[1]);
+
+    snprintf(buf, sizeof(buf), "bench%d", i);
+    req = create_req();
+    req->sd = sv[0];
+    req->user = create_string(buf);
+    req->host = create_string("localhost");
+    req->fqdn = create_string("localhost");
+    req->ip = create_string("127.0.0.1");
+    req->port = i + 1;
+    req->command = CONMAN_CMD_MONITOR;
+
+    client = create_client_obj(conf, req);
+    client->aux.client.gotSuspend = 1;
+    return(client);
+}
+
+
+static double get_secs(void)
+{
+    struct timeval tv;
+
+    if (gettimeofday(&tv, NULL) < 0) {
+        log_err(errno, "Unable to get time of day");
+    }
+    return(tv.tv_sec + tv.tv_usec / 1e6);
+}
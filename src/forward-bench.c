@@ -0,0 +1,652 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The forward-bench utility measures the cost of forwarding console data
+ *    through the daemon's I/O path with many active consoles.  It creates
+ *    a number of unix domain socket consoles, each monitored by a client
+ *    over a socketpair, and runs them on the daemon's reactors.  A forked
+ *    pump process writes data into every console and reads it back from
+ *    every client, limiting the data in flight per console so none of it
+ *    is overwritten.  The daemon's CPU time (via getrusage), read & write
+ *    syscalls (via /proc/self/io), and tpoll syscalls are reported for the
+ *    data forwarded.  Build with --enable-io-uring to measure the io_uring
+ *    backend instead of epoll.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "common.h"
+#include "list.h"
+#include "log.h"
+#include "server.h"
+#include "tpoll.h"
+#include "util-file.h"
+#include "util-str.h"
+#include "util.h"
+
+
+/*  Required by the server objs for setting timers.
+ */
+tpoll_t tp_global = NULL;
+
+
+/*  Max bytes written into a console but not yet read back from its client.
+ *  This must be less than a client's buffer so no data is overwritten.
+ */
+#define BENCH_WINDOW_LEN        (OBJ_BUF_SIZE / 2)
+
+#define BENCH_GB                (1024.0 * 1024.0 * 1024.0)
+
+
+typedef struct bench_stats {
+    double           secs;              /* wall-clock time                   */
+    double           usr;               /* user cpu time                     */
+    double           sys;               /* system cpu time                   */
+    long             numSwitches;       /* num context switches              */
+    unsigned long    numPolls;          /* num tpoll syscalls                */
+    unsigned long    numReads;          /* num read syscalls, or 0 if n/a    */
+    unsigned long    numWrites;         /* num write syscalls, or 0 if n/a   */
+} bench_stats_t;
+
+
+static void display_help(const char *prog);
+static void raise_nofile_limit(int n);
+static int create_bench_listener(const char *path);
+static obj_t * create_bench_client(server_conf_t *conf, int i, int *peer);
+static void send_peers(int sd, int fd1, int fd2);
+static void recv_peers(int sd, int *fd1, int *fd2);
+static void run_pump(int sd, int n, int numChunks, int chunkLen);
+static void get_stats(server_conf_t *conf, bench_stats_t *stats);
+static int get_proc_io(unsigned long *reads, unsigned long *writes);
+static double get_secs(void);
+
+
+int main(int argc, char *argv[])
+{
+    int c;
+    int numConsoles = 5000;
+    int numThreads = 1;
+    int numMegs = 1024;
+    int chunkLen = 1024;
+    int numChunks;
+    char dir[] = "/tmp/forward-bench.XXXXXX";
+    char dev[PATH_MAX];
+    char name[MAX_LINE];
+    char errbuf[MAX_LINE];
+    server_conf_t *conf;
+    obj_t *console;
+    int sv[2];
+    int sd;
+    int ld;
+    int peer1, peer2;
+    pid_t pid;
+    List dead;
+    bench_stats_t s0, s1;
+    unsigned long long numBytes = 0;
+    double gb;
+    int done = 0;
+    int i, k, n;
+    int fd;
+
+    log_set_file(stderr, LOG_WARNING, 0);
+
+    opterr = 0;
+    while ((c = getopt(argc, argv, "c:hl:m:t:")) != -1) {
+        switch(c) {
+        case 'c':
+            if ((numConsoles = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid count \"%s\"", optarg);
+            }
+            break;
+        case 'h':
+            display_help(argv[0]);
+            exit(0);
+        case 'l':
+            if (((chunkLen = atoi(optarg)) <= 0)
+                    || (chunkLen > BENCH_WINDOW_LEN)) {
+                log_err(0, "CMDLINE: invalid length \"%s\"", optarg);
+            }
+            break;
+        case 'm':
+            if ((numMegs = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid size \"%s\"", optarg);
+            }
+            break;
+        case 't':
+            if ((numThreads = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid thread count \"%s\"", optarg);
+            }
+            break;
+        case '?':                       /* invalid option */
+            log_err(0, "CMDLINE: invalid option \"%c\"", optopt);
+            exit(1);
+        default:
+            log_err(0, "CMDLINE: option \"%c\" not implemented", c);
+            exit(1);
+        }
+    }
+    if (optind != argc) {
+        display_help(argv[0]);
+        exit(1);
+    }
+    numChunks = ((double) numMegs * 1024 * 1024 / numConsoles + chunkLen - 1)
+        / chunkLen;
+    if (numChunks <= 0) {
+        numChunks = 1;
+    }
+    /*  Each console needs two fds in the daemon (its socket & its client's),
+     *    and two in the pump (their peers).
+     */
+    raise_nofile_limit(numConsoles * 2 + 64);
+
+    if (signal(SIGPIPE, SIG_IGN) == SIG_ERR) {
+        log_err(errno, "Unable to ignore SIGPIPE");
+    }
+    if (!mkdtemp(dir)) {
+        log_err(errno, "Unable to create directory \"%s\"", dir);
+    }
+    /*  The pump is forked before any of the daemon's fds are created (and
+     *    before its reactor threads are started).  Each console's peers are
+     *    passed to the pump over (sd) as they are created.
+     */
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0) {
+        log_err(errno, "Unable to create socketpair");
+    }
+    if ((pid = fork()) < 0) {
+        log_err(errno, "Unable to fork pump");
+    }
+    else if (pid == 0) {
+        (void) close(sv[0]);
+        run_pump(sv[1], numConsoles, numChunks, chunkLen);
+        _exit(0);
+    }
+    (void) close(sv[1]);
+    sd = sv[0];
+
+    conf = create_server_conf();
+    tp_global = conf->tp;
+    conf->numThreads = numThreads;
+
+    for (i = 0; i < numConsoles; i++) {
+        snprintf(name, sizeof(name), "bench%d", i);
+        snprintf(dev, sizeof(dev), "%s/%d", dir, i);
+        if (!create_unixsock_obj(conf, name, dev, errbuf, sizeof(errbuf))) {
+            log_err(0, "Unable to create console: %s", errbuf);
+        }
+    }
+    create_reactors(conf);
+
+    /*  Each console's socket is unlinked once connected since it is no longer
+     *    needed, and this keeps the directory from growing.
+     */
+    for (i = 0; i < numConsoles; i++) {
+        snprintf(name, sizeof(name), "bench%d", i);
+        console = find_console_obj(conf, name);
+        ld = create_bench_listener(console->aux.unixsock.dev);
+        if (open_unixsock_obj(console) < 0) {
+            log_err(0, "Unable to connect console [%s]", console->name);
+        }
+        if ((peer1 = accept(ld, NULL, NULL)) < 0) {
+            log_err(errno, "Unable to accept console [%s]", console->name);
+        }
+        if (close(ld) < 0) {
+            log_err(errno, "Unable to close listening socket");
+        }
+        if (unlink(console->aux.unixsock.dev) < 0) {
+            log_err(errno, "Unable to unlink \"%s\"",
+                console->aux.unixsock.dev);
+        }
+        link_objs(console, create_bench_client(conf, i, &peer2));
+        send_peers(sd, peer1, peer2);
+        (void) close(peer1);
+        (void) close(peer2);
+    }
+    if (rmdir(dir) < 0) {
+        log_err(errno, "Unable to remove directory \"%s\"", dir);
+    }
+    start_reactors(conf);
+    tpoll_set(conf->tp, sd, POLLIN);
+    dead = list_create(NULL);
+
+    get_stats(conf, &s0);
+    if (write(sd, "", 1) != 1) {
+        log_err(errno, "Unable to start pump");
+    }
+    /*  The main loop mirrors the daemon's mux_io() until the pump reports
+     *    that all of the data has been read back from the clients.
+     */
+    while (!done) {
+        while ((n = tpoll(conf->tp, 1000)) < 0) {
+            if (errno != EINTR) {
+                log_err(errno, "Unable to multiplex I/O");
+            }
+        }
+        for (k = 0; (n > 0) && ((fd = tpoll_ready(conf->tp, k)) >= 0); k++) {
+            if (fd == sd) {
+                if (read(sd, &numBytes, sizeof(numBytes))
+                        != sizeof(numBytes)) {
+                    log_err(0, "Pump exited prematurely");
+                }
+                done = 1;
+                continue;
+            }
+            dispatch_obj_io(conf->tp, fd, dead);
+        }
+        reclaim_objs(conf, dead);
+    }
+    get_stats(conf, &s1);
+
+    stop_reactors(conf);
+    (void) close(sd);
+    if (waitpid(pid, NULL, 0) < 0) {
+        log_err(errno, "Unable to wait for pump");
+    }
+
+    gb = numBytes / BENCH_GB;
+    printf("backend:  %s, %d reactor thread%s\n", tpoll_backend(conf->tp),
+        conf->numThreads, (conf->numThreads == 1 ? "" : "s"));
+    printf("consoles: %d, each with 1 client\n", numConsoles);
+    printf("data:     %llu bytes in %d-byte chunks\n", numBytes, chunkLen);
+    printf("time:     %.2f s (%.1f MB/s)\n", s1.secs - s0.secs,
+        numBytes / (1024.0 * 1024.0) / (s1.secs - s0.secs));
+    printf("cpu:      %.2f s/GB (%.2f user + %.2f sys)\n",
+        (s1.usr - s0.usr + s1.sys - s0.sys) / gb,
+        (s1.usr - s0.usr) / gb, (s1.sys - s0.sys) / gb);
+    printf("tpoll:    %.0f syscalls/GB\n", (s1.numPolls - s0.numPolls) / gb);
+    if (s0.numReads || s1.numReads) {
+        printf("read:     %.0f syscalls/GB\n",
+            (s1.numReads - s0.numReads) / gb);
+        printf("write:    %.0f syscalls/GB\n",
+            (s1.numWrites - s0.numWrites) / gb);
+    }
+    printf("switches: %.0f/GB\n", (s1.numSwitches - s0.numSwitches) / gb);
+
+    list_destroy(dead);
+    destroy_server_conf(conf);
+    tp_global = NULL;
+    return(0);
+}
+
+
+static void display_help(const char *prog)
+{
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("\n");
+    printf("  -c N      Specify number of consoles (default: 5000).\n");
+    printf("  -h        Display this help message.\n");
+    printf("  -l N      Specify length of each chunk (default: 1024).\n");
+    printf("  -m N      Specify megabytes to forward (default: 1024).\n");
+    printf("  -t N      Specify number of reactor threads (default: 1).\n");
+    printf("\n");
+    return;
+}
+
+
+static void raise_nofile_limit(int n)
+{
+/*  Raises the limit on open files to at least (n).
+ */
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+        log_err(errno, "Unable to get open file limit");
+    }
+    if (limit.rlim_cur < (rlim_t) n) {
+        limit.rlim_cur = (rlim_t) n;
+        if (limit.rlim_max < limit.rlim_cur) {
+            limit.rlim_max = limit.rlim_cur;
+        }
+        if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+            log_err(errno, "Unable to set open file limit to %d", n);
+        }
+    }
+    return;
+}
+
+
+static int create_bench_listener(const char *path)
+{
+/*  Creates a unix domain socket listening at (path) for a console.
+ *  Returns the listening socket.
+ */
+    struct sockaddr_un saddr;
+    int ld;
+
+    memset(&saddr, 0, sizeof(saddr));
+    saddr.sun_family = AF_UNIX;
+    if (strlcpy(saddr.sun_path, path, sizeof(saddr.sun_path))
+            >= sizeof(saddr.sun_path)) {
+        log_err(0, "Socket path \"%s\" is too long", path);
+    }
+    if ((ld = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        log_err(errno, "Unable to create socket");
+    }
+    if (bind(ld, (struct sockaddr *) &saddr, sizeof(saddr)) < 0) {
+        log_err(errno, "Unable to bind socket to \"%s\"", path);
+    }
+    if (listen(ld, 1) < 0) {
+        log_err(errno, "Unable to listen on \"%s\"", path);
+    }
+    return(ld);
+}
+
+
+static obj_t * create_bench_client(server_conf_t *conf, int i, int *peer)
+{
+/*  Creates the (i)th client obj over one end of a socketpair.
+ *  The other end is returned via (peer).
+ */
+    int sv[2];
+    char buf[MAX_LINE];
+    req_t *req;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        log_err(errno, "Unable to create socketpair");
+    }
+    *peer = sv[1];
+
+    snprintf(buf, sizeof(buf), "bench%d", i);
+    req = create_req();
+    req->sd = sv[0];
+    req->user = create_string(buf);
+    req->host = create_string("localhost");
+    req->fqdn = create_string("localhost");
+    req->ip = create_string("127.0.0.1");
+    req->port = i + 1;
+    req->command = CONMAN_CMD_MONITOR;
+
+    return(create_client_obj(conf, req));
+}
+
+
+static void send_peers(int sd, int fd1, int fd2)
+{
+/*  Passes the fds (fd1) and (fd2) over the unix domain socket (sd).
+ */
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char c = 0;
+    union {
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } u;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&u, 0, sizeof(u));
+    iov.iov_base = &c;
+    iov.iov_len = 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = u.buf;
+    msg.msg_controllen = sizeof(u.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd1, sizeof(int));
+    memcpy(CMSG_DATA(cmsg) + sizeof(int), &fd2, sizeof(int));
+
+    if (sendmsg(sd, &msg, 0) != 1) {
+        log_err(errno, "Unable to pass fds to pump");
+    }
+    return;
+}
+
+
+static void recv_peers(int sd, int *fd1, int *fd2)
+{
+/*  Receives the fds passed over the unix domain socket (sd) by send_peers()
+ *    into (fd1) and (fd2).
+ */
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char c;
+    union {
+        char buf[CMSG_SPACE(2 * sizeof(int))];
+        struct cmsghdr align;
+    } u;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &c;
+    iov.iov_len = 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = u.buf;
+    msg.msg_controllen = sizeof(u.buf);
+
+    if (recvmsg(sd, &msg, 0) != 1) {
+        log_err(errno, "Unable to receive fds from daemon");
+    }
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || (cmsg->cmsg_level != SOL_SOCKET)
+            || (cmsg->cmsg_type != SCM_RIGHTS)
+            || (cmsg->cmsg_len != CMSG_LEN(2 * sizeof(int)))) {
+        log_err(0, "Received unexpected message from daemon");
+    }
+    memcpy(fd1, CMSG_DATA(cmsg), sizeof(int));
+    memcpy(fd2, CMSG_DATA(cmsg) + sizeof(int), sizeof(int));
+    return;
+}
+
+
+static void run_pump(int sd, int n, int numChunks, int chunkLen)
+{
+/*  Writes (numChunks) chunks of (chunkLen) bytes into each of the (n)
+ *    consoles' peers, and reads the data forwarded to their clients' peers.
+ *    A console is not written while more than BENCH_WINDOW_LEN bytes are
+ *    in flight through it.
+ *  The peers are received over (sd), followed by a byte to start pumping.
+ *    Afterwards, the number of bytes read back is written to (sd), and the
+ *    pump waits for (sd) to be closed.
+ *  Since the clients may also receive the daemon's notification messages,
+ *    a console is done once its client has read at least as much as it sent.
+ */
+    struct pollfd *fds;
+    int *consoleFds;
+    int *clientFds;
+    unsigned long long *numSent;
+    unsigned long long *numRecv;
+    unsigned long long numBytes = 0;
+    unsigned long long len;
+    int numLeft = n;
+    char *buf;
+    char c;
+    int i;
+    ssize_t m;
+
+    if (!(buf = malloc(MAX(chunkLen, OBJ_BUF_SIZE)))) {
+        out_of_memory();
+    }
+    for (i = 0; i < chunkLen; i++) {
+        buf[i] = (i % 80 == 79) ? '\n' : 'a' + (i % 26);
+    }
+    if (!(fds = malloc(n * 2 * sizeof(struct pollfd)))) {
+        out_of_memory();
+    }
+    if (!(consoleFds = malloc(n * sizeof(int)))) {
+        out_of_memory();
+    }
+    if (!(clientFds = malloc(n * sizeof(int)))) {
+        out_of_memory();
+    }
+    if (!(numSent = calloc(n, sizeof(unsigned long long)))) {
+        out_of_memory();
+    }
+    if (!(numRecv = calloc(n, sizeof(unsigned long long)))) {
+        out_of_memory();
+    }
+    for (i = 0; i < n; i++) {
+        recv_peers(sd, &consoleFds[i], &clientFds[i]);
+        set_fd_nonblocking(consoleFds[i]);
+        set_fd_nonblocking(clientFds[i]);
+        fds[2 * i].fd = consoleFds[i];
+        fds[2 * i + 1].fd = clientFds[i];
+        fds[2 * i + 1].events = POLLIN;
+    }
+    if (read(sd, &c, 1) != 1) {
+        _exit(1);
+    }
+    len = (unsigned long long) numChunks * chunkLen;
+
+    while (numLeft > 0) {
+        for (i = 0; i < n; i++) {
+            fds[2 * i].events = ((numSent[i] < len)
+                && (numSent[i] + chunkLen <= numRecv[i] + BENCH_WINDOW_LEN))
+                ? POLLOUT : 0;
+        }
+        if (poll(fds, n * 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_err(errno, "Unable to poll pump");
+        }
+        for (i = 0; i < n; i++) {
+            if (fds[2 * i].revents & POLLOUT) {
+                m = write(consoleFds[i], buf, chunkLen);
+                if (m > 0) {
+                    numSent[i] += m;
+                }
+                else if ((m < 0) && (errno != EAGAIN)) {
+                    log_err(errno, "Unable to write console %d", i);
+                }
+            }
+            if (fds[2 * i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                m = read(clientFds[i], buf + chunkLen, OBJ_BUF_SIZE - chunkLen);
+                if (m > 0) {
+                    if ((numSent[i] == len) && (numRecv[i] < len)
+                            && (numRecv[i] + m >= len)) {
+                        numLeft--;
+                    }
+                    numRecv[i] += m;
+                    numBytes += m;
+                }
+                else if (m == 0) {
+                    log_err(0, "Client %d closed prematurely", i);
+                }
+                else if (errno != EAGAIN) {
+                    log_err(errno, "Unable to read client %d", i);
+                }
+            }
+        }
+    }
+    if (write(sd, &numBytes, sizeof(numBytes)) != sizeof(numBytes)) {
+        _exit(1);
+    }
+    while (read(sd, &c, 1) > 0) {
+        ;
+    }
+    for (i = 0; i < n; i++) {
+        (void) close(consoleFds[i]);
+        (void) close(clientFds[i]);
+    }
+    free(buf);
+    free(fds);
+    free(consoleFds);
+    free(clientFds);
+    free(numSent);
+    free(numRecv);
+    return;
+}
+
+
+static void get_stats(server_conf_t *conf, bench_stats_t *stats)
+{
+/*  Samples the daemon's resource usage into (stats).
+ *  The tpoll syscalls are summed over the main thread and every reactor.
+ */
+    struct rusage ru;
+    int k;
+
+    stats->secs = get_secs();
+    if (getrusage(RUSAGE_SELF, &ru) < 0) {
+        log_err(errno, "Unable to get resource usage");
+    }
+    stats->usr = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+    stats->sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+    stats->numSwitches = ru.ru_nvcsw + ru.ru_nivcsw;
+
+    stats->numPolls = 0;
+    for (k = 0; k <= conf->numThreads; k++) {
+        stats->numPolls += tpoll_num_syscalls(conf->reactors[k].tp);
+    }
+    if (get_proc_io(&stats->numReads, &stats->numWrites) < 0) {
+        stats->numReads = stats->numWrites = 0;
+    }
+    return;
+}
+
+
+static int get_proc_io(unsigned long *reads, unsigned long *writes)
+{
+/*  Gets the number of read & write syscalls made by this process
+ *    (summed over all of its threads) from /proc/self/io.
+ *  Returns 0 on success, or -1 if they are not available.
+ */
+    FILE *fp;
+    char buf[MAX_LINE];
+    int n = 0;
+
+    if (!(fp = fopen("/proc/self/io", "r"))) {
+        return(-1);
+    }
+    while (fgets(buf, sizeof(buf), fp)) {
+        if (sscanf(buf, "syscr: %lu", reads) == 1) {
+            n++;
+        }
+        else if (sscanf(buf, "syscw: %lu", writes) == 1) {
+            n++;
+        }
+    }
+    (void) fclose(fp);
+    return((n == 2) ? 0 : -1);
+}
+
+
+static double get_secs(void)
+{
+    struct timeval tv;
+
+    if (gettimeofday(&tv, NULL) < 0) {
+        log_err(errno, "Unable to get time of day");
+    }
+    return(tv.tv_sec + tv.tv_usec / 1e6);
+}
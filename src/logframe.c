@@ -0,0 +1,211 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************
+ *  Refer to "logframe.h" for documentation on public functions.
+ *****************************************************************************/
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#if WITH_ZLIB
+
+#include <assert.h>
+#include <string.h>
+#include <zlib.h>
+#include "logframe.h"
+
+
+#define LOGFRAME_ID1            0x1f    /* gzip magic                        */
+#define LOGFRAME_ID2            0x8b    /* gzip magic                        */
+#define LOGFRAME_CM             8       /* gzip compression method: deflate  */
+#define LOGFRAME_FLG            0x04    /* gzip flags: FEXTRA                */
+#define LOGFRAME_OS             3       /* gzip OS: Unix                     */
+#define LOGFRAME_XLEN           12      /* len of extra field                */
+#define LOGFRAME_SI1            'C'     /* extra subfield id                 */
+#define LOGFRAME_SI2            'M'     /* extra subfield id                 */
+#define LOGFRAME_SLEN           8       /* len of extra subfield data        */
+
+
+static void put_le32(unsigned char *dst, unsigned long n);
+static unsigned long get_le32(const unsigned char *src);
+
+
+int logframe_bound(int len)
+{
+    assert(len >= 0);
+
+    /*  This is zlib's conservative deflateBound() for a raw stream with
+     *    arbitrary parameters, so an initialized stream is not required.
+     */
+    return(LOGFRAME_HDR_LEN + len + ((len + 7) >> 3) + ((len + 63) >> 6)
+        + 5 + 6 + LOGFRAME_TRL_LEN);
+}
+
+
+int logframe_encode(z_stream *zs, unsigned char *dst, int dstlen,
+    const unsigned char *src, int srclen)
+{
+    unsigned char *p;
+    int n;
+
+    assert(zs != NULL);
+    assert(dst != NULL);
+    assert((src != NULL) || (srclen == 0));
+
+    if ((srclen < 0) || (dstlen < logframe_bound(srclen))) {
+        return(-1);
+    }
+    if (deflateReset(zs) != Z_OK) {
+        return(-1);
+    }
+    zs->next_in = (unsigned char *) src;
+    zs->avail_in = srclen;
+    zs->next_out = dst + LOGFRAME_HDR_LEN;
+    zs->avail_out = dstlen - LOGFRAME_HDR_LEN - LOGFRAME_TRL_LEN;
+
+    if (deflate(zs, Z_FINISH) != Z_STREAM_END) {
+        return(-1);
+    }
+    n = LOGFRAME_HDR_LEN + zs->total_out + LOGFRAME_TRL_LEN;
+    if (n > LOGFRAME_MAX_LEN) {
+        return(-1);
+    }
+    p = dst;
+    *p++ = LOGFRAME_ID1;
+    *p++ = LOGFRAME_ID2;
+    *p++ = LOGFRAME_CM;
+    *p++ = LOGFRAME_FLG;
+    put_le32(p, 0);                     /* MTIME: not available */
+    p += 4;
+    *p++ = 0;                           /* XFL */
+    *p++ = LOGFRAME_OS;
+    *p++ = LOGFRAME_XLEN & 0xff;
+    *p++ = (LOGFRAME_XLEN >> 8) & 0xff;
+    *p++ = LOGFRAME_SI1;
+    *p++ = LOGFRAME_SI2;
+    *p++ = LOGFRAME_SLEN & 0xff;
+    *p++ = (LOGFRAME_SLEN >> 8) & 0xff;
+    put_le32(p, n);
+    p += 4;
+    put_le32(p, srclen);
+    p += 4;
+    assert(p == dst + LOGFRAME_HDR_LEN);
+
+    p = dst + n - LOGFRAME_TRL_LEN;
+    put_le32(p, crc32(crc32(0L, Z_NULL, 0), src, srclen));
+    put_le32(p + 4, srclen);
+    return(n);
+}
+
+
+int logframe_parse_header(const unsigned char *src, int srclen,
+    int *framelenp, int *datalenp)
+{
+    unsigned long framelen;
+    unsigned long datalen;
+
+    assert(src != NULL);
+    assert(framelenp != NULL);
+    assert(datalenp != NULL);
+
+    if (srclen < LOGFRAME_HDR_LEN) {
+        return(-1);
+    }
+    if ((src[0] != LOGFRAME_ID1) || (src[1] != LOGFRAME_ID2)
+            || (src[2] != LOGFRAME_CM) || (src[3] != LOGFRAME_FLG)
+            || (src[10] != (LOGFRAME_XLEN & 0xff)) || (src[11] != 0)
+            || (src[12] != LOGFRAME_SI1) || (src[13] != LOGFRAME_SI2)
+            || (src[14] != (LOGFRAME_SLEN & 0xff)) || (src[15] != 0)) {
+        return(-1);
+    }
+    framelen = get_le32(src + 16);
+    datalen = get_le32(src + 20);
+    if ((framelen < LOGFRAME_HDR_LEN + LOGFRAME_TRL_LEN)
+            || (framelen > LOGFRAME_MAX_LEN)
+            || (datalen > LOGFRAME_MAX_LEN)) {
+        return(-1);
+    }
+    *framelenp = framelen;
+    *datalenp = datalen;
+    return(0);
+}
+
+
+int logframe_decode(z_stream *zs, unsigned char *dst, int dstlen,
+    const unsigned char *src, int srclen)
+{
+    int framelen;
+    int datalen;
+    const unsigned char *trl;
+
+    assert(zs != NULL);
+    assert(dst != NULL);
+    assert(src != NULL);
+
+    if (logframe_parse_header(src, srclen, &framelen, &datalen) < 0) {
+        return(-1);
+    }
+    if ((framelen != srclen) || (datalen > dstlen)) {
+        return(-1);
+    }
+    if (inflateReset(zs) != Z_OK) {
+        return(-1);
+    }
+    zs->next_in = (unsigned char *) src + LOGFRAME_HDR_LEN;
+    zs->avail_in = framelen - LOGFRAME_HDR_LEN - LOGFRAME_TRL_LEN;
+    zs->next_out = dst;
+    zs->avail_out = dstlen;
+
+    if (inflate(zs, Z_FINISH) != Z_STREAM_END) {
+        return(-1);
+    }
+    trl = src + framelen - LOGFRAME_TRL_LEN;
+    if ((zs->total_out != (unsigned long) datalen)
+            || (get_le32(trl + 4) != (unsigned long) datalen)
+            || (get_le32(trl) != crc32(crc32(0L, Z_NULL, 0), dst, datalen))) {
+        return(-1);
+    }
+    return(datalen);
+}
+
+
+static void put_le32(unsigned char *dst, unsigned long n)
+{
+    dst[0] = n & 0xff;
+    dst[1] = (n >> 8) & 0xff;
+    dst[2] = (n >> 16) & 0xff;
+    dst[3] = (n >> 24) & 0xff;
+    return;
+}
+
+
+static unsigned long get_le32(const unsigned char *src)
+{
+    return((unsigned long) src[0]
+        | ((unsigned long) src[1] << 8)
+        | ((unsigned long) src[2] << 16)
+        | ((unsigned long) src[3] << 24));
+}
+
+#endif /* WITH_ZLIB */
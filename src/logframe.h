@@ -0,0 +1,89 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#ifndef _LOGFRAME_H
+#define _LOGFRAME_H
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#if WITH_ZLIB
+
+#include <zlib.h>
+
+
+/*  A compressed console logfile is a sequence of frames, each of which is a
+ *    self-contained gzip member (RFC 1952), so the logfile can be read by
+ *    standard gzip tools.  Each frame is written out in its entirety with a
+ *    single write(), so a crash loses at most the frame being accumulated.
+ *  The gzip header of each frame carries an extra field ('C','M') holding
+ *    the total length of the frame and the length of its uncompressed data
+ *    (both as 32-bit little-endian integers), so a reader can seek from
+ *    frame to frame without decompressing them.
+ */
+#define LOGFRAME_HDR_LEN        24      /* gzip hdr + xlen + 'CM' subfield   */
+#define LOGFRAME_TRL_LEN        8       /* gzip CRC32 + ISIZE                */
+#define LOGFRAME_MAX_LEN        (64 * 1024 * 1024)
+
+
+int logframe_bound(int len);
+/*
+ *  Returns the maximum length of a frame holding (len) bytes of data.
+ */
+
+int logframe_encode(z_stream *zs, unsigned char *dst, int dstlen,
+    const unsigned char *src, int srclen);
+/*
+ *  Compresses the (srclen) bytes of (src) into a frame written into the
+ *    buffer (dst) of length (dstlen), which must be at least
+ *    logframe_bound(srclen) bytes.
+ *  The deflate stream (zs) must have been initialized for raw deflate
+ *    (ie, with negative windowBits); it is reset before use.
+ *  Returns the length of the frame, or -1 on error.
+ */
+
+int logframe_parse_header(const unsigned char *src, int srclen,
+    int *framelenp, int *datalenp);
+/*
+ *  Parses the frame header at the start of (src) of length (srclen),
+ *    setting (*framelenp) to the total length of the frame and (*datalenp)
+ *    to the length of its uncompressed data.
+ *  Returns 0 on success, or -1 if (src) does not start with a valid frame
+ *    header (or is shorter than LOGFRAME_HDR_LEN).
+ */
+
+int logframe_decode(z_stream *zs, unsigned char *dst, int dstlen,
+    const unsigned char *src, int srclen);
+/*
+ *  Decompresses the complete frame (src) of length (srclen) into the
+ *    buffer (dst) of length (dstlen), verifying its CRC and length.
+ *  The inflate stream (zs) must have been initialized for raw inflate
+ *    (ie, with negative windowBits); it is reset before use.
+ *  Returns the length of the uncompressed data, or -1 on error.
+ */
+
+#endif /* WITH_ZLIB */
+
+#endif /* !_LOGFRAME_H */
@@ -0,0 +1,610 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The muxmon-bench utility measures the cost of monitoring many consoles
+ *    at once, as a dashboard watching a whole cluster would.  It monitors
+ *    the consoles matching the patterns given via -p (or every console)
+ *    of a running daemon, either via one v1 connection per console or via
+ *    channels over a single v2 (multiplexed) connection, and reports the
+ *    sockets used, the time taken to set up the sessions, and the console
+ *    output received over the following interval.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <sys/types.h>                  /* include before in.h for bsd */
+#include <netinet/in.h>                 /* include before inet.h for bsd */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "common.h"
+#include "lex.h"
+#include "list.h"
+#include "log.h"
+#include "util-file.h"
+#include "util-net.h"
+#include "util-str.h"
+#include "util.h"
+
+
+typedef enum conn_state {
+    CONN_CONNECTING,                    /* awaiting non-blocking connect()   */
+    CONN_GREETING,                      /* awaiting response to greeting     */
+    CONN_MONITOR,                       /* awaiting response to monitor      */
+    CONN_STREAMING,                     /* receiving console output          */
+    CONN_FAILED                         /* connection failed                 */
+} conn_state_t;
+
+typedef struct conn {
+    int              sd;                /* socket descriptor                 */
+    conn_state_t     state;             /* state of connection               */
+    char            *console;           /* name of console being monitored   */
+} conn_t;
+
+typedef struct result {
+    int              numSessions;       /* num console sessions set up       */
+    int              numSockets;        /* num sockets used                  */
+    double           tSetup;            /* secs taken to set up sessions     */
+    unsigned long    numBytes;          /* bytes of console output received  */
+} result_t;
+
+
+static void display_help(const char *prog);
+static int connect_daemon(struct sockaddr_in *addr, int isBlocking);
+static int read_rsp_line(int sd, char *buf, int len);
+static List query_consoles(struct sockaddr_in *addr, const char *pats);
+static void run_v1(struct sockaddr_in *addr, List consoles, double secs,
+    result_t *res);
+static void advance_conn(conn_t *c, char *buf, int len, result_t *res);
+static void run_v2(struct sockaddr_in *addr, const char *pats, double secs,
+    result_t *res);
+static void write_frame(int sd, int type, int id, const void *src, int len);
+static void print_result(const char *label, result_t *res, double secs);
+static double get_secs(void);
+
+
+int main(int argc, char *argv[])
+{
+    int c;
+    char *host = "127.0.0.1";
+    int port = atoi(CONMAN_PORT);
+    int mode = 0;
+    double secs = 5;
+    char *p;
+    char pats[MAX_SOCK_LINE] = "";
+    struct sockaddr_in addr;
+    struct rlimit limit;
+    List consoles;
+    result_t res;
+
+    log_set_file(stderr, LOG_WARNING, 0);
+
+    opterr = 0;
+    while ((c = getopt(argc, argv, "d:hm:p:t:")) != -1) {
+        switch(c) {
+        case 'd':
+            host = optarg;
+            if ((p = strchr(host, ':'))) {
+                *p++ = '\0';
+                if ((port = atoi(p)) <= 0) {
+                    log_err(0, "CMDLINE: invalid port \"%s\"", p);
+                }
+            }
+            break;
+        case 'h':
+            display_help(argv[0]);
+            exit(0);
+        case 'm':
+            if (((mode = atoi(optarg)) != 1) && (mode != 2)) {
+                log_err(0, "CMDLINE: invalid protocol \"%s\"", optarg);
+            }
+            break;
+        case 'p':
+            if (append_format_string(pats, sizeof(pats), " %s='%s'",
+                    LEX_TOK2STR(proto_strs, CONMAN_TOK_CONSOLE),
+                    lex_encode(optarg)) < 0) {
+                log_err(0, "CMDLINE: too many console patterns");
+            }
+            break;
+        case 't':
+            if ((secs = atof(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid interval \"%s\"", optarg);
+            }
+            break;
+        case '?':                       /* invalid option */
+            log_err(0, "CMDLINE: invalid option \"%c\"", optopt);
+            exit(1);
+        default:
+            log_err(0, "CMDLINE: option \"%c\" not implemented", c);
+            exit(1);
+        }
+    }
+    if (optind != argc) {
+        display_help(argv[0]);
+        exit(1);
+    }
+    if (pats[0] == '\0') {
+        snprintf(pats, sizeof(pats), " %s='*'",
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_CONSOLE));
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (host_name_to_addr4(host, &addr.sin_addr) < 0) {
+        log_err(0, "Unable to resolve \"%s\"", host);
+    }
+    consoles = query_consoles(&addr, pats);
+    printf("consoles:    %d\n", list_count(consoles));
+
+    if (mode != 2) {
+        /*
+         *  Each v1 session needs its own fd.
+         */
+        if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+            log_err(errno, "Unable to get open file limit");
+        }
+        if (limit.rlim_cur < (rlim_t) list_count(consoles) + 16) {
+            limit.rlim_cur = list_count(consoles) + 16;
+            if (limit.rlim_max < limit.rlim_cur) {
+                limit.rlim_max = limit.rlim_cur;
+            }
+            if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+                log_err(errno, "Unable to set open file limit to %d",
+                    list_count(consoles) + 16);
+            }
+        }
+        run_v1(&addr, consoles, secs, &res);
+        print_result("v1", &res, secs);
+    }
+    if (mode != 1) {
+        run_v2(&addr, pats, secs, &res);
+        print_result("v2", &res, secs);
+    }
+    list_destroy(consoles);
+    return(0);
+}
+
+
+static void display_help(const char *prog)
+{
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("\n");
+    printf("  -d HOST   Specify daemon location [host:port] "
+        "(default: 127.0.0.1:%s).\n", CONMAN_PORT);
+    printf("  -h        Display this help message.\n");
+    printf("  -m N      Only monitor via protocol version N (1 or 2).\n");
+    printf("  -p PAT    Monitor consoles matching PAT (may be repeated).\n");
+    printf("  -t SECS   Specify interval to receive output (default: 5).\n");
+    printf("\n");
+    return;
+}
+
+
+static int connect_daemon(struct sockaddr_in *addr, int isBlocking)
+{
+/*  Initiates a connect() to the daemon at (addr).
+ *  Returns the socket, or -1 if a blocking connect() failed.
+ */
+    int sd;
+
+    if ((sd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        log_err(errno, "Unable to create socket");
+    }
+    if (!isBlocking) {
+        set_fd_nonblocking(sd);
+    }
+    if (connect(sd, (struct sockaddr *) addr, sizeof(*addr)) < 0) {
+        if (isBlocking || (errno != EINPROGRESS)) {
+            (void) close(sd);
+            return(-1);
+        }
+    }
+    return(sd);
+}
+
+
+static int read_rsp_line(int sd, char *buf, int len)
+{
+/*  Reads a line from the blocking socket (sd) into (buf) of length (len)
+ *    a byte at a time, so nothing following the line is consumed.
+ *  Returns the length of the line, or -1 on EOF or error.
+ */
+    int n = 0;
+
+    while (n < len - 1) {
+        if (read(sd, &buf[n], 1) != 1) {
+            return(-1);
+        }
+        if (buf[n++] == '\n') {
+            break;
+        }
+    }
+    buf[n] = '\0';
+    return(n);
+}
+
+
+static List query_consoles(struct sockaddr_in *addr, const char *pats)
+{
+/*  Queries the daemon at (addr) for the consoles matching (pats).
+ *  Returns a list of console names.
+ */
+    List consoles;
+    char *buf;
+    int sd;
+    int n;
+    int len = 0;
+    Lex l;
+    int tok;
+
+    if (!(buf = malloc(MAX_SOCK_LINE))) {
+        out_of_memory();
+    }
+    if ((sd = connect_daemon(addr, 1)) < 0) {
+        log_err(errno, "Unable to connect to daemon");
+    }
+    snprintf(buf, MAX_SOCK_LINE, "%s %s='bench'\n",
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_HELLO),
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_USER));
+    if ((write_n(sd, buf, strlen(buf)) < 0)
+            || (read_rsp_line(sd, buf, MAX_SOCK_LINE) < 0)
+            || strncmp(buf, LEX_TOK2STR(proto_strs, CONMAN_TOK_OK), 2)) {
+        log_err(0, "Unable to greet daemon");
+    }
+    snprintf(buf, MAX_SOCK_LINE, "%s%s\n",
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_QUERY), pats);
+    if (write_n(sd, buf, strlen(buf)) < 0) {
+        log_err(errno, "Unable to query daemon");
+    }
+    while ((n = read(sd, buf + len, MAX_SOCK_LINE - 1 - len)) > 0) {
+        len += n;
+    }
+    buf[len] = '\0';
+    (void) close(sd);
+
+    consoles = list_create((ListDelF) destroy_string);
+    l = lex_create(buf, proto_strs);
+    while (((tok = lex_next(l)) != LEX_EOF) && (tok != LEX_EOL)) {
+        if ((tok == CONMAN_TOK_CONSOLE) && (lex_next(l) == '=')
+                && (lex_next(l) == LEX_STR)) {
+            list_append(consoles, lex_decode(create_string(lex_text(l))));
+        }
+    }
+    lex_destroy(l);
+    free(buf);
+    return(consoles);
+}
+
+
+static void run_v1(struct sockaddr_in *addr, List consoles, double secs,
+    result_t *res)
+{
+/*  Monitors each of the (consoles) via its own v1 connection to the daemon
+ *    at (addr), receiving output for (secs) once every session is set up.
+ */
+    conn_t *conns;
+    struct pollfd *pfds;
+    ListIterator i;
+    char *name;
+    char buf[MAX_SOCK_LINE];
+    int numConns = list_count(consoles);
+    int n, k;
+    double t0, tEnd = 0;
+
+    memset(res, 0, sizeof(*res));
+    conns = malloc(numConns * sizeof(conn_t));
+    pfds = malloc(numConns * sizeof(struct pollfd));
+    if (!conns || !pfds) {
+        out_of_memory();
+    }
+    t0 = get_secs();
+    i = list_iterator_create(consoles);
+    for (k = 0; (name = list_next(i)); k++) {
+        conns[k].console = name;
+        conns[k].state = CONN_CONNECTING;
+        if ((conns[k].sd = connect_daemon(addr, 0)) < 0) {
+            conns[k].state = CONN_FAILED;
+        }
+        else {
+            res->numSockets++;
+        }
+    }
+    list_iterator_destroy(i);
+
+    for (;;) {
+        for (k = 0; k < numConns; k++) {
+            pfds[k].fd = (conns[k].state != CONN_FAILED) ? conns[k].sd : -1;
+            pfds[k].events = (conns[k].state == CONN_CONNECTING)
+                ? POLLOUT : POLLIN;
+            pfds[k].revents = 0;
+        }
+        if ((tEnd > 0) && (get_secs() >= tEnd)) {
+            break;
+        }
+        while ((n = poll(pfds, numConns, 100)) < 0) {
+            if (errno != EINTR) {
+                log_err(errno, "Unable to poll connections");
+            }
+        }
+        for (k = 0; (k < numConns) && (n > 0); k++) {
+            if (pfds[k].revents) {
+                advance_conn(&conns[k], buf, sizeof(buf), res);
+                n--;
+            }
+        }
+        if ((tEnd == 0) && (res->numSessions == res->numSockets)) {
+            res->tSetup = get_secs() - t0;
+            res->numBytes = 0;
+            tEnd = get_secs() + secs;
+        }
+    }
+    for (k = 0; k < numConns; k++) {
+        if (conns[k].sd >= 0) {
+            (void) close(conns[k].sd);
+        }
+    }
+    free(conns);
+    free(pfds);
+    return;
+}
+
+
+static void advance_conn(conn_t *c, char *buf, int len, result_t *res)
+{
+/*  Advances the v1 connection (c) through the client protocol once its
+ *    socket is ready.  The responses are short, so each is expected to
+ *    arrive in a single read.
+ */
+    int err;
+    socklen_t errlen = sizeof(err);
+    int n;
+
+    if (c->state == CONN_CONNECTING) {
+        if ((getsockopt(c->sd, SOL_SOCKET, SO_ERROR, &err, &errlen) < 0)
+                || (err != 0)) {
+            goto fail;
+        }
+        n = snprintf(buf, len, "%s %s='bench'\n",
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_HELLO),
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_USER));
+        if (write_n(c->sd, buf, n) < 0) {
+            goto fail;
+        }
+        c->state = CONN_GREETING;
+        return;
+    }
+    if ((n = read(c->sd, buf, len)) < 0) {
+        if (errno == EAGAIN) {
+            return;
+        }
+        goto fail;
+    }
+    if (n == 0) {
+        goto fail;
+    }
+    if (c->state == CONN_STREAMING) {
+        res->numBytes += n;
+    }
+    else if (strncmp(buf, LEX_TOK2STR(proto_strs, CONMAN_TOK_OK), 2)) {
+        goto fail;
+    }
+    else if (c->state == CONN_GREETING) {
+        n = snprintf(buf, len, "%s %s='%s'\n",
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_MONITOR),
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_CONSOLE),
+            lex_encode(c->console));
+        if (write_n(c->sd, buf, n) < 0) {
+            goto fail;
+        }
+        c->state = CONN_MONITOR;
+    }
+    else {
+        c->state = CONN_STREAMING;
+        res->numSessions++;
+    }
+    return;
+
+fail:
+    log_msg(LOG_WARNING, "Unable to monitor console [%s]", c->console);
+    (void) close(c->sd);
+    c->sd = -1;
+    c->state = CONN_FAILED;
+    res->numSockets--;
+    return;
+}
+
+
+static void run_v2(struct sockaddr_in *addr, const char *pats, double secs,
+    result_t *res)
+{
+/*  Monitors the consoles matching (pats) via channels over a single v2
+ *    connection to the daemon at (addr), receiving output for (secs) once
+ *    the OPEN request has been answered.  Credit is returned to each
+ *    channel as its output is consumed.
+ */
+    unsigned char *buf;
+    unsigned long *consumed = NULL;
+    int numIds = 0;
+    unsigned char win[4];
+    struct pollfd pfd;
+    int sd;
+    int len = 0;
+    int n, id, type, frameLen;
+    double t0, tEnd = 0;
+
+    memset(res, 0, sizeof(*res));
+    if (!(buf = malloc(MAX_SOCK_LINE))) {
+        out_of_memory();
+    }
+    t0 = get_secs();
+    if ((sd = connect_daemon(addr, 1)) < 0) {
+        log_err(errno, "Unable to connect to daemon");
+    }
+    res->numSockets = 1;
+    snprintf((char *) buf, MAX_SOCK_LINE, "%s %s='bench' %s=%d\n",
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_HELLO),
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_USER),
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_PROTOCOL), CONMAN_PROTOCOL_MUX);
+    if ((write_n(sd, buf, strlen((char *) buf)) < 0)
+            || (read_rsp_line(sd, (char *) buf, MAX_SOCK_LINE) < 0)
+            || strncmp((char *) buf, LEX_TOK2STR(proto_strs, CONMAN_TOK_OK), 2)
+            || !strstr((char *) buf,
+                LEX_TOK2STR(proto_strs, CONMAN_TOK_PROTOCOL))) {
+        log_err(0, "Daemon does not support the multiplexed protocol");
+    }
+    n = snprintf((char *) buf, MAX_SOCK_LINE, "%s%s\n",
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_MONITOR), pats);
+    if (n > MUX_FRAME_MAX_LEN) {
+        log_err(0, "Too many console patterns for an OPEN frame");
+    }
+    write_frame(sd, CONMAN_FRAME_OPEN, 0, buf, n);
+    set_fd_nonblocking(sd);
+
+    pfd.fd = sd;
+    pfd.events = POLLIN;
+    while ((tEnd == 0) || (get_secs() < tEnd)) {
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        if ((n = read(sd, buf + len, MAX_SOCK_LINE - len)) < 0) {
+            if ((errno == EAGAIN) || (errno == EINTR)) {
+                continue;
+            }
+            log_err(errno, "Unable to read from daemon");
+        }
+        if (n == 0) {
+            log_err(0, "Daemon closed the connection");
+        }
+        len += n;
+        n = 0;
+        while (len - n >= MUX_FRAME_HDR_LEN) {
+            type = buf[n];
+            frameLen = (buf[n + 2] << 8) | buf[n + 3];
+            id = (buf[n + 4] << 24) | (buf[n + 5] << 16)
+                | (buf[n + 6] << 8) | buf[n + 7];
+            if (len - n < MUX_FRAME_HDR_LEN + frameLen) {
+                break;
+            }
+            if (type == CONMAN_FRAME_OPEN) {
+                res->numSessions++;
+            }
+            else if (type == CONMAN_FRAME_RSP) {
+                if (strncmp((char *) &buf[n + MUX_FRAME_HDR_LEN],
+                        LEX_TOK2STR(proto_strs, CONMAN_TOK_OK), 2)) {
+                    log_err(0, "Unable to open channels");
+                }
+                res->tSetup = get_secs() - t0;
+                tEnd = get_secs() + secs;
+            }
+            else if (type == CONMAN_FRAME_DATA) {
+                if (tEnd > 0) {
+                    res->numBytes += frameLen;
+                }
+                if (id >= numIds) {
+                    consumed = realloc(consumed,
+                        (id + 1) * sizeof(unsigned long));
+                    if (!consumed) {
+                        out_of_memory();
+                    }
+                    memset(consumed + numIds, 0,
+                        (id + 1 - numIds) * sizeof(unsigned long));
+                    numIds = id + 1;
+                }
+                consumed[id] += frameLen;
+                if (consumed[id] >= MUX_WINDOW_SIZE / 2) {
+                    win[0] = (consumed[id] >> 24) & 0xFF;
+                    win[1] = (consumed[id] >> 16) & 0xFF;
+                    win[2] = (consumed[id] >> 8) & 0xFF;
+                    win[3] = consumed[id] & 0xFF;
+                    set_fd_blocking(sd);
+                    write_frame(sd, CONMAN_FRAME_WINDOW, id, win, 4);
+                    set_fd_nonblocking(sd);
+                    consumed[id] = 0;
+                }
+            }
+            n += MUX_FRAME_HDR_LEN + frameLen;
+        }
+        len -= n;
+        memmove(buf, buf + n, len);
+    }
+    (void) close(sd);
+    free(consumed);
+    free(buf);
+    return;
+}
+
+
+static void write_frame(int sd, int type, int id, const void *src, int len)
+{
+/*  Writes a frame of (type) for channel (id) carrying the payload (src)
+ *    of length (len) to the blocking socket (sd).
+ */
+    unsigned char hdr[MUX_FRAME_HDR_LEN];
+
+    hdr[0] = type;
+    hdr[1] = 0;
+    hdr[2] = (len >> 8) & 0xFF;
+    hdr[3] = len & 0xFF;
+    hdr[4] = (id >> 24) & 0xFF;
+    hdr[5] = (id >> 16) & 0xFF;
+    hdr[6] = (id >> 8) & 0xFF;
+    hdr[7] = id & 0xFF;
+    if ((write_n(sd, hdr, sizeof(hdr)) < 0)
+            || ((len > 0) && (write_n(sd, (void *) src, len) < 0))) {
+        log_err(errno, "Unable to write frame to daemon");
+    }
+    return;
+}
+
+
+static void print_result(const char *label, result_t *res, double secs)
+{
+    printf("%s: %d sessions over %d socket%s, setup %.1f ms, "
+        "%lu bytes in %.1f s (%.0f KB/s)\n", label, res->numSessions,
+        res->numSockets, (res->numSockets == 1 ? "" : "s"),
+        res->tSetup * 1e3, res->numBytes, secs,
+        res->numBytes / secs / 1024);
+    return;
+}
+
+
+static double get_secs(void)
+{
+    struct timeval tv;
+
+    if (gettimeofday(&tv, NULL) < 0) {
+        log_err(errno, "Unable to get time of day");
+    }
+    return(tv.tv_sec + tv.tv_usec / 1e6);
+}
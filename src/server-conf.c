@@ -54,12 +54,15 @@ enum server_conf_toks {
 /*
  *  Keep enums in sync w/ server_conf_strs[].
  */
-    SERVER_CONF_CONSOLE = LEX_TOK_OFFSET,
+    SERVER_CONF_ACTION = LEX_TOK_OFFSET,
+    SERVER_CONF_CONSOLE,
     SERVER_CONF_COREDUMP,
     SERVER_CONF_COREDUMPDIR,
     SERVER_CONF_DEV,
+    SERVER_CONF_EXEC,
     SERVER_CONF_EXECPATH,
     SERVER_CONF_GLOBAL,
+    SERVER_CONF_HISTORY,
 #if WITH_FREEIPMI
     SERVER_CONF_IPMIOPTS,
 #endif /* WITH_FREEIPMI */
@@ -73,6 +76,7 @@ enum server_conf_toks {
     SERVER_CONF_NOFILE,
     SERVER_CONF_OFF,
     SERVER_CONF_ON,
+    SERVER_CONF_PATTERN,
     SERVER_CONF_PIDFILE,
     SERVER_CONF_PORT,
     SERVER_CONF_RESETCMD,
@@ -81,7 +85,9 @@ enum server_conf_toks {
     SERVER_CONF_SYSLOG,
     SERVER_CONF_TCPWRAPPERS,
     SERVER_CONF_TESTOPTS,
-    SERVER_CONF_TIMESTAMP
+    SERVER_CONF_THREADS,
+    SERVER_CONF_TIMESTAMP,
+    SERVER_CONF_TRIGGER
 };
 
 static char *server_conf_strs[] = {
@@ -89,12 +95,15 @@ static char *server_conf_strs[] = {
  *  Keep strings in sync w/ server_conf_toks enum.
  *  These must be sorted in a case-insensitive manner.
  */
+    "ACTION",
     "CONSOLE",
     "COREDUMP",
     "COREDUMPDIR",
     "DEV",
+    "EXEC",
     "EXECPATH",
     "GLOBAL",
+    "HISTORY",
 #if WITH_FREEIPMI
     "IPMIOPTS",
 #endif /* WITH_FREEIPMI */
@@ -108,6 +117,7 @@ static char *server_conf_strs[] = {
     "NOFILE",
     "OFF",
     "ON",
+    "PATTERN",
     "PIDFILE",
     "PORT",
     "RESETCMD",
@@ -116,7 +126,9 @@ static char *server_conf_strs[] = {
     "SYSLOG",
     "TCPWRAPPERS",
     "TESTOPTS",
+    "THREADS",
     "TIMESTAMP",
+    "TRIGGER",
     NULL
 };
 
@@ -175,6 +187,7 @@ typedef struct console_strs {
     char *dev;
     char *log;
     char *lopts;
+    char *hist;
     char *sopts;
 #if WITH_FREEIPMI
     char *iopts;
@@ -190,6 +203,7 @@ static int process_console(server_conf_t *conf, console_strs_t *con_p,
     char *errbuf, int errbuflen);
 static void parse_global_directive(server_conf_t *conf, Lex l);
 static void parse_server_directive(server_conf_t *conf, Lex l);
+static void parse_trigger_directive(server_conf_t *conf, Lex l);
 static int read_pidfile(const char *pidfile);
 static int write_pidfile(const char *pidfile);
 static int lookup_syslog_priority(const char *priority);
@@ -214,6 +228,8 @@ server_conf_t * create_server_conf(void)
     conf->logFilePtr = NULL;
     conf->logFileLevel = LOG_INFO;
     conf->numOpenFiles = 0;
+    conf->numThreads = 1;
+    conf->reactors = NULL;
     conf->pidFileName = NULL;
     conf->resetCmd = NULL;
     conf->syslogFacility = -1;
@@ -231,12 +247,32 @@ server_conf_t * create_server_conf(void)
     conf->port = -1;
     conf->ld = -1;
     conf->objs = list_create((ListDelF) destroy_obj);
+    conf->objsCursor = NULL;
+    init_obj_index(&conf->consoleIndex);
+    init_obj_index(&conf->logfileIndex);
+    init_obj_index(&conf->deviceIndex);
+    conf->consoleTable = NULL;
+    conf->consoleNames = NULL;
+    conf->numConsoles = 0;
+    conf->queryRsp = NULL;
+    conf->queryRspLen = 0;
     if (!(conf->tp = tpoll_create(0))) {
         log_err(0, "Unable to create object for multiplexing I/O");
     }
     conf->globalLogName = NULL;
+    conf->globalHistSize = 0;
+    conf->histArena = NULL;
+    conf->histArenaSize = 0;
+    conf->triggers = list_create((ListDelF) destroy_trigger);
+    conf->trigSet = NULL;
+    conf->globalLogOpts.bufSize = DEFAULT_LOGOPT_BUFSIZE;
     conf->globalLogOpts.enableSanitize = DEFAULT_LOGOPT_SANITIZE;
     conf->globalLogOpts.enableTimestamp = DEFAULT_LOGOPT_TIMESTAMP;
+    conf->globalLogOpts.enableCompress = DEFAULT_LOGOPT_COMPRESS;
+    conf->globalLogOpts.tsFormat = DEFAULT_LOGOPT_TSFORMAT;
+    conf->globalLogOpts.rotateSize = 0;
+    conf->globalLogOpts.rotateSecs = 0;
+    conf->globalLogOpts.rotateKeep = DEFAULT_LOGOPT_ROTATE_KEEP;
     conf->globalLogOpts.enableLock = DEFAULT_LOGOPT_LOCK;
     conf->globalSerOpts.bps = DEFAULT_SEROPT_BPS;
     conf->globalSerOpts.databits = DEFAULT_SEROPT_DATABITS;
@@ -299,9 +335,23 @@ void destroy_server_conf(server_conf_t *conf)
         }
         conf->ld = -1;
     }
+    if (conf->objsCursor) {
+        list_iterator_destroy(conf->objsCursor);
+    }
     if (conf->objs) {
         list_destroy(conf->objs);
     }
+    destroy_obj_index(&conf->consoleIndex);
+    destroy_obj_index(&conf->logfileIndex);
+    destroy_obj_index(&conf->deviceIndex);
+    destroy_query_rsp(conf);
+    destroy_console_table(conf);
+    destroy_history_arena(conf);
+    destroy_trigger_set(conf);
+    if (conf->triggers) {
+        list_destroy(conf->triggers);
+    }
+    destroy_reactors(conf);
     if (conf->tp) {
         tpoll_destroy(conf->tp);
     }
@@ -444,6 +494,9 @@ void process_config(server_conf_t *conf)
         case SERVER_CONF_SERVER:
             parse_server_directive(conf, l);
             break;
+        case SERVER_CONF_TRIGGER:
+            parse_trigger_directive(conf, l);
+            break;
         case LEX_EOL:
             break;
         case LEX_ERR:
@@ -476,6 +529,14 @@ void process_config(server_conf_t *conf)
             conf->pidFileName = NULL;   /* prevent unlink() at exit */
         }
     }
+    if (conf->objsCursor) {
+        list_iterator_destroy(conf->objsCursor);
+        conf->objsCursor = NULL;
+    }
+    create_console_table(conf);
+    create_query_rsp(conf);
+    create_history_arena(conf);
+    create_trigger_set(conf);
     return;
 }
 
@@ -580,8 +641,8 @@ static void signal_daemon(server_conf_t *conf)
 
 static void parse_console_directive(server_conf_t *conf, Lex l)
 {
-/*  CONSOLE NAME="<str>" DEV="<file>" [LOG="<file>"]
- *    [LOGOPTS="<str>"] [SEROPTS="<str>"] [IPMIOPTS="<str>"] [TESTOPTS="<str>"]
+/*  CONSOLE NAME="<str>" DEV="<file>" [LOG="<file>"] [LOGOPTS="<str>"]
+ *    [HISTORY="<str>"] [SEROPTS="<str>"] [IPMIOPTS="<str>"] [TESTOPTS="<str>"]
  *  Note: IPMIOPTS is only available if WITH_FREEIPMI is defined.
  */
     const char *directive;              /* name of directive being parsed */
@@ -676,6 +737,21 @@ static void parse_console_directive(server_conf_t *conf, Lex l)
             }
             break;
 
+        case SERVER_CONF_HISTORY:
+            if (lex_next(l) != '=') {
+                snprintf(err, sizeof(err),
+                    "expected '=' after %s keyword", tokstr);
+            }
+            else if ((lex_next(l) != LEX_STR)
+                    || is_empty_string(lex_text(l))) {
+                snprintf(err, sizeof(err),
+                    "expected STRING for %s value", tokstr);
+            }
+            else {
+                replace_string(&con.hist, lex_text(l));
+            }
+            break;
+
         case SERVER_CONF_SEROPTS:
             if (lex_next(l) != '=') {
                 snprintf(err, sizeof(err),
@@ -754,6 +830,7 @@ static void parse_console_directive(server_conf_t *conf, Lex l)
     destroy_string(con.dev);
     destroy_string(con.log);
     destroy_string(con.lopts);
+    destroy_string(con.hist);
     destroy_string(con.sopts);
 #if WITH_FREEIPMI
     destroy_string(con.iopts);
@@ -784,6 +861,7 @@ static int process_console(server_conf_t *conf, console_strs_t *con_p,
     logopt_t     logopts;
     test_opt_t   testopts;
     obj_t       *logfile;
+    int          histSize;
 
     assert(conf != NULL);
     assert(con_p != NULL);
@@ -920,6 +998,16 @@ static int process_console(server_conf_t *conf, console_strs_t *con_p,
             con_p->name, arg0);
         goto err;
     }
+    histSize = conf->globalHistSize;
+    if (con_p->hist && (parse_history_size(&histSize, con_p->hist) < 0)) {
+        snprintf(errbuf, errbuflen,
+            "console [%s] has invalid history \"%s\" (range is 0,%dk-%dm)",
+            con_p->name, con_p->hist, OBJ_BUF_MIN_SIZE / 1024,
+            OBJ_BUF_MAX_SIZE / (1024 * 1024));
+        goto err;
+    }
+    create_obj_history(console, histSize);
+
     if ((con_p->log && con_p->log[ 0 ] != '\0')
             || (!con_p->log && conf->globalLogName)) {
         if (con_p->log) {
@@ -1024,6 +1112,25 @@ static void parse_global_directive(server_conf_t *conf, Lex l)
             }
             break;
 
+        case SERVER_CONF_HISTORY:
+            if (lex_next(l) != '=') {
+                snprintf(err, sizeof(err),
+                    "expected '=' after %s keyword", tokstr);
+            }
+            else if ((lex_next(l) != LEX_STR)
+                    || is_empty_string(lex_text(l))) {
+                snprintf(err, sizeof(err),
+                    "expected STRING for %s value", tokstr);
+            }
+            else if (parse_history_size(&conf->globalHistSize,
+                    lex_text(l)) < 0) {
+                snprintf(err, sizeof(err),
+                    "invalid %s value \"%s\" (range is 0,%dk-%dm)",
+                    tokstr, lex_text(l), OBJ_BUF_MIN_SIZE / 1024,
+                    OBJ_BUF_MAX_SIZE / (1024 * 1024));
+            }
+            break;
+
         case SERVER_CONF_SEROPTS:
             if (lex_next(l) != '=') {
                 snprintf(err, sizeof(err),
@@ -1409,6 +1516,24 @@ static void parse_server_directive(server_conf_t *conf, Lex l)
 #endif /* WITH_TCP_WRAPPERS */
             break;
 
+        case SERVER_CONF_THREADS:
+            if (lex_next(l) != '=') {
+                snprintf(err, sizeof(err),
+                    "expected '=' after %s keyword", tokstr);
+            }
+            else if (lex_next(l) != LEX_INT) {
+                snprintf(err, sizeof(err),
+                    "expected INTEGER for %s value", tokstr);
+            }
+            else if ((n = atoi(lex_text(l))) < 1) {
+                snprintf(err, sizeof(err),
+                    "invalid %s value %d", tokstr, n);
+            }
+            else {
+                conf->numThreads = n;
+            }
+            break;
+
         case SERVER_CONF_TIMESTAMP:
             if (lex_next(l) != '=') {
                 snprintf(err, sizeof(err),
@@ -1482,6 +1607,128 @@ static void parse_server_directive(server_conf_t *conf, Lex l)
 }
 
 
+static void parse_trigger_directive(server_conf_t *conf, Lex l)
+{
+/*  TRIGGER PATTERN="<str>" [CONSOLE="<glob>"] [ACTION="<str>"] [EXEC="<cmd>"]
+ */
+    const char *directive;              /* name of directive being parsed */
+    int tok;
+    const char *tokstr;
+    int done = 0;
+    char err[MAX_LINE] = "";
+    char *pattern = NULL;
+    char *consoles = NULL;
+    char *actions = NULL;
+    char *cmd = NULL;
+    trigger_t *trig;
+
+    directive = lex_tok_to_str(l, lex_prev(l));
+    if (!directive) {
+        log_err(0, "Unable to lookup string for trigger directive");
+    }
+    while (!done && !*err) {
+        tok = lex_next(l);
+        tokstr = lex_tok_to_str(l, tok);
+        switch(tok) {
+
+        case SERVER_CONF_PATTERN:
+            if (lex_next(l) != '=') {
+                snprintf(err, sizeof(err),
+                    "expected '=' after %s keyword", tokstr);
+            }
+            else if ((lex_next(l) != LEX_STR)
+                    || is_empty_string(lex_text(l))) {
+                snprintf(err, sizeof(err),
+                    "expected STRING for %s value", tokstr);
+            }
+            else {
+                replace_string(&pattern, lex_text(l));
+            }
+            break;
+
+        case SERVER_CONF_CONSOLE:
+            if (lex_next(l) != '=') {
+                snprintf(err, sizeof(err),
+                    "expected '=' after %s keyword", tokstr);
+            }
+            else if ((lex_next(l) != LEX_STR)
+                    || is_empty_string(lex_text(l))) {
+                snprintf(err, sizeof(err),
+                    "expected STRING for %s value", tokstr);
+            }
+            else {
+                replace_string(&consoles, lex_text(l));
+            }
+            break;
+
+        case SERVER_CONF_ACTION:
+            if (lex_next(l) != '=') {
+                snprintf(err, sizeof(err),
+                    "expected '=' after %s keyword", tokstr);
+            }
+            else if ((lex_next(l) != LEX_STR)
+                    || is_empty_string(lex_text(l))) {
+                snprintf(err, sizeof(err),
+                    "expected STRING for %s value", tokstr);
+            }
+            else {
+                replace_string(&actions, lex_text(l));
+            }
+            break;
+
+        case SERVER_CONF_EXEC:
+            if (lex_next(l) != '=') {
+                snprintf(err, sizeof(err),
+                    "expected '=' after %s keyword", tokstr);
+            }
+            else if ((lex_next(l) != LEX_STR)
+                    || is_empty_string(lex_text(l))) {
+                snprintf(err, sizeof(err),
+                    "expected STRING for %s value", tokstr);
+            }
+            else {
+                replace_string(&cmd, lex_text(l));
+            }
+            break;
+
+        case LEX_EOF:
+        case LEX_EOL:
+            done = 1;
+            break;
+
+        case LEX_ERR:
+            snprintf(err, sizeof(err), "unmatched quote");
+            break;
+
+        default:
+            snprintf(err, sizeof(err), "unrecognized token '%s'", lex_text(l));
+            break;
+        }
+    }
+    if (!*err) {
+        if (!pattern) {
+            snprintf(err, sizeof(err), "incomplete %s directive", directive);
+        }
+        else if ((trig = create_trigger(pattern, consoles, actions, cmd,
+                err, sizeof(err)))) {
+            list_append(conf->triggers, trig);
+        }
+    }
+    if (*err) {
+        log_msg(LOG_ERR, "CONFIG[%s:%d]: %s",
+            conf->confFileName, lex_line(l), err);
+        while (lex_prev(l) != LEX_EOL && lex_prev(l) != LEX_EOF) {
+            (void) lex_next(l);
+        }
+    }
+    destroy_string(pattern);
+    destroy_string(consoles);
+    destroy_string(actions);
+    destroy_string(cmd);
+    return;
+}
+
+
 static int read_pidfile(const char *pidfile)
 {
 /*  Reads the PID from the specified pidfile.
@@ -47,9 +47,12 @@ extern tpoll_t tp_global;               /* defined in server.c */
 
 
 static void perform_serial_break(obj_t *client);
+static void send_serial_break(obj_t *serial);
 static void perform_del_char_seq(obj_t *client);
 static void perform_console_writer_linkage(obj_t *client);
 static void perform_log_replay(obj_t *client);
+static void perform_deep_log_replay(obj_t *client);
+static void write_replay_msg(obj_t *client, obj_t *console, const char *fmt);
 static void perform_quiet_toggle(obj_t *client);
 static void perform_reset(obj_t *client);
 static void kill_reset_cmd(obj_t *console);
@@ -68,7 +71,7 @@ int process_client_escapes(obj_t *client, void *src, int len)
     unsigned char *p, *q;
 
     assert(is_client_obj(client));
-    assert(client->fd >= 0);
+    assert((client->fd >= 0) || (client->aux.client.conn != NULL));
 
     if (!src || len <= 0)
         return(0);
@@ -99,6 +102,9 @@ int process_client_escapes(obj_t *client, void *src, int len)
             case ESC_CHAR_REPLAY:
                 perform_log_replay(client);
                 break;
+            case ESC_CHAR_DEEP_REPLAY:
+                perform_deep_log_replay(client);
+                break;
             case ESC_CHAR_MONITOR:
                 client->aux.client.req->enableForce = 0;
                 client->aux.client.req->enableJoin = 0;
@@ -133,6 +139,92 @@ int process_client_escapes(obj_t *client, void *src, int len)
 }
 
 
+int start_log_replay(obj_t *client, obj_t *console, int lines, time_t since)
+{
+/*  Starts a deep log replay of the console's scrollback history or on-disk
+ *    logfile to the client (as chosen by create_console_reader()): the last
+ *    (lines) lines if (lines) is positive, or o/w the data logged since the
+ *    time (since).  Any replay already in progress is replaced.
+ *  The replay is read by feed_log_replay() as the client drains
+ *    its buffer, so it cannot overwrite data the client has yet to write.
+ *    Meanwhile, the console's output to the client is held in the console's
+ *    chain and written out once the replay completes.  Data the logfile
+ *    has yet to write out is not replayed.
+ *  Returns 0 if the replay is started, or -1 if the console has neither
+ *    a history nor a logfile.
+ */
+    log_reader_t *r;
+    log_reader_t *old;
+
+    assert(is_client_obj(client));
+    assert(is_console_obj(console));
+
+    if (!(r = create_console_reader(console, lines, since))) {
+        write_replay_msg(client, console,
+            "Console [%s] is not being logged -- cannot replay");
+        return(-1);
+    }
+    DPRINTF((5, "Performing deep log replay on console [%s].\n",
+        console->name));
+    write_replay_msg(client, console, "Begin deep log replay of console [%s]");
+
+    /*  The client may have already drained the "Begin" message,
+     *    so request another write_to_obj() to start feeding the replay.
+     */
+    x_pthread_mutex_lock(&client->bufLock);
+    old = client->aux.client.replay;
+    client->aux.client.replay = r;
+    wake_client_obj(client);
+    x_pthread_mutex_unlock(&client->bufLock);
+
+    destroy_log_reader(old);
+    return(0);
+}
+
+
+void feed_log_replay(obj_t *client, int len)
+{
+/*  Feeds up to (len) bytes of the client's deep log replay (if any)
+ *    into its circular-buffer.
+ *  Ends the replay once all of its data has been fed.
+ *  This is invoked by write_to_obj() (or drain_client_obj() for a channel)
+ *    on the main thread, which is the only thread that reads from or
+ *    destroys a replay once it has been started.
+ */
+    unsigned char buf[OBJ_CHUNK_SIZE];
+    log_reader_t *r;
+    obj_t *console;
+    int n;
+
+    assert(is_client_obj(client));
+
+    x_pthread_mutex_lock(&client->bufLock);
+    r = client->aux.client.replay;
+    x_pthread_mutex_unlock(&client->bufLock);
+
+    if (!r || (len <= 0)) {
+        return;
+    }
+    n = MIN(len, (int) sizeof(buf));
+    if ((n = read_log_reader(r, buf, n)) > 0) {
+        write_obj_data(client, buf, n, 0);
+        return;
+    }
+    x_pthread_mutex_lock(&client->bufLock);
+    client->aux.client.replay = NULL;
+    x_pthread_mutex_unlock(&client->bufLock);
+
+    destroy_log_reader(r);
+
+    if (!list_is_empty(client->writers)) {
+        console = list_peek(client->writers);
+        write_replay_msg(client, console,
+            "End deep log replay of console [%s]");
+    }
+    return;
+}
+
+
 static void perform_serial_break(obj_t *client)
 {
 /*  Transmits a serial-break to each of the consoles written to by the client.
@@ -165,10 +257,7 @@ static void perform_serial_break(obj_t *client)
             write_obj_data(console, &brk, 2, 0);
         }
         else if (is_serial_obj(console)) {
-            if (tcsendbreak(console->fd, 0) < 0)
-                log_msg(LOG_WARNING,
-                    "Unable to send serial-break to console [%s]: %s",
-                    console->name, strerror(errno));
+            defer_obj_callback(console, (callback_f) send_serial_break);
         }
         else if (is_telnet_obj(console)) {
             if (send_telnet_cmd(console, BREAK, -1) < 0) {
@@ -195,6 +284,26 @@ static void perform_serial_break(obj_t *client)
 }
 
 
+static void send_serial_break(obj_t *serial)
+{
+/*  Transmits a serial-break to the (serial) console.
+ *  This is invoked by the reactor servicing the console since it accesses
+ *    the console's fd.
+ */
+    assert(is_serial_obj(serial));
+
+    if (serial->fd < 0) {
+        return;
+    }
+    if (tcsendbreak(serial->fd, 0) < 0) {
+        log_msg(LOG_WARNING,
+            "Unable to send serial-break to console [%s]: %s",
+            serial->name, strerror(errno));
+    }
+    return;
+}
+
+
 static void perform_del_char_seq(obj_t *client)
 {
 /*  Transmits a del char to each of the consoles written to by the client.
@@ -262,8 +371,9 @@ static void perform_console_writer_linkage(obj_t *client)
 static void perform_log_replay(obj_t *client)
 {
 /*  Kinda like TiVo's Instant Replay.  :)
- *  Replays the last bytes from the console logfile (if present) associated
- *    with this client (in either a R/O or R/W session, but not a B/C session).
+ *  Replays the last bytes from the console's scrollback history or logfile
+ *    (if present) associated with this client (in either a R/O or R/W session,
+ *    but not a B/C session).
  *
  *  The maximum amount of data that can be written into an object's
  *    circular-buffer via write_obj_data() is (OBJ_BUF_SIZE - 1) bytes.
@@ -293,7 +403,7 @@ static void perform_log_replay(obj_t *client)
     assert(is_console_obj(console));
     logfile = get_console_logfile_obj(console);
 
-    if (!logfile) {
+    if (!logfile && !console->history) {
         assert(len > 0);
         n = snprintf((char *) ptr, len,
             "%sConsole [%s] is not being logged -- cannot replay%s",
@@ -308,7 +418,7 @@ static void perform_log_replay(obj_t *client)
         len -= n;
     }
     else {
-        assert(is_logfile_obj(logfile));
+        assert(!logfile || is_logfile_obj(logfile));
         assert(len > 0);
         n = snprintf((char *) ptr, len, "%sBegin log replay of console [%s]%s",
             CONMAN_MSG_PREFIX, console->name, CONMAN_MSG_SUFFIX);
@@ -331,49 +441,59 @@ static void perform_log_replay(obj_t *client)
                 console->name, client->name);
             return;
         }
-        x_pthread_mutex_lock(&logfile->bufLock);
-
-        /*  Compute the number of bytes to replay.
-         *  If the console's circular-buffer has not yet wrapped around,
-         *    don't wrap back into uncharted buffer territory.
-         *  The result is bounded by the value of LOG_REPLAY_LEN and the
-         *    amount of buffer space remaining in 'buf'.
+        /*  The history (when configured) is preferred over the logfile's
+         *    circular-buffer since it is not affected by log rotation.
          */
-        if (!logfile->gotBufWrap) {
-            n = logfile->bufInPtr - logfile->buf;
+        if (console->history) {
+            ptr += copy_obj_history(console, ptr, MIN(LOG_REPLAY_LEN, len));
         }
         else {
-            n = OBJ_BUF_SIZE - 1;
-        }
-        if (n < 0) {
-            n = 0;
-        }
-        if (n > LOG_REPLAY_LEN) {
-            n = LOG_REPLAY_LEN;
-        }
-        if (n > len) {
-            n = len;
-        }
+            x_pthread_mutex_lock(&logfile->bufLock);
+
+            /*  Compute the number of bytes to replay.
+             *  If the console's circular-buffer has not yet wrapped around,
+             *    don't wrap back into uncharted buffer territory.
+             *  The result is bounded by the value of LOG_REPLAY_LEN and the
+             *    amount of buffer space remaining in 'buf'.
+             */
+            if (!logfile->gotBufWrap) {
+                n = logfile->bufInPtr - logfile->buf;
+            }
+            else {
+                n = logfile->bufSize - 1;
+            }
+            if (n < 0) {
+                n = 0;
+            }
+            if (n > LOG_REPLAY_LEN) {
+                n = LOG_REPLAY_LEN;
+            }
+            if (n > len) {
+                n = len;
+            }
 
-        p = logfile->bufInPtr - n;
-        if (p >= logfile->buf) {        /* no wrap needed */
-            assert(n > 0);
-            memcpy(ptr, p, n);
-            ptr += n;
-        }
-        else {                          /* wrap backwards */
-            m = logfile->buf - p;
-            assert(m > 0);
-            assert(m <= n);
-            p = &logfile->buf[OBJ_BUF_SIZE] - m;
-            memcpy(ptr, p, m);
-            ptr += m;
-            n -= m;
-            memcpy(ptr, logfile->buf, n);
-            ptr += n;
-        }
+            p = logfile->bufInPtr - n;
+            if (n == 0) {                   /* nothing logged yet */
+                ;
+            }
+            else if (p >= logfile->buf) {   /* no wrap needed */
+                memcpy(ptr, p, n);
+                ptr += n;
+            }
+            else {                          /* wrap backwards */
+                m = logfile->buf - p;
+                assert(m > 0);
+                assert(m <= n);
+                p = &logfile->buf[logfile->bufSize] - m;
+                memcpy(ptr, p, m);
+                ptr += m;
+                n -= m;
+                memcpy(ptr, logfile->buf, n);
+                ptr += n;
+            }
 
-        x_pthread_mutex_unlock(&logfile->bufLock);
+            x_pthread_mutex_unlock(&logfile->bufLock);
+        }
 
         /*  Recompute 'len' since space was already reserved for it above.
          */
@@ -391,6 +511,63 @@ static void perform_log_replay(obj_t *client)
 }
 
 
+static void perform_deep_log_replay(obj_t *client)
+{
+/*  Replays the console logfile (if present) associated with this client
+ *    from disk (in either a R/O or R/W session, but not a B/C session).
+ *  The number of lines (or the start time) requested when the client
+ *    connected is replayed, or o/w the last LOG_DEEP_REPLAY_LINES lines.
+ */
+    obj_t *console;
+    req_t *req;
+
+    assert(is_client_obj(client));
+
+    /*  Broadcast sessions are "write-only", so the log-replay is a no-op.
+     */
+    if (list_is_empty(client->writers))
+        return;
+
+    assert(list_count(client->writers) == 1);
+    console = list_peek(client->writers);
+    assert(is_console_obj(console));
+
+    req = client->aux.client.req;
+    if ((req->replayLines == 0) && (req->timeSince == 0)) {
+        (void) start_log_replay(client, console, LOG_DEEP_REPLAY_LINES, 0);
+    }
+    else {
+        (void) start_log_replay(client, console,
+            req->replayLines, req->timeSince);
+    }
+    return;
+}
+
+
+static void write_replay_msg(obj_t *client, obj_t *console, const char *fmt)
+{
+/*  Writes an informational message about the deep log replay of the console
+ *    to the client, where (fmt) contains a single "%s" for the console name.
+ */
+    char msg[MAX_LINE];
+    char buf[MAX_LINE];
+    int n;
+
+    n = snprintf(msg, sizeof(msg), fmt, console->name);
+    if ((n >= 0) && ((size_t) n < sizeof(msg))) {
+        n = snprintf(buf, sizeof(buf), "%s%s%s",
+            CONMAN_MSG_PREFIX, msg, CONMAN_MSG_SUFFIX);
+    }
+    if ((n < 0) || ((size_t) n >= sizeof(buf))) {
+        log_msg(LOG_WARNING,
+            "Insufficient buffer to write message to <%s>", client->name);
+        return;
+    }
+    write_obj_data(client, buf, n, 0);
+    return;
+}
+
+
 static void perform_quiet_toggle(obj_t *client)
 {
 /*  Toggles whether informational messages are suppressed by the client.
@@ -561,11 +738,11 @@ static void perform_suspend(obj_t *client)
 
     client->aux.client.gotSuspend ^= 1;
 
-    if (client->aux.client.gotSuspend) {
-        tpoll_clear(tp_global, client->fd, POLLOUT);
+    if (!client->aux.client.gotSuspend) {
+        wake_client_obj(client);
     }
-    else {
-        tpoll_set(tp_global, client->fd, POLLOUT);
+    else if (!client->aux.client.conn) {
+        tpoll_clear(client->tp, client->fd, POLLOUT);
     }
 
     /*  FIXME: Do check_console_state() here looking for downed telnets.
@@ -0,0 +1,280 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "list.h"
+#include "log.h"
+#include "server.h"
+#include "util.h"
+#include "wrapper.h"
+
+
+/*  A console's scrollback history is a ring holding the most recent data
+ *    read from the console, independent of whether it is being logged.
+ *  The rings of all consoles are carved from a single arena allocated once
+ *    the configuration has been read, so the history does not fragment the
+ *    heap or add a per-console allocation to the daemon's footprint.
+ */
+
+
+int parse_history_size(int *sizep, const char *str)
+{
+/*  Parses 'str' for a history size of the form "<int>[k|m]",
+ *    where the optional 'k' or 'm' suffix denotes KiB or MiB.
+ *    A size of 0 disables the history.
+ *  Returns 0 and updates 'sizep' on success; o/w, returns -1.
+ */
+    long l;
+    char *endp;
+
+    assert(sizep != NULL);
+    assert(str != NULL);
+
+    errno = 0;
+    l = strtol(str, &endp, 10);
+    if ((endp == str) || (errno == ERANGE) || (l < 0)) {
+        return(-1);
+    }
+    if ((*endp == 'k') || (*endp == 'K')) {
+        l = (l > LONG_MAX / 1024) ? LONG_MAX : l * 1024;
+        endp++;
+    }
+    else if ((*endp == 'm') || (*endp == 'M')) {
+        l = (l > LONG_MAX / (1024 * 1024)) ? LONG_MAX : l * 1024 * 1024;
+        endp++;
+    }
+    if ((*endp != '\0') || (l > OBJ_BUF_MAX_SIZE)
+            || ((l > 0) && (l < OBJ_BUF_MIN_SIZE))) {
+        return(-1);
+    }
+    *sizep = l;
+    return(0);
+}
+
+
+void create_obj_history(obj_t *console, int size)
+{
+/*  Creates a scrollback history of (size) bytes for the console obj.
+ *  Its ring is not allocated until create_history_arena() is invoked.
+ */
+    obj_history_t *h;
+
+    assert(is_console_obj(console));
+    assert(console->history == NULL);
+
+    if (size <= 0) {
+        return;
+    }
+    if (!(h = malloc(sizeof(obj_history_t)))) {
+        out_of_memory();
+    }
+    h->buf = NULL;
+    h->size = size;
+    h->len = 0;
+    h->in = 0;
+    x_pthread_mutex_init(&h->lock, NULL);
+    console->history = h;
+    return;
+}
+
+
+void destroy_obj_history(obj_t *console)
+{
+/*  Destroys the console obj's scrollback history (if any).
+ *  Its ring is freed along with the arena by destroy_history_arena().
+ */
+    if (!console->history) {
+        return;
+    }
+    x_pthread_mutex_destroy(&console->history->lock);
+    free(console->history);
+    console->history = NULL;
+    return;
+}
+
+
+void create_history_arena(server_conf_t *conf)
+{
+/*  Allocates the arena holding the scrollback history rings of all consoles
+ *    in the configuration, and assigns each console its ring.
+ *  This must be invoked after the configuration has been read,
+ *    but before the consoles are opened.
+ */
+    ListIterator i;
+    obj_t *obj;
+    size_t total = 0;
+    unsigned char *p;
+
+    assert(conf != NULL);
+    assert(conf->histArena == NULL);
+
+    i = list_iterator_create(conf->objs);
+    while ((obj = list_next(i))) {
+        if (is_console_obj(obj) && obj->history) {
+            total += obj->history->size;
+        }
+    }
+    if (total == 0) {
+        list_iterator_destroy(i);
+        return;
+    }
+    if (!(conf->histArena = malloc(total))) {
+        out_of_memory();
+    }
+    conf->histArenaSize = total;
+
+    p = conf->histArena;
+    list_iterator_reset(i);
+    while ((obj = list_next(i))) {
+        if (is_console_obj(obj) && obj->history) {
+            obj->history->buf = p;
+            p += obj->history->size;
+        }
+    }
+    list_iterator_destroy(i);
+    assert(p == conf->histArena + total);
+
+    DPRINTF((5, "Allocated %lu-byte console history arena.\n",
+        (unsigned long) total));
+    return;
+}
+
+
+void destroy_history_arena(server_conf_t *conf)
+{
+/*  Frees the arena of scrollback history rings.
+ *  This must be invoked after the console objs have been destroyed.
+ */
+    assert(conf != NULL);
+
+    free(conf->histArena);
+    conf->histArena = NULL;
+    conf->histArenaSize = 0;
+    return;
+}
+
+
+void append_obj_history(obj_t *console, const void *src, int len)
+{
+/*  Appends the data (src) of length (len) read from the console obj
+ *    to its scrollback history (if any), overwriting the oldest data.
+ */
+    obj_history_t *h = console->history;
+    const unsigned char *p = src;
+    int m;
+
+    if (!h || !h->buf || (len <= 0)) {
+        return;
+    }
+    if (len > h->size) {
+        p += len - h->size;
+        len = h->size;
+    }
+    x_pthread_mutex_lock(&h->lock);
+    m = MIN(len, h->size - h->in);
+    memcpy(h->buf + h->in, p, m);
+    memcpy(h->buf, p + m, len - m);
+    h->in = (h->in + len) % h->size;
+    h->len = MIN(h->len + len, h->size);
+    x_pthread_mutex_unlock(&h->lock);
+    return;
+}
+
+
+int copy_obj_history(obj_t *console, void *dst, int len)
+{
+/*  Copies up to the last (len) bytes of the console obj's scrollback
+ *    history (oldest first) into the buffer (dst).
+ *  Returns the number of bytes copied.
+ */
+    obj_history_t *h = console->history;
+    unsigned char *q = dst;
+    int start;
+    int m;
+
+    if (!h || !h->buf || (len <= 0)) {
+        return(0);
+    }
+    x_pthread_mutex_lock(&h->lock);
+    len = MIN(len, h->len);
+    start = (h->in - len + h->size) % h->size;
+    m = MIN(len, h->size - start);
+    memcpy(q, h->buf + start, m);
+    memcpy(q + m, h->buf, len - m);
+    x_pthread_mutex_unlock(&h->lock);
+    return(len);
+}
+
+
+log_reader_t * create_console_reader(obj_t *console, int lines, time_t since)
+{
+/*  Creates a reader for the last (lines) lines of data read from the
+ *    console obj if (lines) is positive, or o/w the data since (since).
+ *  The console's scrollback history is read when it holds enough lines
+ *    (or if the console is not being logged); o/w, its logfiles are read.
+ *    The history is not timestamped, so all of it is read for (since).
+ *  Returns the new reader, or NULL if the console has neither a history
+ *    nor a logfile.
+ */
+    obj_t *logfile;
+    obj_history_t *h;
+    unsigned char *buf;
+    int len;
+    int n;
+    log_reader_t *r;
+
+    assert(is_console_obj(console));
+
+    logfile = get_console_logfile_obj(console);
+    h = console->history;
+
+    if (h && h->buf && ((lines > 0) || !logfile)) {
+        if (!(buf = malloc(h->size))) {
+            out_of_memory();
+        }
+        len = copy_obj_history(console, buf, h->size);
+        r = create_log_buffer_reader(buf, len, lines, &n);
+        if (!logfile || (n >= lines)) {
+            return(r);
+        }
+        destroy_log_reader(r);
+    }
+    if (!logfile) {
+        return(NULL);
+    }
+    if (lines > 0) {
+        return(create_log_line_reader(logfile, lines));
+    }
+    return(create_log_time_reader(logfile, since, 0));
+}
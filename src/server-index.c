@@ -0,0 +1,333 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "list.h"
+#include "server.h"
+#include "util-str.h"
+#include "util.h"
+
+
+/*  The console objs are indexed by name, the logfile objs by pathname, and
+ *    the console devices by device string, so the duplicate checks made as
+ *    each obj is created from the configuration do not walk conf->objs.
+ *  Each index is a chained hash table whose number of buckets is doubled
+ *    whenever it holds more entries than buckets.  Entries are only added
+ *    while the configuration is being read, so an index may be searched
+ *    without locking once the daemon is running.
+ *  Once the configuration has been read, the console objs are also placed
+ *    in two tables.  The consoleTable is sorted via compare_objs(), the order
+ *    in which consoles are listed to clients; a console's position in it is
+ *    its (id).  The consoleNames table is sorted via strcmp(), so consoles
+ *    whose names begin with a given prefix occupy a contiguous range of it,
+ *    which is found via binary search.
+ */
+
+
+#define OBJ_INDEX_MIN_BUCKETS           64
+
+
+static unsigned hash_key(const char *key);
+static void grow_obj_index(obj_index_t *idx);
+static int compare_console_objs(const void *p1, const void *p2);
+static int compare_console_names(const void *p1, const void *p2);
+
+
+void init_obj_index(obj_index_t *idx)
+{
+/*  Initializes the obj index (idx) to be empty.
+ */
+    assert(idx != NULL);
+
+    idx->buckets = NULL;
+    idx->numBuckets = 0;
+    idx->numEntries = 0;
+    return;
+}
+
+
+void destroy_obj_index(obj_index_t *idx)
+{
+/*  Destroys the entries of the obj index (idx), leaving it empty.
+ *  The objs themselves are not destroyed.
+ */
+    obj_index_entry_t *e;
+    int i;
+
+    assert(idx != NULL);
+
+    for (i = 0; i < idx->numBuckets; i++) {
+        while ((e = idx->buckets[i])) {
+            idx->buckets[i] = e->next;
+            destroy_string(e->key);
+            free(e);
+        }
+    }
+    free(idx->buckets);
+    init_obj_index(idx);
+    return;
+}
+
+
+void insert_obj_index(obj_index_t *idx, const char *key, obj_t *obj)
+{
+/*  Inserts the obj into the index (idx) under the string (key),
+ *    which is copied.  Several objs may share a key.
+ */
+    obj_index_entry_t *e;
+    int h;
+
+    assert(idx != NULL);
+    assert(key != NULL);
+    assert(obj != NULL);
+
+    if (idx->numEntries >= idx->numBuckets) {
+        grow_obj_index(idx);
+    }
+    if (!(e = malloc(sizeof(obj_index_entry_t)))) {
+        out_of_memory();
+    }
+    e->key = create_string(key);
+    e->hash = hash_key(key);
+    e->obj = obj;
+    h = e->hash & (idx->numBuckets - 1);
+    e->next = idx->buckets[h];
+    idx->buckets[h] = e;
+    idx->numEntries++;
+    return;
+}
+
+
+obj_t * find_obj_index(obj_index_t *idx, const char *key, int types)
+{
+/*  Searches the index (idx) for an obj of one of the given (types)
+ *    (a bitwise-OR of obj_type values) indexed under the string (key).
+ *  Returns the obj, or NULL if not found.
+ */
+    obj_index_entry_t *e;
+    unsigned hash;
+
+    assert(idx != NULL);
+    assert(key != NULL);
+
+    if (idx->numEntries == 0) {
+        return(NULL);
+    }
+    hash = hash_key(key);
+    for (e = idx->buckets[hash & (idx->numBuckets - 1)]; e; e = e->next) {
+        if ((e->hash == hash) && (e->obj->type & types)
+                && !strcmp(e->key, key)) {
+            return(e->obj);
+        }
+    }
+    return(NULL);
+}
+
+
+obj_t * find_console_obj(server_conf_t *conf, const char *name)
+{
+/*  Returns the console obj named (name), or NULL if not found.
+ */
+    assert(conf != NULL);
+    assert(name != NULL);
+
+    return(find_obj_index(&conf->consoleIndex, name, ~0));
+}
+
+
+void create_console_table(server_conf_t *conf)
+{
+/*  Creates the tables of console objs sorted by compare_objs() and by name,
+ *    setting each console's (id) to its index in the former.
+ */
+    ListIterator i;
+    obj_t *obj;
+    int n;
+
+    assert(conf != NULL);
+    assert(conf->consoleTable == NULL);
+    assert(conf->consoleNames == NULL);
+
+    n = list_count(conf->objs) + 1;
+    if (!(conf->consoleTable = malloc(n * sizeof(obj_t *)))) {
+        out_of_memory();
+    }
+    if (!(conf->consoleNames = malloc(n * sizeof(obj_t *)))) {
+        out_of_memory();
+    }
+    conf->numConsoles = 0;
+    i = list_iterator_create(conf->objs);
+    while ((obj = list_next(i))) {
+        if (is_console_obj(obj)) {
+            conf->consoleTable[conf->numConsoles] = obj;
+            conf->consoleNames[conf->numConsoles] = obj;
+            conf->numConsoles++;
+        }
+    }
+    list_iterator_destroy(i);
+
+    qsort(conf->consoleTable, conf->numConsoles, sizeof(obj_t *),
+        compare_console_objs);
+    qsort(conf->consoleNames, conf->numConsoles, sizeof(obj_t *),
+        compare_console_names);
+    for (n = 0; n < conf->numConsoles; n++) {
+        conf->consoleTable[n]->id = n;
+    }
+    return;
+}
+
+
+void destroy_console_table(server_conf_t *conf)
+{
+/*  Destroys the tables of console objs.
+ *  The objs themselves are not destroyed.
+ */
+    assert(conf != NULL);
+
+    free(conf->consoleTable);
+    conf->consoleTable = NULL;
+    free(conf->consoleNames);
+    conf->consoleNames = NULL;
+    conf->numConsoles = 0;
+    return;
+}
+
+
+int find_console_range(server_conf_t *conf, const char *prefix, int len,
+    int *firstp)
+{
+/*  Finds the range of consoles in the conf's consoleNames table whose names
+ *    begin with the first (len) chars of (prefix).
+ *  Returns the number of consoles in the range, setting (*firstp) to the
+ *    index of the first.
+ */
+    int lo, hi, mid;
+    int first;
+
+    assert(conf != NULL);
+    assert(prefix != NULL);
+    assert(firstp != NULL);
+
+    /*  Find the first name not less than the prefix.
+     */
+    lo = 0;
+    hi = conf->numConsoles;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (strncmp(conf->consoleNames[mid]->name, prefix, len) < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    first = lo;
+    /*
+     *  Find the first name past the prefix.
+     */
+    hi = conf->numConsoles;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (strncmp(conf->consoleNames[mid]->name, prefix, len) <= 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    *firstp = first;
+    return(lo - first);
+}
+
+
+static unsigned hash_key(const char *key)
+{
+/*  Returns the FNV-1a hash of the string (key).
+ */
+    const unsigned char *p;
+    unsigned h = 2166136261U;
+
+    for (p = (const unsigned char *) key; *p; p++) {
+        h ^= *p;
+        h *= 16777619U;
+    }
+    return(h);
+}
+
+
+static void grow_obj_index(obj_index_t *idx)
+{
+/*  Doubles the number of buckets in the index (idx),
+ *    rehashing its entries into the new buckets.
+ */
+    obj_index_entry_t **buckets;
+    obj_index_entry_t *e;
+    int n;
+    int i;
+    int h;
+
+    n = (idx->numBuckets > 0) ? idx->numBuckets * 2 : OBJ_INDEX_MIN_BUCKETS;
+    if (!(buckets = calloc(n, sizeof(obj_index_entry_t *)))) {
+        out_of_memory();
+    }
+    for (i = 0; i < idx->numBuckets; i++) {
+        while ((e = idx->buckets[i])) {
+            idx->buckets[i] = e->next;
+            h = e->hash & (n - 1);
+            e->next = buckets[h];
+            buckets[h] = e;
+        }
+    }
+    free(idx->buckets);
+    idx->buckets = buckets;
+    idx->numBuckets = n;
+    return;
+}
+
+
+static int compare_console_objs(const void *p1, const void *p2)
+{
+/*  Used by qsort() to sort console objs via compare_objs().
+ */
+    return(compare_objs(*(obj_t **) p1, *(obj_t **) p2));
+}
+
+
+static int compare_console_names(const void *p1, const void *p2)
+{
+/*  Used by qsort() to sort console objs by name in strcmp() order,
+ *    which find_console_range() relies upon.
+ */
+    const obj_t *obj1 = *(const obj_t **) p1;
+    const obj_t *obj2 = *(const obj_t **) p2;
+
+    return(strcmp(obj1->name, obj2->name));
+}
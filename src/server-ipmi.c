@@ -76,7 +76,6 @@ static int complete_ipmi_connect(obj_t *ipmi);
 static void fail_ipmi_connect(obj_t *ipmi);
 static void reset_ipmi_delay(obj_t *ipmi);
 
-extern tpoll_t tp_global;               /* defined in server.c */
 static int is_ipmi_engine_started = 0;
 
 
@@ -717,35 +716,27 @@ obj_t * create_ipmi_obj(server_conf_t *conf, char *name,
 /*  Creates a new IPMI device object and adds it to the master objs list.
  *  Returns the new object, or NULL on error.
  */
-    ListIterator i;
     obj_t *ipmi;
 
     assert(conf != NULL);
     assert((name != NULL) && (name[0] != '\0'));
     assert(iconf != NULL);
 
-    /*  Check for duplicate console names.
+    /*  Check for duplicate console names and hostnames.
      */
-    i = list_iterator_create(conf->objs);
-    while ((ipmi = list_next(i))) {
-        if (is_console_obj(ipmi) && !strcmp(ipmi->name, name)) {
-            if ((errbuf != NULL) && (errlen > 0)) {
-                snprintf(errbuf, errlen,
-                    "console [%s] specifies duplicate console name", name);
-            }
-            break;
-        }
-        if (is_ipmi_obj(ipmi) && !strcmp(ipmi->aux.ipmi.host, host)) {
-            if ((errbuf != NULL) && (errlen > 0)) {
-                snprintf(errbuf, errlen,
-                    "console [%s] specifies duplicate hostname \"%s\"",
-                    name, host);
-            }
-            break;
+    if (find_console_obj(conf, name)) {
+        if ((errbuf != NULL) && (errlen > 0)) {
+            snprintf(errbuf, errlen,
+                "console [%s] specifies duplicate console name", name);
         }
+        return(NULL);
     }
-    list_iterator_destroy(i);
-    if (ipmi != NULL) {
+    if (find_obj_index(&conf->deviceIndex, host, CONMAN_OBJ_IPMI)) {
+        if ((errbuf != NULL) && (errlen > 0)) {
+            snprintf(errbuf, errlen,
+                "console [%s] specifies duplicate hostname \"%s\"",
+                name, host);
+        }
         return(NULL);
     }
     ipmi = create_obj(conf, name, -1, CONMAN_OBJ_IPMI);
@@ -759,9 +750,12 @@ obj_t * create_ipmi_obj(server_conf_t *conf, char *name,
     x_pthread_mutex_init(&ipmi->aux.ipmi.mutex, NULL);
     conf->numIpmiObjs++;
     /*
-     *  Add obj to the master conf->objs list.
+     *  Add obj to the master conf->objs list
+     *    and index it by name and hostname.
      */
     list_append(conf->objs, ipmi);
+    insert_obj_index(&conf->consoleIndex, name, ipmi);
+    insert_obj_index(&conf->deviceIndex, ipmi->aux.ipmi.host, ipmi);
 
     DPRINTF((11,
         "Created IPMI [%s] H:%s U:%s P:%s K:%s L:%d C:%d W:0x%X\n",
@@ -817,23 +811,24 @@ static void disconnect_ipmi_obj(obj_t *ipmi)
 {
 /*  Closes the existing connection with the specified 'ipmi' obj.
  */
+    int fd;
+
     DPRINTF((10, "Disconnecting from <%s> via IPMI for [%s].\n",
         ipmi->aux.ipmi.host, ipmi->name));
 
     x_pthread_mutex_lock(&ipmi->aux.ipmi.mutex);
 
     if (ipmi->aux.ipmi.timer >= 0) {
-        (void) tpoll_timeout_cancel(tp_global, ipmi->aux.ipmi.timer);
+        (void) tpoll_timeout_cancel(ipmi->tp, ipmi->aux.ipmi.timer);
         ipmi->aux.ipmi.timer = -1;
     }
     if (ipmi->fd >= 0) {
-        tpoll_clear(tp_global, ipmi->fd, POLLIN | POLLOUT);
-        if (close(ipmi->fd) < 0) {
+        fd = detach_obj_fd(ipmi);
+        if (close(fd) < 0) {
             log_msg(LOG_WARNING,
                 "Unable to close connection to <%s> for console [%s]: %s",
                 ipmi->aux.ipmi.host, ipmi->name, strerror(errno));
         }
-        ipmi->fd = -1;
     }
     /*  Notify linked objs when transitioning from an UP state.
      */
@@ -874,7 +869,7 @@ static int connect_ipmi_obj(obj_t *ipmi)
     if (ipmi->aux.ipmi.state != CONMAN_IPMI_UP) {
 
         if (ipmi->aux.ipmi.timer >= 0) {
-            (void) tpoll_timeout_cancel(tp_global, ipmi->aux.ipmi.timer);
+            (void) tpoll_timeout_cancel(ipmi->tp, ipmi->aux.ipmi.timer);
             ipmi->aux.ipmi.timer = -1;
         }
         if (ipmi->aux.ipmi.state == CONMAN_IPMI_DOWN) {
@@ -927,7 +922,7 @@ static int initiate_ipmi_connect(obj_t *ipmi)
      *    connect_ipmi_obj().
      */
     assert(ipmi->aux.ipmi.timer == -1);
-    ipmi->aux.ipmi.timer = tpoll_timeout_relative(tp_global,
+    ipmi->aux.ipmi.timer = tpoll_timeout_relative(ipmi->tp,
         (callback_f) connect_ipmi_obj, ipmi,
         IPMI_CONNECT_TIMEOUT * 1000);
 
@@ -998,6 +993,7 @@ static int complete_ipmi_connect(obj_t *ipmi)
  *  XXX: This routine assumes the ipmi obj mutex is already locked.
  */
     ipmiconsole_ctx_status_t status;
+    int fd;
 
     assert(ipmi->aux.ipmi.state == CONMAN_IPMI_PENDING);
 
@@ -1005,15 +1001,16 @@ static int complete_ipmi_connect(obj_t *ipmi)
     if (status != IPMICONSOLE_CTX_STATUS_SOL_ESTABLISHED) {
         return(-1);
     }
-    if ((ipmi->fd = ipmiconsole_ctx_fd(ipmi->aux.ipmi.ctx)) < 0) {
+    if ((fd = ipmiconsole_ctx_fd(ipmi->aux.ipmi.ctx)) < 0) {
         return(-1);
     }
+    set_obj_fd(ipmi, fd);
     set_fd_nonblocking(ipmi->fd);
     set_fd_closed_on_exec(ipmi->fd);
 
     ipmi->gotEOF = 0;
     ipmi->aux.ipmi.state = CONMAN_IPMI_UP;
-    tpoll_set(tp_global, ipmi->fd, POLLIN);
+    tpoll_set(ipmi->tp, ipmi->fd, POLLIN);
 
     /*  Require the connection to be up for a minimum length of time
      *    before resetting the reconnect delay back to the minimum.
@@ -1021,7 +1018,7 @@ static int complete_ipmi_connect(obj_t *ipmi)
      *    connect_ipmi_obj().
      */
     assert(ipmi->aux.ipmi.timer == -1);
-    ipmi->aux.ipmi.timer = tpoll_timeout_relative(tp_global,
+    ipmi->aux.ipmi.timer = tpoll_timeout_relative(ipmi->tp,
         (callback_f) reset_ipmi_delay, ipmi, IPMI_MIN_TIMEOUT * 1000);
 
     /*  Notify linked objs when transitioning into an UP state.
@@ -1063,7 +1060,7 @@ static void fail_ipmi_connect(obj_t *ipmi)
     DPRINTF((15, "Reconnect attempt to <%s> via IPMI for [%s] in %ds.\n",
         ipmi->aux.ipmi.host, ipmi->name, ipmi->aux.ipmi.delay));
     assert(ipmi->aux.ipmi.timer == -1);
-    ipmi->aux.ipmi.timer = tpoll_timeout_relative(tp_global,
+    ipmi->aux.ipmi.timer = tpoll_timeout_relative(ipmi->tp,
         (callback_f) connect_ipmi_obj, ipmi,
         ipmi->aux.ipmi.delay * 1000);
 
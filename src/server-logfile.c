@@ -30,18 +30,90 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 #include "common.h"
 #include "log.h"
+#include "logframe.h"
 #include "server.h"
 #include "tpoll.h"
 #include "util-file.h"
 #include "util-str.h"
+#include "util.h"
+#include "wrapper.h"
 
-extern tpoll_t tp_global;               /* defined in server.c */
+
+static int parse_logfile_bufsize(int *sizep, const char *str);
+
+static int parse_logfile_tsformat(const char *str);
+
+static int parse_logfile_rotate_size(off_t *sizep, const char *str);
+
+static int parse_logfile_rotate_time(int *secsp, const char *str);
+
+static unsigned char * write_log_char(obj_t *log, unsigned char c,
+    unsigned char *q, const unsigned char *qLast);
+
+static const unsigned char * find_log_eol(const unsigned char *p, int len);
+
+static unsigned char * sanitize_log_run(unsigned char *q,
+    const unsigned char *p, int len);
+
+
+#if WITH_ZLIB
+/*  Deflate stream shared by all compressed logfiles.  A frame is compressed
+ *    in a single pass, so only one stream's state needs to be kept in memory
+ *    regardless of the number of logfiles.
+ */
+static pthread_mutex_t logZLock = PTHREAD_MUTEX_INITIALIZER;
+static z_stream logZStream;
+static int logZStreamInited = 0;
+#endif /* WITH_ZLIB */
+
+
+/*  Sanitized logs strip data to 7-bit ASCII and display control/binary
+ *    characters as two-character printable sequences.  This table maps each
+ *    byte to its sanitized representation of either one or two characters.
+ */
+static const char log_sanitize_map[256][3] = {
+    /* 0x00 */ "^@", "^A", "^B", "^C", "^D", "^E", "^F", "^G",
+    /* 0x08 */ "^H", "^I", "^J", "^K", "^L", "^M", "^N", "^O",
+    /* 0x10 */ "^P", "^Q", "^R", "^S", "^T", "^U", "^V", "^W",
+    /* 0x18 */ "^X", "^Y", "^Z", "^[", "^\\", "^]", "^^", "^_",
+    /* 0x20 */ " ", "!", "\"", "#", "$", "%", "&", "'",
+    /* 0x28 */ "(", ")", "*", "+", ",", "-", ".", "/",
+    /* 0x30 */ "0", "1", "2", "3", "4", "5", "6", "7",
+    /* 0x38 */ "8", "9", ":", ";", "<", "=", ">", "?",
+    /* 0x40 */ "@", "A", "B", "C", "D", "E", "F", "G",
+    /* 0x48 */ "H", "I", "J", "K", "L", "M", "N", "O",
+    /* 0x50 */ "P", "Q", "R", "S", "T", "U", "V", "W",
+    /* 0x58 */ "X", "Y", "Z", "[", "\\", "]", "^", "_",
+    /* 0x60 */ "`", "a", "b", "c", "d", "e", "f", "g",
+    /* 0x68 */ "h", "i", "j", "k", "l", "m", "n", "o",
+    /* 0x70 */ "p", "q", "r", "s", "t", "u", "v", "w",
+    /* 0x78 */ "x", "y", "z", "{", "|", "}", "~", "^?",
+    /* 0x80 */ "~@", "~A", "~B", "~C", "~D", "~E", "~F", "~G",
+    /* 0x88 */ "~H", "~I", "~J", "~K", "~L", "~M", "~N", "~O",
+    /* 0x90 */ "~P", "~Q", "~R", "~S", "~T", "~U", "~V", "~W",
+    /* 0x98 */ "~X", "~Y", "~Z", "~[", "~\\", "~]", "~^", "~_",
+    /* 0xA0 */ "` ", "`!", "`\"", "`#", "`$", "`%", "`&", "`'",
+    /* 0xA8 */ "`(", "`)", "`*", "`+", "`,", "`-", "`.", "`/",
+    /* 0xB0 */ "`0", "`1", "`2", "`3", "`4", "`5", "`6", "`7",
+    /* 0xB8 */ "`8", "`9", "`:", "`;", "`<", "`=", "`>", "`?",
+    /* 0xC0 */ "`@", "`A", "`B", "`C", "`D", "`E", "`F", "`G",
+    /* 0xC8 */ "`H", "`I", "`J", "`K", "`L", "`M", "`N", "`O",
+    /* 0xD0 */ "`P", "`Q", "`R", "`S", "`T", "`U", "`V", "`W",
+    /* 0xD8 */ "`X", "`Y", "`Z", "`[", "`\\", "`]", "`^", "`_",
+    /* 0xE0 */ "``", "`a", "`b", "`c", "`d", "`e", "`f", "`g",
+    /* 0xE8 */ "`h", "`i", "`j", "`k", "`l", "`m", "`n", "`o",
+    /* 0xF0 */ "`p", "`q", "`r", "`s", "`t", "`u", "`v", "`w",
+    /* 0xF8 */ "`x", "`y", "`z", "`{", "`|", "`}", "`~", "~?",
+};
 
 
 int parse_logfile_opts(logopt_t *opts, const char *str,
@@ -50,6 +122,10 @@ int parse_logfile_opts(logopt_t *opts, const char *str,
 /*  Parses 'str' for logfile device options 'opts'.
  *    The 'opts' struct should be initialized to a default value.
  *    The 'str' string is of the form "(sanitize|nosanitize)".
+ *    The "bufsize:<int>[k|m]" option sets the logfile buffer size limit.
+ *    The "timestamp:<fmt>" option enables timestamps in the given format.
+ *    The "rotate-size:<int>[k|m|g]", "rotate-time:<int>(m|h|d)", and
+ *    "rotate-keep:<int>" options control native logfile rotation.
  *  Returns 0 and updates the 'opts' struct on success; o/w, returns -1
  *    (writing an error message into 'errbuf' if defined).
  */
@@ -57,6 +133,7 @@ int parse_logfile_opts(logopt_t *opts, const char *str,
     char buf[MAX_LINE];
     const char * const separators = " \t\n.,;";
     char *tok;
+    int fmt;
 
     assert(opts != NULL);
 
@@ -93,6 +170,74 @@ int parse_logfile_opts(logopt_t *opts, const char *str,
             optsTmp.enableTimestamp = 1;
         else if (!strcasecmp(tok, "notimestamp"))
             optsTmp.enableTimestamp = 0;
+        else if (!strncasecmp(tok, "timestamp:", 10)) {
+            if ((fmt = parse_logfile_tsformat(tok + 10)) < 0) {
+                if ((errbuf != NULL) && (errlen > 0))
+                    snprintf(errbuf, errlen,
+                        "invalid logopt timestamp format \"%s\"", tok + 10);
+                return(-1);
+            }
+            optsTmp.enableTimestamp = 1;
+            optsTmp.tsFormat = fmt;
+        }
+        else if (!strcasecmp(tok, "compress")) {
+#if WITH_ZLIB
+            optsTmp.enableCompress = 1;
+#else /* !WITH_ZLIB */
+            if ((errbuf != NULL) && (errlen > 0))
+                snprintf(errbuf, errlen,
+                    "logopt compress requires zlib support");
+            return(-1);
+#endif /* !WITH_ZLIB */
+        }
+        else if (!strcasecmp(tok, "nocompress"))
+            optsTmp.enableCompress = 0;
+        else if (!strcasecmp(tok, "norotate")) {
+            optsTmp.rotateSize = 0;
+            optsTmp.rotateSecs = 0;
+        }
+        else if (!strncasecmp(tok, "rotate-size:", 12)) {
+            if (parse_logfile_rotate_size(&optsTmp.rotateSize, tok + 12) < 0) {
+                if ((errbuf != NULL) && (errlen > 0))
+                    snprintf(errbuf, errlen,
+                        "invalid logopt rotate-size \"%s\"", tok + 12);
+                return(-1);
+            }
+        }
+        else if (!strncasecmp(tok, "rotate-time:", 12)) {
+            if (parse_logfile_rotate_time(&optsTmp.rotateSecs, tok + 12) < 0) {
+                if ((errbuf != NULL) && (errlen > 0))
+                    snprintf(errbuf, errlen,
+                        "invalid logopt rotate-time \"%s\"", tok + 12);
+                return(-1);
+            }
+        }
+        else if (!strncasecmp(tok, "rotate-keep:", 12)) {
+            char *endp;
+            long l;
+
+            errno = 0;
+            l = strtol(tok + 12, &endp, 10);
+            if ((endp == tok + 12) || (*endp != '\0') || (errno == ERANGE)
+                    || (l < 0) || (l > MAX_LOGOPT_ROTATE_KEEP)) {
+                if ((errbuf != NULL) && (errlen > 0))
+                    snprintf(errbuf, errlen,
+                        "invalid logopt rotate-keep \"%s\" (range is 0-%d)",
+                        tok + 12, MAX_LOGOPT_ROTATE_KEEP);
+                return(-1);
+            }
+            optsTmp.rotateKeep = l;
+        }
+        else if (!strncasecmp(tok, "bufsize:", 8)) {
+            if (parse_logfile_bufsize(&optsTmp.bufSize, tok + 8) < 0) {
+                if ((errbuf != NULL) && (errlen > 0))
+                    snprintf(errbuf, errlen,
+                        "invalid logopt bufsize \"%s\" (range is %dk-%dm)",
+                        tok + 8, OBJ_BUF_MIN_SIZE / 1024,
+                        OBJ_BUF_MAX_SIZE / (1024 * 1024));
+                return(-1);
+            }
+        }
         else {
             log_msg(LOG_WARNING, "ignoring unrecognized token '%s'", tok);
         }
@@ -103,6 +248,138 @@ int parse_logfile_opts(logopt_t *opts, const char *str,
 }
 
 
+static int parse_logfile_bufsize(int *sizep, const char *str)
+{
+/*  Parses 'str' for a logfile buffer size of the form "<int>[k|m]",
+ *    where the optional 'k' or 'm' suffix denotes KiB or MiB.
+ *  Returns 0 and updates 'sizep' on success; o/w, returns -1.
+ */
+    long l;
+    char *endp;
+
+    assert(sizep != NULL);
+    assert(str != NULL);
+
+    errno = 0;
+    l = strtol(str, &endp, 10);
+    if ((endp == str) || (errno == ERANGE) || (l <= 0)) {
+        return(-1);
+    }
+    if ((*endp == 'k') || (*endp == 'K')) {
+        l = (l > LONG_MAX / 1024) ? LONG_MAX : l * 1024;
+        endp++;
+    }
+    else if ((*endp == 'm') || (*endp == 'M')) {
+        l = (l > LONG_MAX / (1024 * 1024)) ? LONG_MAX : l * 1024 * 1024;
+        endp++;
+    }
+    if ((*endp != '\0') || (l < OBJ_BUF_MIN_SIZE) || (l > OBJ_BUF_MAX_SIZE)) {
+        return(-1);
+    }
+    *sizep = l;
+    return(0);
+}
+
+
+static int parse_logfile_tsformat(const char *str)
+{
+/*  Parses 'str' for a logfile timestamp format of "sec", "ms", "us", "iso",
+ *    or "mono".
+ *  Returns the timestamp_fmt_t on success; o/w, returns -1.
+ */
+    assert(str != NULL);
+
+    if (!strcasecmp(str, "sec"))
+        return(CONMAN_TS_SEC);
+    if (!strcasecmp(str, "ms"))
+        return(CONMAN_TS_MSEC);
+    if (!strcasecmp(str, "us"))
+        return(CONMAN_TS_USEC);
+    if (!strcasecmp(str, "iso"))
+        return(CONMAN_TS_ISO8601);
+    if (!strcasecmp(str, "mono"))
+        return(CONMAN_TS_MONOTONIC);
+    return(-1);
+}
+
+
+static int parse_logfile_rotate_size(off_t *sizep, const char *str)
+{
+/*  Parses 'str' for a logfile rotation size of the form "<int>[k|m|g]",
+ *    where the optional 'k', 'm', or 'g' suffix denotes KiB, MiB, or GiB.
+ *  Returns 0 and updates 'sizep' on success; o/w, returns -1.
+ */
+    long l;
+    off_t n;
+    char *endp;
+
+    assert(sizep != NULL);
+    assert(str != NULL);
+
+    errno = 0;
+    l = strtol(str, &endp, 10);
+    if ((endp == str) || (errno == ERANGE) || (l <= 0)) {
+        return(-1);
+    }
+    n = l;
+    if ((*endp == 'k') || (*endp == 'K')) {
+        n *= 1024;
+        endp++;
+    }
+    else if ((*endp == 'm') || (*endp == 'M')) {
+        n *= 1024 * 1024;
+        endp++;
+    }
+    else if ((*endp == 'g') || (*endp == 'G')) {
+        n *= 1024 * 1024 * 1024;
+        endp++;
+    }
+    if ((*endp != '\0') || (n < l) || (n < OBJ_BUF_MIN_SIZE)) {
+        return(-1);
+    }
+    *sizep = n;
+    return(0);
+}
+
+
+static int parse_logfile_rotate_time(int *secsp, const char *str)
+{
+/*  Parses 'str' for a logfile rotation interval of the form "<int>(m|h|d)",
+ *    where the 'm', 'h', or 'd' suffix denotes minutes, hours, or days.
+ *  Returns 0 and updates 'secsp' (in seconds) on success; o/w, returns -1.
+ */
+    long l;
+    char *endp;
+
+    assert(secsp != NULL);
+    assert(str != NULL);
+
+    errno = 0;
+    l = strtol(str, &endp, 10);
+    if ((endp == str) || (errno == ERANGE) || (l <= 0)
+            || (l > INT_MAX / (60 * 60 * 24))) {
+        return(-1);
+    }
+    if ((*endp == 'm') || (*endp == 'M')) {
+        l *= 60;
+    }
+    else if ((*endp == 'h') || (*endp == 'H')) {
+        l *= 60 * 60;
+    }
+    else if ((*endp == 'd') || (*endp == 'D')) {
+        l *= 60 * 60 * 24;
+    }
+    else {
+        return(-1);
+    }
+    if (*++endp != '\0') {
+        return(-1);
+    }
+    *secsp = l;
+    return(0);
+}
+
+
 obj_t * create_logfile_obj(server_conf_t *conf, char *name,
     obj_t *console, logopt_t *opts, char *errbuf, int errlen)
 {
@@ -112,7 +389,6 @@ obj_t * create_logfile_obj(server_conf_t *conf, char *name,
  *    by main:open_objs:reopen_obj:open_logfile_obj().
  *  Returns the new object, or NULL on error.
  */
-    ListIterator i;
     obj_t *logfile;
     char buf[MAX_LINE];
     char *pname;
@@ -137,18 +413,8 @@ obj_t * create_logfile_obj(server_conf_t *conf, char *name,
         pname = name;
     }
 
-    i = list_iterator_create(conf->objs);
-    while ((logfile = list_next(i))) {
-        if (!is_logfile_obj(logfile)) {
-            continue;
-        }
-        if (!strcmp(logfile->name, pname)) {
-            break;
-        }
-    }
-    list_iterator_destroy(i);
-
-    if (logfile) {
+    if ((logfile = find_obj_index(
+            &conf->logfileIndex, pname, CONMAN_OBJ_LOGFILE))) {
         if ((errbuf != NULL) && (errlen > 0)) {
             snprintf(errbuf, errlen, "console [%s] already logging to \"%s\"",
                 logfile->aux.logfile.console->name, pname);
@@ -159,7 +425,22 @@ obj_t * create_logfile_obj(server_conf_t *conf, char *name,
     logfile->aux.logfile.console = console;
     logfile->aux.logfile.lineState = CONMAN_LOG_LINE_INIT;
     logfile->aux.logfile.opts = *opts;
+    logfile->bufMaxSize = opts->bufSize;
     logfile->aux.logfile.gotTruncate = !!conf->enableZeroLogs;
+    logfile->aux.logfile.outBuf = NULL;
+    logfile->aux.logfile.outLen = 0;
+    logfile->aux.logfile.outSize = 0;
+    logfile->aux.logfile.flushTimer = 0;
+    logfile->aux.logfile.fileSize = 0;
+    logfile->aux.logfile.timeRotate = 0;
+    logfile->aux.logfile.idxFd = -1;
+    logfile->aux.logfile.idxOffset = 0;
+    logfile->aux.logfile.idxTime = 0;
+    logfile->aux.logfile.zBuf = NULL;
+    logfile->aux.logfile.zLen = 0;
+    logfile->aux.logfile.zSize = 0;
+    logfile->aux.logfile.frameTimer = 0;
+    logfile->aux.logfile.gotFrameFlush = 0;
 
     if (logfile->aux.logfile.opts.enableSanitize
             || logfile->aux.logfile.opts.enableTimestamp) {
@@ -202,19 +483,24 @@ obj_t * create_logfile_obj(server_conf_t *conf, char *name,
     }
     /*  Add obj to the master conf->objs list
      *    before its corresponding console obj.
+     *  Since console objs are appended to the list as the configuration is
+     *    read, the console is found by advancing the conf's cursor from the
+     *    previous console rather than by walking the list from its head.
      */
-    i = list_iterator_create(conf->objs);
-    while ((obj = list_next(i))) {
+    if (!conf->objsCursor) {
+        conf->objsCursor = list_iterator_create(conf->objs);
+    }
+    while ((obj = list_next(conf->objsCursor))) {
         if (obj == console) {
-            list_insert(i, logfile);
+            list_insert(conf->objsCursor, logfile);
             break;
         }
     }
-    list_iterator_destroy(i);
     if (!obj) {
         log_err(0, "INTERNAL: Console [%s] object not found in master list",
             console->name);
     }
+    insert_obj_index(&conf->logfileIndex, pname, logfile);
     return(logfile);
 }
 
@@ -224,10 +510,15 @@ int open_logfile_obj(obj_t *logfile)
 /*  (Re)opens the specified 'logfile' obj.
  *  Since this logfile can be re-opened after the daemon has chdir()'d,
  *    it must be specified with an absolute pathname.
+ *  Once the daemon is running, this is invoked from the logfile reactor;
+ *    the obj's fd and name are swapped under its bufLock since a console
+ *    reactor may concurrently be writing into the logfile's buffer.
  *  Returns 0 if the logfile is successfully opened; o/w, returns -1.
  */
     char  dirname[PATH_MAX];
     int   flags;
+    int   fd;
+    struct stat st;
     char *now;
     char *msg;
 
@@ -239,11 +530,10 @@ int open_logfile_obj(obj_t *logfile)
     assert(logfile->aux.logfile.console->name != NULL);
 
     if (logfile->fd >= 0) {
-        tpoll_clear(tp_global, logfile->fd, POLLOUT);
-        if (close(logfile->fd) < 0)
+        fd = detach_obj_fd(logfile);
+        if (close(fd) < 0)
             log_msg(LOG_WARNING, "Unable to close logfile \"%s\": %s",
                 logfile->name, strerror(errno));
-        logfile->fd = -1;
     }
     /*  Perform conversion specifier expansion.
      */
@@ -257,11 +547,12 @@ int open_logfile_obj(obj_t *logfile)
             log_msg(LOG_WARNING,
                 "Unable to open logfile for [%s]: filename exceeded buffer",
                 logfile->aux.logfile.console->name);
-            logfile->fd = -1;
             return(-1);
         }
+        x_pthread_mutex_lock(&logfile->bufLock);
         free(logfile->name);
         logfile->name = create_string(buf);
+        x_pthread_mutex_unlock(&logfile->bufLock);
     }
     /*  Create intermediate directories.
      */
@@ -275,21 +566,31 @@ int open_logfile_obj(obj_t *logfile)
         logfile->aux.logfile.gotTruncate = 0;
         flags |= O_TRUNC;
     }
-    if ((logfile->fd = open(logfile->name, flags, S_IRUSR | S_IWUSR)) < 0) {
+    if ((fd = open(logfile->name, flags, S_IRUSR | S_IWUSR)) < 0) {
         log_msg(LOG_WARNING, "Unable to open logfile \"%s\": %s",
             logfile->name, strerror(errno));
         return(-1);
     }
-    if (logfile->aux.logfile.opts.enableLock
-            && (get_write_lock(logfile->fd) < 0)) {
+    if (logfile->aux.logfile.opts.enableLock && (get_write_lock(fd) < 0)) {
         log_msg(LOG_WARNING, "Unable to lock \"%s\"", logfile->name);
-        (void) close(logfile->fd);
-        logfile->fd = -1;
+        (void) close(fd);
         return(-1);
     }
+    set_fd_nonblocking(fd);             /* redundant, just playing it safe */
+    set_fd_closed_on_exec(fd);
+    /*
+     *  The rotation size includes any data already in the logfile,
+     *    whereas the rotation interval starts anew with each open.
+     */
+    logfile->aux.logfile.fileSize = (fstat(fd, &st) == 0) ? st.st_size : 0;
+    logfile->aux.logfile.timeRotate = (logfile->aux.logfile.opts.rotateSecs > 0)
+        ? time(NULL) + logfile->aux.logfile.opts.rotateSecs : 0;
+    (void) open_logfile_index(logfile, !!(flags & O_TRUNC));
+
+    set_obj_fd(logfile, fd);
+    x_pthread_mutex_lock(&logfile->bufLock);
     logfile->gotEOF = 0;
-    set_fd_nonblocking(logfile->fd);    /* redundant, just playing it safe */
-    set_fd_closed_on_exec(logfile->fd);
+    x_pthread_mutex_unlock(&logfile->bufLock);
 
     now = create_long_time_string(0);
     msg = create_format_string("%sConsole [%s] log opened at %s%s",
@@ -311,6 +612,165 @@ int open_logfile_obj(obj_t *logfile)
 }
 
 
+int is_logfile_rotate_due(obj_t *logfile)
+{
+/*  Returns true if the 'logfile' obj has reached the size or age at which
+ *    it is to be rotated; o/w, returns false.
+ */
+    assert(logfile != NULL);
+    assert(is_logfile_obj(logfile));
+
+    if ((logfile->aux.logfile.opts.rotateSize > 0)
+            && (logfile->aux.logfile.fileSize
+                >= logfile->aux.logfile.opts.rotateSize)) {
+        return(1);
+    }
+    if ((logfile->aux.logfile.timeRotate > 0)
+            && (time(NULL) >= logfile->aux.logfile.timeRotate)) {
+        return(1);
+    }
+    return(0);
+}
+
+
+int rotate_logfile_obj(obj_t *logfile)
+{
+/*  Rotates the specified 'logfile' obj.  The logfiles previously rotated
+ *    have their numeric suffixes incremented (discarding those beyond the
+ *    rotate-keep limit), the current logfile is renamed with a ".1" suffix
+ *    (or removed if none are kept), and a new logfile is opened in its place.
+ *  Each logfile's sidecar index is renamed (or removed) along with it.
+ *  This is invoked from the logfile reactor once the data written to the
+ *    logfile has been flushed, so each logfile is rotated independently
+ *    without SIGHUP reopening every logfile at once.
+ *  Returns 0 if the new logfile is successfully opened; o/w, returns -1.
+ */
+    char src[PATH_MAX];
+    char dst[PATH_MAX];
+    int keep;
+    int k;
+
+    assert(logfile != NULL);
+    assert(is_logfile_obj(logfile));
+    assert(logfile->name != NULL);
+
+    keep = logfile->aux.logfile.opts.rotateKeep;
+
+    for (k = keep - 1; k >= 1; k--) {
+        if ((snprintf(src, sizeof(src), "%s.%d", logfile->name, k)
+                    >= (int) sizeof(src))
+                || (snprintf(dst, sizeof(dst), "%s.%d", logfile->name, k + 1)
+                    >= (int) sizeof(dst))) {
+            log_msg(LOG_WARNING,
+                "Unable to rotate logfile \"%s\": filename exceeded buffer",
+                logfile->name);
+            goto err;
+        }
+        if ((rename(src, dst) < 0) && (errno != ENOENT)) {
+            log_msg(LOG_WARNING, "Unable to rename \"%s\" to \"%s\": %s",
+                src, dst, strerror(errno));
+        }
+        rename_logfile_index(src, dst);
+    }
+    if (keep > 0) {
+        if (snprintf(dst, sizeof(dst), "%s.1", logfile->name)
+                >= (int) sizeof(dst)) {
+            log_msg(LOG_WARNING,
+                "Unable to rotate logfile \"%s\": filename exceeded buffer",
+                logfile->name);
+            goto err;
+        }
+        if (rename(logfile->name, dst) < 0) {
+            log_msg(LOG_WARNING, "Unable to rename \"%s\" to \"%s\": %s",
+                logfile->name, dst, strerror(errno));
+            goto err;
+        }
+        rename_logfile_index(logfile->name, dst);
+    }
+    else if (unlink(logfile->name) < 0) {
+        log_msg(LOG_WARNING, "Unable to remove logfile \"%s\": %s",
+            logfile->name, strerror(errno));
+        goto err;
+    }
+    else {
+        remove_logfile_index(logfile->name);
+    }
+    log_msg(LOG_INFO, "Console [%s] logfile \"%s\" rotated",
+        logfile->aux.logfile.console->name, logfile->name);
+    return(open_logfile_obj(logfile));
+
+err:
+    /*  Defer another attempt until the logfile again reaches its rotation
+     *    size or age.
+     */
+    logfile->aux.logfile.fileSize = 0;
+    if (logfile->aux.logfile.opts.rotateSecs > 0) {
+        logfile->aux.logfile.timeRotate =
+            time(NULL) + logfile->aux.logfile.opts.rotateSecs;
+    }
+    return(-1);
+}
+
+
+#if WITH_ZLIB
+int compress_logfile_frame(obj_t *logfile)
+{
+/*  Compresses the data accumulated in the 'logfile' obj's outBuf into a
+ *    frame in its zBuf, thereby emptying the outBuf.
+ *  This is invoked from the logfile reactor, so it never adds latency to
+ *    the console reactors.
+ *  Returns 0 on success, or -1 on error (in which case the data is lost).
+ */
+    logfile_obj_t *auxp;
+    unsigned char *p;
+    int n;
+
+    assert(logfile != NULL);
+    assert(is_logfile_obj(logfile));
+
+    auxp = &logfile->aux.logfile;
+    assert(auxp->zLen == 0);
+
+    if (auxp->outLen == 0) {
+        return(0);
+    }
+    n = logframe_bound(auxp->outLen);
+    if (n > auxp->zSize) {
+        if (!(p = realloc(auxp->zBuf, n))) {
+            out_of_memory();
+        }
+        auxp->zBuf = p;
+        auxp->zSize = n;
+    }
+    x_pthread_mutex_lock(&logZLock);
+    if (!logZStreamInited) {
+        memset(&logZStream, 0, sizeof(logZStream));
+        if (deflateInit2(&logZStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            log_err(0, "Unable to initialize zlib: %s",
+                logZStream.msg ? logZStream.msg : "unknown error");
+        }
+        logZStreamInited = 1;
+    }
+    n = logframe_encode(&logZStream, auxp->zBuf, auxp->zSize,
+        auxp->outBuf, auxp->outLen);
+    x_pthread_mutex_unlock(&logZLock);
+
+    if (n < 0) {
+        log_msg(LOG_WARNING, "Unable to compress %d bytes for [%s]",
+            auxp->outLen, logfile->name);
+        auxp->outLen = 0;
+        return(-1);
+    }
+    DPRINTF((15, "Compressed %d bytes into %d for [%s].\n",
+        auxp->outLen, n, logfile->name));
+    auxp->zLen = n;
+    auxp->outLen = 0;
+    return(0);
+}
+#endif /* WITH_ZLIB */
+
+
 obj_t * get_console_logfile_obj(obj_t *console)
 {
 /*  Returns a ptr to the logfile obj associated with 'console'
@@ -366,11 +826,14 @@ int write_log_data(obj_t *log, const void *src, int len)
  *    after each newline.
  *  Returns the number of bytes written into the logfile obj's buffer.
  */
-    const int minbuf = 25;              /* cr/lf + timestamp + meta/char */
+    const int minbuf = TIMESTAMP_MAX_LEN + 6;   /* cr/lf+timestamp+meta/char */
     unsigned char buf[OBJ_BUF_SIZE - 1];
-    const unsigned char *p;
+    const unsigned char *p = src;
+    const unsigned char * const pLast = p + len;
+    const unsigned char *r;
     unsigned char *q;
     const unsigned char * const qLast = buf + sizeof(buf);
+    int m;
     int n = 0;
 
     assert(is_logfile_obj(log));
@@ -385,74 +848,33 @@ int write_log_data(obj_t *log, const void *src, int len)
     DPRINTF((15, "Processing %d bytes for [%s] log \"%s\".\n",
         len, log->aux.logfile.console->name, log->name));
 
-    for (p=src, q=buf; len>0; p++, len--) {
+    for (q=buf; p<pLast; ) {
         /*
-         *  A newline state machine is used to properly sanitize CR/LF line
-         *    terminations.  This is responsible for coalescing multiple CRs,
-         *    swapping LF/CR to CR/LF, transcribing CR/NUL to CR/LF,
-         *    prepending a CR to a lonely LF, and appending a LF to a
-         *    lonely CR to prevent characters from being overwritten.
+         *  Within a line, everything up to the next CR/LF is copied as a
+         *    single run (translated if sanitizing), bounded by the space
+         *    remaining in the internal buffer.  Only the byte ending the run
+         *    goes through the newline state machine.
          */
-        if (*p == '\r') {
-            if (log->aux.logfile.lineState == CONMAN_LOG_LINE_DATA) {
-                log->aux.logfile.lineState = CONMAN_LOG_LINE_CR;
-            }
-            else if (log->aux.logfile.lineState == CONMAN_LOG_LINE_INIT) {
-                if (log->aux.logfile.opts.enableTimestamp)
-                    q += write_time_string(0, (char *) q, qLast - q);
-                log->aux.logfile.lineState = CONMAN_LOG_LINE_CR;
-            }
-            else {
-                ; /* ignore */
-            }
-        }
-        else if (*p == '\n') {
-            if (  (log->aux.logfile.lineState == CONMAN_LOG_LINE_INIT)
-               || (log->aux.logfile.lineState == CONMAN_LOG_LINE_LF) ) {
-                if (log->aux.logfile.opts.enableTimestamp)
-                    q += write_time_string(0, (char *) q, qLast - q);
-            }
-            *q++ = '\r';
-            *q++ = '\n';
-            log->aux.logfile.lineState = CONMAN_LOG_LINE_LF;
-        }
-        else if (  (*p == '\0')
-                && (  (log->aux.logfile.lineState == CONMAN_LOG_LINE_CR)
-                   || (log->aux.logfile.lineState == CONMAN_LOG_LINE_LF) ) ) {
-            ; /* ignore */
-        }
-        else {
-            if (log->aux.logfile.lineState == CONMAN_LOG_LINE_CR) {
-                *q++ = '\r';
-                *q++ = '\n';
-            }
-            if (log->aux.logfile.lineState != CONMAN_LOG_LINE_DATA) {
-                if (log->aux.logfile.opts.enableTimestamp)
-                    q += write_time_string(0, (char *) q, qLast - q);
-            }
-            log->aux.logfile.lineState = CONMAN_LOG_LINE_DATA;
-
-            if (log->aux.logfile.opts.enableSanitize) {
-
-                int c = *p & 0x7F;      /* strip data to 7-bit ASCII */
-
-                if (c < 0x20) {         /* ASCII ctrl-chars */
-                    *q++ = (*p & 0x80) ? '~' : '^';
-                    *q++ = c + '@';
-                }
-                else if (c == 0x7F) {   /* ASCII DEL char */
-                    *q++ = (*p & 0x80) ? '~' : '^';
-                    *q++ = '?';
+        if (log->aux.logfile.lineState == CONMAN_LOG_LINE_DATA) {
+            m = (qLast - q) - minbuf;
+            if (log->aux.logfile.opts.enableSanitize)
+                m /= 2;
+            if (m > pLast - p)
+                m = pLast - p;
+            if (m > 0) {
+                r = find_log_eol(p, m);
+                if (log->aux.logfile.opts.enableSanitize) {
+                    q = sanitize_log_run(q, p, r - p);
                 }
                 else {
-                    if (*p & 0x80)
-                        *q++ = '`';
-                    *q++ = c;
+                    memcpy(q, p, r - p);
+                    q += r - p;
                 }
+                p = r;
             }
-            else {
-                *q++ = *p;
-            }
+        }
+        if (p < pLast) {
+            q = write_log_char(log, *p++, q, qLast);
         }
         /*  Flush internal buffer before it overruns.
          */
@@ -466,3 +888,122 @@ int write_log_data(obj_t *log, const void *src, int len)
     n += write_obj_data(log, buf, q - buf, 0);
     return(n);
 }
+
+
+static unsigned char * write_log_char(obj_t *log, unsigned char c,
+    unsigned char *q, const unsigned char *qLast)
+{
+/*  Writes the processed representation of the console character (c)
+ *    for the logfile obj (log) into the buffer (q), updating the log's
+ *    newline state.  The buffer must have at least 'minbuf' bytes remaining
+ *    before (qLast).
+ *  Returns a ptr to the byte following the last one written into (q).
+ */
+    const char *s;
+
+    /*  A newline state machine is used to properly sanitize CR/LF line
+     *    terminations.  This is responsible for coalescing multiple CRs,
+     *    swapping LF/CR to CR/LF, transcribing CR/NUL to CR/LF,
+     *    prepending a CR to a lonely LF, and appending a LF to a
+     *    lonely CR to prevent characters from being overwritten.
+     */
+    if (c == '\r') {
+        if (log->aux.logfile.lineState == CONMAN_LOG_LINE_DATA) {
+            log->aux.logfile.lineState = CONMAN_LOG_LINE_CR;
+        }
+        else if (log->aux.logfile.lineState == CONMAN_LOG_LINE_INIT) {
+            if (log->aux.logfile.opts.enableTimestamp)
+                q += write_timestamp_string(log->aux.logfile.opts.tsFormat,
+                    (char *) q, qLast - q);
+            log->aux.logfile.lineState = CONMAN_LOG_LINE_CR;
+        }
+        else {
+            ; /* ignore */
+        }
+    }
+    else if (c == '\n') {
+        if (  (log->aux.logfile.lineState == CONMAN_LOG_LINE_INIT)
+           || (log->aux.logfile.lineState == CONMAN_LOG_LINE_LF) ) {
+            if (log->aux.logfile.opts.enableTimestamp)
+                q += write_timestamp_string(log->aux.logfile.opts.tsFormat,
+                    (char *) q, qLast - q);
+        }
+        *q++ = '\r';
+        *q++ = '\n';
+        log->aux.logfile.lineState = CONMAN_LOG_LINE_LF;
+    }
+    else if (  (c == '\0')
+            && (  (log->aux.logfile.lineState == CONMAN_LOG_LINE_CR)
+               || (log->aux.logfile.lineState == CONMAN_LOG_LINE_LF) ) ) {
+        ; /* ignore */
+    }
+    else {
+        if (log->aux.logfile.lineState == CONMAN_LOG_LINE_CR) {
+            *q++ = '\r';
+            *q++ = '\n';
+        }
+        if (log->aux.logfile.lineState != CONMAN_LOG_LINE_DATA) {
+            if (log->aux.logfile.opts.enableTimestamp)
+                q += write_timestamp_string(log->aux.logfile.opts.tsFormat,
+                    (char *) q, qLast - q);
+        }
+        log->aux.logfile.lineState = CONMAN_LOG_LINE_DATA;
+
+        if (log->aux.logfile.opts.enableSanitize) {
+            s = log_sanitize_map[c];
+            *q++ = s[0];
+            if (s[1] != '\0')
+                *q++ = s[1];
+        }
+        else {
+            *q++ = c;
+        }
+    }
+    return(q);
+}
+
+
+static const unsigned char * find_log_eol(const unsigned char *p, int len)
+{
+/*  Searches the first (len) bytes of (p) for a CR or LF.
+ *  Returns a ptr to the first one found, or to the byte following the
+ *    search range if neither is found.
+ */
+    const unsigned char *lf;
+    const unsigned char *cr = NULL;
+
+    assert(p != NULL);
+    assert(len > 0);
+
+    /*  The CR search is bounded by the LF (if any) so the memchr() calls
+     *    examine no more of the data than is needed.
+     */
+    if ((lf = memchr(p, '\n', len)) != NULL)
+        len = lf - p;
+    if (len > 0)
+        cr = memchr(p, '\r', len);
+    if (cr != NULL)
+        return(cr);
+    if (lf != NULL)
+        return(lf);
+    return(p + len);
+}
+
+
+static unsigned char * sanitize_log_run(unsigned char *q,
+    const unsigned char *p, int len)
+{
+/*  Writes the sanitized representation of the (len) bytes of (p) into (q),
+ *    which must have at least (2 * len) bytes available.
+ *  Returns a ptr to the byte following the last one written into (q).
+ */
+    const char *s;
+
+    for (; len > 0; p++, len--) {
+        s = log_sanitize_map[*p];
+        *q++ = s[0];
+        if (s[1] != '\0')
+            *q++ = s[1];
+    }
+    return(q);
+}
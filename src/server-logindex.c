@@ -0,0 +1,1247 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "common.h"
+#include "list.h"
+#include "log.h"
+#include "logframe.h"
+#include "server.h"
+#include "util-file.h"
+#include "util-str.h"
+#include "util.h"
+#include "wrapper.h"
+
+
+/*  A logfile's sidecar index is a file named by appending LOG_INDEX_SUFFIX
+ *    to the logfile's name.  It is an array of fixed-length entries, each
+ *    holding a time (in seconds since the epoch) and the logfile offset of
+ *    the first byte written (or the first frame compressed) at that time,
+ *    both as 64-bit little-endian integers.  Entries are appended in order
+ *    of increasing time and offset, so the index can be binary-searched.
+ */
+#define LOG_INDEX_SUFFIX        ".idx"
+#define LOG_INDEX_ENTRY_LEN     16
+#define LOG_RANGE_BUF_SIZE      65536
+
+
+/*  A log reader reads a list of segments in turn, each of which is a range
+ *    of offsets within a logfile.  For a compressed logfile, the range must
+ *    start at a frame, and frames are decompressed one at a time.
+ *  The segment's sidecar index is followed alongside it so the time at which
+ *    the data in the buffer was logged is known; an uncompressed chunk is
+ *    never read across an index entry, so all of its data shares that time.
+ */
+typedef struct log_seg {
+    char            *name;              /* name of logfile                   */
+    off_t            off;               /* offset of first byte (or frame)   */
+    off_t            end;               /* offset just past the range        */
+    int              skipLines;         /* num leading lines to skip         */
+} log_seg_t;
+
+struct log_reader {
+    List             segs;              /* list of segments yet to be read   */
+    int              fd;                /* fd of current segment, or -1      */
+    off_t            off;               /* offset of next read from segment  */
+    off_t            end;               /* end offset of current segment     */
+    int              skipLines;         /* num lines yet to be skipped       */
+    int              idxFd;             /* fd of current segment's index     */
+    long             idxNum;            /* num entries in current index      */
+    long             idxPos;            /* position of next index entry      */
+    off_t            idxOff;            /* offset of next index entry        */
+    time_t           idxTime;           /* time of next index entry          */
+    time_t           time;              /* time data in buffer was logged    */
+    unsigned char   *buf;               /* data read from current segment    */
+    int              bufSize;           /* size of data buffer               */
+    int              bufLen;            /* num bytes of data in buffer       */
+    int              bufPos;            /* offset of next byte in buffer     */
+    unsigned char   *zBuf;              /* buffer for a compressed frame     */
+    int              zSize;             /* size of compressed frame buffer   */
+#if WITH_ZLIB
+    z_stream         zs;                /* inflate stream for frames         */
+    unsigned         gotZStream:1;      /* true if zs has been initialized   */
+#endif /* WITH_ZLIB */
+    unsigned         isCompressed:1;    /* true if segment is compressed     */
+};
+
+
+static int get_index_name(char *dst, int dstlen, const char *name);
+static int get_rotated_name(char *dst, int dstlen, const char *name, int k);
+static int copy_logfile_name(obj_t *logfile, char *dst, size_t dstlen);
+static int find_time_range(const char *name, time_t since, time_t until,
+    off_t *offp, off_t *endp);
+static int find_line_range(log_reader_t *r, const char *name, int lines);
+#if WITH_ZLIB
+static int find_frame_line_range(log_reader_t *r, const char *name,
+    off_t size, int lines);
+static int count_log_lines(log_reader_t *r, unsigned char *lastp);
+#endif /* WITH_ZLIB */
+static long find_index_entry(int fd, long n, time_t t);
+static long find_index_offset(int fd, long n, off_t off);
+static int read_index_entry(int fd, long pos, time_t *tp, off_t *offp);
+static log_reader_t * create_log_reader(void);
+static void add_log_segment(log_reader_t *r, const char *name,
+    off_t off, off_t end, int skipLines, int isPrepended);
+static void destroy_log_segment(log_seg_t *seg);
+static int open_log_segment(log_reader_t *r);
+static void close_log_segment(log_reader_t *r);
+static void open_log_segment_index(log_reader_t *r, const char *name);
+static void advance_log_segment_index(log_reader_t *r);
+static int fill_log_reader(log_reader_t *r);
+#if WITH_ZLIB
+static int is_compressed_range(int fd, off_t off, off_t end);
+#endif /* WITH_ZLIB */
+static ssize_t pread_n(int fd, void *buf, size_t n, off_t off);
+static void put_le64(unsigned char *dst, unsigned long long n);
+static unsigned long long get_le64(const unsigned char *src);
+
+
+int open_logfile_index(obj_t *logfile, int doTruncate)
+{
+/*  (Re)opens the sidecar index of the 'logfile' obj, which must have just
+ *    been (re)opened with its fileSize set.
+ *  An existing index is appended to unless (doTruncate) is set or its last
+ *    entry lies beyond the end of the logfile, as happens when the logfile
+ *    has been truncated or replaced behind the daemon's back.
+ *  The logfile is still written if its index cannot be opened.
+ *  Returns 0 if the index is successfully opened; o/w, returns -1.
+ */
+    char name[PATH_MAX];
+    int flags;
+    int fd;
+    struct stat st;
+    off_t n;
+    time_t t;
+    off_t off;
+
+    assert(logfile != NULL);
+    assert(is_logfile_obj(logfile));
+    assert(logfile->name != NULL);
+
+    close_logfile_index(logfile);
+    logfile->aux.logfile.idxOffset = 0;
+    logfile->aux.logfile.idxTime = 0;
+
+    if (get_index_name(name, sizeof(name), logfile->name) < 0) {
+        log_msg(LOG_WARNING,
+            "Unable to open index for \"%s\": filename exceeded buffer",
+            logfile->name);
+        return(-1);
+    }
+    flags = O_RDWR | O_CREAT | O_APPEND;
+    if (doTruncate) {
+        flags |= O_TRUNC;
+    }
+    if ((fd = open(name, flags, S_IRUSR | S_IWUSR)) < 0) {
+        log_msg(LOG_WARNING, "Unable to open logfile index \"%s\": %s",
+            name, strerror(errno));
+        return(-1);
+    }
+    set_fd_closed_on_exec(fd);
+
+    if (fstat(fd, &st) < 0) {
+        log_msg(LOG_WARNING, "Unable to stat logfile index \"%s\": %s",
+            name, strerror(errno));
+        (void) close(fd);
+        return(-1);
+    }
+    /*  Discard a partial entry left by a crash, as well as the entire index
+     *    if it no longer describes the logfile.
+     */
+    n = st.st_size / LOG_INDEX_ENTRY_LEN;
+    if ((n > 0) && (read_index_entry(fd, n - 1, &t, &off) == 0)
+            && (off <= logfile->aux.logfile.fileSize)) {
+        logfile->aux.logfile.idxOffset = off;
+        logfile->aux.logfile.idxTime = t;
+    }
+    else {
+        n = 0;
+    }
+    if ((n * LOG_INDEX_ENTRY_LEN != st.st_size)
+            && (ftruncate(fd, n * LOG_INDEX_ENTRY_LEN) < 0)) {
+        log_msg(LOG_WARNING, "Unable to truncate logfile index \"%s\": %s",
+            name, strerror(errno));
+        (void) close(fd);
+        return(-1);
+    }
+    logfile->aux.logfile.idxFd = fd;
+    /*
+     *  Force an entry for the first data written after (re)opening.
+     */
+    logfile->aux.logfile.idxTime = 0;
+
+    DPRINTF((9, "Opened [%s] logfile index: fd=%d file=%s entries=%ld.\n",
+        logfile->aux.logfile.console->name, fd, name, (long) n));
+    return(0);
+}
+
+
+void close_logfile_index(obj_t *logfile)
+{
+/*  Closes the sidecar index of the 'logfile' obj (if open).
+ */
+    assert(logfile != NULL);
+    assert(is_logfile_obj(logfile));
+
+    if (logfile->aux.logfile.idxFd < 0) {
+        return;
+    }
+    if (close(logfile->aux.logfile.idxFd) < 0) {
+        log_msg(LOG_WARNING, "Unable to close index for logfile \"%s\": %s",
+            logfile->name, strerror(errno));
+    }
+    logfile->aux.logfile.idxFd = -1;
+    return;
+}
+
+
+void update_logfile_index(obj_t *logfile, off_t offset)
+{
+/*  Notes that the data about to be written to the 'logfile' obj will start
+ *    at (offset), appending an entry to its sidecar index if LOG_INDEX_SECS
+ *    have elapsed or LOG_INDEX_LEN bytes have been written since the last.
+ *  For a compressed logfile, (offset) must be that of a frame.
+ *  This is invoked from the logfile reactor without holding the bufLock.
+ */
+    logfile_obj_t *auxp;
+    unsigned char buf[LOG_INDEX_ENTRY_LEN];
+    time_t now;
+    int n;
+
+    assert(logfile != NULL);
+    assert(is_logfile_obj(logfile));
+
+    auxp = &logfile->aux.logfile;
+    if (auxp->idxFd < 0) {
+        return;
+    }
+    now = time(NULL);
+    if ((auxp->idxTime > 0)
+            && (now - auxp->idxTime < LOG_INDEX_SECS)
+            && (offset - auxp->idxOffset < LOG_INDEX_LEN)) {
+        return;
+    }
+    /*  Entry times must not decrease, even if the clock is stepped backwards.
+     */
+    if (now < auxp->idxTime) {
+        now = auxp->idxTime;
+    }
+    put_le64(buf, (unsigned long long) now);
+    put_le64(buf + 8, (unsigned long long) offset);
+
+    do {
+        n = write(auxp->idxFd, buf, sizeof(buf));
+    } while ((n < 0) && (errno == EINTR));
+
+    if (n != sizeof(buf)) {
+        log_msg(LOG_WARNING,
+            "Unable to write index for logfile \"%s\": %s; index disabled",
+            logfile->name, (n < 0) ? strerror(errno) : "short write");
+        close_logfile_index(logfile);
+        return;
+    }
+    auxp->idxOffset = offset;
+    auxp->idxTime = now;
+    return;
+}
+
+
+void rename_logfile_index(const char *src, const char *dst)
+{
+/*  Renames the sidecar index of the logfile (src) to be that of (dst),
+ *    such as when rotating the logfile.
+ */
+    char srcIdx[PATH_MAX];
+    char dstIdx[PATH_MAX];
+
+    assert(src != NULL);
+    assert(dst != NULL);
+
+    if ((get_index_name(srcIdx, sizeof(srcIdx), src) < 0)
+            || (get_index_name(dstIdx, sizeof(dstIdx), dst) < 0)) {
+        log_msg(LOG_WARNING,
+            "Unable to rename index for \"%s\": filename exceeded buffer",
+            src);
+        return;
+    }
+    if ((rename(srcIdx, dstIdx) < 0) && (errno != ENOENT)) {
+        log_msg(LOG_WARNING, "Unable to rename \"%s\" to \"%s\": %s",
+            srcIdx, dstIdx, strerror(errno));
+    }
+    return;
+}
+
+
+void remove_logfile_index(const char *name)
+{
+/*  Removes the sidecar index of the logfile (name).
+ */
+    char idx[PATH_MAX];
+
+    assert(name != NULL);
+
+    if (get_index_name(idx, sizeof(idx), name) < 0) {
+        return;
+    }
+    if ((unlink(idx) < 0) && (errno != ENOENT)) {
+        log_msg(LOG_WARNING, "Unable to remove \"%s\": %s",
+            idx, strerror(errno));
+    }
+    return;
+}
+
+
+log_reader_t * create_log_time_reader(obj_t *logfile,
+    time_t since, time_t until)
+{
+/*  Creates a reader for the data logged by the 'logfile' obj between the
+ *    times (since) and (until); a time of 0 leaves that end of the range
+ *    unbounded.
+ *  The logfiles rotated by the daemon are read (oldest first) followed by
+ *    the current logfile.  Each logfile's sidecar index is binary-searched
+ *    for the entries bounding the range, and only the data between them is
+ *    read (and decompressed if it was written with the "compress" logopt).
+ *    Since the data following an index entry was written within
+ *    LOG_INDEX_SECS of it, the data read may extend up to that long
+ *    beyond either end of the range.
+ *  Logfiles without an index are skipped, as is data not yet written out.
+ *  Returns the new reader, which must be destroyed by the caller.
+ */
+    log_reader_t *r;
+    char name[PATH_MAX];
+    char buf[PATH_MAX];
+    int k;
+    off_t off = 0;
+    off_t end = 0;
+
+    assert(logfile != NULL);
+    assert(is_logfile_obj(logfile));
+
+    r = create_log_reader();
+    if (copy_logfile_name(logfile, name, sizeof(name)) < 0) {
+        return(r);
+    }
+    for (k = logfile->aux.logfile.opts.rotateKeep; k >= 0; k--) {
+        if ((get_rotated_name(buf, sizeof(buf), name, k) == 0)
+                && (find_time_range(buf, since, until, &off, &end) == 0)) {
+            add_log_segment(r, buf, off, end, 0, 0);
+        }
+    }
+    return(r);
+}
+
+
+log_reader_t * create_log_line_reader(obj_t *logfile, int lines)
+{
+/*  Creates a reader for the last (lines) lines of data logged by the
+ *    'logfile' obj, where a trailing partial line counts as a line.
+ *  The current logfile is searched backwards, followed by the logfiles
+ *    rotated by the daemon (newest first) until enough lines are found.
+ *    An uncompressed logfile is scanned backwards from its end; a compressed
+ *    logfile is decompressed one sidecar index interval at a time.
+ *  Returns the new reader, which must be destroyed by the caller.
+ */
+    log_reader_t *r;
+    char name[PATH_MAX];
+    char buf[PATH_MAX];
+    int k;
+
+    assert(logfile != NULL);
+    assert(is_logfile_obj(logfile));
+
+    r = create_log_reader();
+    if ((lines <= 0) || (copy_logfile_name(logfile, name, sizeof(name)) < 0)) {
+        return(r);
+    }
+    for (k = 0; (k <= logfile->aux.logfile.opts.rotateKeep) && (lines > 0);
+            k++) {
+        if (get_rotated_name(buf, sizeof(buf), name, k) == 0) {
+            lines -= find_line_range(r, buf, lines);
+        }
+    }
+    return(r);
+}
+
+
+log_reader_t * create_log_buffer_reader(unsigned char *buf, int len,
+    int lines, int *numLinesp)
+{
+/*  Creates a reader for the data (buf) of length (len), which must have been
+ *    malloc'd and is freed along with the reader.  If (lines) is positive,
+ *    only the last (lines) lines of the data are read, where a trailing
+ *    partial line counts as a line.
+ *  Sets (*numLinesp) to the number of lines to be read if (lines) is
+ *    positive, or to 0 o/w.
+ *  Returns the new reader, which must be destroyed by the caller.
+ */
+    log_reader_t *r;
+    int i;
+    int count = 0;
+    int pos = 0;
+
+    assert((buf != NULL) || (len == 0));
+    assert(numLinesp != NULL);
+
+    if ((lines > 0) && (len > 0)) {
+        for (i = len - 2; i >= 0; i--) {
+            if ((buf[i] == '\n') && (++count == lines)) {
+                pos = i + 1;
+                break;
+            }
+        }
+        if (count < lines) {
+            count++;
+        }
+    }
+    *numLinesp = count;
+
+    r = create_log_reader();
+    free(r->buf);
+    r->buf = buf;
+    r->bufSize = len;
+    r->bufLen = len;
+    r->bufPos = pos;
+    return(r);
+}
+
+
+int read_log_reader(log_reader_t *r, void *dst, int len)
+{
+/*  Reads up to (len) bytes of logged data from the reader (r) into (dst).
+ *  At most one chunk (or one frame) is read from disk per call, so the
+ *    count returned may be short of (len) before all data has been read.
+ *  Returns the number of bytes read, or 0 once all data has been read.
+ */
+    unsigned char *p = dst;
+    unsigned char *q;
+    int n;
+
+    assert(r != NULL);
+    assert(dst != NULL);
+
+    while (len > 0) {
+        if (r->bufPos < r->bufLen) {
+            if (r->skipLines > 0) {
+                q = memchr(r->buf + r->bufPos, '\n', r->bufLen - r->bufPos);
+                if (q) {
+                    r->bufPos = q - r->buf + 1;
+                    r->skipLines--;
+                }
+                else {
+                    r->bufPos = r->bufLen;
+                }
+                continue;
+            }
+            n = MIN(len, r->bufLen - r->bufPos);
+            memcpy(p, r->buf + r->bufPos, n);
+            r->bufPos += n;
+            p += n;
+            len -= n;
+        }
+        else if (p != (unsigned char *) dst) {
+            break;
+        }
+        else if ((r->fd < 0) || (fill_log_reader(r) <= 0)) {
+            close_log_segment(r);
+            if (open_log_segment(r) < 0) {
+                break;
+            }
+        }
+    }
+    return(p - (unsigned char *) dst);
+}
+
+
+time_t get_log_reader_time(log_reader_t *r)
+{
+/*  Returns the time at which the data last read from the reader (r) was
+ *    logged (to within LOG_INDEX_SECS), or 0 if unknown (such as for data
+ *    not read from a logfile, or from a logfile without an index).
+ *  Since read_log_reader() returns data from one chunk (or frame) per call,
+ *    this applies to all of the data returned by the last call.
+ */
+    assert(r != NULL);
+    return(r->time);
+}
+
+
+void destroy_log_reader(log_reader_t *r)
+{
+/*  Destroys the reader (r), closing any logfile it has open.
+ */
+    if (!r) {
+        return;
+    }
+    close_log_segment(r);
+    list_destroy(r->segs);
+#if WITH_ZLIB
+    if (r->gotZStream) {
+        (void) inflateEnd(&r->zs);
+    }
+#endif /* WITH_ZLIB */
+    free(r->buf);
+    free(r->zBuf);
+    free(r);
+    return;
+}
+
+
+int write_logfile_range(obj_t *logfile, int sd, time_t since, time_t until)
+{
+/*  Writes the data logged by the 'logfile' obj between the times (since)
+ *    and (until) to the socket (sd), as read by create_log_time_reader().
+ *  This is invoked from a client thread, not from a reactor.
+ *  Returns 0 on success, or -1 if unable to write to the socket.
+ */
+    log_reader_t *r;
+    unsigned char buf[OBJ_CHUNK_SIZE];
+    int n;
+    int rc = 0;
+
+    assert(sd >= 0);
+
+    r = create_log_time_reader(logfile, since, until);
+    while ((n = read_log_reader(r, buf, sizeof(buf))) > 0) {
+        if (write_n(sd, buf, n) < 0) {
+            rc = -1;
+            break;
+        }
+    }
+    destroy_log_reader(r);
+    return(rc);
+}
+
+
+static int get_index_name(char *dst, int dstlen, const char *name)
+{
+/*  Writes the name of the sidecar index of the logfile (name) into the
+ *    buffer (dst) of length (dstlen).
+ *  Returns 0 on success, or -1 if the buffer is too small.
+ */
+    int n;
+
+    n = snprintf(dst, dstlen, "%s%s", name, LOG_INDEX_SUFFIX);
+    if ((n < 0) || (n >= dstlen)) {
+        return(-1);
+    }
+    return(0);
+}
+
+
+static int get_rotated_name(char *dst, int dstlen, const char *name, int k)
+{
+/*  Writes the name of the (k)th rotated logfile of the logfile (name)
+ *    into the buffer (dst) of length (dstlen); the 0th is (name) itself.
+ *  Returns 0 on success, or -1 if the buffer is too small.
+ */
+    int n;
+
+    if (k == 0) {
+        n = snprintf(dst, dstlen, "%s", name);
+    }
+    else {
+        n = snprintf(dst, dstlen, "%s.%d", name, k);
+    }
+    if ((n < 0) || (n >= dstlen)) {
+        return(-1);
+    }
+    return(0);
+}
+
+
+static int copy_logfile_name(obj_t *logfile, char *dst, size_t dstlen)
+{
+/*  Copies the name of the 'logfile' obj into the buffer (dst) of length
+ *    (dstlen).  The logfile reactor may swap the name while (re)opening
+ *    the logfile, so it is copied while holding the bufLock.
+ *  Returns 0 on success, or -1 if the buffer is too small.
+ */
+    size_t n;
+
+    x_pthread_mutex_lock(&logfile->bufLock);
+    n = strlcpy(dst, logfile->name, dstlen);
+    x_pthread_mutex_unlock(&logfile->bufLock);
+    return((n < dstlen) ? 0 : -1);
+}
+
+
+static int find_time_range(const char *name, time_t since, time_t until,
+    off_t *offp, off_t *endp)
+{
+/*  Searches the sidecar index of the logfile (name) for the range of
+ *    offsets [*offp,*endp) holding the data written between the times
+ *    (since) and (until).
+ *  Returns 0 if a non-empty range is found, or -1 if there is none
+ *    (including when the logfile or its index does not exist).
+ */
+    char idx[PATH_MAX];
+    int fd = -1;
+    int idxFd = -1;
+    struct stat st;
+    long n;
+    long i;
+    long j;
+    time_t t;
+    off_t off = 0;
+    off_t end;
+    int rc = -1;
+
+    if (get_index_name(idx, sizeof(idx), name) < 0) {
+        return(-1);
+    }
+    if ((idxFd = open(idx, O_RDONLY)) < 0) {
+        return(-1);
+    }
+    if ((fd = open(name, O_RDONLY)) < 0) {
+        goto end;
+    }
+    if (fstat(idxFd, &st) < 0) {
+        goto end;
+    }
+    n = st.st_size / LOG_INDEX_ENTRY_LEN;
+    if ((n == 0) || (fstat(fd, &st) < 0)) {
+        goto end;
+    }
+    /*  Start at the first entry whose data may have been written after
+     *    (since), and end at the first entry written after (until).
+     */
+    if (since > 0) {
+        if ((i = find_index_entry(idxFd, n, since - LOG_INDEX_SECS)) < 0) {
+            goto end;
+        }
+        if (i == n) {
+            goto end;
+        }
+        if (read_index_entry(idxFd, i, &t, &off) < 0) {
+            goto end;
+        }
+    }
+    end = st.st_size;
+    if (until > 0) {
+        if ((j = find_index_entry(idxFd, n, until)) < 0) {
+            goto end;
+        }
+        if ((j < n) && (read_index_entry(idxFd, j, &t, &end) < 0)) {
+            goto end;
+        }
+    }
+    if (end > st.st_size) {
+        end = st.st_size;
+    }
+    if (off < end) {
+        *offp = off;
+        *endp = end;
+        rc = 0;
+    }
+
+end:
+    if ((fd >= 0) && (close(fd) < 0)) {
+        log_msg(LOG_WARNING, "Unable to close \"%s\": %s",
+            name, strerror(errno));
+    }
+    if ((idxFd >= 0) && (close(idxFd) < 0)) {
+        log_msg(LOG_WARNING, "Unable to close \"%s\": %s",
+            idx, strerror(errno));
+    }
+    return(rc);
+}
+
+
+static int find_line_range(log_reader_t *r, const char *name, int lines)
+{
+/*  Searches backwards from the end of the logfile (name) for the start of
+ *    its last (lines) lines, and prepends the range to the reader (r).
+ *    If the logfile has fewer lines, the entire logfile is prepended.
+ *  Returns the number of lines in the range prepended.
+ */
+    int fd;
+    struct stat st;
+    off_t pos;
+    off_t off = 0;
+    int n;
+    int i;
+    int count = 0;
+
+    if ((fd = open(name, O_RDONLY)) < 0) {
+        return(0);
+    }
+    if ((fstat(fd, &st) < 0) || (st.st_size == 0)) {
+        (void) close(fd);
+        return(0);
+    }
+#if WITH_ZLIB
+    if (r->gotZStream && is_compressed_range(fd, 0, st.st_size)) {
+        (void) close(fd);
+        return(find_frame_line_range(r, name, st.st_size, lines));
+    }
+#endif /* WITH_ZLIB */
+
+    /*  The last byte is excluded since a trailing newline ends the last line.
+     */
+    pos = st.st_size - 1;
+    while ((pos > 0) && (count < lines)) {
+        n = MIN(pos, r->bufSize);
+        pos -= n;
+        if (pread_n(fd, r->buf, n, pos) != n) {
+            break;
+        }
+        for (i = n - 1; i >= 0; i--) {
+            if ((r->buf[i] == '\n') && (++count == lines)) {
+                off = pos + i + 1;
+                break;
+            }
+        }
+    }
+    if (close(fd) < 0) {
+        log_msg(LOG_WARNING, "Unable to close \"%s\": %s",
+            name, strerror(errno));
+    }
+    if (count < lines) {
+        off = 0;
+        count++;
+    }
+    add_log_segment(r, name, off, st.st_size, 0, 1);
+    return(count);
+}
+
+
+#if WITH_ZLIB
+static int find_frame_line_range(log_reader_t *r, const char *name,
+    off_t size, int lines)
+{
+/*  Searches backwards from offset (size) of the compressed logfile (name)
+ *    for the frame containing the start of its last (lines) lines, counting
+ *    the lines in each interval between sidecar index entries in turn.
+ *    The range starting at that frame (skipping the lines preceding the
+ *    last (lines) within it) is prepended to the reader (r).
+ *    If the logfile has fewer lines, the entire logfile is prepended.
+ *  Returns the number of lines in the range prepended.
+ */
+    char idx[PATH_MAX];
+    int idxFd;
+    struct stat st;
+    log_reader_t *tmp;
+    long n = 0;
+    long i;
+    time_t t;
+    off_t off;
+    off_t end;
+    int count;
+    int total = 0;
+    int isLast = 1;
+    unsigned char last;
+
+    if ((get_index_name(idx, sizeof(idx), name) == 0)
+            && ((idxFd = open(idx, O_RDONLY)) >= 0)) {
+        if (fstat(idxFd, &st) == 0) {
+            n = st.st_size / LOG_INDEX_ENTRY_LEN;
+        }
+    }
+    else {
+        idxFd = -1;
+    }
+    tmp = create_log_reader();
+    end = size;
+
+    for (i = n - 1; i >= -1; i--) {
+        off = 0;
+        if ((i >= 0) && (read_index_entry(idxFd, i, &t, &off) < 0)) {
+            break;
+        }
+        if (off >= end) {
+            continue;
+        }
+        add_log_segment(tmp, name, off, end, 0, 0);
+        count = count_log_lines(tmp, &last);
+        if (isLast && (count > 0) && (last == '\n')) {
+            count--;
+        }
+        isLast = 0;
+        total += count;
+        if (total >= lines) {
+            break;
+        }
+        end = off;
+    }
+    destroy_log_reader(tmp);
+    if ((idxFd >= 0) && (close(idxFd) < 0)) {
+        log_msg(LOG_WARNING, "Unable to close \"%s\": %s",
+            idx, strerror(errno));
+    }
+    if (total >= lines) {
+        add_log_segment(r, name, off, size, total - lines + 1, 1);
+        return(lines);
+    }
+    add_log_segment(r, name, 0, size, 0, 1);
+    return(total + 1);
+}
+
+
+static int count_log_lines(log_reader_t *r, unsigned char *lastp)
+{
+/*  Reads all of the data from the reader (r), counting its newlines and
+ *    noting its last byte in (*lastp) (or NUL if no data is read).
+ *  Returns the number of newlines read.
+ */
+    unsigned char buf[OBJ_CHUNK_SIZE];
+    unsigned char *p;
+    unsigned char *q;
+    int n;
+    int count = 0;
+
+    *lastp = '\0';
+    while ((n = read_log_reader(r, buf, sizeof(buf))) > 0) {
+        for (p = buf; (q = memchr(p, '\n', buf + n - p)); p = q + 1) {
+            count++;
+        }
+        *lastp = buf[n - 1];
+    }
+    return(count);
+}
+#endif /* WITH_ZLIB */
+
+
+static long find_index_entry(int fd, long n, time_t t)
+{
+/*  Binary-searches the (n) entries of the index (fd) for the first entry
+ *    whose time is later than (t).
+ *  Returns the position of that entry, (n) if there is none,
+ *    or -1 on error.
+ */
+    long lo = 0;
+    long hi = n;
+    long mid;
+    time_t tMid;
+    off_t off;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (read_index_entry(fd, mid, &tMid, &off) < 0) {
+            return(-1);
+        }
+        if (tMid > t) {
+            hi = mid;
+        }
+        else {
+            lo = mid + 1;
+        }
+    }
+    return(lo);
+}
+
+
+static long find_index_offset(int fd, long n, off_t off)
+{
+/*  Binary-searches the (n) entries of the index (fd) for the first entry
+ *    whose offset is greater than (off).
+ *  Returns the position of that entry, (n) if there is none,
+ *    or -1 on error.
+ */
+    long lo = 0;
+    long hi = n;
+    long mid;
+    time_t t;
+    off_t offMid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (read_index_entry(fd, mid, &t, &offMid) < 0) {
+            return(-1);
+        }
+        if (offMid > off) {
+            hi = mid;
+        }
+        else {
+            lo = mid + 1;
+        }
+    }
+    return(lo);
+}
+
+
+static int read_index_entry(int fd, long pos, time_t *tp, off_t *offp)
+{
+/*  Reads the index (fd) entry at position (pos) into (*tp) and (*offp).
+ *  Returns 0 on success, or -1 on error.
+ */
+    unsigned char buf[LOG_INDEX_ENTRY_LEN];
+
+    if (pread_n(fd, buf, sizeof(buf), (off_t) pos * LOG_INDEX_ENTRY_LEN)
+            != sizeof(buf)) {
+        return(-1);
+    }
+    *tp = (time_t) get_le64(buf);
+    *offp = (off_t) get_le64(buf + 8);
+    return(0);
+}
+
+
+static log_reader_t * create_log_reader(void)
+{
+/*  Creates a reader without any segments.
+ *  Returns the new reader.
+ */
+    log_reader_t *r;
+
+    if (!(r = malloc(sizeof(log_reader_t)))) {
+        out_of_memory();
+    }
+    memset(r, 0, sizeof(log_reader_t));
+    r->segs = list_create((ListDelF) destroy_log_segment);
+    r->fd = -1;
+    r->idxFd = -1;
+    r->bufSize = LOG_RANGE_BUF_SIZE;
+    if (!(r->buf = malloc(r->bufSize))) {
+        out_of_memory();
+    }
+#if WITH_ZLIB
+    if (inflateInit2(&r->zs, -MAX_WBITS) != Z_OK) {
+        log_msg(LOG_WARNING, "Unable to initialize zlib: %s",
+            r->zs.msg ? r->zs.msg : "unknown error");
+    }
+    else {
+        r->gotZStream = 1;
+    }
+#endif /* WITH_ZLIB */
+    return(r);
+}
+
+
+static void add_log_segment(log_reader_t *r, const char *name,
+    off_t off, off_t end, int skipLines, int isPrepended)
+{
+/*  Adds the range [off,end) of the logfile (name) to the reader (r),
+ *    skipping its first (skipLines) lines.  The segment is added at the
+ *    front of the reader's list if (isPrepended) is set, or o/w at the back.
+ */
+    log_seg_t *seg;
+
+    if (!(seg = malloc(sizeof(log_seg_t)))) {
+        out_of_memory();
+    }
+    seg->name = create_string(name);
+    seg->off = off;
+    seg->end = end;
+    seg->skipLines = skipLines;
+
+    if (isPrepended) {
+        list_prepend(r->segs, seg);
+    }
+    else {
+        list_append(r->segs, seg);
+    }
+    DPRINTF((10, "Reading \"%s\" range [%lld,%lld) skipping %d lines.\n",
+        name, (long long) off, (long long) end, skipLines));
+    return;
+}
+
+
+static void destroy_log_segment(log_seg_t *seg)
+{
+/*  Destroys the segment (seg).
+ */
+    if (!seg) {
+        return;
+    }
+    free(seg->name);
+    free(seg);
+    return;
+}
+
+
+static int open_log_segment(log_reader_t *r)
+{
+/*  Opens the next segment of the reader (r) that can be opened.
+ *  Returns 0 on success, or -1 if no segments remain.
+ */
+    log_seg_t *seg;
+    int fd;
+
+    while ((seg = list_pop(r->segs))) {
+        if ((fd = open(seg->name, O_RDONLY)) < 0) {
+            log_msg(LOG_WARNING, "Unable to open \"%s\": %s",
+                seg->name, strerror(errno));
+            destroy_log_segment(seg);
+            continue;
+        }
+        set_fd_closed_on_exec(fd);
+        r->fd = fd;
+        r->off = seg->off;
+        r->end = seg->end;
+        r->skipLines = seg->skipLines;
+        r->isCompressed = 0;
+#if WITH_ZLIB
+        r->isCompressed = r->gotZStream
+            && is_compressed_range(fd, seg->off, seg->end);
+#endif /* WITH_ZLIB */
+        open_log_segment_index(r, seg->name);
+        destroy_log_segment(seg);
+        return(0);
+    }
+    return(-1);
+}
+
+
+static void close_log_segment(log_reader_t *r)
+{
+/*  Closes the current segment of the reader (r) (if open),
+ *    discarding any of its data remaining in the reader's buffer.
+ */
+    if (r->fd >= 0) {
+        if (close(r->fd) < 0) {
+            log_msg(LOG_WARNING, "Unable to close logfile: %s",
+                strerror(errno));
+        }
+        r->fd = -1;
+    }
+    if (r->idxFd >= 0) {
+        if (close(r->idxFd) < 0) {
+            log_msg(LOG_WARNING, "Unable to close logfile index: %s",
+                strerror(errno));
+        }
+        r->idxFd = -1;
+    }
+    r->idxNum = r->idxPos = 0;
+    r->bufLen = r->bufPos = 0;
+    r->skipLines = 0;
+    return;
+}
+
+
+static void open_log_segment_index(log_reader_t *r, const char *name)
+{
+/*  Opens the sidecar index of the logfile (name) for the segment just
+ *    opened by the reader (r), positioning it at the entry covering the
+ *    segment's first byte.  Data preceding the first entry is taken to have
+ *    been logged at that entry's time.
+ *  The reader's time is left at 0 if the index cannot be read.
+ */
+    char idx[PATH_MAX];
+    struct stat st;
+    long i;
+    time_t t;
+    off_t off;
+
+    r->time = 0;
+    if ((get_index_name(idx, sizeof(idx), name) < 0)
+            || ((r->idxFd = open(idx, O_RDONLY)) < 0)) {
+        return;
+    }
+    set_fd_closed_on_exec(r->idxFd);
+    if (fstat(r->idxFd, &st) < 0) {
+        return;
+    }
+    r->idxNum = st.st_size / LOG_INDEX_ENTRY_LEN;
+    if (((i = find_index_offset(r->idxFd, r->idxNum, r->off)) < 0)
+            || (read_index_entry(r->idxFd, MAX(i - 1, 0), &t, &off) < 0)) {
+        r->idxNum = 0;
+        return;
+    }
+    r->time = t;
+    r->idxPos = i - 1;
+    advance_log_segment_index(r);
+    return;
+}
+
+
+static void advance_log_segment_index(log_reader_t *r)
+{
+/*  Advances the index of the reader's (r) current segment past the entries
+ *    at or before the segment's read offset, updating the reader's time.
+ *    The offset of the next entry beyond it is left in idxOff.
+ */
+    time_t t;
+    off_t off;
+
+    while (++r->idxPos < r->idxNum) {
+        if (read_index_entry(r->idxFd, r->idxPos, &t, &off) < 0) {
+            r->idxNum = 0;
+            break;
+        }
+        if (off > r->off) {
+            r->idxOff = off;
+            r->idxTime = t;
+            return;
+        }
+        r->time = t;
+    }
+    return;
+}
+
+
+static int fill_log_reader(log_reader_t *r)
+{
+/*  Reads the next chunk (or frame) of the current segment of the reader (r)
+ *    into the reader's buffer, replacing its contents.
+ *  Reading stops at a truncated or corrupted frame.
+ *  Returns the number of bytes in the buffer, or 0 at the end of the segment.
+ */
+    ssize_t n;
+#if WITH_ZLIB
+    unsigned char hdr[LOGFRAME_HDR_LEN];
+    int framelen;
+    int datalen;
+    unsigned char *p;
+#endif /* WITH_ZLIB */
+
+    r->bufLen = r->bufPos = 0;
+    if (r->off >= r->end) {
+        return(0);
+    }
+    if ((r->idxPos < r->idxNum) && (r->idxOff <= r->off)) {
+        r->time = r->idxTime;
+        advance_log_segment_index(r);
+    }
+#if WITH_ZLIB
+    if (r->isCompressed) {
+        if ((r->end - r->off < LOGFRAME_HDR_LEN)
+                || (pread_n(r->fd, hdr, sizeof(hdr), r->off) != sizeof(hdr))
+                || (logframe_parse_header(hdr, sizeof(hdr),
+                    &framelen, &datalen) < 0)
+                || (r->end - r->off < framelen)) {
+            return(0);
+        }
+        if (framelen > r->zSize) {
+            if (!(p = realloc(r->zBuf, framelen))) {
+                out_of_memory();
+            }
+            r->zBuf = p;
+            r->zSize = framelen;
+        }
+        if (datalen > r->bufSize) {
+            if (!(p = realloc(r->buf, datalen))) {
+                out_of_memory();
+            }
+            r->buf = p;
+            r->bufSize = datalen;
+        }
+        if ((pread_n(r->fd, r->zBuf, framelen, r->off) != framelen)
+                || (logframe_decode(&r->zs, r->buf, r->bufSize,
+                    r->zBuf, framelen) != datalen)) {
+            return(0);
+        }
+        r->off += framelen;
+        r->bufLen = datalen;
+        return(datalen);
+    }
+#endif /* WITH_ZLIB */
+    n = MIN(r->end - r->off, r->bufSize);
+    if (r->idxPos < r->idxNum) {
+        n = MIN(n, r->idxOff - r->off);
+    }
+    if ((n = pread_n(r->fd, r->buf, n, r->off)) <= 0) {
+        return(0);
+    }
+    r->off += n;
+    r->bufLen = n;
+    return(n);
+}
+
+
+#if WITH_ZLIB
+static int is_compressed_range(int fd, off_t off, off_t end)
+{
+/*  Returns true if the range [off,end) of the logfile (fd) starts with
+ *    a compressed frame.
+ */
+    unsigned char hdr[LOGFRAME_HDR_LEN];
+    int framelen;
+    int datalen;
+
+    return((end - off >= (off_t) sizeof(hdr))
+        && (pread_n(fd, hdr, sizeof(hdr), off) == sizeof(hdr))
+        && (logframe_parse_header(hdr, sizeof(hdr), &framelen, &datalen)
+            == 0));
+}
+#endif /* WITH_ZLIB */
+
+
+static ssize_t pread_n(int fd, void *buf, size_t n, off_t off)
+{
+/*  Reads up to (n) bytes at offset (off) of the file (fd) into (buf),
+ *    retrying short reads.
+ *  Returns the number of bytes read (which is less than (n) only at EOF),
+ *    or -1 on error.
+ */
+    size_t nleft = n;
+    ssize_t nread;
+    unsigned char *p = buf;
+
+    while (nleft > 0) {
+        if ((nread = pread(fd, p, nleft, off)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return(-1);
+        }
+        if (nread == 0) {
+            break;
+        }
+        nleft -= nread;
+        p += nread;
+        off += nread;
+    }
+    return(n - nleft);
+}
+
+
+static void put_le64(unsigned char *dst, unsigned long long n)
+{
+/*  Writes (n) into (dst) as a 64-bit little-endian integer.
+ */
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        dst[i] = (n >> (8 * i)) & 0xff;
+    }
+    return;
+}
+
+
+static unsigned long long get_le64(const unsigned char *src)
+{
+/*  Returns the 64-bit little-endian integer at (src).
+ */
+    unsigned long long n = 0;
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        n = (n << 8) | src[i];
+    }
+    return(n);
+}
@@ -0,0 +1,617 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  A client negotiating PROTOCOL=2 in its greeting multiplexes any number of
+ *    console sessions over its one connection (see common.h for the framing).
+ *  Each session is a channel: a client obj without an fd of its own, linked
+ *    to its console exactly as a client obj of a v1 connection would be, and
+ *    identified on the wire by its console's id.  Escape sequences in its
+ *    input are processed as for any other client.
+ *  Output to a channel accumulates in its circular-buffer and its console's
+ *    chain as usual.  But instead of having its fd polled for writing, the
+ *    channel is queued on its connection, whose write_to_obj() pumps the
+ *    queued channels round-robin, framing their output into the connection's
+ *    circular-buffer.  Framing stops once CLIENT_MUX_BUF_LEN bytes are
+ *    buffered, so a busy console cannot monopolize the connection, and output
+ *    remains in the channels (where it is subject to their lag limits) until
+ *    the client is ready to receive it.
+ *  A channel's output is also limited by the credit the client has granted
+ *    it via WINDOW frames; a channel without credit is held like a suspended
+ *    client until its credit is replenished.
+ *  Channels are only created, framed, and closed by the main thread, which
+ *    services every client connection.  A console reactor may queue a channel
+ *    as it appends output, so the ready queue is protected by a lock.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "common.h"
+#include "list.h"
+#include "log.h"
+#include "server.h"
+#include "tpoll.h"
+#include "util-str.h"
+#include "util.h"
+#include "wrapper.h"
+
+
+struct mux_conn {                       /* MULTIPLEXED CLIENT CONNECTION:    */
+    server_conf_t   *conf;              /*  server configuration             */
+    struct base_obj **channels;         /*  open channels indexed by con id  */
+    int              numSlots;          /*  num slots in each array by id    */
+    int              numChannels;       /*  num channels currently open      */
+    List             closed;            /*  closed channels awaiting reaping */
+    int             *ready;             /*  ring of ids of queued channels   */
+    unsigned char   *isReady;           /*  true if id is in ready ring      */
+    int              readyFirst;        /*  index of first id in ready ring  */
+    int              numReady;          /*  num ids in ready ring            */
+    pthread_mutex_t  readyLock;         /*  lock protecting ready ring       */
+    int              gotClosed;         /*  true once channels are closed    */
+    int              inLen;             /*  num bytes of frame read into in  */
+    unsigned char    in[MUX_FRAME_HDR_LEN + MUX_FRAME_MAX_LEN + 1];
+};
+
+
+static int dispatch_mux_frame(obj_t *conn, int type, int flags, int id,
+    unsigned char *src, int len);
+static void close_mux_channel(obj_t *conn, obj_t *chan);
+static void retire_mux_channel(obj_t *conn, obj_t *chan);
+static void pack_mux_frame_hdr(unsigned char *p, int type, int flags, int id,
+    int len);
+
+
+mux_conn_t * create_mux_conn(server_conf_t *conf)
+{
+/*  Creates the channel state of a multiplexed client connection.
+ *  The arrays indexed by console id are sized for every console in the
+ *    config, which is fixed once the daemon is running.
+ */
+    mux_conn_t *mux;
+    int n;
+
+    assert(conf != NULL);
+
+    if (!(mux = malloc(sizeof(mux_conn_t)))) {
+        out_of_memory();
+    }
+    n = MAX(conf->numConsoles, 1);
+    mux->conf = conf;
+    if (!(mux->channels = calloc(n, sizeof(obj_t *)))) {
+        out_of_memory();
+    }
+    if (!(mux->ready = malloc(n * sizeof(int)))) {
+        out_of_memory();
+    }
+    if (!(mux->isReady = calloc(n, sizeof(unsigned char)))) {
+        out_of_memory();
+    }
+    mux->numSlots = n;
+    mux->numChannels = 0;
+    mux->closed = list_create(NULL);
+    mux->readyFirst = 0;
+    mux->numReady = 0;
+    x_pthread_mutex_init(&mux->readyLock, NULL);
+    mux->gotClosed = 0;
+    mux->inLen = 0;
+    return(mux);
+}
+
+
+void destroy_mux_conn(mux_conn_t *mux)
+{
+/*  Destroys the channel state of a multiplexed client connection.
+ *  The channel objs themselves are destroyed via the master objs list.
+ */
+    if (!mux) {
+        return;
+    }
+    list_destroy(mux->closed);
+    x_pthread_mutex_destroy(&mux->readyLock);
+    free(mux->channels);
+    free(mux->ready);
+    free(mux->isReady);
+    free(mux);
+    return;
+}
+
+
+obj_t * create_mux_channel(obj_t *conn, obj_t *console, req_t *req)
+{
+/*  Creates a channel over the multiplexed connection (conn) for a session
+ *    on (console) as requested by (req), and adds it to the master objs list.
+ *  The channel has no fd; its req duplicates that of the connection
+ *    (for the client's identity) along with the session options of (req).
+ *  The caller is responsible for linking the channel to the console.
+ *  Returns the new channel obj.
+ */
+    mux_conn_t *mux;
+    req_t *creq;
+    req_t *r;
+    char name[MAX_LINE];
+    obj_t *chan;
+
+    assert(is_client_obj(conn));
+    assert(conn->aux.client.mux != NULL);
+    assert(is_console_obj(console));
+    assert(req != NULL);
+
+    mux = conn->aux.client.mux;
+    assert((console->id >= 0) && (console->id < mux->numSlots));
+    assert(mux->channels[console->id] == NULL);
+
+    creq = conn->aux.client.req;
+    r = create_req();
+    r->user = create_string(creq->user);
+    r->tty = create_string(creq->tty);
+    r->host = create_string(creq->host);
+    r->fqdn = create_string(creq->fqdn);
+    r->ip = create_string(creq->ip);
+    r->port = creq->port;
+    r->protocol = creq->protocol;
+    r->command = req->command;
+    r->enableForce = req->enableForce;
+    r->enableJoin = req->enableJoin;
+    r->enableQuiet = req->enableQuiet;
+
+    snprintf(name, sizeof(name), "%s[%s]", conn->name, console->name);
+    name[sizeof(name) - 1] = '\0';
+    chan = create_obj(mux->conf, name, -1, CONMAN_OBJ_CLIENT);
+    chan->id = console->id;
+    chan->aux.client.req = r;
+    chan->aux.client.cursor = NULL;
+    chan->aux.client.replay = NULL;
+    chan->aux.client.timeLastRead = conn->aux.client.timeLastRead;
+    chan->aux.client.mux = NULL;
+    chan->aux.client.conn = conn;
+    chan->aux.client.credit = MUX_WINDOW_SIZE;
+    chan->aux.client.gotEscape = 0;
+    chan->aux.client.gotSuspend = 0;
+
+    mux->channels[chan->id] = chan;
+    mux->numChannels++;
+    list_append(mux->conf->objs, chan);
+
+    DPRINTF((9, "Opened channel [%s] id=%d.\n", chan->name, chan->id));
+    return(chan);
+}
+
+
+int is_mux_channel_open(obj_t *conn, obj_t *console)
+{
+/*  Returns true if the multiplexed connection (conn) has a channel open
+ *    on (console).
+ */
+    mux_conn_t *mux = conn->aux.client.mux;
+
+    assert(mux != NULL);
+    assert((console->id >= 0) && (console->id < mux->numSlots));
+
+    return(mux->channels[console->id] != NULL);
+}
+
+
+int write_mux_frame(obj_t *conn, int type, int flags, int id,
+    const void *src, int len)
+{
+/*  Writes a frame of (type) with (flags) for channel (id) carrying the
+ *    payload (src) of length (len) into the connection's circular-buffer.
+ *  A frame is never truncated or overwritten; if the buffer cannot hold it,
+ *    the client is not keeping up and the frame is refused.
+ *  Returns 0 on success, or -1 if the frame could not be written.
+ */
+    unsigned char buf[MUX_FRAME_HDR_LEN + MUX_FRAME_MAX_LEN];
+    int n;
+
+    assert(is_client_obj(conn));
+    assert((len >= 0) && (len <= MUX_FRAME_MAX_LEN));
+
+    n = MUX_FRAME_HDR_LEN + len;
+    if (get_obj_buf_len(conn) + n >= conn->bufMaxSize) {
+        log_msg(LOG_NOTICE, "Unable to write frame to <%s>: buffer full",
+            conn->name);
+        return(-1);
+    }
+    pack_mux_frame_hdr(buf, type, flags, id, len);
+    if (len > 0) {
+        memcpy(buf + MUX_FRAME_HDR_LEN, src, len);
+    }
+    return(write_obj_data(conn, buf, n, 0) == n ? 0 : -1);
+}
+
+
+int process_mux_frames(obj_t *conn, const void *src, int len)
+{
+/*  Processes the data (src) of length (len) read from the multiplexed
+ *    connection (conn), dispatching each frame once it has been read
+ *    in its entirety.  A partial frame is retained until the next read.
+ *  Returns 0 on success, or -1 if the connection is to be shut down.
+ */
+    mux_conn_t *mux = conn->aux.client.mux;
+    const unsigned char *p = src;
+    unsigned char *hdr;
+    int n;
+    int frameLen;
+    int rc;
+
+    assert(mux != NULL);
+
+    hdr = mux->in;
+    while (len > 0) {
+
+        n = MUX_FRAME_HDR_LEN - mux->inLen;
+        if (n <= 0) {
+            n += (hdr[2] << 8) | hdr[3];
+        }
+        n = MIN(n, len);
+        memcpy(&mux->in[mux->inLen], p, n);
+        mux->inLen += n;
+        p += n;
+        len -= n;
+
+        if (mux->inLen < MUX_FRAME_HDR_LEN) {
+            continue;
+        }
+        frameLen = (hdr[2] << 8) | hdr[3];
+        if (frameLen > MUX_FRAME_MAX_LEN) {
+            log_msg(LOG_NOTICE, "Received oversized frame from <%s>",
+                conn->name);
+            return(-1);
+        }
+        if (mux->inLen < MUX_FRAME_HDR_LEN + frameLen) {
+            continue;
+        }
+        mux->inLen = 0;
+        rc = dispatch_mux_frame(conn, hdr[0], hdr[1],
+            (hdr[4] << 24) | (hdr[5] << 16) | (hdr[6] << 8) | hdr[7],
+            &mux->in[MUX_FRAME_HDR_LEN], frameLen);
+        if (rc < 0) {
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+
+static int dispatch_mux_frame(obj_t *conn, int type, int flags, int id,
+    unsigned char *src, int len)
+{
+/*  Dispatches the frame of (type) with (flags) for channel (id) carrying
+ *    the payload (src) of length (len) received over the connection (conn).
+ *  Frames for channels that are not open are ignored since the client may
+ *    have sent them before learning the channel was closed, as are frames
+ *    of unknown type.
+ *  Returns 0 on success, or -1 if the connection is to be shut down.
+ */
+    mux_conn_t *mux = conn->aux.client.mux;
+    obj_t *chan = NULL;
+    long credit;
+
+    if (type == CONMAN_FRAME_OPEN) {
+        src[len] = '\0';                /* in[] has room for terminating NUL */
+        return(open_mux_channels(conn, mux->conf, (char *) src));
+    }
+    if ((id >= 0) && (id < mux->numSlots)) {
+        chan = mux->channels[id];
+    }
+    if (!chan) {
+        DPRINTF((10, "Ignoring frame type=%d for id=%d from <%s>.\n",
+            type, id, conn->name));
+        return(0);
+    }
+    switch(type) {
+    case CONMAN_FRAME_DATA:
+        x_pthread_mutex_lock(&chan->bufLock);
+        chan->aux.client.timeLastRead = time(NULL);
+        x_pthread_mutex_unlock(&chan->bufLock);
+        len = process_client_escapes(chan, src, len);
+        if (len > 0) {
+            forward_obj_data(chan, src, len);
+        }
+        break;
+    case CONMAN_FRAME_WINDOW:
+        if (len != 4) {
+            log_msg(LOG_NOTICE, "Received invalid window frame from <%s>",
+                conn->name);
+            return(-1);
+        }
+        credit = (long) chan->aux.client.credit
+            + (((unsigned long) src[0] << 24) | (src[1] << 16)
+            | (src[2] << 8) | src[3]);
+        chan->aux.client.credit = MIN(credit, INT_MAX);
+        wake_client_obj(chan);
+        break;
+    case CONMAN_FRAME_CLOSE:
+        close_mux_channel(conn, chan);
+        queue_mux_channel(chan);
+        break;
+    default:
+        DPRINTF((10, "Ignoring frame type=%d from <%s>.\n",
+            type, conn->name));
+        break;
+    }
+    return(0);
+}
+
+
+static void close_mux_channel(obj_t *conn, obj_t *chan)
+{
+/*  Closes the channel (chan) of the connection (conn),
+ *    discarding its pending output.
+ *  When the client has requested the close, the channel is then queued
+ *    so frame_mux_channels() retires it, acknowledging via a CLOSE frame.
+ */
+    log_reader_t *replay;
+
+    unlink_obj(chan);
+
+    x_pthread_mutex_lock(&chan->bufLock);
+    chan->bufInPtr = chan->bufOutPtr = chan->buf;
+    replay = chan->aux.client.replay;
+    chan->aux.client.replay = NULL;
+    chan->gotEOF = 1;
+    x_pthread_mutex_unlock(&chan->bufLock);
+
+    destroy_log_reader(replay);
+    return;
+}
+
+
+void queue_mux_channel(obj_t *chan)
+{
+/*  Queues the channel (chan) to have its output framed onto its connection,
+ *    and notifies tpoll that data is available for writing to the connection.
+ *  A channel already queued retains its place in the queue.
+ *  This may be called by any reactor.  The connection's fd is only
+ *    referenced under the readyLock until its channels have been closed,
+ *    which shutdown_obj() does before closing the fd.
+ */
+    obj_t *conn;
+    mux_conn_t *mux;
+    int k;
+
+    assert(is_client_obj(chan));
+    assert(chan->aux.client.conn != NULL);
+
+    conn = chan->aux.client.conn;
+    mux = conn->aux.client.mux;
+
+    x_pthread_mutex_lock(&mux->readyLock);
+    if (!mux->gotClosed) {
+        if (!mux->isReady[chan->id]) {
+            k = mux->readyFirst + mux->numReady;
+            if (k >= mux->numSlots) {
+                k -= mux->numSlots;
+            }
+            mux->ready[k] = chan->id;
+            mux->isReady[chan->id] = 1;
+            mux->numReady++;
+        }
+        tpoll_set(conn->tp, conn->fd, POLLOUT);
+    }
+    x_pthread_mutex_unlock(&mux->readyLock);
+    return;
+}
+
+
+int frame_mux_channels(obj_t *conn)
+{
+/*  Frames the output of the queued channels into the connection's
+ *    circular-buffer, taking one frame from each channel in turn until
+ *    CLIENT_MUX_BUF_LEN bytes are buffered or no channel has output to send.
+ *  A channel with output remaining (and credit to send it) is requeued
+ *    behind the others.  A channel that has closed is retired once its
+ *    output has been sent.
+ *  Since output drained from a channel cannot be put back, room for its
+ *    frame is reserved in the connection's buffer beforehand.
+ *  This is invoked by write_to_obj() on the main thread.
+ *  Returns 0 on success, or -1 if the connection is to be shut down.
+ */
+    unsigned char buf[MUX_FRAME_HDR_LEN + MUX_FRAME_MAX_LEN];
+    mux_conn_t *mux = conn->aux.client.mux;
+    obj_t *chan;
+    int id;
+    int n;
+    int numLeft;
+    int room;
+
+    assert(mux != NULL);
+
+    if (conn->gotEOF) {
+        return(0);
+    }
+    while (get_obj_buf_len(conn) < CLIENT_MUX_BUF_LEN) {
+
+        x_pthread_mutex_lock(&mux->readyLock);
+        if (mux->numReady == 0) {
+            x_pthread_mutex_unlock(&mux->readyLock);
+            break;
+        }
+        id = mux->ready[mux->readyFirst];
+        if (++mux->readyFirst == mux->numSlots) {
+            mux->readyFirst = 0;
+        }
+        mux->numReady--;
+        mux->isReady[id] = 0;
+        x_pthread_mutex_unlock(&mux->readyLock);
+
+        if (!(chan = mux->channels[id])) {
+            continue;
+        }
+        /*  A suspended channel is requeued by wake_client_obj() on resuming.
+         */
+        if (chan->aux.client.gotSuspend && !chan->gotEOF) {
+            continue;
+        }
+        /*  As in write_mux_frame(), the frame must leave the buffer short
+         *    of full so it does not overwrite data yet to be written out.
+         */
+        room = conn->bufMaxSize - 1 - get_obj_buf_len(conn)
+            - MUX_FRAME_HDR_LEN;
+        if (room <= 0) {
+            queue_mux_channel(chan);
+            break;
+        }
+        n = MIN(chan->aux.client.credit, MUX_FRAME_MAX_LEN);
+        n = MIN(n, room);
+        n = drain_client_obj(chan, &buf[MUX_FRAME_HDR_LEN], MAX(n, 0),
+            &numLeft);
+        if (n > 0) {
+            pack_mux_frame_hdr(buf, CONMAN_FRAME_DATA, 0, id, n);
+            if (write_obj_data(conn, buf, MUX_FRAME_HDR_LEN + n, 0)
+                    != MUX_FRAME_HDR_LEN + n) {
+                log_msg(LOG_NOTICE,
+                    "Unable to write frame to <%s>: %d bytes of [%s] lost",
+                    conn->name, n, chan->name);
+                return(-1);
+            }
+            chan->aux.client.credit -= n;
+        }
+        if (numLeft > 0) {
+            if (chan->aux.client.credit > 0) {
+                queue_mux_channel(chan);
+            }
+        }
+        else if (chan->gotEOF) {
+            retire_mux_channel(conn, chan);
+        }
+    }
+    return(0);
+}
+
+
+void idle_mux_conn(obj_t *conn)
+{
+/*  Notifies tpoll that all available data has been written to the
+ *    connection (conn), unless a channel has been queued in the meantime.
+ *  The check is made under the readyLock, which queue_mux_channel() holds
+ *    when notifying tpoll, so a channel queued by a console reactor is not
+ *    lost.
+ */
+    mux_conn_t *mux = conn->aux.client.mux;
+
+    assert(mux != NULL);
+
+    x_pthread_mutex_lock(&mux->readyLock);
+    if ((mux->numReady == 0) || conn->gotEOF) {
+        tpoll_clear(conn->tp, conn->fd, POLLOUT);
+    }
+    x_pthread_mutex_unlock(&mux->readyLock);
+    return;
+}
+
+
+void close_mux_channels(obj_t *conn)
+{
+/*  Closes every channel of the multiplexed connection (conn)
+ *    as it is being shut down.  Their pending output is discarded.
+ */
+    mux_conn_t *mux = conn->aux.client.mux;
+    obj_t *chan;
+    int id;
+
+    assert(mux != NULL);
+
+    x_pthread_mutex_lock(&mux->readyLock);
+    mux->gotClosed = 1;
+    mux->numReady = 0;
+    memset(mux->isReady, 0, mux->numSlots);
+    x_pthread_mutex_unlock(&mux->readyLock);
+
+    for (id = 0; (id < mux->numSlots) && (mux->numChannels > 0); id++) {
+        if ((chan = mux->channels[id])) {
+            close_mux_channel(conn, chan);
+            mux->channels[id] = NULL;
+            mux->numChannels--;
+            list_append(mux->closed, chan);
+        }
+    }
+    return;
+}
+
+
+void reap_mux_channels(obj_t *conn, List dead)
+{
+/*  Moves the closed channels of the multiplexed connection (conn)
+ *    onto the (dead) list for removal from the master objs list.
+ */
+    mux_conn_t *mux = conn->aux.client.mux;
+    obj_t *chan;
+
+    assert(mux != NULL);
+    assert(dead != NULL);
+
+    while ((chan = list_pop(mux->closed))) {
+        list_append(dead, chan);
+    }
+    return;
+}
+
+
+static void retire_mux_channel(obj_t *conn, obj_t *chan)
+{
+/*  Retires the channel (chan) once it has closed and all of its output
+ *    has been framed, notifying the client via a CLOSE frame.
+ *    The channel is reaped via reap_mux_channels().
+ */
+    mux_conn_t *mux = conn->aux.client.mux;
+
+    assert(mux->channels[chan->id] == chan);
+
+    (void) write_mux_frame(conn, CONMAN_FRAME_CLOSE, 0, chan->id, NULL, 0);
+    mux->channels[chan->id] = NULL;
+    mux->numChannels--;
+    list_append(mux->closed, chan);
+
+    DPRINTF((9, "Closed channel [%s] id=%d.\n", chan->name, chan->id));
+    return;
+}
+
+
+static void pack_mux_frame_hdr(unsigned char *p, int type, int flags, int id,
+    int len)
+{
+/*  Packs the header of a frame of (type) with (flags) for channel (id)
+ *    with a payload of length (len) into the buffer (p).
+ */
+    p[0] = type;
+    p[1] = flags;
+    p[2] = (len >> 8) & 0xFF;
+    p[3] = len & 0xFF;
+    p[4] = (id >> 24) & 0xFF;
+    p[5] = (id >> 16) & 0xFF;
+    p[6] = (id >> 8) & 0xFF;
+    p[7] = id & 0xFF;
+    return;
+}
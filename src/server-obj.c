@@ -51,15 +51,47 @@
 #include "util.h"
 #include "wrapper.h"
 
+
 extern tpoll_t tp_global;               /* defined in server.c */
 
 
+/*  The fd_objs[] table maps each open fd onto the obj using it so mux_io()
+ *    can dispatch the fds reported ready by tpoll() directly to their objs.
+ *  It is protected by fd_objs_lock since client objs are created by the
+ *    client-processing threads.
+ */
+static obj_t **fd_objs = NULL;
+static int fd_objs_len = 0;
+static pthread_mutex_t fd_objs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
 static char * sanitize_file_string(char *str);
 static char * find_trailing_int_str(char *str);
+static void map_obj_fd(obj_t *obj, int fd);
 #ifndef NDEBUG
 static int validate_obj_links(obj_t *obj);
+static int validate_obj_buf(obj_t *obj);
 #endif /* !NDEBUG */
+static void grow_obj_buf(obj_t *obj, int len);
 static int num_bytes_buffered(obj_t *obj);
+static int write_logfile_obj(obj_t *logfile);
+static void flush_logfile_obj(obj_t *logfile);
+#if WITH_ZLIB
+static int write_compressed_logfile_obj(obj_t *logfile);
+static void flush_logfile_frame(obj_t *logfile);
+#endif /* WITH_ZLIB */
+static int is_obj_drainable(obj_t *obj, int len);
+static void add_obj_reader(obj_t *obj, obj_t *reader);
+static void remove_obj_reader(obj_t *obj, obj_t *reader);
+static obj_chain_t * create_obj_chain(void);
+static void release_obj_chain(obj_chain_t *chain);
+static void append_obj_chain(obj_t *console, const void *src, int len);
+static void wake_obj_chain(obj_chain_t *chain);
+static void trim_obj_chain(obj_chain_t *chain);
+static void attach_obj_cursor(obj_t *client, obj_t *console);
+static void detach_obj_cursor(obj_t *client);
+static void advance_obj_cursor(obj_cursor_t *cursor, int len);
+static int get_obj_cursor_iov(obj_cursor_t *cursor, struct iovec *iov, int n);
 
 
 obj_t * create_obj(
@@ -75,17 +107,40 @@ obj_t * create_obj(
     if (!(obj = malloc(sizeof(obj_t))))
         out_of_memory();
     obj->name = create_string(name);
-    obj->fd = fd;
+    obj->id = -1;
+    obj->fd = -1;
+    obj->tp = conf->tp;
+    /*
+     *  The circular-buffer is allocated on demand by write_obj_data().
+     *  Its size limit may be raised afterwards (eg, via the bufsize logopt).
+     */
+    obj->buf = NULL;
+    obj->bufSize = 0;
+    obj->bufMaxSize = OBJ_BUF_SIZE;
     obj->bufInPtr = obj->bufOutPtr = obj->buf;
     x_pthread_mutex_init(&obj->bufLock, NULL);
+    set_obj_fd(obj, fd);
     obj->readers = list_create(NULL);
+    obj->readerArray = NULL;
+    obj->numReaders = 0;
+    obj->maxReaders = 0;
+    x_pthread_mutex_init(&obj->readersLock, NULL);
     obj->writers = list_create(NULL);
     if ((type == 0) || (type >= CONMAN_OBJ_LAST_ENTRY)) {
         log_err(0, "INTERNAL: Unrecognized object [%s] type=%d", name, type);
     }
     obj->type = type;
+    obj->chain = is_console_obj(obj) ? create_obj_chain() : NULL;
+    obj->history = NULL;
+    obj->trigSet = NULL;
+    obj->trigState = -1;
+    obj->trigTimes = NULL;
+    obj->numReadBytes = 0;
+    obj->numReadCalls = 0;
+    obj->numReadWakeups = 0;
     obj->gotBufWrap = 0;
     obj->gotEOF = 0;
+    obj->gotReclaim = 0;
     /*
      *  resetCmdRef, resetCmdPid, and resetCmdTimer only apply to console objs.
      *  But the code is simplified if they are placed in the base obj.
@@ -116,21 +171,35 @@ obj_t * create_client_obj(server_conf_t *conf, req_t *req)
 
     set_fd_nonblocking(req->sd);
     set_fd_closed_on_exec(req->sd);
-    tpoll_set(tp_global, req->sd, POLLIN);
 
     snprintf(name, sizeof(name), "%s@%s:%d", req->user, req->host, req->port);
     name[sizeof(name) - 1] = '\0';
     client = create_obj(conf, name, req->sd, CONMAN_OBJ_CLIENT);
     client->aux.client.req = req;
+    client->aux.client.cursor = NULL;
+    client->aux.client.replay = NULL;
     time(&client->aux.client.timeLastRead);
     if (client->aux.client.timeLastRead == (time_t) -1)
         log_err(errno, "time() failed");
+    client->aux.client.mux = NULL;
+    client->aux.client.conn = NULL;
+    client->aux.client.credit = 0;
     client->aux.client.gotEscape = 0;
     client->aux.client.gotSuspend = 0;
 
+    /*  A multiplexed connection frames the output of its channels into its
+     *    buffer, so allow it to grow (see frame_mux_channels()).
+     *  Its state must be in place before its fd is polled for input.
+     */
+    if (req->protocol >= CONMAN_PROTOCOL_MUX) {
+        client->aux.client.mux = create_mux_conn(conf);
+        client->bufMaxSize = OBJ_BUF_MAX_SIZE;
+    }
+
     /*  Add obj to the master conf->objs list.
      */
     list_append(conf->objs, client);
+    tpoll_set(client->tp, client->fd, POLLIN);
 
     DPRINTF((9, "Opened client: fd=%d user=%s tty=%s host=%s port=%d.\n",
         req->sd, req->user, req->tty, req->host, req->port));
@@ -145,6 +214,7 @@ void destroy_obj(obj_t *obj)
  *    ensuring it will be removed from the master objs list before destruction.
  */
     int n;
+    int fd;
     char **pp;
 
     assert(obj != NULL);
@@ -156,13 +226,27 @@ void destroy_obj(obj_t *obj)
             "Destroying [%s] with %d byte%s of unwritten data",
             obj->name, n, (n == 1 ? "" : "s"));
     }
+    if (is_console_obj(obj) && (obj->numReadWakeups > 0)) {
+        log_msg(LOG_DEBUG,
+            "Read %lu bytes from [%s] in %lu reads over %lu wakeups"
+            " (%lu bytes/wakeup)", obj->numReadBytes, obj->name,
+            obj->numReadCalls, obj->numReadWakeups,
+            obj->numReadBytes / obj->numReadWakeups);
+    }
 
     switch(obj->type) {
     case CONMAN_OBJ_CLIENT:
+        detach_obj_cursor(obj);
+        destroy_log_reader(obj->aux.client.replay);
+        obj->aux.client.replay = NULL;
+        destroy_mux_conn(obj->aux.client.mux);
+        obj->aux.client.mux = NULL;
         if (obj->aux.client.req) {
             req_t *req = obj->aux.client.req;
-            log_msg(LOG_INFO, "Client <%s@%s:%d> disconnected",
-                req->user, req->fqdn, req->port);
+            if (!obj->aux.client.conn) {
+                log_msg(LOG_INFO, "Client <%s@%s:%d> disconnected",
+                    req->user, req->fqdn, req->port);
+            }
             req->sd = -1;       /* prevent destroy_req from also closing sd */
             destroy_req(req);
             obj->aux.client.req = NULL;
@@ -172,6 +256,19 @@ void destroy_obj(obj_t *obj)
         if (obj->aux.logfile.fmtName) {
             free(obj->aux.logfile.fmtName);
         }
+        if (obj->aux.logfile.flushTimer > 0) {
+            (void) tpoll_timeout_cancel(obj->tp, obj->aux.logfile.flushTimer);
+        }
+        if (obj->aux.logfile.frameTimer > 0) {
+            (void) tpoll_timeout_cancel(obj->tp, obj->aux.logfile.frameTimer);
+        }
+        if (obj->aux.logfile.outBuf) {
+            free(obj->aux.logfile.outBuf);
+        }
+        if (obj->aux.logfile.zBuf) {
+            free(obj->aux.logfile.zBuf);
+        }
+        close_logfile_index(obj);
         break;
     case CONMAN_OBJ_PROCESS:
         for (pp = obj->aux.process.argv; *pp != NULL; pp++) {
@@ -237,21 +334,36 @@ void destroy_obj(obj_t *obj)
         break;
     }
 
+    if (obj->fd >= 0) {
+        fd = detach_obj_fd(obj);
+        if (close(fd) < 0) {
+            log_msg(LOG_WARNING, "Unable to close [%s] during destruction: %s",
+                obj->name, strerror(errno));
+        }
+    }
     x_pthread_mutex_destroy(&obj->bufLock);
+    if (obj->buf) {
+        free(obj->buf);
+    }
+    if (obj->chain) {
+        release_obj_chain(obj->chain);
+    }
+    if (obj->history) {
+        destroy_obj_history(obj);
+    }
+    if (obj->trigTimes) {
+        free(obj->trigTimes);
+    }
     if (obj->readers) {
         list_destroy(obj->readers);
     }
+    if (obj->readerArray) {
+        free(obj->readerArray);
+    }
+    x_pthread_mutex_destroy(&obj->readersLock);
     if (obj->writers) {
         list_destroy(obj->writers);
     }
-    if (obj->fd >= 0) {
-        tpoll_clear(tp_global, obj->fd, POLLIN | POLLOUT);
-        if (close(obj->fd) < 0) {
-            log_msg(LOG_WARNING, "Unable to close [%s] during destruction: %s",
-                obj->name, strerror(errno));
-        }
-        obj->fd = -1;
-    }
     if (obj->name) {
         free(obj->name);
     }
@@ -512,6 +624,103 @@ int find_obj(obj_t *obj, obj_t *key)
 }
 
 
+void set_obj_fd(obj_t *obj, int fd)
+{
+/*  Sets the obj's fd to (fd), updating the fd-to-obj table accordingly.
+ *  This must be used whenever an obj's fd changes.  An fd of -1 indicates
+ *    the obj no longer has an open fd; use detach_obj_fd() for that instead
+ *    since the old fd must not be closed while it can still be referenced.
+ *  The fd is changed under the obj's bufLock since another reactor writing
+ *    into the obj's buffer sets POLLOUT on the obj's fd while holding it.
+ */
+    assert(obj != NULL);
+
+    x_pthread_mutex_lock(&obj->bufLock);
+    map_obj_fd(obj, fd);
+    x_pthread_mutex_unlock(&obj->bufLock);
+    return;
+}
+
+
+int detach_obj_fd(obj_t *obj)
+{
+/*  Detaches the obj's fd, removing it from the obj's tpoll and from the
+ *    fd-to-obj table, and setting the obj's fd to -1.
+ *  This is done under the obj's bufLock (see set_obj_fd()), so once it
+ *    returns, no other reactor can set POLLOUT on the old fd.  Only then
+ *    can the old fd be closed without the risk of its number being reused
+ *    (eg, by accept()) while still referenced.
+ *  Returns the detached fd for the caller to close, or -1 if none.
+ */
+    int fd;
+
+    assert(obj != NULL);
+
+    x_pthread_mutex_lock(&obj->bufLock);
+    fd = obj->fd;
+    if (fd >= 0) {
+        tpoll_clear(obj->tp, fd, POLLIN | POLLOUT);
+        map_obj_fd(obj, -1);
+    }
+    x_pthread_mutex_unlock(&obj->bufLock);
+    return(fd);
+}
+
+
+static void map_obj_fd(obj_t *obj, int fd)
+{
+/*  Maps (fd) onto (obj) in the fd-to-obj table, replacing the mapping of
+ *    the obj's previous fd (if any), and sets the obj's fd to (fd).
+ *  The obj's bufLock must be held when calling this routine.
+ */
+    obj_t **fd_objs_tmp;
+    int n;
+
+    x_pthread_mutex_lock(&fd_objs_lock);
+
+    if ((obj->fd >= 0) && (obj->fd < fd_objs_len)
+            && (fd_objs[obj->fd] == obj)) {
+        fd_objs[obj->fd] = NULL;
+    }
+    if ((fd >= 0) && (fd >= fd_objs_len)) {
+        n = (fd_objs_len > 0) ? fd_objs_len : 256;
+        while (n <= fd) {
+            n *= 2;
+        }
+        if (!(fd_objs_tmp = realloc(fd_objs, n * sizeof(obj_t *)))) {
+            out_of_memory();
+        }
+        memset(fd_objs_tmp + fd_objs_len, 0,
+            (n - fd_objs_len) * sizeof(obj_t *));
+        fd_objs = fd_objs_tmp;
+        fd_objs_len = n;
+    }
+    if (fd >= 0) {
+        fd_objs[fd] = obj;
+    }
+    obj->fd = fd;
+
+    x_pthread_mutex_unlock(&fd_objs_lock);
+    return;
+}
+
+
+obj_t * find_obj_by_fd(int fd)
+{
+/*  Returns the obj currently using (fd), or NULL if no obj is using it.
+ */
+    obj_t *obj = NULL;
+
+    x_pthread_mutex_lock(&fd_objs_lock);
+
+    if ((fd >= 0) && (fd < fd_objs_len)) {
+        obj = fd_objs[fd];
+    }
+    x_pthread_mutex_unlock(&fd_objs_lock);
+    return(obj);
+}
+
+
 int write_notify_msg(obj_t *console, int priority, char *fmt, ...)
 {
 /*  Writes a notification message to the daemon logfile and all attached
@@ -579,25 +788,31 @@ void notify_console_objs(obj_t *console, char *msg)
  */
     ListIterator i;
     obj_t *obj;
+    int j;
+    int len;
 
     assert(is_console_obj(console));
 
-    if (!msg || !strlen(msg)) {
+    if (!msg || !(len = strlen(msg))) {
         return;
     }
-    i = list_iterator_create(console->readers);
-    while ((obj = list_next(i))) {
-        write_obj_data(obj, msg, strlen(msg), 1);
+    x_pthread_mutex_lock(&console->readersLock);
+    for (j = 0; j < console->numReaders; j++) {
+        write_obj_data(console->readerArray[j], msg, len, 1);
     }
-    list_iterator_destroy(i);
-
     i = list_iterator_create(console->writers);
     while ((obj = list_next(i))) {
-        if (!list_find_first(console->readers, (ListFindF) find_obj, obj)) {
-            write_obj_data(obj, msg, strlen(msg), 1);
+        for (j = 0; j < console->numReaders; j++) {
+            if (console->readerArray[j] == obj) {
+                break;
+            }
+        }
+        if (j == console->numReaders) {
+            write_obj_data(obj, msg, len, 1);
         }
     }
     list_iterator_destroy(i);
+    x_pthread_mutex_unlock(&console->readersLock);
     return;
 }
 
@@ -667,9 +882,15 @@ void link_objs(obj_t *src, obj_t *dst)
     }
 
     /*  Create link from src reads to dst writes.
+     *  A client reading from a console writes the console's data out
+     *    directly from the console's chain via its cursor.
      */
+    if (is_console_obj(src) && is_client_obj(dst)) {
+        attach_obj_cursor(dst, src);
+    }
     assert(!list_find_first(src->readers, (ListFindF) find_obj, dst));
     list_append(src->readers, dst);
+    add_obj_reader(src, dst);
     assert(!list_find_first(dst->writers, (ListFindF) find_obj, src));
     list_append(dst->writers, src);
 
@@ -693,6 +914,10 @@ void unlink_objs(obj_t *src, obj_t *dst)
     if (list_delete_all(src->readers, (ListFindF) find_obj, dst)) {
         DPRINTF((10, "Removing [%s] from [%s] readers.\n",
             dst->name, src->name));
+        remove_obj_reader(src, dst);
+        if (is_console_obj(src) && is_client_obj(dst)) {
+            detach_obj_cursor(dst);
+        }
     }
     if ((n = list_delete_all(dst->writers, (ListFindF) find_obj, src))) {
         DPRINTF((10, "Removing [%s] from [%s] writers.\n",
@@ -725,11 +950,13 @@ void unlink_objs(obj_t *src, obj_t *dst)
             && list_is_empty(src->readers) && list_is_empty(src->writers)) {
         assert(is_console_obj(dst));
         src->gotEOF = 1;
+        wake_client_obj(src);
     }
     else if (is_client_obj(dst)
             && list_is_empty(dst->readers) && list_is_empty(dst->writers)) {
         assert(is_console_obj(src));
         dst->gotEOF = 1;
+        wake_client_obj(dst);
     }
 
     DPRINTF((10, "Unlinked [%s] reads from [%s] writes.\n",
@@ -790,6 +1017,11 @@ static int validate_obj_links(obj_t *obj)
     }
     list_iterator_destroy(i);
 
+    if (list_count(obj->readers) != obj->numReaders) {
+        DPRINTF((1, "[%s] readers list does not match reader array.\n",
+            obj->name));
+        gotError = 1;
+    }
     return(gotError ? -1 : 0);
 }
 #endif /* !NDEBUG */
@@ -802,6 +1034,7 @@ int shutdown_obj(obj_t *obj)
  *    and destroyed; o/w, returns 0.
  */
     int n;
+    int fd;
 
     assert(obj != NULL);
 
@@ -814,14 +1047,20 @@ int shutdown_obj(obj_t *obj)
             obj->name, obj->fd);
         return(0);
     }
+    /*  A multiplexed connection's channels are closed first, since
+     *    a console reactor queueing a channel sets POLLOUT on the
+     *    connection's fd until then (see queue_mux_channel()).
+     */
+    if (is_client_obj(obj) && obj->aux.client.mux) {
+        close_mux_channels(obj);
+    }
     /*  Close the existing connection.
      */
-    tpoll_clear(tp_global, obj->fd, POLLIN | POLLOUT);
-    if (close(obj->fd) < 0) {
+    fd = detach_obj_fd(obj);
+    if (close(fd) < 0) {
         log_msg(LOG_WARNING, "Unable to close [%s] during shutdown: %s",
             obj->name, strerror(errno));
     }
-    obj->fd = -1;
     /*
      *  FIXME:  The connection state should ideally be marked as DOWN here if
      *    applicable (eg, telnet & unixsock), perhaps via a close_foo_obj().
@@ -881,12 +1120,19 @@ int read_from_obj(obj_t *obj)
  *  But if the obj is a logfile, its data can grow as a result of the
  *    additional processing.  This routine's internal buffer is reduced
  *    somewhat to reduce the likelihood of log data being dropped.
+ *
+ *  A console fd is drained until the read would block (or returns short)
+ *    or OBJ_READ_BUDGET bytes have been read, thereby amortizing the cost
+ *    of each poll wakeup over a burst of output.  Draining stops early
+ *    if a reader could not accept another read without overwriting data
+ *    it has yet to write out.  A client fd is read once since its escape
+ *    sequences can alter the obj's links.
  */
     unsigned char buf[(OBJ_BUF_SIZE / 2) - 1];
     int n;
+    int m;
+    int total;
     int isEmpty;
-    ListIterator i;
-    obj_t *reader;
 
     DPRINTF((20, "Entered read_from_obj: [%s]\n", obj->name));
 
@@ -901,13 +1147,17 @@ int read_from_obj(obj_t *obj)
     if (is_telnet_obj(obj) && (obj->aux.telnet.state != CONMAN_TELNET_UP)) {
         return(0);
     }
+    obj->numReadWakeups++;
+    total = 0;
 again:
+    obj->numReadCalls++;
     if ((n = read(obj->fd, buf, sizeof(buf))) < 0) {
         if (errno == EINTR) {
             goto again;
         }
         if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
-            return(0);
+            DPRINTF((15, "Drained %d bytes from [%s].\n", total, obj->name));
+            return(total);
         }
         log_msg(LOG_INFO, "Unable to read from [%s]: %s",
             obj->name, strerror(errno));
@@ -919,42 +1169,92 @@ again:
             log_msg(LOG_WARNING, "Read EOF from [%s] after gotEOF", obj->name);
         }
         obj->gotEOF = 1;
-        tpoll_clear(tp_global, obj->fd, POLLIN);
+        tpoll_clear(obj->tp, obj->fd, POLLIN);
         isEmpty = (obj->bufInPtr == obj->bufOutPtr);
-        return(isEmpty ? shutdown_obj(obj) : 0);
+        return(isEmpty ? shutdown_obj(obj) : total);
     }
-    else {
-        DPRINTF((15, "Read %d bytes from [%s].\n", n, obj->name));
-        if (is_client_obj(obj)) {
-            x_pthread_mutex_lock(&obj->bufLock);
-            time(&obj->aux.client.timeLastRead);
-            if (obj->aux.client.timeLastRead == (time_t) -1) {
-                log_err(errno, "time() failed");
+    DPRINTF((15, "Read %d bytes from [%s].\n", n, obj->name));
+    obj->numReadBytes += n;
+    total += n;
+    m = n;
+
+    if (is_client_obj(obj)) {
+        x_pthread_mutex_lock(&obj->bufLock);
+        time(&obj->aux.client.timeLastRead);
+        if (obj->aux.client.timeLastRead == (time_t) -1) {
+            log_err(errno, "time() failed");
+        }
+        x_pthread_mutex_unlock(&obj->bufLock);
+        /*
+         *  A multiplexed connection carries its channels' input in frames.
+         */
+        if (obj->aux.client.mux) {
+            if (process_mux_frames(obj, buf, m) < 0) {
+                return(shutdown_obj(obj));
             }
-            x_pthread_mutex_unlock(&obj->bufLock);
-            n = process_client_escapes(obj, buf, n);
+            m = 0;
         }
-        else if (is_telnet_obj(obj)) {
-            n = process_telnet_escapes(obj, buf, n);
+        else {
+            m = process_client_escapes(obj, buf, m);
         }
-        /*  Ensure the buffer still contains data
-         *    after the escape characters have been processed.
-         */
-        if (n > 0) {
-            i = list_iterator_create(obj->readers);
-            while ((reader = list_next(i))) {
+    }
+    else if (is_telnet_obj(obj)) {
+        m = process_telnet_escapes(obj, buf, m);
+    }
+    /*  Ensure the buffer still contains data
+     *    after the escape characters have been processed.
+     */
+    if (m > 0) {
+        forward_obj_data(obj, buf, m);
+    }
+    if (is_console_obj(obj) && (n == sizeof(buf))
+            && (total < OBJ_READ_BUDGET) && is_obj_drainable(obj, n)) {
+        goto again;
+    }
+    return(total);
+}
 
-                if (is_logfile_obj(reader)) {
-                    write_log_data(reader, buf, n);
-                }
-                else {
-                    write_obj_data(reader, buf, n, 0);
-                }
-            }
-            list_iterator_destroy(i);
+
+void forward_obj_data(obj_t *obj, const void *src, int len)
+{
+/*  Forwards the data (src) of length (len) read from (obj) to each obj
+ *    in its "readers" list.
+ *  Data read from a console is appended once to the console's chain
+ *    from which each client reader writes it out via its own cursor;
+ *    only logfile readers receive a (potentially modified) copy.
+ *    It is also retained in the console's scrollback history (if any),
+ *    and then matched against the console's triggers once it has been
+ *    forwarded (since a trigger's actions may notify the readers).
+ *  The readers are walked via the obj's flat readerArray (rather than
+ *    a list iterator) since this is called for every chunk of data read.
+ */
+    obj_t *reader;
+    int j;
+
+    if (is_console_obj(obj)) {
+        append_obj_chain(obj, src, len);
+        append_obj_history(obj, src, len);
+    }
+    x_pthread_mutex_lock(&obj->readersLock);
+    for (j = 0; j < obj->numReaders; j++) {
+
+        reader = obj->readerArray[j];
+        if (is_logfile_obj(reader)) {
+            write_log_data(reader, src, len);
+        }
+        else if (is_console_obj(obj) && is_client_obj(reader)) {
+            continue;
+        }
+        else {
+            write_obj_data(reader, src, len, 0);
         }
     }
-    return(n);
+    x_pthread_mutex_unlock(&obj->readersLock);
+
+    if (is_console_obj(obj) && (obj->trigState >= 0)) {
+        match_obj_triggers(obj, src, len);
+    }
+    return;
 }
 
 
@@ -965,7 +1265,7 @@ int write_obj_data(obj_t *obj, const void *src, int len, int isInfo)
  *    an informational message which a client may suppress.
  *  Returns the number of bytes written.
  *
- *  Note that this routine can write at most (OBJ_BUF_SIZE - 1) bytes
+ *  Note that this routine can write at most (bufMaxSize - 1) bytes
  *    of data into the object's circular-buffer.
  */
     int avail;
@@ -985,10 +1285,10 @@ int write_obj_data(obj_t *obj, const void *src, int len, int isInfo)
         return(0);
     }
     /*  An obj's circular-buffer is empty when (bufInPtr == bufOutPtr).
-     *    Thus, it can hold at most (OBJ_BUF_SIZE - 1) bytes of data.
+     *    Thus, it can hold at most (bufMaxSize - 1) bytes of data.
      */
-    if (len >= OBJ_BUF_SIZE) {
-        len = OBJ_BUF_SIZE - 1;
+    if (len >= obj->bufMaxSize) {
+        len = obj->bufMaxSize - 1;
     }
     x_pthread_mutex_lock(&obj->bufLock);
 
@@ -1001,11 +1301,23 @@ int write_obj_data(obj_t *obj, const void *src, int len, int isInfo)
     }
     /*  Assert the buffer's input and output ptrs are valid upon entry.
      */
-    assert(obj->bufInPtr >= obj->buf);
-    assert(obj->bufInPtr < &obj->buf[OBJ_BUF_SIZE]);
-    assert(obj->bufOutPtr >= obj->buf);
-    assert(obj->bufOutPtr < &obj->buf[OBJ_BUF_SIZE]);
+    assert(validate_obj_buf(obj) >= 0);
 
+    /*  Grow the circular-buffer (or allocate it on first use) if this data
+     *    would overwrite data that has not yet been written out to the fd.
+     *  A logfile's buffer is also grown when it would wrap around since
+     *    its past contents are retained for log replay.
+     */
+    if (obj->bufSize < obj->bufMaxSize) {
+        n = num_bytes_buffered(obj);
+        if (len > obj->bufSize - 1 - n) {
+            grow_obj_buf(obj, n + len);
+        }
+        else if (is_logfile_obj(obj)
+                && (len >= &obj->buf[obj->bufSize] - obj->bufInPtr)) {
+            grow_obj_buf(obj, obj->bufSize);
+        }
+    }
     n = len;
 
     /*  Calculate the number of bytes available before data is overwritten.
@@ -1014,11 +1326,11 @@ int write_obj_data(obj_t *obj, const void *src, int len, int isInfo)
      *  Since an obj's circular-buffer is empty when (bufInPtr == bufOutPtr),
      *    subtract one byte to account for this sentinel.
      */
-    avail = OBJ_BUF_SIZE - 1 - num_bytes_buffered(obj);
+    avail = obj->bufSize - 1 - num_bytes_buffered(obj);
 
     /*  Copy first chunk of data (ie, up to the end of the buffer).
      */
-    m = MIN(len, &obj->buf[OBJ_BUF_SIZE] - obj->bufInPtr);
+    m = MIN(len, &obj->buf[obj->bufSize] - obj->bufInPtr);
     if (m > 0) {
         memcpy(obj->bufInPtr, src, m);
         n -= m;
@@ -1027,7 +1339,7 @@ int write_obj_data(obj_t *obj, const void *src, int len, int isInfo)
         /*
          *  Do the hokey-pokey and perform a circular-buffer wrap-around.
          */
-        if (obj->bufInPtr == &obj->buf[OBJ_BUF_SIZE]) {
+        if (obj->bufInPtr == &obj->buf[obj->bufSize]) {
             obj->bufInPtr = obj->buf;
             obj->gotBufWrap = 1;
         }
@@ -1041,27 +1353,42 @@ int write_obj_data(obj_t *obj, const void *src, int len, int isInfo)
     /*  Check to see if any data in circular-buffer was overwritten.
      */
     if (len > avail) {
-        if (!is_client_obj(obj) || !obj->aux.client.gotSuspend) {
+        if (!is_client_obj(obj) || !is_client_held(obj)) {
             log_msg(LOG_NOTICE, "Overwrote %d bytes for \"%s\"",
                 len - avail, obj->name);
         }
         obj->bufOutPtr = obj->bufInPtr + 1;
-        if (obj->bufOutPtr == &obj->buf[OBJ_BUF_SIZE]) {
+        if (obj->bufOutPtr == &obj->buf[obj->bufSize]) {
             obj->bufOutPtr = obj->buf;
         }
     }
     /*  Notify tpoll that data is available for writing
-     *    unless it is a client obj that is currently suspended.
+     *    (see wake_client_obj() regarding client objs).
+     *  Writes to a logfile are coalesced: it is only notified once enough
+     *    data has accumulated, or else when its flush timer expires.
      */
-    if (!is_client_obj(obj) || !obj->aux.client.gotSuspend) {
-        tpoll_set(tp_global, obj->fd, POLLOUT);
+    if (is_logfile_obj(obj)) {
+        if (num_bytes_buffered(obj) >= MIN(LOG_FLUSH_LEN, obj->bufMaxSize / 2))
+        {
+            tpoll_set(obj->tp, obj->fd, POLLOUT);
+        }
+        else if (obj->aux.logfile.flushTimer <= 0) {
+            obj->aux.logfile.flushTimer = tpoll_timeout_relative(obj->tp,
+                (callback_f) flush_logfile_obj, obj, LOG_FLUSH_MSECS);
+            if (obj->aux.logfile.flushTimer <= 0) {
+                tpoll_set(obj->tp, obj->fd, POLLOUT);
+            }
+        }
+    }
+    else if (is_client_obj(obj)) {
+        wake_client_obj(obj);
+    }
+    else {
+        tpoll_set(obj->tp, obj->fd, POLLOUT);
     }
     /*  Assert the buffer's input and output ptrs are valid upon exit.
      */
-    assert(obj->bufInPtr >= obj->buf);
-    assert(obj->bufInPtr < &obj->buf[OBJ_BUF_SIZE]);
-    assert(obj->bufOutPtr >= obj->buf);
-    assert(obj->bufOutPtr < &obj->buf[OBJ_BUF_SIZE]);
+    assert(validate_obj_buf(obj) >= 0);
 
     x_pthread_mutex_unlock(&obj->bufLock);
 
@@ -1078,12 +1405,21 @@ int write_obj_data(obj_t *obj, const void *src, int len, int isInfo)
 int write_to_obj(obj_t *obj)
 {
 /*  Writes data from the obj's circular-buffer out to its file descriptor.
+ *  If the obj is a client reading from a console, data from the console's
+ *    chain is written out after its circular-buffer in the same writev().
+ *    But during a deep log replay, the console's data is held in the chain
+ *    while the replay is fed into the circular-buffer as it drains.
+ *  If the obj is a multiplexed connection, its channels' output is first
+ *    framed into its circular-buffer.
  *  Returns 0 on success, or -1 if the obj is ready to be destroyed.
  */
-    struct iovec iov[2];
+    struct iovec iov[2 + OBJ_CHUNK_IOV_MAX];
     int iovcnt = 0;
     int isDead = 0;
     int n;
+    int m;
+    int avail = 0;
+    obj_cursor_t *cursor;
 
     DPRINTF((20, "Entered write_to_obj: [%s]\n", obj->name));
 
@@ -1098,20 +1434,25 @@ int write_to_obj(obj_t *obj)
         open_telnet_obj(obj);
         return(0);
     }
+    if (is_logfile_obj(obj)) {
+        return(write_logfile_obj(obj));
+    }
+    if (is_client_obj(obj) && obj->aux.client.mux) {
+        if (frame_mux_channels(obj) < 0) {
+            isDead = 1;
+        }
+    }
     x_pthread_mutex_lock(&obj->bufLock);
 
     /*  Assert the buffer's input and output ptrs are valid upon entry.
      */
-    assert(obj->bufInPtr >= obj->buf);
-    assert(obj->bufInPtr < &obj->buf[OBJ_BUF_SIZE]);
-    assert(obj->bufOutPtr >= obj->buf);
-    assert(obj->bufOutPtr < &obj->buf[OBJ_BUF_SIZE]);
+    assert(validate_obj_buf(obj) >= 0);
 
     /*  IOV for object buffer cases OIO (wrap-around pt1) & IO (no-wrap).
      */
     if (obj->bufOutPtr > obj->bufInPtr) {
         iov[0].iov_base = obj->bufOutPtr;
-        iov[0].iov_len = &obj->buf[OBJ_BUF_SIZE] - obj->bufOutPtr;
+        iov[0].iov_len = &obj->buf[obj->bufSize] - obj->bufOutPtr;
         iovcnt = 1;
         /*
          *  IOV for object buffer case OIO (wrap-around pt2).
@@ -1129,7 +1470,18 @@ int write_to_obj(obj_t *obj)
         iov[0].iov_len = obj->bufInPtr - obj->bufOutPtr;
         iovcnt = 1;
     }
+    m = num_bytes_buffered(obj);
 
+    /*  IOVs for the console chain (if any) follow the circular-buffer.
+     *  The chain lock is held until the cursor has been advanced.
+     */
+    cursor = (is_client_obj(obj) && !obj->aux.client.replay)
+        ? obj->aux.client.cursor : NULL;
+    if (cursor) {
+        x_pthread_mutex_lock(&cursor->chain->lock);
+        iovcnt += get_obj_cursor_iov(cursor, &iov[iovcnt],
+            (sizeof(iov) / sizeof(iov[0])) - iovcnt);
+    }
     if (iovcnt > 0) {
 again:
         n = writev(obj->fd, iov, iovcnt);
@@ -1149,15 +1501,21 @@ again:
         }
         else if (n > 0) {
             DPRINTF((15, "Wrote %d bytes to [%s].\n", n, obj->name));
-            obj->bufOutPtr += n;
-            if (obj->bufOutPtr >= &obj->buf[OBJ_BUF_SIZE]) {
-                obj->bufOutPtr -= OBJ_BUF_SIZE;
+            m = MIN(n, m);
+            obj->bufOutPtr += m;
+            if (obj->bufOutPtr >= &obj->buf[obj->bufSize]) {
+                obj->bufOutPtr -= obj->bufSize;
+            }
+            if (cursor && (n > m)) {
+                advance_obj_cursor(cursor, n - m);
             }
         }
     }
     /*  If all buffered data has been written out to the fd...
      */
-    if (obj->bufInPtr == obj->bufOutPtr) {
+    if ((obj->bufInPtr == obj->bufOutPtr)
+            && (!cursor || (cursor->chunk->seq + cursor->offset
+                == cursor->chain->seq))) {
         /*
          *  If the gotEOF flag is set, no additional data can be written into
          *    the buffer.  As such, the object is ready for shutdown.
@@ -1165,20 +1523,229 @@ again:
         if (obj->gotEOF) {
             isDead = 1;
         }
-        /*  Notify tpoll that all available data has been written.
+        /*  Notify tpoll that all available data has been written
+         *    (unless a multiplexed connection has channels yet to frame).
          */
-        tpoll_clear(tp_global, obj->fd, POLLOUT);
+        if (is_client_obj(obj) && obj->aux.client.mux) {
+            idle_mux_conn(obj);
+        }
+        else {
+            tpoll_clear(obj->tp, obj->fd, POLLOUT);
+        }
+    }
+    if (cursor) {
+        trim_obj_chain(cursor->chain);
+        x_pthread_mutex_unlock(&cursor->chain->lock);
+    }
+    /*  A deep log replay is fed once at least half of the buffer is free,
+     *    leaving room for informational messages.
+     */
+    if (is_client_obj(obj) && obj->aux.client.replay) {
+        avail = obj->bufMaxSize - 1 - num_bytes_buffered(obj);
     }
     /*  Assert the buffer's input and output ptrs are valid upon exit.
      */
-    assert(obj->bufInPtr >= obj->buf);
-    assert(obj->bufInPtr < &obj->buf[OBJ_BUF_SIZE]);
-    assert(obj->bufOutPtr >= obj->buf);
-    assert(obj->bufOutPtr < &obj->buf[OBJ_BUF_SIZE]);
+    assert(validate_obj_buf(obj) >= 0);
+
+    x_pthread_mutex_unlock(&obj->bufLock);
+
+    if (isDead) {
+        return(shutdown_obj(obj));
+    }
+    if (avail >= obj->bufMaxSize / 2) {
+        feed_log_replay(obj, avail - MAX_LINE);
+    }
+    return(0);
+}
+
+
+void wake_client_obj(obj_t *client)
+{
+/*  Notifies tpoll that data is available for writing to the (client)
+ *    unless it is suspended (and has not yet been closed).
+ *  A channel has no fd of its own; instead, it is queued to have its data
+ *    framed onto its multiplexed connection.
+ *  This must be called by the main thread, or with the client's bufLock
+ *    held so its fd cannot be closed in the meantime.
+ */
+    assert(is_client_obj(client));
+
+    if (client->aux.client.gotSuspend && !client->gotEOF) {
+        return;
+    }
+    if (client->aux.client.conn) {
+        queue_mux_channel(client);
+    }
+    else if (client->fd >= 0) {
+        tpoll_set(client->tp, client->fd, POLLOUT);
+    }
+    return;
+}
+
+
+int drain_client_obj(obj_t *client, void *dst, int len, int *numLeftp)
+{
+/*  Copies up to (len) bytes of data awaiting output to the (client) into
+ *    (dst), consuming it as write_to_obj() would once written to the fd:
+ *    the client's circular-buffer first, followed by its console's chain
+ *    (unless held during a deep log replay, which is fed as it drains).
+ *  This is how a channel's data reaches its multiplexed connection.
+ *  Sets (numLeftp) to the number of bytes still awaiting output.
+ *  Returns the number of bytes copied into (dst).
+ */
+    unsigned char *p = dst;
+    struct iovec iov[OBJ_CHUNK_IOV_MAX];
+    obj_cursor_t *cursor;
+    int iovcnt;
+    int k;
+    int m;
+    int n = 0;
+    int avail = 0;
+
+    assert(is_client_obj(client));
+    assert(dst != NULL);
+    assert(numLeftp != NULL);
+
+    x_pthread_mutex_lock(&client->bufLock);
+    assert(validate_obj_buf(client) >= 0);
+
+    while ((n < len) && (client->bufOutPtr != client->bufInPtr)) {
+        if (client->bufOutPtr > client->bufInPtr) {
+            m = &client->buf[client->bufSize] - client->bufOutPtr;
+        }
+        else {
+            m = client->bufInPtr - client->bufOutPtr;
+        }
+        m = MIN(m, len - n);
+        memcpy(p + n, client->bufOutPtr, m);
+        n += m;
+        client->bufOutPtr += m;
+        if (client->bufOutPtr == &client->buf[client->bufSize]) {
+            client->bufOutPtr = client->buf;
+        }
+    }
+    *numLeftp = num_bytes_buffered(client);
+
+    cursor = !client->aux.client.replay ? client->aux.client.cursor : NULL;
+    if (cursor) {
+        x_pthread_mutex_lock(&cursor->chain->lock);
+        while ((n < len) && ((iovcnt = get_obj_cursor_iov(cursor,
+                iov, OBJ_CHUNK_IOV_MAX)) > 0)) {
+            for (k = 0; (k < iovcnt) && (n < len); k++) {
+                m = MIN((int) iov[k].iov_len, len - n);
+                memcpy(p + n, iov[k].iov_base, m);
+                n += m;
+                advance_obj_cursor(cursor, m);
+            }
+        }
+        *numLeftp += cursor->chain->seq
+            - (cursor->chunk->seq + cursor->offset);
+        trim_obj_chain(cursor->chain);
+        x_pthread_mutex_unlock(&cursor->chain->lock);
+    }
+    if (client->aux.client.replay) {
+        avail = client->bufMaxSize - 1 - num_bytes_buffered(client);
+    }
+    assert(validate_obj_buf(client) >= 0);
+    x_pthread_mutex_unlock(&client->bufLock);
+
+    if (avail >= client->bufMaxSize / 2) {
+        feed_log_replay(client, avail - MAX_LINE);
+    }
+    return(n);
+}
+
+
+int get_obj_buf_len(obj_t *obj)
+{
+/*  Returns the number of bytes in the obj's circular-buffer
+ *    awaiting output to its fd.
+ */
+    int n;
 
+    x_pthread_mutex_lock(&obj->bufLock);
+    n = num_bytes_buffered(obj);
     x_pthread_mutex_unlock(&obj->bufLock);
+    return(n);
+}
+
+
+#ifndef NDEBUG
+static int validate_obj_buf(obj_t *obj)
+{
+/*  Validates the obj's circular-buffer input and output ptrs.
+ *  Returns 0 if the ptrs are good; o/w, returns -1.
+ */
+    assert(obj != NULL);
+
+    if (!obj->buf) {
+        return(((obj->bufSize == 0) && !obj->bufInPtr && !obj->bufOutPtr)
+            ? 0 : -1);
+    }
+    if ((obj->bufInPtr < obj->buf)
+            || (obj->bufInPtr >= &obj->buf[obj->bufSize])
+            || (obj->bufOutPtr < obj->buf)
+            || (obj->bufOutPtr >= &obj->buf[obj->bufSize])) {
+        return(-1);
+    }
+    return(0);
+}
+#endif /* !NDEBUG */
+
+
+static void grow_obj_buf(obj_t *obj, int len)
+{
+/*  Grows the obj's circular-buffer so it can hold at least (len) bytes
+ *    of data, doubling its size as needed up to the obj's bufMaxSize.
+ *    If the buffer has not yet been allocated, it starts at OBJ_BUF_MIN_SIZE.
+ *  The existing contents are linearized into the new buffer (oldest first)
+ *    so both the unwritten data and the logfile replay history are retained.
+ *  The obj's bufLock must be held when calling this routine.
+ */
+    unsigned char *buf;
+    int size;
+    int numHistory;
+    int numPending;
+    int m;
+
+    assert(obj != NULL);
+    assert(obj->bufSize < obj->bufMaxSize);
+
+    size = (obj->bufSize > 0) ? obj->bufSize * 2 : OBJ_BUF_MIN_SIZE;
+    while ((size <= len) && (size < obj->bufMaxSize)) {
+        size *= 2;
+    }
+    if (size > obj->bufMaxSize) {
+        size = obj->bufMaxSize;
+    }
+    if (!(buf = malloc(size))) {
+        out_of_memory();
+    }
+    numPending = num_bytes_buffered(obj);
 
-    return(isDead ? shutdown_obj(obj) : 0);
+    if (!obj->buf) {
+        numHistory = 0;
+    }
+    else if (!obj->gotBufWrap) {
+        numHistory = obj->bufInPtr - obj->buf;
+        memcpy(buf, obj->buf, numHistory);
+    }
+    else {
+        numHistory = obj->bufSize;
+        m = &obj->buf[obj->bufSize] - obj->bufInPtr;
+        memcpy(buf, obj->bufInPtr, m);
+        memcpy(buf + m, obj->buf, obj->bufInPtr - obj->buf);
+    }
+    DPRINTF((15, "Resized [%s] buffer from %d to %d bytes.\n",
+        obj->name, obj->bufSize, size));
+
+    free(obj->buf);
+    obj->buf = buf;
+    obj->bufSize = size;
+    obj->bufInPtr = buf + numHistory;
+    obj->bufOutPtr = obj->bufInPtr - numPending;
+    obj->gotBufWrap = 0;
+    return;
 }
 
 
@@ -1195,8 +1762,710 @@ static int num_bytes_buffered(obj_t *obj)
         n = obj->bufInPtr - obj->bufOutPtr;
     }
     else {
-        n = (&obj->buf[OBJ_BUF_SIZE] - obj->bufOutPtr) +
+        n = (&obj->buf[obj->bufSize] - obj->bufOutPtr) +
             (obj->bufInPtr - obj->buf);
     }
     return(n);
 }
+
+
+static int write_logfile_obj(obj_t *logfile)
+{
+/*  Writes data from the logfile's circular-buffer out to its file descriptor.
+ *  The buffered data is moved into the logfile's outBuf under the bufLock,
+ *    but written out to the file without holding it; thus, a slow
+ *    filesystem stalls only the logfile reactor, not the console reactors
+ *    writing into the buffer.  Data buffered in the meantime is coalesced
+ *    into the next write.
+ *  Returns 0 on success, or -1 if the obj is ready to be destroyed.
+ */
+    logfile_obj_t *auxp = &logfile->aux.logfile;
+    unsigned char *p;
+    int isDead = 0;
+    int isNew = 0;
+    int n;
+    int m;
+
+    assert(is_logfile_obj(logfile));
+
+#if WITH_ZLIB
+    if (auxp->opts.enableCompress) {
+        return(write_compressed_logfile_obj(logfile));
+    }
+#endif /* WITH_ZLIB */
+    x_pthread_mutex_lock(&logfile->bufLock);
+    assert(validate_obj_buf(logfile) >= 0);
+
+    if ((auxp->outLen == 0) && ((n = num_bytes_buffered(logfile)) > 0)) {
+        if (n > auxp->outSize) {
+            if (!(p = realloc(auxp->outBuf, logfile->bufSize))) {
+                out_of_memory();
+            }
+            auxp->outBuf = p;
+            auxp->outSize = logfile->bufSize;
+        }
+        m = MIN(n, &logfile->buf[logfile->bufSize] - logfile->bufOutPtr);
+        memcpy(auxp->outBuf, logfile->bufOutPtr, m);
+        memcpy(auxp->outBuf + m, logfile->buf, n - m);
+        logfile->bufOutPtr = logfile->bufInPtr;
+        auxp->outLen = n;
+        isNew = 1;
+    }
+    x_pthread_mutex_unlock(&logfile->bufLock);
+
+    if (isNew) {
+        update_logfile_index(logfile, auxp->fileSize);
+    }
+
+    if (auxp->outLen > 0) {
+again:
+        n = write(logfile->fd, auxp->outBuf, auxp->outLen);
+        if (n < 0) {
+            if (errno == EINTR) {
+                goto again;
+            }
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                log_msg(LOG_INFO, "Unable to write to [%s]: %s",
+                    logfile->name, strerror(errno));
+                isDead = 1;
+            }
+        }
+        else if (n > 0) {
+            DPRINTF((15, "Wrote %d bytes to [%s].\n", n, logfile->name));
+            auxp->fileSize += n;
+            auxp->outLen -= n;
+            if (auxp->outLen > 0) {
+                memmove(auxp->outBuf, auxp->outBuf + n, auxp->outLen);
+            }
+        }
+    }
+    x_pthread_mutex_lock(&logfile->bufLock);
+    if ((auxp->outLen == 0) && (logfile->bufInPtr == logfile->bufOutPtr)) {
+        if (logfile->gotEOF) {
+            isDead = 1;
+        }
+        tpoll_clear(logfile->tp, logfile->fd, POLLOUT);
+    }
+    x_pthread_mutex_unlock(&logfile->bufLock);
+
+    if (isDead && (auxp->outLen > 0)) {
+        log_msg(LOG_WARNING,
+            "Flushed %d byte%s of unwritten data from [%s]",
+            auxp->outLen, (auxp->outLen == 1 ? "" : "s"), logfile->name);
+        auxp->outLen = 0;
+    }
+    /*  Rotate the logfile once the data pending for it has been written.
+     *  Data buffered in the meantime is written to the new logfile.
+     */
+    if (!isDead && (auxp->outLen == 0) && is_logfile_rotate_due(logfile)) {
+        (void) rotate_logfile_obj(logfile);
+    }
+    return(isDead ? shutdown_obj(logfile) : 0);
+}
+
+
+static void flush_logfile_obj(obj_t *logfile)
+{
+/*  Timer callback to write out the data coalesced in the logfile's buffer.
+ */
+    assert(is_logfile_obj(logfile));
+
+    x_pthread_mutex_lock(&logfile->bufLock);
+    logfile->aux.logfile.flushTimer = 0;
+    if (logfile->bufInPtr != logfile->bufOutPtr) {
+        tpoll_set(logfile->tp, logfile->fd, POLLOUT);
+    }
+    x_pthread_mutex_unlock(&logfile->bufLock);
+    return;
+}
+
+
+#if WITH_ZLIB
+static int write_compressed_logfile_obj(obj_t *logfile)
+{
+/*  Writes data from the compressed logfile's circular-buffer out to its
+ *    file descriptor.
+ *  The buffered data is accumulated in the logfile's outBuf until it holds
+ *    LOG_FRAME_LEN bytes, its frame timer expires, or the logfile is to be
+ *    rotated or closed.  The outBuf is then compressed into a frame (zBuf)
+ *    and written out.  As with write_logfile_obj(), the bufLock is not held
+ *    while compressing or writing.
+ *  Returns 0 on success, or -1 if the obj is ready to be destroyed.
+ */
+    logfile_obj_t *auxp = &logfile->aux.logfile;
+    unsigned char *p;
+    int isDead = 0;
+    int isFlush;
+    int isNew;
+    int n;
+    int m;
+
+    assert(is_logfile_obj(logfile));
+    assert(auxp->opts.enableCompress);
+
+    for (;;) {
+        x_pthread_mutex_lock(&logfile->bufLock);
+        assert(validate_obj_buf(logfile) >= 0);
+
+        n = MIN(num_bytes_buffered(logfile), LOG_FRAME_LEN - auxp->outLen);
+        isNew = (n > 0) && (auxp->outLen == 0);
+        if (n > 0) {
+            if (auxp->outSize < LOG_FRAME_LEN) {
+                if (!(p = realloc(auxp->outBuf, LOG_FRAME_LEN))) {
+                    out_of_memory();
+                }
+                auxp->outBuf = p;
+                auxp->outSize = LOG_FRAME_LEN;
+            }
+            m = MIN(n, &logfile->buf[logfile->bufSize] - logfile->bufOutPtr);
+            memcpy(auxp->outBuf + auxp->outLen, logfile->bufOutPtr, m);
+            memcpy(auxp->outBuf + auxp->outLen + m, logfile->buf, n - m);
+            logfile->bufOutPtr = (n > m) ? logfile->buf + (n - m)
+                : logfile->bufOutPtr + m;
+            if (logfile->bufOutPtr == &logfile->buf[logfile->bufSize]) {
+                logfile->bufOutPtr = logfile->buf;
+            }
+            auxp->outLen += n;
+        }
+        isFlush = auxp->gotFrameFlush || logfile->gotEOF
+            || (auxp->outLen >= LOG_FRAME_LEN);
+        x_pthread_mutex_unlock(&logfile->bufLock);
+
+        /*  A new frame starts once the previous one has been written.
+         */
+        if (isNew) {
+            update_logfile_index(logfile, auxp->fileSize + auxp->zLen);
+        }
+
+        if (!isFlush && (auxp->outLen > 0) && is_logfile_rotate_due(logfile)) {
+            isFlush = 1;
+        }
+        if ((auxp->zLen == 0) && isFlush) {
+            (void) compress_logfile_frame(logfile);
+        }
+        if (auxp->zLen == 0) {
+            break;
+        }
+again:
+        n = write(logfile->fd, auxp->zBuf, auxp->zLen);
+        if (n < 0) {
+            if (errno == EINTR) {
+                goto again;
+            }
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                log_msg(LOG_INFO, "Unable to write to [%s]: %s",
+                    logfile->name, strerror(errno));
+                isDead = 1;
+            }
+            break;
+        }
+        DPRINTF((15, "Wrote %d bytes to [%s].\n", n, logfile->name));
+        auxp->fileSize += n;
+        auxp->zLen -= n;
+        if (auxp->zLen > 0) {
+            memmove(auxp->zBuf, auxp->zBuf + n, auxp->zLen);
+            break;
+        }
+        /*  Keep going while flushing since the circular-buffer may hold
+         *    more than a frame's worth of data.
+         */
+        if (!isFlush) {
+            break;
+        }
+    }
+    x_pthread_mutex_lock(&logfile->bufLock);
+    if (auxp->zLen == 0) {
+        auxp->gotFrameFlush = 0;
+    }
+    if ((auxp->zLen == 0) && (logfile->bufInPtr == logfile->bufOutPtr)) {
+        if (logfile->gotEOF && (auxp->outLen == 0)) {
+            isDead = 1;
+        }
+        tpoll_clear(logfile->tp, logfile->fd, POLLOUT);
+    }
+    /*  Data left accumulating in the frame is compressed & written out
+     *    once the frame timer expires if the frame does not fill up first.
+     */
+    if (!isDead && (auxp->outLen > 0) && (auxp->frameTimer <= 0)) {
+        auxp->frameTimer = tpoll_timeout_relative(logfile->tp,
+            (callback_f) flush_logfile_frame, logfile, LOG_FRAME_MSECS);
+    }
+    x_pthread_mutex_unlock(&logfile->bufLock);
+
+    if (isDead && ((n = auxp->zLen + auxp->outLen) > 0)) {
+        log_msg(LOG_WARNING,
+            "Flushed %d byte%s of unwritten data from [%s]",
+            n, (n == 1 ? "" : "s"), logfile->name);
+        auxp->zLen = 0;
+        auxp->outLen = 0;
+    }
+    /*  Rotate the logfile once the frames pending for it have been written.
+     */
+    if (!isDead && (auxp->zLen == 0) && (auxp->outLen == 0)
+            && is_logfile_rotate_due(logfile)) {
+        (void) rotate_logfile_obj(logfile);
+    }
+    return(isDead ? shutdown_obj(logfile) : 0);
+}
+
+
+static void flush_logfile_frame(obj_t *logfile)
+{
+/*  Timer callback to compress & write out the logfile's accumulated frame.
+ */
+    assert(is_logfile_obj(logfile));
+
+    x_pthread_mutex_lock(&logfile->bufLock);
+    logfile->aux.logfile.frameTimer = 0;
+    logfile->aux.logfile.gotFrameFlush = 1;
+    tpoll_set(logfile->tp, logfile->fd, POLLOUT);
+    x_pthread_mutex_unlock(&logfile->bufLock);
+    return;
+}
+#endif /* WITH_ZLIB */
+
+
+static int is_obj_drainable(obj_t *obj, int len)
+{
+/*  Returns true if each reader of (obj) can accept another (len) bytes
+ *    without discarding data it has yet to write out; o/w, returns false.
+ *  Data written to a logfile can grow as a result of the additional
+ *    processing, so twice as much space is required in its buffer.
+ *  A suspended client is not considered since it is not writing anyway,
+ *    nor is a channel awaiting credit, nor is a client whose console data
+ *    is held during a deep log replay.
+ */
+    obj_t *reader;
+    obj_cursor_t *cursor;
+    int j;
+    int m;
+    int rc = 1;
+
+    x_pthread_mutex_lock(&obj->readersLock);
+    for (j = 0; rc && (j < obj->numReaders); j++) {
+
+        reader = obj->readerArray[j];
+        if (is_client_obj(reader) && is_console_obj(obj)) {
+            continue;
+        }
+        m = is_logfile_obj(reader) ? (len * 2) : len;
+        x_pthread_mutex_lock(&reader->bufLock);
+        if (reader->bufMaxSize - 1 - num_bytes_buffered(reader) < m) {
+            rc = 0;
+        }
+        x_pthread_mutex_unlock(&reader->bufLock);
+    }
+    x_pthread_mutex_unlock(&obj->readersLock);
+
+    if (rc && obj->chain) {
+        x_pthread_mutex_lock(&obj->chain->lock);
+        for (cursor = obj->chain->cursors; cursor; cursor = cursor->next) {
+            if (is_client_held(cursor->obj)
+                    || cursor->obj->aux.client.replay) {
+                continue;
+            }
+            m = obj->chain->seq - (cursor->chunk->seq + cursor->offset);
+            if (cursor->obj->bufMaxSize - 1 - m < len) {
+                rc = 0;
+                break;
+            }
+        }
+        x_pthread_mutex_unlock(&obj->chain->lock);
+    }
+    return(rc);
+}
+
+
+static void add_obj_reader(obj_t *obj, obj_t *reader)
+{
+/*  Appends (reader) to the readerArray of (obj), growing it as needed.
+ */
+    obj_t **p;
+    int n;
+
+    x_pthread_mutex_lock(&obj->readersLock);
+    if (obj->numReaders == obj->maxReaders) {
+        n = (obj->maxReaders > 0) ? (obj->maxReaders * 2) : 4;
+        if (!(p = realloc(obj->readerArray, n * sizeof(obj_t *)))) {
+            out_of_memory();
+        }
+        obj->readerArray = p;
+        obj->maxReaders = n;
+    }
+    obj->readerArray[obj->numReaders++] = reader;
+    x_pthread_mutex_unlock(&obj->readersLock);
+    return;
+}
+
+
+static void remove_obj_reader(obj_t *obj, obj_t *reader)
+{
+/*  Removes (reader) from the readerArray of (obj).
+ *  The order of the remaining readers is preserved.
+ */
+    int j;
+
+    x_pthread_mutex_lock(&obj->readersLock);
+    for (j = 0; j < obj->numReaders; j++) {
+        if (obj->readerArray[j] == reader) {
+            obj->numReaders--;
+            memmove(&obj->readerArray[j], &obj->readerArray[j + 1],
+                (obj->numReaders - j) * sizeof(obj_t *));
+            break;
+        }
+    }
+    x_pthread_mutex_unlock(&obj->readersLock);
+    return;
+}
+
+
+static obj_chain_t * create_obj_chain(void)
+{
+/*  Creates a chain for the data read from a console obj.
+ *  The chain holds a reference for the console obj, and another for each
+ *    cursor reading from it; it is destroyed once the last is released.
+ *  Returns the new chain.
+ */
+    obj_chain_t *chain;
+
+    if (!(chain = malloc(sizeof(obj_chain_t)))) {
+        out_of_memory();
+    }
+    chain->head = chain->tail = NULL;
+    chain->cursors = NULL;
+    chain->seq = 0;
+    chain->numRefs = 1;
+    chain->gotWake = 0;
+    x_pthread_mutex_init(&chain->lock, NULL);
+    return(chain);
+}
+
+
+static void release_obj_chain(obj_chain_t *chain)
+{
+/*  Releases a reference to the (chain), destroying it with the last one.
+ */
+    int n;
+
+    assert(chain != NULL);
+
+    x_pthread_mutex_lock(&chain->lock);
+    n = --chain->numRefs;
+    x_pthread_mutex_unlock(&chain->lock);
+
+    if (n > 0) {
+        return;
+    }
+    assert(chain->cursors == NULL);
+    trim_obj_chain(chain);
+    assert(chain->head == NULL);
+    x_pthread_mutex_destroy(&chain->lock);
+    free(chain);
+    return;
+}
+
+
+static void append_obj_chain(obj_t *console, const void *src, int len)
+{
+/*  Appends the data (src) of length (len) read from the (console)
+ *    to its chain, and notifies tpoll that data is available for writing
+ *    to each client reading from the chain (unless it is suspended).
+ *  The client objs are serviced by the main thread.  When the console is
+ *    serviced by another reactor, the clients are not notified from here
+ *    since a client's fd can be closed by the main thread at any time;
+ *    instead, a single wake of the chain's readers is deferred to the main
+ *    thread until it has run.
+ *  The data is not retained if no cursors are reading from the chain.
+ *  A cursor that has fallen more than (bufMaxSize - 1) bytes behind
+ *    skips ahead, discarding its oldest data just as a circular-buffer
+ *    would overwrite it.
+ */
+    obj_chain_t *chain = console->chain;
+    obj_chunk_t *chunk;
+    obj_cursor_t *cursor;
+    obj_t *client;
+    int m;
+
+    assert(is_console_obj(console));
+    assert(chain != NULL);
+
+    if (!src || len <= 0) {
+        return;
+    }
+    x_pthread_mutex_lock(&chain->lock);
+
+    if (!chain->cursors) {
+        x_pthread_mutex_unlock(&chain->lock);
+        return;
+    }
+    while (len > 0) {
+        if (!chain->tail || (chain->tail->len == OBJ_CHUNK_SIZE)) {
+            if (!(chunk = malloc(sizeof(obj_chunk_t)))) {
+                out_of_memory();
+            }
+            chunk->next = NULL;
+            chunk->seq = chain->seq;
+            chunk->len = 0;
+            chunk->numRefs = 0;
+            if (chain->tail) {
+                chain->tail->next = chunk;
+            }
+            else {
+                chain->head = chunk;
+            }
+            chain->tail = chunk;
+        }
+        chunk = chain->tail;
+        m = MIN(len, OBJ_CHUNK_SIZE - chunk->len);
+        memcpy(&chunk->data[chunk->len], src, m);
+        chunk->len += m;
+        chain->seq += m;
+        src = (unsigned char *) src + m;
+        len -= m;
+    }
+    for (cursor = chain->cursors; cursor; cursor = cursor->next) {
+
+        client = cursor->obj;
+        m = chain->seq - (cursor->chunk->seq + cursor->offset);
+        m -= client->bufMaxSize - 1;
+        if (m > 0) {
+            advance_obj_cursor(cursor, m);
+            if (!is_client_held(client)) {
+                log_msg(LOG_NOTICE, "Overwrote %d bytes for \"%s\"",
+                    m, client->name);
+            }
+        }
+        if (console->tp == tp_global) {
+            wake_client_obj(client);
+        }
+    }
+    trim_obj_chain(chain);
+    if ((console->tp != tp_global) && !chain->gotWake) {
+        if (tpoll_timeout_relative(tp_global,
+                (callback_f) wake_obj_chain, chain, 0) < 0) {
+            log_msg(LOG_WARNING, "Unable to create timer for [%s]",
+                console->name);
+        }
+        else {
+            chain->gotWake = 1;
+            chain->numRefs++;
+        }
+    }
+    x_pthread_mutex_unlock(&chain->lock);
+    return;
+}
+
+
+static void wake_obj_chain(obj_chain_t *chain)
+{
+/*  Notifies tpoll that data is available for writing to each client
+ *    reading from the (chain), as deferred to the main thread by
+ *    append_obj_chain().
+ *  The reference held on the chain while the wake was pending is released.
+ */
+    obj_cursor_t *cursor;
+
+    assert(chain != NULL);
+
+    x_pthread_mutex_lock(&chain->lock);
+    chain->gotWake = 0;
+    for (cursor = chain->cursors; cursor; cursor = cursor->next) {
+        wake_client_obj(cursor->obj);
+    }
+    x_pthread_mutex_unlock(&chain->lock);
+
+    release_obj_chain(chain);
+    return;
+}
+
+
+static void trim_obj_chain(obj_chain_t *chain)
+{
+/*  Frees the chunks at the head of the (chain) that are no longer
+ *    referenced by any cursor.
+ *  The chain lock must be held when calling this routine
+ *    (unless the chain is being destroyed).
+ */
+    obj_chunk_t *chunk;
+
+    while ((chunk = chain->head) && (chunk->numRefs == 0)) {
+        chain->head = chunk->next;
+        if (!chain->head) {
+            chain->tail = NULL;
+        }
+        free(chunk);
+    }
+    return;
+}
+
+
+static void attach_obj_cursor(obj_t *client, obj_t *console)
+{
+/*  Attaches a cursor for the (client) to the end of the (console)'s chain
+ *    so the client will receive all data subsequently read from it.
+ */
+    obj_chain_t *chain = console->chain;
+    obj_cursor_t *cursor;
+    obj_chunk_t *chunk;
+
+    assert(is_client_obj(client));
+    assert(is_console_obj(console));
+    assert(chain != NULL);
+
+    if (!(cursor = malloc(sizeof(obj_cursor_t)))) {
+        out_of_memory();
+    }
+    cursor->chain = chain;
+    cursor->obj = client;
+
+    x_pthread_mutex_lock(&chain->lock);
+    if (!chain->tail) {
+        if (!(chunk = malloc(sizeof(obj_chunk_t)))) {
+            out_of_memory();
+        }
+        chunk->next = NULL;
+        chunk->seq = chain->seq;
+        chunk->len = 0;
+        chunk->numRefs = 0;
+        chain->head = chain->tail = chunk;
+    }
+    cursor->chunk = chain->tail;
+    cursor->offset = chain->tail->len;
+    cursor->chunk->numRefs++;
+    cursor->next = chain->cursors;
+    chain->cursors = cursor;
+    chain->numRefs++;
+    x_pthread_mutex_unlock(&chain->lock);
+
+    x_pthread_mutex_lock(&client->bufLock);
+    assert(client->aux.client.cursor == NULL);
+    client->aux.client.cursor = cursor;
+    x_pthread_mutex_unlock(&client->bufLock);
+    return;
+}
+
+
+static void detach_obj_cursor(obj_t *client)
+{
+/*  Detaches the (client)'s cursor (if any) from its console's chain.
+ *  Any chain data not yet written out is first copied into the client's
+ *    circular-buffer so it can still be flushed before the client closes.
+ */
+    obj_cursor_t *cursor;
+    obj_cursor_t **pp;
+    obj_chain_t *chain;
+    struct iovec iov[OBJ_CHUNK_IOV_MAX];
+    unsigned char *buf = NULL;
+    int len = 0;
+    int iovcnt;
+    int k;
+
+    assert(is_client_obj(client));
+
+    x_pthread_mutex_lock(&client->bufLock);
+    cursor = client->aux.client.cursor;
+    client->aux.client.cursor = NULL;
+    x_pthread_mutex_unlock(&client->bufLock);
+
+    if (!cursor) {
+        return;
+    }
+    chain = cursor->chain;
+    x_pthread_mutex_lock(&chain->lock);
+
+    if ((client->fd >= 0) || client->aux.client.conn) {
+        len = chain->seq - (cursor->chunk->seq + cursor->offset);
+    }
+    if (len > 0) {
+        if (!(buf = malloc(len))) {
+            out_of_memory();
+        }
+        len = 0;
+        do {
+            iovcnt = get_obj_cursor_iov(cursor, iov, OBJ_CHUNK_IOV_MAX);
+            for (k = 0; k < iovcnt; k++) {
+                memcpy(buf + len, iov[k].iov_base, iov[k].iov_len);
+                len += iov[k].iov_len;
+                advance_obj_cursor(cursor, iov[k].iov_len);
+            }
+        } while (iovcnt > 0);
+    }
+    for (pp = &chain->cursors; *pp; pp = &(*pp)->next) {
+        if (*pp == cursor) {
+            *pp = cursor->next;
+            break;
+        }
+    }
+    cursor->chunk->numRefs--;
+    trim_obj_chain(chain);
+    x_pthread_mutex_unlock(&chain->lock);
+
+    free(cursor);
+    if (buf) {
+        write_obj_data(client, buf, len, 0);
+        free(buf);
+    }
+    release_obj_chain(chain);
+    return;
+}
+
+
+static void advance_obj_cursor(obj_cursor_t *cursor, int len)
+{
+/*  Advances the (cursor) by (len) bytes along its chain, moving its chunk
+ *    reference along with it.  The cursor never rests at the end of a chunk
+ *    that has a successor, so the chunks it has passed can be trimmed.
+ *  The chain lock must be held when calling this routine.
+ */
+    obj_chunk_t *chunk;
+    int m;
+
+    for (;;) {
+        chunk = cursor->chunk;
+        if (cursor->offset == chunk->len) {
+            if (!chunk->next) {
+                break;
+            }
+            chunk->numRefs--;
+            cursor->chunk = chunk->next;
+            cursor->chunk->numRefs++;
+            cursor->offset = 0;
+            continue;
+        }
+        if (len <= 0) {
+            break;
+        }
+        m = MIN(len, chunk->len - cursor->offset);
+        cursor->offset += m;
+        len -= m;
+    }
+    assert(len == 0);
+    return;
+}
+
+
+static int get_obj_cursor_iov(obj_cursor_t *cursor, struct iovec *iov, int n)
+{
+/*  Fills in up to (n) iovec structs in (iov) describing the chain data
+ *    not yet written out by the (cursor).
+ *  The chain lock must be held when calling this routine.
+ *  Returns the number of iovec structs filled in.
+ */
+    obj_chunk_t *chunk;
+    int offset;
+    int k = 0;
+
+    chunk = cursor->chunk;
+    offset = cursor->offset;
+
+    while (chunk && (k < n)) {
+        if (chunk->len > offset) {
+            iov[k].iov_base = &chunk->data[offset];
+            iov[k].iov_len = chunk->len - offset;
+            k++;
+        }
+        chunk = chunk->next;
+        offset = 0;
+    }
+    return(k);
+}
@@ -53,7 +53,6 @@ static int  connect_process_obj(obj_t *process);
 static int  check_process_prog(obj_t *process);
 static void reset_process_delay(obj_t *process);
 
-extern tpoll_t tp_global;               /* defined in server.c */
 
 
 int is_process_dev(const char *dev, const char *cwd,
@@ -153,7 +152,6 @@ obj_t * create_process_obj(server_conf_t *conf, char *name, List args,
  *    by main:open_objs:reopen_obj:open_process_obj().
  *  Returns the new object, or NULL on error.
  */
-    ListIterator   i;
     obj_t         *process;
     process_obj_t *auxp;
     int            num_args;
@@ -166,18 +164,11 @@ obj_t * create_process_obj(server_conf_t *conf, char *name, List args,
 
     /*  Check for duplicate console names.
      */
-    i = list_iterator_create(conf->objs);
-    while ((process = list_next(i))) {
-        if (is_console_obj(process) && !strcmp(process->name, name)) {
-            if ((errbuf != NULL) && (errlen > 0)) {
-                snprintf(errbuf, errlen,
-                    "console [%s] specifies duplicate console name", name);
-            }
-            break;
+    if (find_console_obj(conf, name)) {
+        if ((errbuf != NULL) && (errlen > 0)) {
+            snprintf(errbuf, errlen,
+                "console [%s] specifies duplicate console name", name);
         }
-    }
-    list_iterator_destroy(i);
-    if (process != NULL) {
         return(NULL);
     }
     process = create_obj(conf, name, -1, CONMAN_OBJ_PROCESS);
@@ -204,9 +195,11 @@ obj_t * create_process_obj(server_conf_t *conf, char *name, List args,
     else {
         auxp->prog = auxp->argv[0];
     }
-    /*  Add obj to the master conf->objs list.
+    /*  Add obj to the master conf->objs list
+     *    and index it by name.
      */
     list_append(conf->objs, process);
+    insert_obj_index(&conf->consoleIndex, name, process);
 
     return(process);
 }
@@ -227,7 +220,7 @@ int open_process_obj(obj_t *process)
     auxp = &(process->aux.process);
 
     if (auxp->timer >= 0) {
-        (void) tpoll_timeout_cancel(tp_global, auxp->timer);
+        (void) tpoll_timeout_cancel(process->tp, auxp->timer);
         auxp->timer = -1;
     }
 
@@ -242,7 +235,7 @@ int open_process_obj(obj_t *process)
         DPRINTF((15, "Retrying [%s] connection to prog=\"%s\" in %ds\n",
             process->name, auxp->argv[0], auxp->delay));
 
-        auxp->timer = tpoll_timeout_relative(tp_global,
+        auxp->timer = tpoll_timeout_relative(process->tp,
             (callback_f) open_process_obj, process, auxp->delay * 1000);
 
         auxp->delay = (auxp->delay == 0)
@@ -270,9 +263,7 @@ static int disconnect_process_obj(obj_t *process)
     auxp = &(process->aux.process);
 
     if (process->fd >= 0) {
-        tpoll_clear(tp_global, process->fd, POLLIN | POLLOUT);
-        (void) close(process->fd);
-        process->fd = -1;
+        (void) close(detach_obj_fd(process));
     }
     if (time(&tNow) == (time_t) -1) {
         log_err(errno, "time() failed");
@@ -353,16 +344,16 @@ static int connect_process_obj(obj_t *process)
     if (time(&(auxp->tStart)) == (time_t) -1) {
         log_err(errno, "time() failed");
     }
-    process->fd = fd_pair[0];
+    set_obj_fd(process, fd_pair[0]);
     auxp->pid = pid;
     process->gotEOF = 0;
     auxp->state = CONMAN_PROCESS_UP;
-    tpoll_set(tp_global, process->fd, POLLIN);
+    tpoll_set(process->tp, process->fd, POLLIN);
 
     /*  Require the connection to be up for a minimum length of time before
      *    resetting the reconnect-delay back to zero.
      */
-    auxp->timer = tpoll_timeout_relative(tp_global,
+    auxp->timer = tpoll_timeout_relative(process->tp,
         (callback_f) reset_process_delay, process, PROCESS_MIN_TIMEOUT * 1000);
 
     /*  Notify linked objs when transitioning into an UP state.
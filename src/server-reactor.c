@@ -0,0 +1,507 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The console objs are sharded across (conf->numThreads) reactors.
+ *    Reactor 0 is the main thread; it owns conf->tp, the listening socket,
+ *    the inotify fd, every client obj, and the daemon-wide timers.
+ *    Each additional reactor runs its own thread with its own tpoll obj,
+ *    and services the I/O & timers of the console objs (and their logfiles)
+ *    assigned to it.
+ *  An obj's (tp) member names the tpoll obj of the reactor servicing it.
+ *    Data is handed between reactors by writing into the destination obj's
+ *    circular-buffer (protected by its bufLock) and setting POLLOUT on the
+ *    destination obj's tpoll, which wakes the owning reactor.  An obj's fd
+ *    is only changed under its bufLock (see set_obj_fd() & detach_obj_fd()),
+ *    so it cannot be closed while another reactor is setting POLLOUT on it.
+ *    Console data reaches the clients via the console's chain instead, so
+ *    the clients' wake is deferred to the main thread servicing them.
+ *    Work that must run on the owning reactor is posted to its tpoll as a
+ *    zero-delay timer via defer_obj_callback().
+ *  A client obj is only freed once every other console reactor has passed
+ *    through its event loop after the client was unlinked from its consoles,
+ *    since a reactor may still hold a ptr to it from its readers list.
+ *  The logfile objs are serviced by a dedicated reactor following the
+ *    (conf->numThreads) console reactors in the array, so a blocking
+ *    open(), lock, or write on a slow filesystem does not stall the
+ *    consoles.  This reactor never references client objs, so it does
+ *    not take part in reclaiming them.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "list.h"
+#include "log.h"
+#include "server.h"
+#include "tpoll.h"
+#include "util-file.h"
+#include "util.h"
+#include "wrapper.h"
+
+
+extern tpoll_t tp_global;               /* defined in server.c */
+
+
+typedef struct reclaim {                /* DEFERRED OBJ RECLAMATION BATCH:   */
+    server_conf_t   *conf;              /*  configuration owning the objs    */
+    List             objs;              /*  list of objs awaiting removal    */
+    int              numPending;        /*  num of reactors yet to check in  */
+    pthread_mutex_t  lock;              /*  lock protecting numPending       */
+} reclaim_t;
+
+
+static void * reactor_loop(reactor_t *r);
+static void reclaim_barrier(reclaim_t *batch);
+static void reclaim_batch(reclaim_t *batch);
+static void sweep_objs(server_conf_t *conf, List objs);
+static int is_reclaimed_obj(obj_t *obj, void *key);
+static int find_reclaim(reclaim_t *batch, reclaim_t *key);
+static void destroy_reclaim(reclaim_t *batch);
+
+/*  List of reclaim batches that have not yet completed.
+ *  Batches still pending when the daemon exits are freed by
+ *    destroy_reactors(); their objs remain in the master objs list.
+ */
+static List reclaims = NULL;
+
+
+void create_reactors(server_conf_t *conf)
+{
+/*  Creates the reactors and assigns each console obj to one of them,
+ *    and each logfile obj to the logfile reactor.
+ *  The number of console reactors is limited to the number of consoles.
+ *  This must be called after the config file has been processed
+ *    but before any of the objs have been opened.
+ */
+    ListIterator i;
+    obj_t *obj;
+    int numConsoles = 0;
+    int k;
+
+    assert(conf->reactors == NULL);
+    assert(conf->numThreads > 0);
+
+    i = list_iterator_create(conf->objs);
+    while ((obj = list_next(i))) {
+        if (is_console_obj(obj)) {
+            numConsoles++;
+        }
+    }
+    if (conf->numThreads > numConsoles) {
+        conf->numThreads = (numConsoles > 0) ? numConsoles : 1;
+    }
+    conf->reactors = malloc((conf->numThreads + 1) * sizeof(reactor_t));
+    if (!conf->reactors) {
+        out_of_memory();
+    }
+    for (k = 0; k <= conf->numThreads; k++) {
+        reactor_t *r = &conf->reactors[k];
+
+        r->tp = NULL;
+        r->fd_pipe[0] = r->fd_pipe[1] = -1;
+        r->gotDone = 0;
+
+        if (k == 0) {
+            r->tp = conf->tp;
+            continue;
+        }
+        if (!(r->tp = tpoll_create(0))) {
+            log_err(0, "Unable to create object for multiplexing I/O");
+        }
+        if (pipe(r->fd_pipe) < 0) {
+            log_err(errno, "Unable to create reactor pipe");
+        }
+        set_fd_nonblocking(r->fd_pipe[0]);
+        set_fd_nonblocking(r->fd_pipe[1]);
+        set_fd_closed_on_exec(r->fd_pipe[0]);
+        set_fd_closed_on_exec(r->fd_pipe[1]);
+        tpoll_set(r->tp, r->fd_pipe[0], POLLIN);
+    }
+    /*  Assign consoles round-robin, and logfiles to the logfile reactor.
+     */
+    k = 0;
+    list_iterator_reset(i);
+    while ((obj = list_next(i))) {
+        if (is_console_obj(obj)) {
+            obj->tp = conf->reactors[k].tp;
+            k = (k + 1) % conf->numThreads;
+        }
+    }
+    list_iterator_reset(i);
+    while ((obj = list_next(i))) {
+        if (is_logfile_obj(obj)) {
+            obj->tp = conf->reactors[conf->numThreads].tp;
+        }
+    }
+    list_iterator_destroy(i);
+
+    if (!(reclaims = list_create((ListDelF) destroy_reclaim))) {
+        out_of_memory();
+    }
+    return;
+}
+
+
+void start_reactors(server_conf_t *conf)
+{
+/*  Starts a thread for each reactor other than the main thread.
+ *  The asynchronous signals are blocked in the reactor threads so they
+ *    will be delivered to the main thread where mux_io() checks for them.
+ */
+    sigset_t sigset;
+    sigset_t sigset_old;
+    int k;
+    int rc;
+
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGCHLD);
+    sigaddset(&sigset, SIGHUP);
+    sigaddset(&sigset, SIGINT);
+    sigaddset(&sigset, SIGPIPE);
+    sigaddset(&sigset, SIGTERM);
+    if ((rc = pthread_sigmask(SIG_BLOCK, &sigset, &sigset_old)) != 0) {
+        log_err(rc, "Unable to block signals");
+    }
+    for (k = 1; k <= conf->numThreads; k++) {
+        if ((rc = pthread_create(&conf->reactors[k].tid, NULL,
+          (PthreadFunc) reactor_loop, &conf->reactors[k])) != 0) {
+            log_err(rc, "Unable to create reactor thread");
+        }
+    }
+    if ((rc = pthread_sigmask(SIG_SETMASK, &sigset_old, NULL)) != 0) {
+        log_err(rc, "Unable to restore signal mask");
+    }
+    if (conf->numThreads > 1) {
+        log_msg(LOG_INFO, "Multiplexing console I/O across %d threads",
+            conf->numThreads);
+    }
+    return;
+}
+
+
+void stop_reactors(server_conf_t *conf)
+{
+/*  Stops the reactor threads started by start_reactors().
+ *  Afterwards, the data still buffered for each logfile (eg, awaiting
+ *    a coalesced write or accumulating in a compressed frame) is written out.
+ */
+    ListIterator i;
+    obj_t *obj;
+    int k;
+    int rc;
+    const char c = 0;
+
+    if (!conf->reactors) {
+        return;
+    }
+    for (k = 1; k <= conf->numThreads; k++) {
+        if (write(conf->reactors[k].fd_pipe[1], &c, 1) < 0) {
+            log_err(errno, "Unable to signal reactor thread");
+        }
+    }
+    for (k = 1; k <= conf->numThreads; k++) {
+        if ((rc = pthread_join(conf->reactors[k].tid, NULL)) != 0) {
+            log_err(rc, "Unable to join reactor thread");
+        }
+    }
+    i = list_iterator_create(conf->objs);
+    while ((obj = list_next(i))) {
+        if (is_logfile_obj(obj)) {
+            obj->aux.logfile.gotFrameFlush = 1;
+            (void) write_to_obj(obj);
+        }
+    }
+    list_iterator_destroy(i);
+    return;
+}
+
+
+void destroy_reactors(server_conf_t *conf)
+{
+/*  Destroys the reactors created by create_reactors().
+ *  This must be called after the objs have been destroyed since
+ *    destroy_obj() clears the obj's fd from its reactor's tpoll obj.
+ */
+    int k;
+
+    if (!conf->reactors) {
+        return;
+    }
+    for (k = 1; k <= conf->numThreads; k++) {
+        reactor_t *r = &conf->reactors[k];
+
+        if (r->tp) {
+            tpoll_destroy(r->tp);
+        }
+        if ((r->fd_pipe[0] >= 0) && (close(r->fd_pipe[0]) < 0)) {
+            log_msg(LOG_WARNING, "Unable to close reactor pipe: %s",
+                strerror(errno));
+        }
+        if ((r->fd_pipe[1] >= 0) && (close(r->fd_pipe[1]) < 0)) {
+            log_msg(LOG_WARNING, "Unable to close reactor pipe: %s",
+                strerror(errno));
+        }
+    }
+    free(conf->reactors);
+    conf->reactors = NULL;
+
+    if (reclaims) {
+        list_destroy(reclaims);
+        reclaims = NULL;
+    }
+    return;
+}
+
+
+void dispatch_obj_io(tpoll_t tp, int fd, List dead)
+{
+/*  Dispatches the I/O ready on (fd) of the tpoll obj (tp) to its obj.
+ *  If read_from_obj() or write_to_obj() returns -1, the obj is appended
+ *    to the (dead) list for removal from the master objs list.
+ *    So are the channels of a multiplexed connection that have since closed
+ *    (which have no fd of their own to be dispatched).
+ *  An fd no longer belonging to an obj serviced by (tp) is a stale event
+ *    (eg, the fd was closed and reused by another reactor),
+ *    so it is removed from (tp).
+ */
+    obj_t *obj;
+    int rvr, rvw;
+    int isDead = 0;
+
+    obj = find_obj_by_fd(fd);
+    if (!obj || (obj->tp != tp)) {
+        tpoll_clear(tp, fd, POLLIN | POLLOUT);
+        return;
+    }
+    rvr = tpoll_is_set(tp, fd, POLLIN | POLLHUP | POLLERR);
+    rvw = tpoll_is_set(tp, fd, POLLOUT);
+
+    if ((rvr > 0) && (read_from_obj(obj) < 0)) {
+        isDead = 1;
+    }
+    else if ((rvw > 0) && (write_to_obj(obj) < 0)) {
+        isDead = 1;
+    }
+    if (dead && is_client_obj(obj) && obj->aux.client.mux) {
+        reap_mux_channels(obj, dead);
+    }
+    if (dead && isDead) {
+        list_append(dead, obj);
+    }
+    return;
+}
+
+
+void reclaim_objs(server_conf_t *conf, List dead)
+{
+/*  Removes the objs in the (dead) list from the master objs list
+ *    (thereby destroying them), emptying the (dead) list in the process.
+ *  With a single reactor, the objs are destroyed immediately.
+ *    O/w, they are moved into a reclaim batch and destroyed by the
+ *    main thread once every other console reactor has checked in.
+ *  This must be called by the main thread.
+ */
+    reclaim_t *batch;
+    obj_t *obj;
+    int k;
+
+    if (list_is_empty(dead)) {
+        return;
+    }
+    if (conf->numThreads <= 1) {
+        sweep_objs(conf, dead);
+        return;
+    }
+    if (!(batch = malloc(sizeof(reclaim_t)))) {
+        out_of_memory();
+    }
+    batch->conf = conf;
+    batch->objs = list_create(NULL);
+    batch->numPending = conf->numThreads - 1;
+    x_pthread_mutex_init(&batch->lock, NULL);
+    while ((obj = list_pop(dead))) {
+        list_append(batch->objs, obj);
+    }
+    list_append(reclaims, batch);
+
+    for (k = 1; k < conf->numThreads; k++) {
+        if (tpoll_timeout_relative(conf->reactors[k].tp,
+                (callback_f) reclaim_barrier, batch, 0) < 0) {
+            log_err(0, "Unable to create timer for reclaiming objs");
+        }
+    }
+    return;
+}
+
+
+void defer_obj_callback(obj_t *obj, callback_f cb)
+{
+/*  Invokes the callback function (cb) on (obj) from the reactor servicing it.
+ *  If (obj) is serviced by the main thread, (cb) is invoked immediately;
+ *    o/w, it is posted to the obj's reactor as a zero-delay timer.
+ *  This must be called by the main thread.
+ */
+    assert(obj != NULL);
+    assert(cb != NULL);
+
+    if (obj->tp == tp_global) {
+        cb(obj);
+    }
+    else if (tpoll_timeout_relative(obj->tp, cb, obj, 0) < 0) {
+        log_msg(LOG_WARNING, "Unable to create timer for [%s]", obj->name);
+    }
+    return;
+}
+
+
+static void * reactor_loop(reactor_t *r)
+{
+/*  Multiplexes I/O for the objs assigned to reactor (r).
+ *  The reactor exits once data has been written into its pipe.
+ */
+    int n;
+    int k;
+    int fd;
+    char c;
+
+    assert(r->tp != NULL);
+
+    while (!r->gotDone) {
+        if ((n = tpoll(r->tp, -1)) < 0) {
+            if (errno != EINTR) {
+                log_err(errno, "Unable to multiplex I/O");
+            }
+            continue;
+        }
+        for (k = 0; (n > 0) && ((fd = tpoll_ready(r->tp, k)) >= 0); k++) {
+            if (fd == r->fd_pipe[0]) {
+                while (read(r->fd_pipe[0], &c, 1) > 0) {
+                    r->gotDone = 1;
+                }
+                continue;
+            }
+            dispatch_obj_io(r->tp, fd, NULL);
+        }
+    }
+    return(NULL);
+}
+
+
+static void reclaim_barrier(reclaim_t *batch)
+{
+/*  Checks in the calling reactor for the reclaim (batch).
+ *  Once every reactor has checked in, none of them can still be holding
+ *    a ptr to any of the batch's objs, so the batch is handed to the
+ *    main thread for destruction.
+ */
+    int n;
+
+    x_pthread_mutex_lock(&batch->lock);
+    n = --batch->numPending;
+    x_pthread_mutex_unlock(&batch->lock);
+
+    if (n == 0) {
+        if (tpoll_timeout_relative(tp_global,
+                (callback_f) reclaim_batch, batch, 0) < 0) {
+            log_err(0, "Unable to create timer for reclaiming objs");
+        }
+    }
+    return;
+}
+
+
+static void reclaim_batch(reclaim_t *batch)
+{
+/*  Removes the objs in the reclaim (batch) from the master objs list.
+ */
+    sweep_objs(batch->conf, batch->objs);
+    list_delete_all(reclaims, (ListFindF) find_reclaim, batch);
+    return;
+}
+
+
+static void sweep_objs(server_conf_t *conf, List objs)
+{
+/*  Removes the objs in the (objs) list from the master objs list
+ *    (thereby destroying them), emptying the (objs) list in the process.
+ *  The objs are flagged and then removed in a single pass over the master
+ *    objs list, so reclaiming many objs at once (eg, when many clients
+ *    disconnect together) is not quadratic in the number of objs.
+ *  An obj is only flagged here since the objs of another reclaim batch
+ *    may still be pending.
+ *  The flag is not a bitfield since it is read here for every live obj
+ *    while reactors may be updating the obj's other flags.
+ */
+    obj_t *obj;
+
+    if (list_is_empty(objs)) {
+        return;
+    }
+    while ((obj = list_pop(objs))) {
+        obj->gotReclaim = 1;
+    }
+    list_delete_all(conf->objs, (ListFindF) is_reclaimed_obj, conf);
+    return;
+}
+
+
+static int is_reclaimed_obj(obj_t *obj, void *key)
+{
+/*  Used by list_delete_all() to locate the objs flagged by sweep_objs();
+ *    the (key) is unused.
+ *  Returns non-zero if (obj) has been flagged; o/w returns zero.
+ */
+    assert(obj != NULL);
+
+    return(obj->gotReclaim);
+}
+
+
+static int find_reclaim(reclaim_t *batch, reclaim_t *key)
+{
+/*  Used by list_delete_all() to locate the reclaim batch (key).
+ *  Returns non-zero if (batch == key); o/w returns zero.
+ */
+    return(batch == key);
+}
+
+
+static void destroy_reclaim(reclaim_t *batch)
+{
+    assert(batch != NULL);
+
+    list_destroy(batch->objs);
+    x_pthread_mutex_destroy(&batch->lock);
+    free(batch);
+    return;
+}
@@ -0,0 +1,446 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  Client addresses are resolved into host names by a pool of resolver
+ *    threads calling getnameinfo(), which (unlike gethostbyaddr()) does not
+ *    serialize every lookup in the daemon behind a single mutex.
+ *  A lookup is queued by prefetch_addr_name() as soon as a client connects,
+ *    so it proceeds while the client sends its greeting.  The handshake
+ *    worker then waits in resolve_addr_name() for at most RESOLVE_TIMEOUT
+ *    seconds from when the lookup was queued before falling back to the
+ *    IP address; a slow DNS server thereby delays each client by a bounded
+ *    amount instead of stalling the handshake workers one after another.
+ *  Results are cached by address: found names for RESOLVE_POSITIVE_TTL
+ *    seconds, and failed lookups for RESOLVE_NEGATIVE_TTL seconds.  The cache
+ *    holds at most RESOLVE_CACHE_SIZE entries (plus any lookups in progress),
+ *    evicting the least-recently queued entry when full.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <sys/types.h>                  /* include before in.h for bsd */
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <assert.h>
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "log.h"
+#include "server.h"
+#include "util-str.h"
+#include "util.h"
+#include "wrapper.h"
+
+
+typedef enum resolve_state {
+    RESOLVE_PENDING,                    /* lookup queued or in progress      */
+    RESOLVE_FOUND,                      /* address resolved to (name)        */
+    RESOLVE_NOT_FOUND                   /* address could not be resolved     */
+} resolve_state_t;
+
+typedef struct resolve_entry {
+    struct resolve_entry *hashNext;     /* next entry in hash chain          */
+    struct resolve_entry *agePrev;      /* next older entry in cache         */
+    struct resolve_entry *ageNext;      /* next newer entry in cache         */
+    struct resolve_entry *queueNext;    /* next entry awaiting a lookup      */
+    struct in_addr        addr;         /* address being resolved            */
+    resolve_state_t       state;        /* state of lookup                   */
+    int                   numWaiters;   /* threads awaiting the lookup       */
+    struct timespec       deadline;     /* time waiters give up on lookup    */
+    time_t                expires;      /* time cached result expires        */
+    char                 *name;         /* host name if RESOLVE_FOUND        */
+} resolve_entry_t;
+
+typedef struct resolve_stats {
+    unsigned long         hits;         /* lookups answered by the cache     */
+    unsigned long         negHits;      /* hits on failed lookups            */
+    unsigned long         misses;       /* lookups queued for a resolver     */
+    unsigned long         timeouts;     /* waits abandoned at the deadline   */
+    unsigned long         evictions;    /* entries evicted when cache full   */
+} resolve_stats_t;
+
+
+static resolve_entry_t * get_resolve_entry(const struct in_addr *addr,
+    int doCount);
+static void evict_resolve_entry(void);
+static void unlink_resolve_entry_age(resolve_entry_t *e);
+static void append_resolve_entry_age(resolve_entry_t *e);
+static void queue_resolve_entry(resolve_entry_t *e);
+static void * resolver(void *arg);
+
+
+/*  The cache, lookup queue, and counters are protected by resolveLock.
+ */
+static resolve_entry_t *resolveCache[RESOLVE_CACHE_SIZE];
+static resolve_entry_t *resolveOldest = NULL;
+static resolve_entry_t *resolveNewest = NULL;
+static resolve_entry_t *resolveQueueHead = NULL;
+static resolve_entry_t *resolveQueueTail = NULL;
+static int numResolveEntries = 0;
+static int resolveDone = 0;
+static resolve_stats_t resolveStats;
+static pthread_mutex_t resolveLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t resolveQueueCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t resolveDoneCond = PTHREAD_COND_INITIALIZER;
+
+
+void start_resolver(void)
+{
+/*  Starts the pool of resolver threads.
+ *  The threads are detached since one may be blocked in getnameinfo()
+ *    when the daemon exits.
+ */
+    pthread_t tid;
+    int k;
+    int rc;
+
+    for (k = 0; k < RESOLVER_THREADS; k++) {
+        if ((rc = pthread_create(&tid, NULL, resolver, NULL)) != 0) {
+            log_err(rc, "Unable to create resolver thread");
+        }
+        x_pthread_detach(tid);
+    }
+    return;
+}
+
+
+void stop_resolver(void)
+{
+/*  Signals the resolver threads to exit once they finish their current
+ *    lookup, and wakes any threads awaiting a lookup.
+ *  The cache is not freed since a resolver may still reference it.
+ */
+    int rc;
+
+    log_resolver_stats();
+
+    x_pthread_mutex_lock(&resolveLock);
+    resolveDone = 1;
+    if ((rc = pthread_cond_broadcast(&resolveQueueCond)) != 0) {
+        log_err(rc, "Unable to broadcast resolver queue condition");
+    }
+    if ((rc = pthread_cond_broadcast(&resolveDoneCond)) != 0) {
+        log_err(rc, "Unable to broadcast resolver done condition");
+    }
+    x_pthread_mutex_unlock(&resolveLock);
+    return;
+}
+
+
+void prefetch_addr_name(const struct in_addr *addr)
+{
+/*  Starts resolving the address (addr) into a host name if the result
+ *    is not already cached.  This does not block on the lookup.
+ */
+    assert(addr != NULL);
+
+    x_pthread_mutex_lock(&resolveLock);
+    (void) get_resolve_entry(addr, 1);
+    x_pthread_mutex_unlock(&resolveLock);
+    return;
+}
+
+
+char * resolve_addr_name(const struct in_addr *addr, char *dst, int dstlen)
+{
+/*  Resolves the address (addr) into a host name, storing the result
+ *    in the buffer (dst) of length (dstlen).
+ *  If the lookup is still in progress, waits until RESOLVE_TIMEOUT seconds
+ *    after it was queued.
+ *  Returns (dst) on success, or NULL if the address could not be resolved
+ *    in time.
+ */
+    resolve_entry_t *e;
+    char *p = NULL;
+    int rc;
+
+    assert(addr != NULL);
+    assert(dst != NULL);
+
+    x_pthread_mutex_lock(&resolveLock);
+    e = get_resolve_entry(addr, 0);
+    e->numWaiters++;
+    while ((e->state == RESOLVE_PENDING) && !resolveDone) {
+        rc = pthread_cond_timedwait(&resolveDoneCond, &resolveLock,
+            &e->deadline);
+        if (rc == ETIMEDOUT) {
+            break;
+        }
+        else if (rc != 0) {
+            log_err(rc, "Unable to wait on resolver done condition");
+        }
+    }
+    e->numWaiters--;
+    if (e->state == RESOLVE_PENDING) {
+        resolveStats.timeouts++;
+    }
+    else if ((e->state == RESOLVE_FOUND)
+            && (dstlen > 0) && (strlen(e->name) < (size_t) dstlen)) {
+        strcpy(dst, e->name);
+        p = dst;
+    }
+    x_pthread_mutex_unlock(&resolveLock);
+    return(p);
+}
+
+
+void log_resolver_stats(void)
+{
+/*  Logs the counters of the resolver cache.
+ */
+    resolve_stats_t stats;
+    unsigned long n;
+    int numEntries;
+
+    x_pthread_mutex_lock(&resolveLock);
+    stats = resolveStats;
+    numEntries = numResolveEntries;
+    x_pthread_mutex_unlock(&resolveLock);
+
+    n = stats.hits + stats.misses;
+    log_msg(LOG_INFO, "Resolver cache has %d entr%s: "
+        "%lu hit%s (%lu negative), %lu miss%s (%.1f%% hit rate), "
+        "%lu timeout%s, %lu eviction%s",
+        numEntries, (numEntries == 1) ? "y" : "ies",
+        stats.hits, (stats.hits == 1) ? "" : "s", stats.negHits,
+        stats.misses, (stats.misses == 1) ? "" : "es",
+        (n > 0) ? (100.0 * stats.hits / n) : 0.0,
+        stats.timeouts, (stats.timeouts == 1) ? "" : "s",
+        stats.evictions, (stats.evictions == 1) ? "" : "s");
+    return;
+}
+
+
+static resolve_entry_t * get_resolve_entry(const struct in_addr *addr,
+    int doCount)
+{
+/*  Returns the cache entry for the address (addr), queueing a lookup if the
+ *    address is not cached or its cached result has expired.
+ *  If (doCount) is set, the lookup is counted as a cache hit or miss.
+ *  The caller must hold resolveLock.
+ */
+    resolve_entry_t *e;
+    unsigned h;
+    struct timeval tv;
+
+    h = (ntohl(addr->s_addr) * 2654435761U) & (RESOLVE_CACHE_SIZE - 1);
+    for (e = resolveCache[h]; e; e = e->hashNext) {
+        if (e->addr.s_addr == addr->s_addr) {
+            break;
+        }
+    }
+    if (e && ((e->state == RESOLVE_PENDING) || (e->expires > time(NULL)))) {
+        if (doCount) {
+            resolveStats.hits++;
+            if (e->state == RESOLVE_NOT_FOUND) {
+                resolveStats.negHits++;
+            }
+        }
+        return(e);
+    }
+    if (!e) {
+        if (numResolveEntries >= RESOLVE_CACHE_SIZE) {
+            evict_resolve_entry();
+        }
+        if (!(e = malloc(sizeof(resolve_entry_t)))) {
+            out_of_memory();
+        }
+        e->addr = *addr;
+        e->numWaiters = 0;
+        e->name = NULL;
+        e->hashNext = resolveCache[h];
+        resolveCache[h] = e;
+        numResolveEntries++;
+    }
+    else {
+        unlink_resolve_entry_age(e);
+    }
+    append_resolve_entry_age(e);
+
+    if (gettimeofday(&tv, NULL) < 0) {
+        log_err(errno, "Unable to get time of day");
+    }
+    e->state = RESOLVE_PENDING;
+    e->expires = 0;
+    e->deadline.tv_sec = tv.tv_sec + RESOLVE_TIMEOUT;
+    e->deadline.tv_nsec = tv.tv_usec * 1000;
+    queue_resolve_entry(e);
+    if (doCount) {
+        resolveStats.misses++;
+    }
+    return(e);
+}
+
+
+static void evict_resolve_entry(void)
+{
+/*  Evicts the least-recently queued entry that is neither awaiting a lookup
+ *    nor being waited upon.  If every entry is busy, none is evicted and the
+ *    cache temporarily exceeds RESOLVE_CACHE_SIZE.
+ *  The caller must hold resolveLock.
+ */
+    resolve_entry_t *e;
+    resolve_entry_t **pp;
+    unsigned h;
+
+    for (e = resolveOldest; e; e = e->ageNext) {
+        if ((e->state != RESOLVE_PENDING) && (e->numWaiters == 0)) {
+            break;
+        }
+    }
+    if (!e) {
+        return;
+    }
+    h = (ntohl(e->addr.s_addr) * 2654435761U) & (RESOLVE_CACHE_SIZE - 1);
+    for (pp = &resolveCache[h]; *pp != e; pp = &(*pp)->hashNext) {;}
+    *pp = e->hashNext;
+    unlink_resolve_entry_age(e);
+    destroy_string(e->name);
+    free(e);
+    numResolveEntries--;
+    resolveStats.evictions++;
+    return;
+}
+
+
+static void unlink_resolve_entry_age(resolve_entry_t *e)
+{
+/*  Unlinks the entry (e) from the age-ordered list of the cache.
+ */
+    if (e->agePrev) {
+        e->agePrev->ageNext = e->ageNext;
+    }
+    else {
+        resolveOldest = e->ageNext;
+    }
+    if (e->ageNext) {
+        e->ageNext->agePrev = e->agePrev;
+    }
+    else {
+        resolveNewest = e->agePrev;
+    }
+    return;
+}
+
+
+static void append_resolve_entry_age(resolve_entry_t *e)
+{
+/*  Appends the entry (e) as the newest in the age-ordered list of the cache.
+ */
+    e->ageNext = NULL;
+    e->agePrev = resolveNewest;
+    if (resolveNewest) {
+        resolveNewest->ageNext = e;
+    }
+    else {
+        resolveOldest = e;
+    }
+    resolveNewest = e;
+    return;
+}
+
+
+static void queue_resolve_entry(resolve_entry_t *e)
+{
+/*  Queues the entry (e) for a lookup by a resolver thread.
+ *  The caller must hold resolveLock.
+ */
+    int rc;
+
+    e->queueNext = NULL;
+    if (resolveQueueTail) {
+        resolveQueueTail->queueNext = e;
+    }
+    else {
+        resolveQueueHead = e;
+    }
+    resolveQueueTail = e;
+    if ((rc = pthread_cond_signal(&resolveQueueCond)) != 0) {
+        log_err(rc, "Unable to signal resolver queue condition");
+    }
+    return;
+}
+
+
+static void * resolver(void *arg)
+{
+/*  Performs the lookups queued in the cache until the resolver is stopped.
+ *  An entry is not evicted while its lookup is pending, so it can be
+ *    updated once getnameinfo() returns without the lock having been held.
+ */
+    resolve_entry_t *e;
+    struct sockaddr_in sin;
+    char host[NI_MAXHOST];
+    int rc;
+
+    for (;;) {
+        x_pthread_mutex_lock(&resolveLock);
+        while (!resolveDone && !resolveQueueHead) {
+            if ((rc = pthread_cond_wait(&resolveQueueCond, &resolveLock))
+                    != 0) {
+                log_err(rc, "Unable to wait on resolver queue condition");
+            }
+        }
+        if (resolveDone) {
+            x_pthread_mutex_unlock(&resolveLock);
+            break;
+        }
+        e = resolveQueueHead;
+        if (!(resolveQueueHead = e->queueNext)) {
+            resolveQueueTail = NULL;
+        }
+        memset(&sin, 0, sizeof(sin));
+        sin.sin_family = AF_INET;
+        sin.sin_addr = e->addr;
+        x_pthread_mutex_unlock(&resolveLock);
+
+        rc = getnameinfo((struct sockaddr *) &sin, sizeof(sin),
+            host, sizeof(host), NULL, 0, NI_NAMEREQD);
+
+        x_pthread_mutex_lock(&resolveLock);
+        if (rc == 0) {
+            e->state = RESOLVE_FOUND;
+            e->expires = time(NULL) + RESOLVE_POSITIVE_TTL;
+            replace_string(&e->name, host);
+        }
+        else {
+            DPRINTF((10, "Unable to resolve address: %s\n",
+                gai_strerror(rc)));
+            e->state = RESOLVE_NOT_FOUND;
+            e->expires = time(NULL) + RESOLVE_NEGATIVE_TTL;
+        }
+        if ((rc = pthread_cond_broadcast(&resolveDoneCond)) != 0) {
+            log_err(rc, "Unable to broadcast resolver done condition");
+        }
+        x_pthread_mutex_unlock(&resolveLock);
+    }
+    return(NULL);
+}
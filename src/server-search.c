@@ -0,0 +1,337 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+#include "list.h"
+#include "log.h"
+#include "server.h"
+#include "util-file.h"
+#include "util-str.h"
+#include "util.h"
+#include "wrapper.h"
+
+
+/*  The consoles are searched in parallel by up to LOG_SEARCH_THREADS threads
+ *    (including the client thread running the search), each taking the next
+ *    console yet to be searched.  Each line that matches is written to the
+ *    client as "[<console>] <time> <line>", where the time is that of the
+ *    logfile's sidecar index entry covering the line.  A thread buffers its
+ *    matches and writes them in whole lines while holding the search's lock,
+ *    so the lines of different consoles may be interleaved but not mixed.
+ */
+#define LOG_SEARCH_THREADS      8
+
+
+struct log_search {
+    char            *pattern;           /* pattern to search for             */
+    regex_t          rex;               /* compiled pattern if not literal   */
+    pthread_mutex_t  lock;              /* lock for iterator and socket      */
+    ListIterator     consoles;          /* consoles yet to be searched       */
+    int              sd;                /* socket to write matches to        */
+    time_t           since;             /* start of range to search, or 0    */
+    time_t           until;             /* end of range to search, or 0      */
+    int              numMatches;        /* num lines matched                 */
+    int              gotError;          /* true if unable to write to sd     */
+    unsigned         isLiteral:1;       /* true if pattern is literal text   */
+};
+
+typedef struct search_out {
+    char             buf[MAX_BUF_SIZE]; /* matches not yet written           */
+    int              len;               /* num bytes in buffer               */
+    int              numMatches;        /* num lines matched in buffer       */
+} search_out_t;
+
+
+static void * search_consoles(log_search_t *s);
+static void search_console(log_search_t *s, obj_t *console);
+static void match_line(log_search_t *s, obj_t *console, char *line,
+    time_t t, search_out_t *out);
+static void flush_matches(log_search_t *s, search_out_t *out);
+
+
+log_search_t * create_log_search(const char *pattern, int isLiteral,
+    char *errbuf, int errlen)
+{
+/*  Creates a search for lines containing the text (pattern) if (isLiteral)
+ *    is set, or o/w for lines matching the extended regex (pattern).
+ *  Returns the new search, or NULL if the regex is invalid
+ *    (in which case the error is written into (errbuf) of length (errlen)).
+ */
+    log_search_t *s;
+    int rc;
+
+    assert(pattern != NULL);
+    assert(errbuf != NULL);
+
+    if (!(s = malloc(sizeof(log_search_t)))) {
+        out_of_memory();
+    }
+    memset(s, 0, sizeof(log_search_t));
+    s->pattern = create_string(pattern);
+    s->isLiteral = !!isLiteral;
+    s->sd = -1;
+
+    if (!s->isLiteral) {
+        rc = regcomp(&s->rex, pattern, REG_EXTENDED | REG_NOSUB);
+        if (rc != 0) {
+            if (regerror(rc, &s->rex, errbuf, errlen) > (size_t) errlen) {
+                log_msg(LOG_WARNING, "Got regerror() buffer overrun");
+            }
+            regfree(&s->rex);
+            free(s->pattern);
+            free(s);
+            return(NULL);
+        }
+    }
+    x_pthread_mutex_init(&s->lock, NULL);
+    return(s);
+}
+
+
+void destroy_log_search(log_search_t *s)
+{
+/*  Destroys the search (s).
+ */
+    if (!s) {
+        return;
+    }
+    if (!s->isLiteral) {
+        regfree(&s->rex);
+    }
+    x_pthread_mutex_destroy(&s->lock);
+    free(s->pattern);
+    free(s);
+    return;
+}
+
+
+int run_log_search(log_search_t *s, List consoles, int sd,
+    time_t since, time_t until)
+{
+/*  Runs the search (s) across the list of console objs (consoles), writing
+ *    the matching lines logged between the times (since) and (until) to the
+ *    socket (sd); a time of 0 leaves that end of the range unbounded.
+ *  A console's logfiles are searched if it is being logged, or o/w its
+ *    scrollback history (which is not timestamped, so it is only searched
+ *    if no range is given).
+ *  This is invoked from a client thread, not from a reactor.
+ *  Returns the number of lines matched, or -1 if unable to write to the
+ *    socket.
+ */
+    pthread_t tids[LOG_SEARCH_THREADS - 1];
+    int n;
+    int i;
+    int rc;
+
+    assert(s != NULL);
+    assert(consoles != NULL);
+    assert(sd >= 0);
+
+    s->consoles = list_iterator_create(consoles);
+    s->sd = sd;
+    s->since = since;
+    s->until = until;
+    s->numMatches = 0;
+    s->gotError = 0;
+
+    n = MIN(list_count(consoles), LOG_SEARCH_THREADS) - 1;
+    for (i = 0; i < n; i++) {
+        if ((rc = pthread_create(&tids[i], NULL,
+          (PthreadFunc) search_consoles, s)) != 0) {
+            log_msg(LOG_WARNING, "Unable to create search thread: %s",
+                strerror(rc));
+            break;
+        }
+    }
+    n = i;
+    (void) search_consoles(s);
+
+    for (i = 0; i < n; i++) {
+        if ((rc = pthread_join(tids[i], NULL)) != 0) {
+            log_msg(LOG_WARNING, "Unable to join search thread: %s",
+                strerror(rc));
+        }
+    }
+    list_iterator_destroy(s->consoles);
+    s->consoles = NULL;
+    return(s->gotError ? -1 : s->numMatches);
+}
+
+
+static void * search_consoles(log_search_t *s)
+{
+/*  Searches the consoles of the search (s) until none remain.
+ */
+    obj_t *console;
+
+    for (;;) {
+        x_pthread_mutex_lock(&s->lock);
+        console = s->gotError ? NULL : list_next(s->consoles);
+        x_pthread_mutex_unlock(&s->lock);
+        if (!console) {
+            break;
+        }
+        search_console(s, console);
+    }
+    return(NULL);
+}
+
+
+static void search_console(log_search_t *s, obj_t *console)
+{
+/*  Searches the logfiles (or history) of the console obj for the search (s),
+ *    reading it a chunk at a time and matching each line as it completes.
+ *  Lines longer than MAX_LINE are truncated for matching and output.
+ */
+    obj_t *logfile;
+    log_reader_t *r;
+    search_out_t out;
+    unsigned char buf[OBJ_CHUNK_SIZE];
+    char line[MAX_LINE];
+    int lineLen = 0;
+    int gotLine = 0;
+    time_t t = 0;
+    unsigned char *p;
+    unsigned char *q;
+    int n;
+    int m;
+
+    assert(is_console_obj(console));
+
+    if ((logfile = get_console_logfile_obj(console))) {
+        r = create_log_time_reader(logfile, s->since, s->until);
+    }
+    else if (console->history && (s->since == 0) && (s->until == 0)) {
+        r = create_console_reader(console, 0, 0);
+    }
+    else {
+        return;
+    }
+    out.len = 0;
+    out.numMatches = 0;
+
+    while (!s->gotError && ((n = read_log_reader(r, buf, sizeof(buf))) > 0)) {
+        for (p = buf; p < buf + n; p = q + 1) {
+            if (!gotLine) {
+                t = get_log_reader_time(r);
+                gotLine = 1;
+            }
+            if (!(q = memchr(p, '\n', buf + n - p))) {
+                q = buf + n - 1;
+                m = n - (p - buf);
+            }
+            else {
+                m = q - p;
+            }
+            m = MIN(m, (int) sizeof(line) - 1 - lineLen);
+            memcpy(line + lineLen, p, m);
+            lineLen += m;
+            if (*q == '\n') {
+                line[lineLen] = '\0';
+                match_line(s, console, line, t, &out);
+                lineLen = 0;
+                gotLine = 0;
+            }
+        }
+    }
+    if (gotLine && (lineLen > 0)) {
+        line[lineLen] = '\0';
+        match_line(s, console, line, t, &out);
+    }
+    flush_matches(s, &out);
+    destroy_log_reader(r);
+    return;
+}
+
+
+static void match_line(log_search_t *s, obj_t *console, char *line,
+    time_t t, search_out_t *out)
+{
+/*  Matches the NUL-terminated (line) of the console obj logged at time (t)
+ *    against the search (s), appending it to the output buffer (out)
+ *    if it matches.  A trailing carriage-return is removed from the line.
+ */
+    char tbuf[MAX_LINE];
+    int n;
+    int len;
+
+    n = strlen(line);
+    if ((n > 0) && (line[n - 1] == '\r')) {
+        line[--n] = '\0';
+    }
+    if (s->isLiteral) {
+        if (!strstr(line, s->pattern)) {
+            return;
+        }
+    }
+    else if (regexec(&s->rex, line, 0, NULL, 0) != 0) {
+        return;
+    }
+    if ((t == 0) || (write_time_string(t, tbuf, sizeof(tbuf)) == 0)) {
+        tbuf[0] = '\0';
+    }
+    len = strlen(console->name) + strlen(tbuf) + n + 4;
+    if (out->len + len >= (int) sizeof(out->buf)) {
+        flush_matches(s, out);
+    }
+    n = snprintf(out->buf + out->len, sizeof(out->buf) - out->len,
+        "[%s] %s%s\n", console->name, tbuf, line);
+    if ((n < 0) || (n >= (int) sizeof(out->buf) - out->len)) {
+        log_msg(LOG_WARNING, "Search match for console [%s] exceeded buffer",
+            console->name);
+        return;
+    }
+    out->len += n;
+    out->numMatches++;
+    return;
+}
+
+
+static void flush_matches(log_search_t *s, search_out_t *out)
+{
+/*  Writes the matches in the output buffer (out) to the search's socket.
+ */
+    if (out->len == 0) {
+        return;
+    }
+    x_pthread_mutex_lock(&s->lock);
+    if (!s->gotError && (write_n(s->sd, out->buf, out->len) < 0)) {
+        s->gotError = 1;
+    }
+    s->numMatches += out->numMatches;
+    x_pthread_mutex_unlock(&s->lock);
+    out->len = 0;
+    out->numMatches = 0;
+    return;
+}
@@ -44,7 +44,6 @@
 #include "util-file.h"
 #include "util-str.h"
 
-extern tpoll_t tp_global;               /* defined in server.c */
 
 
 typedef struct bps_tag {
@@ -323,7 +322,6 @@ obj_t * create_serial_obj(server_conf_t *conf, char *name,
  *    Note: the console is open and set for non-blocking I/O.
  *  Returns the new object, or NULL on error.
  */
-    ListIterator i;
     obj_t *serial;
 
     assert(conf != NULL);
@@ -337,26 +335,19 @@ obj_t * create_serial_obj(server_conf_t *conf, char *name,
      *    objects within the same daemon process using the same device.
      *    So that check is performed here.
      */
-    i = list_iterator_create(conf->objs);
-    while ((serial = list_next(i))) {
-        if (is_console_obj(serial) && !strcmp(serial->name, name)) {
-            if ((errbuf != NULL) && (errlen > 0)) {
-                snprintf(errbuf, errlen,
-                    "console [%s] specifies duplicate console name", name);
-            }
-            break;
-        }
-        if (is_serial_obj(serial) && !strcmp(serial->aux.serial.dev, dev)) {
-            if ((errbuf != NULL) && (errlen > 0)) {
-                snprintf(errbuf, errlen,
-                    "console [%s] specifies duplicate device \"%s\"",
-                    name, dev);
-            }
-            break;
+    if (find_console_obj(conf, name)) {
+        if ((errbuf != NULL) && (errlen > 0)) {
+            snprintf(errbuf, errlen,
+                "console [%s] specifies duplicate console name", name);
         }
+        return(NULL);
     }
-    list_iterator_destroy(i);
-    if (serial != NULL) {
+    if (find_obj_index(&conf->deviceIndex, dev, CONMAN_OBJ_SERIAL)) {
+        if ((errbuf != NULL) && (errlen > 0)) {
+            snprintf(errbuf, errlen,
+                "console [%s] specifies duplicate device \"%s\"",
+                name, dev);
+        }
         return(NULL);
     }
     serial = create_obj(conf, name, -1, CONMAN_OBJ_SERIAL);
@@ -364,9 +355,12 @@ obj_t * create_serial_obj(server_conf_t *conf, char *name,
     serial->aux.serial.opts = *opts;
     serial->aux.serial.logfile = NULL;
     /*
-     *  Add obj to the master conf->objs list.
+     *  Add obj to the master conf->objs list
+     *    and index it by name and device.
      */
     list_append(conf->objs, serial);
+    insert_obj_index(&conf->consoleIndex, name, serial);
+    insert_obj_index(&conf->deviceIndex, serial->aux.serial.dev, serial);
 
     return(serial);
 }
@@ -390,12 +384,11 @@ int open_serial_obj(obj_t *serial)
         write_notify_msg(serial, LOG_INFO,
             "Console [%s] disconnected from \"%s\"",
             serial->name, serial->aux.serial.dev);
-        tpoll_clear(tp_global, serial->fd, POLLIN | POLLOUT);
-        set_tty_mode(&serial->aux.serial.tty, serial->fd);
-        if (close(serial->fd) < 0)      /* log err and continue */
+        fd = detach_obj_fd(serial);
+        set_tty_mode(&serial->aux.serial.tty, fd);
+        if (close(fd) < 0)              /* log err and continue */
             log_msg(LOG_WARNING, "Unable to close [%s] device \"%s\": %s",
                 serial->name, serial->aux.serial.dev, strerror(errno));
-        serial->fd = -1;
     }
     flags = O_RDWR | O_NONBLOCK | O_NOCTTY;
     if ((fd = open(serial->aux.serial.dev, flags)) < 0) {
@@ -435,9 +428,9 @@ int open_serial_obj(obj_t *serial)
     get_tty_raw(&tty, fd);
     set_serial_opts(&tty, serial, &serial->aux.serial.opts);
     set_tty_mode(&tty, fd);
-    serial->fd = fd;
+    set_obj_fd(serial, fd);
     serial->gotEOF = 0;
-    tpoll_set(tp_global, serial->fd, POLLIN);
+    tpoll_set(serial->tp, serial->fd, POLLIN);
     /*
      *  Success!
      */
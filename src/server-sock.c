@@ -38,6 +38,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 #include "common.h"
@@ -47,6 +48,7 @@
 #include "util-file.h"
 #include "util-net.h"
 #include "util-str.h"
+#include "util.h"
 #include "wrapper.h"
 
 
@@ -66,61 +68,800 @@ int deny_severity = LOG_WARNING;        /* logging level for rejected reqs */
 #endif /* WITH_TCP_WRAPPERS */
 
 
-static int resolve_addr(server_conf_t *conf, req_t *req, int sd);
-static int recv_greeting(req_t *req);
+/*  A client connection is driven through its handshake in two stages:
+ *    the greeting and the request.  The line for each stage is read by the
+ *    main thread from the non-blocking socket as it becomes readable, so an
+ *    idle or slow client holds neither a thread nor the event loop.  Once a
+ *    complete line has been read, the handshake is queued to a fixed pool of
+ *    worker threads that performs the (potentially blocking) work for that
+ *    stage: resolving the peer address and composing the response to the
+ *    greeting, or resolving the request's consoles and composing the response
+ *    to its command.  The response is then passed back to the main thread,
+ *    which writes it to the socket as it becomes writable before moving on
+ *    to the next stage (or creating the client obj for the session).
+ *  A handshake not completed within CLIENT_HANDSHAKE_TIMEOUT seconds (either
+ *    awaiting a line or writing a response) is dropped.  The QUERY log/tail
+ *    and SEARCH commands stream an unbounded amount of data to the client,
+ *    so they are performed by a thread of their own rather than tying up
+ *    a worker; at most CLIENT_STREAM_THREADS of these run at once.
+ */
+typedef enum handshake_state {
+    CONMAN_HS_GREETING,                 /* awaiting greeting line            */
+    CONMAN_HS_REQUEST                   /* awaiting request line             */
+} handshake_state_t;
+
+typedef struct handshake {              /* CLIENT HANDSHAKE IN PROGRESS:     */
+    server_conf_t   *conf;              /*  server's configuration           */
+    req_t           *req;               /*  request being received           */
+    char            *buf;               /*  line being read from socket      */
+    int              len;               /*  num bytes of line read so far    */
+    int              size;              /*  num bytes allocated for buf      */
+    char            *rsp;               /*  response being written to socket */
+    int              rspLen;            /*  num bytes of response, or 0      */
+    int              rspSize;           /*  num bytes allocated for rsp      */
+    int              rspDone;           /*  num bytes of response written    */
+    int              timer;             /*  timer id for timeout, or -1      */
+    handshake_state_t state;            /*  stage of handshake               */
+    unsigned         gotError:1;        /*  true if conn closed after rsp    */
+} handshake_t;
+
+#define HANDSHAKE_BUF_MIN_SIZE          256
+
+
+static handshake_t * create_handshake(server_conf_t *conf, int sd);
+static void destroy_handshake(handshake_t *hs);
+static void wait_handshake(handshake_t *hs, short int events);
+static void unwait_handshake(handshake_t *hs);
+static void resume_handshake(handshake_t *hs);
+static void reply_handshake(handshake_t *hs);
+static void finish_handshake(handshake_t *hs);
+static void expire_handshake(handshake_t *hs);
+static int read_handshake_line(handshake_t *hs);
+static int write_handshake_rsp(handshake_t *hs);
+static void * client_worker(server_conf_t *conf);
+static void process_handshake(handshake_t *hs);
+static int process_req(handshake_t *hs);
+static int start_stream_cmd(handshake_t *hs);
+static void * perform_stream_cmd(handshake_t *hs);
+static int get_peer_addr(req_t *req);
+static int resolve_addr(server_conf_t *conf, req_t *req);
+static int recv_greeting(handshake_t *hs);
 static void parse_greeting(Lex l, req_t *req);
-static int recv_req(req_t *req);
+static int recv_req(req_t *req, char *buf);
 static void parse_cmd_opts(Lex l, req_t *req);
-static int query_consoles(server_conf_t *conf, req_t *req);
+static int query_consoles(server_conf_t *conf, req_t *req,
+    char *errbuf, int errlen);
 static int query_consoles_via_globbing(
     server_conf_t *conf, req_t *req, List matches);
 static int query_consoles_via_regex(
-    server_conf_t *conf, req_t *req, List matches);
-static int validate_req(req_t *req);
-static int check_too_many_consoles(req_t *req);
-static int check_busy_consoles(req_t *req);
-static int send_rsp(req_t *req, int errnum, char *errmsg);
-static int perform_query_cmd(req_t *req);
-static int perform_monitor_cmd(req_t *req, server_conf_t *conf);
-static int perform_connect_cmd(req_t *req, server_conf_t *conf);
+    server_conf_t *conf, req_t *req, List matches, char *errbuf, int errlen);
+static int validate_req(handshake_t *hs);
+static int check_too_many_consoles(handshake_t *hs);
+static int check_busy_consoles(handshake_t *hs);
+static int send_rsp(handshake_t *hs, int errnum, char *errmsg);
+static void append_rsp(handshake_t *hs, const char *src, int len);
+static int flush_rsp(handshake_t *hs);
+static int format_err_rsp(char *buf, int buflen, int errnum, char *errmsg);
+static int perform_query_cmd(handshake_t *hs, server_conf_t *conf);
+static int perform_query_log_cmd(handshake_t *hs);
+static int perform_query_tail_cmd(handshake_t *hs);
+static int perform_search_cmd(handshake_t *hs);
+static void perform_monitor_cmd(req_t *req, server_conf_t *conf);
+static void perform_connect_cmd(req_t *req, server_conf_t *conf);
 static void check_console_state(obj_t *console, obj_t *client);
 
 
-void process_client(client_arg_t *args)
+/*  Handshakes awaiting a line from the client or writing a response to it,
+ *    indexed by socket descriptor.
+ *  This table is only accessed by the main thread.
+ */
+static handshake_t **handshakes = NULL;
+static int numHandshakes = 0;
+
+/*  Queue of handshakes with a complete line awaiting a worker thread.
+ */
+static List hsQueue = NULL;
+static pthread_mutex_t hsQueueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t hsQueueCond = PTHREAD_COND_INITIALIZER;
+static int hsQueueDone = 0;
+
+/*  Number of threads performing QUERY log/tail or SEARCH cmds.
+ *  This count is protected by hsQueueLock.
+ */
+static int numStreams = 0;
+
+
+void start_client_workers(server_conf_t *conf)
 {
-/*  The thread responsible for accepting a client connection
- *    and processing the request.
- *  The QUERY cmd is processed entirely by this thread.
- *  The MONITOR and CONNECT cmds are setup and then placed
- *    in the conf->objs list to be handled by mux_io().
+/*  Starts the pool of worker threads processing client handshakes.
+ *  The workers are detached since one may be blocked on a client
+ *    when the daemon exits.
  */
-    int sd;
-    server_conf_t *conf;
+    pthread_t tid;
+    int k;
+    int rc;
+
+    assert(hsQueue == NULL);
+
+    hsQueue = list_create(NULL);
+    for (k = 0; k < CLIENT_WORKER_THREADS; k++) {
+        if ((rc = pthread_create(&tid, NULL,
+                (PthreadFunc) client_worker, conf)) != 0) {
+            log_err(rc, "Unable to create client worker thread");
+        }
+        x_pthread_detach(tid);
+    }
+    return;
+}
+
+
+void stop_client_workers(server_conf_t *conf)
+{
+/*  Signals the worker threads to exit once they finish their current
+ *    handshake, and drops the handshakes still in progress.
+ */
+    int rc;
+    int fd;
+    handshake_t *hs;
+
+    x_pthread_mutex_lock(&hsQueueLock);
+    hsQueueDone = 1;
+    if ((rc = pthread_cond_broadcast(&hsQueueCond)) != 0) {
+        log_err(rc, "Unable to broadcast client queue condition");
+    }
+    x_pthread_mutex_unlock(&hsQueueLock);
+
+    for (fd = 0; fd < numHandshakes; fd++) {
+        if ((hs = handshakes[fd])) {
+            unwait_handshake(hs);
+            destroy_handshake(hs);
+        }
+    }
+    free(handshakes);
+    handshakes = NULL;
+    numHandshakes = 0;
+    return;
+}
+
+
+void start_client_handshake(server_conf_t *conf, int sd)
+{
+/*  Starts the handshake for the newly-accepted client socket (sd),
+ *    which must be non-blocking.
+ *  This must be called by the main thread.
+ */
+    handshake_t *hs;
+
+    assert(sd >= 0);
+
+    if (!(hs = create_handshake(conf, sd))) {
+        return;
+    }
+    resume_handshake(hs);
+    return;
+}
+
+
+void create_query_rsp(server_conf_t *conf)
+{
+/*  Creates the cached response to a QUERY of every console, as would
+ *    otherwise be serialized by send_rsp() for each such request.
+ *  The console set only changes when the configuration is read,
+ *    at which point this response is recreated.
+ */
+    char tmp[MAX_LINE];                 /* tmp buffer for lex-encoding strs */
+    const char *tok;
+    size_t size;
+    int len;
+    int k;
+
+    assert(conf != NULL);
+    assert(conf->queryRsp == NULL);
+
+    if (conf->numConsoles == 0) {
+        return;
+    }
+    tok = LEX_TOK2STR(proto_strs, CONMAN_TOK_CONSOLE);
+    size = MAX_LINE;
+    for (k = 0; k < conf->numConsoles; k++) {
+        size += strlen(tok) + strlen(conf->consoleTable[k]->name) + 4;
+    }
+    if (!(conf->queryRsp = malloc(size))) {
+        out_of_memory();
+    }
+    len = snprintf(conf->queryRsp, size, "%s",
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_OK));
+    if (conf->resetCmd) {
+        len += snprintf(conf->queryRsp + len, size - len, " %s=%s",
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_OPTION),
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_RESET));
+    }
+    for (k = 0; k < conf->numConsoles; k++) {
+        if (strlcpy(tmp, conf->consoleTable[k]->name, sizeof(tmp))
+                >= sizeof(tmp)) {
+            log_msg(LOG_WARNING, "Unable to cache query response: "
+                "console name [%s] exceeds %d bytes",
+                conf->consoleTable[k]->name, MAX_LINE - 1);
+            destroy_query_rsp(conf);
+            return;
+        }
+        len += snprintf(conf->queryRsp + len, size - len, " %s='%s'",
+            tok, lex_encode(tmp));
+    }
+    len += snprintf(conf->queryRsp + len, size - len, "\n");
+    conf->queryRspLen = len;
+    return;
+}
+
+
+void destroy_query_rsp(server_conf_t *conf)
+{
+/*  Destroys the cached response to a QUERY of every console.
+ */
+    assert(conf != NULL);
+
+    free(conf->queryRsp);
+    conf->queryRsp = NULL;
+    conf->queryRspLen = 0;
+    return;
+}
+
+
+int open_mux_channels(obj_t *conn, server_conf_t *conf, char *buf)
+{
+/*  Opens a channel over the multiplexed connection (conn) for each console
+ *    matching the request line (buf) received in an OPEN frame.
+ *  The request is a MONITOR or CONNECT, whose consoles become R/O or R/W
+ *    channels respectively.  Since each channel is its own session, a CONNECT
+ *    may match any number of consoles without the broadcast option; but as
+ *    with a v1 request, it fails if any are busy (unless forced or joined).
+ *  An OPEN frame is sent for each channel opened (skipping consoles already
+ *    open on the connection), followed by a RSP frame with the response line.
+ *  This is invoked by the main thread as the connection's frames are read.
+ *  Returns 0 on success, or -1 if the connection is to be shut down.
+ */
+    req_t *creq = conn->aux.client.req;
     req_t *req;
+    ListIterator i;
+    obj_t *console;
+    obj_t *chan;
+    int isWrite;
+    int errnum = CONMAN_ERR_NONE;
+    char errbuf[MAX_LINE];
+    char rsp[MAX_LINE];
+    int len;
+    int n = 0;
+    int rc = 0;
 
-    /*  Free the tmp struct that was created by accept_client()
-     *    in order to pass multiple args to this thread.
+    req = create_req();
+    (void) recv_req(req, buf);
+    isWrite = (req->command == CONMAN_CMD_CONNECT);
+
+    if ((req->command != CONMAN_CMD_MONITOR) && !isWrite) {
+        errnum = CONMAN_ERR_BAD_REQUEST;
+        strlcpy(errbuf, "Invalid request for multiplexed connection",
+            sizeof(errbuf));
+    }
+    else if (query_consoles(conf, req, errbuf, sizeof(errbuf)) < 0) {
+        errnum = CONMAN_ERR_BAD_REGEX;
+    }
+    else if (list_is_empty(req->consoles)) {
+        errnum = CONMAN_ERR_NO_CONSOLES;
+        strlcpy(errbuf, "Found no matching consoles", sizeof(errbuf));
+    }
+    else if (isWrite && !req->enableForce && !req->enableJoin) {
+        i = list_iterator_create(req->consoles);
+        while ((console = list_next(i))) {
+            if (!list_is_empty(console->writers)
+              && !is_mux_channel_open(conn, console)) {
+                n++;
+            }
+        }
+        list_iterator_destroy(i);
+        if (n > 0) {
+            errnum = CONMAN_ERR_BUSY_CONSOLES;
+            if (n == 1) {
+                snprintf(errbuf, sizeof(errbuf),
+                    "Found console already in use");
+            }
+            else {
+                snprintf(errbuf, sizeof(errbuf),
+                    "Found %d consoles already in use", n);
+            }
+        }
+    }
+    if (errnum != CONMAN_ERR_NONE) {
+        if ((len = format_err_rsp(rsp, sizeof(rsp), errnum, errbuf)) >= 0) {
+            rc = write_mux_frame(conn, CONMAN_FRAME_RSP, 0, 0, rsp, len);
+        }
+        log_msg(LOG_NOTICE, "Client <%s@%s:%d> request failed: %s",
+            creq->user, creq->fqdn, creq->port, errbuf);
+        destroy_req(req);
+        return(rc);
+    }
+
+    n = 0;
+    i = list_iterator_create(req->consoles);
+    while ((console = list_next(i)) && (rc == 0)) {
+        assert(is_console_obj(console));
+        if (is_mux_channel_open(conn, console)) {
+            continue;
+        }
+        chan = create_mux_channel(conn, console, req);
+        if (isWrite) {
+            link_objs(chan, console);
+        }
+        link_objs(console, chan);
+        check_console_state(console, chan);
+        if ((req->replayLines > 0) || (req->timeSince > 0)) {
+            (void) start_log_replay(chan, console,
+                req->replayLines, req->timeSince);
+        }
+        rc = write_mux_frame(conn, CONMAN_FRAME_OPEN,
+            (isWrite ? CONMAN_FRAME_FLAG_WRITE : 0), console->id,
+            console->name, strlen(console->name));
+        n++;
+    }
+    list_iterator_destroy(i);
+
+    if (rc == 0) {
+        len = snprintf(rsp, sizeof(rsp), "%s",
+            LEX_TOK2STR(proto_strs, CONMAN_TOK_OK));
+        if (conf->resetCmd) {
+            len += snprintf(rsp + len, sizeof(rsp) - len, " %s=%s",
+                LEX_TOK2STR(proto_strs, CONMAN_TOK_OPTION),
+                LEX_TOK2STR(proto_strs, CONMAN_TOK_RESET));
+        }
+        len += snprintf(rsp + len, sizeof(rsp) - len, "\n");
+        rc = write_mux_frame(conn, CONMAN_FRAME_RSP, 0, 0, rsp, len);
+    }
+    log_msg(LOG_INFO, "Client <%s@%s:%d> opened %d channel%s (%s)",
+        creq->user, creq->fqdn, creq->port, n, (n == 1 ? "" : "s"),
+        (isWrite ? "read-write" : "read-only"));
+
+    destroy_req(req);
+    return(rc);
+}
+
+
+int dispatch_client_handshake(server_conf_t *conf, int fd)
+{
+/*  Performs I/O on the client socket (fd) if it belongs to a handshake
+ *    awaiting a line or writing a response.  Once the line is complete,
+ *    the handshake is queued for a worker; once the response has been
+ *    written, the handshake moves on to its next stage.
+ *  Returns 1 if (fd) belongs to a handshake, or 0 if not.
+ *  This must be called by the main thread.
+ */
+    handshake_t *hs;
+    int rc;
+
+    if ((fd < 0) || (fd >= numHandshakes) || !(hs = handshakes[fd])) {
+        return(0);
+    }
+    if (hs->rspLen > 0) {
+        if (tpoll_is_set(conf->tp, fd, POLLOUT | POLLHUP | POLLERR) <= 0) {
+            return(1);
+        }
+        if ((rc = write_handshake_rsp(hs)) < 0) {
+            unwait_handshake(hs);
+            destroy_handshake(hs);
+        }
+        else if (rc > 0) {
+            unwait_handshake(hs);
+            finish_handshake(hs);
+        }
+        return(1);
+    }
+    if (tpoll_is_set(conf->tp, fd, POLLIN | POLLHUP | POLLERR) <= 0) {
+        return(1);
+    }
+    if ((rc = read_handshake_line(hs)) < 0) {
+        unwait_handshake(hs);
+        destroy_handshake(hs);
+        return(1);
+    }
+    if (rc == 0) {
+        return(1);
+    }
+    /*  The line is complete, so hand the handshake over to a worker.
      */
-    assert(args != NULL);
-    sd = args->sd;
-    conf = args->conf;
-    free(args);
+    unwait_handshake(hs);
+    x_pthread_mutex_lock(&hsQueueLock);
+    list_enqueue(hsQueue, hs);
+    if ((rc = pthread_cond_signal(&hsQueueCond)) != 0) {
+        log_err(rc, "Unable to signal client queue condition");
+    }
+    x_pthread_mutex_unlock(&hsQueueLock);
+    return(1);
+}
 
-    DPRINTF((5, "Processing new client.\n"));
 
-    x_pthread_detach(pthread_self());
+static handshake_t * create_handshake(server_conf_t *conf, int sd)
+{
+/*  Creates a handshake for the client socket (sd).
+ *  Returns the new handshake, or NULL on error (in which case
+ *    the socket is closed).
+ */
+    handshake_t *hs;
+    req_t *req;
 
     req = create_req();
+    req->sd = sd;
+    if (get_peer_addr(req) < 0) {
+        destroy_req(req);
+        return(NULL);
+    }
+    if (!(hs = malloc(sizeof(handshake_t)))) {
+        out_of_memory();
+    }
+    hs->conf = conf;
+    hs->req = req;
+    hs->buf = NULL;
+    hs->len = 0;
+    hs->size = 0;
+    hs->rsp = NULL;
+    hs->rspLen = 0;
+    hs->rspSize = 0;
+    hs->rspDone = 0;
+    hs->timer = -1;
+    hs->state = CONMAN_HS_GREETING;
+    hs->gotError = 0;
+    return(hs);
+}
 
-    if (resolve_addr(conf, req, sd) < 0)
-        goto err;
-    if (recv_greeting(req) < 0)
-        goto err;
-    if (recv_req(req) < 0)
-        goto err;
-    if (query_consoles(conf, req) < 0)
+
+static void destroy_handshake(handshake_t *hs)
+{
+/*  Destroys the handshake (hs), closing its client socket unless its
+ *    request has been handed over to a client obj (leaving req NULL).
+ *  A handshake awaiting I/O must first be removed via unwait_handshake().
+ */
+    assert(hs != NULL);
+    assert(hs->timer < 0);
+
+    if (hs->req) {
+        destroy_req(hs->req);
+    }
+    free(hs->buf);
+    free(hs->rsp);
+    free(hs);
+    return;
+}
+
+
+static void wait_handshake(handshake_t *hs, short int events)
+{
+/*  Waits for the handshake's socket to become ready for (events),
+ *    dropping the handshake if it is not completed within
+ *    CLIENT_HANDSHAKE_TIMEOUT seconds.
+ *  This must be called by the main thread.
+ */
+    server_conf_t *conf = hs->conf;
+    int sd = hs->req->sd;
+    int n;
+
+    if (sd >= numHandshakes) {
+        n = (numHandshakes > 0) ? numHandshakes : 64;
+        while (n <= sd) {
+            n *= 2;
+        }
+        if (!(handshakes = realloc(handshakes, n * sizeof(handshake_t *)))) {
+            out_of_memory();
+        }
+        memset(handshakes + numHandshakes, 0,
+            (n - numHandshakes) * sizeof(handshake_t *));
+        numHandshakes = n;
+    }
+    assert(handshakes[sd] == NULL);
+    handshakes[sd] = hs;
+    hs->timer = tpoll_timeout_relative(conf->tp,
+        (callback_f) expire_handshake, hs, CLIENT_HANDSHAKE_TIMEOUT * 1000);
+    if (hs->timer < 0) {
+        log_msg(LOG_WARNING, "Unable to create timer for client <%s:%d>",
+            hs->req->fqdn, hs->req->port);
+    }
+    tpoll_set(conf->tp, sd, events);
+    return;
+}
+
+
+static void unwait_handshake(handshake_t *hs)
+{
+/*  Stops waiting for I/O on the handshake's socket, and cancels its timeout.
+ *  This must be called by the main thread.
+ */
+    int sd = hs->req->sd;
+
+    if ((sd >= 0) && (sd < numHandshakes) && (handshakes[sd] == hs)) {
+        handshakes[sd] = NULL;
+        tpoll_clear(hs->conf->tp, sd, POLLIN | POLLOUT);
+    }
+    if (hs->timer >= 0) {
+        (void) tpoll_timeout_cancel(hs->conf->tp, hs->timer);
+        hs->timer = -1;
+    }
+    return;
+}
+
+
+static void resume_handshake(handshake_t *hs)
+{
+/*  Waits for the next line of the handshake (hs) to be read from its socket.
+ *  This is invoked by the main thread, either when the client is accepted or
+ *    once the response to the greeting has been written.
+ */
+    hs->len = 0;
+    wait_handshake(hs, POLLIN);
+    return;
+}
+
+
+static void reply_handshake(handshake_t *hs)
+{
+/*  Writes the response composed by a worker for the handshake (hs).
+ *  The response is usually written at once; o/w, the rest is written
+ *    by dispatch_client_handshake() as the socket becomes writable.
+ *  This is invoked by the main thread via a zero-delay timer posted by
+ *    the worker that processed the handshake.
+ */
+    int rc;
+
+    if ((rc = write_handshake_rsp(hs)) < 0) {
+        destroy_handshake(hs);
+    }
+    else if (rc == 0) {
+        wait_handshake(hs, POLLOUT);
+    }
+    else {
+        finish_handshake(hs);
+    }
+    return;
+}
+
+
+static void finish_handshake(handshake_t *hs)
+{
+/*  Moves the handshake (hs) on to its next stage once its response
+ *    has been written.
+ *  Once the greeting has been answered, the handshake awaits the request;
+ *    a client negotiating the multiplexed protocol sends no request,
+ *    so its client obj is created instead and it opens channels via frames.
+ *  Once the request has been answered, the client obj is created for a
+ *    MONITOR or CONNECT; a QUERY is finished, as is a failed request.
+ *  This must be called by the main thread.
+ */
+    server_conf_t *conf = hs->conf;
+    req_t *req = hs->req;
+
+    if (hs->gotError) {
+        destroy_handshake(hs);
+        return;
+    }
+    if (hs->state == CONMAN_HS_GREETING) {
+        if (req->protocol < CONMAN_PROTOCOL_MUX) {
+            hs->state = CONMAN_HS_REQUEST;
+            resume_handshake(hs);
+            return;
+        }
+        (void) create_client_obj(conf, req);
+        log_msg(LOG_INFO, "Client <%s@%s:%d> connected (multiplexed)",
+            req->user, req->fqdn, req->port);
+        hs->req = NULL;
+    }
+    else if (req->command == CONMAN_CMD_MONITOR) {
+        perform_monitor_cmd(req, conf);
+        hs->req = NULL;
+    }
+    else if (req->command == CONMAN_CMD_CONNECT) {
+        perform_connect_cmd(req, conf);
+        hs->req = NULL;
+    }
+    destroy_handshake(hs);
+    return;
+}
+
+
+static void expire_handshake(handshake_t *hs)
+{
+/*  Drops the handshake (hs) after it has timed out awaiting a line
+ *    or writing a response.
+ */
+    hs->timer = -1;
+    if (hs->rspLen > 0) {
+        log_msg(LOG_NOTICE, "Timed out writing response to <%s:%d>",
+            hs->req->fqdn, hs->req->port);
+    }
+    else {
+        log_msg(LOG_NOTICE, "Timed out awaiting %s from <%s:%d>",
+            (hs->state == CONMAN_HS_GREETING) ? "greeting" : "request",
+            hs->req->fqdn, hs->req->port);
+    }
+    unwait_handshake(hs);
+    destroy_handshake(hs);
+    return;
+}
+
+
+static int read_handshake_line(handshake_t *hs)
+{
+/*  Reads what is available of the handshake's line from its socket.
+ *  The data is first peeked at so that nothing past the newline is consumed,
+ *    since the client may send its terminal input right behind a request.
+ *  Returns 1 if the line is complete, 0 if more data is needed,
+ *    or -1 on error or EOF.
+ */
+    int sd = hs->req->sd;
+    int n;
+    char *p;
+
+    if (hs->size - hs->len < HANDSHAKE_BUF_MIN_SIZE / 2) {
+        n = (hs->size > 0) ? hs->size * 2 : HANDSHAKE_BUF_MIN_SIZE;
+        if (n > MAX_SOCK_LINE) {
+            n = MAX_SOCK_LINE;
+        }
+        if (!(hs->buf = realloc(hs->buf, n))) {
+            out_of_memory();
+        }
+        hs->size = n;
+    }
+    while ((n = recv(sd, hs->buf + hs->len,
+            hs->size - hs->len - 1, MSG_PEEK)) < 0) {
+        if (errno == EINTR) {
+            continue;
+        }
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            return(0);
+        }
+        log_msg(LOG_NOTICE, "Unable to read %s from <%s:%d>: %s",
+            (hs->state == CONMAN_HS_GREETING) ? "greeting" : "request",
+            hs->req->fqdn, hs->req->port, strerror(errno));
+        return(-1);
+    }
+    if (n == 0) {
+        log_msg(LOG_NOTICE, "Connection terminated by <%s:%d>",
+            hs->req->fqdn, hs->req->port);
+        return(-1);
+    }
+    if ((p = memchr(hs->buf + hs->len, '\n', n))) {
+        n = p - (hs->buf + hs->len) + 1;
+    }
+    if ((n = read(sd, hs->buf + hs->len, n)) <= 0) {
+        log_msg(LOG_NOTICE, "Unable to read %s from <%s:%d>: %s",
+            (hs->state == CONMAN_HS_GREETING) ? "greeting" : "request",
+            hs->req->fqdn, hs->req->port,
+            (n < 0) ? strerror(errno) : "unexpected EOF");
+        return(-1);
+    }
+    hs->len += n;
+    hs->buf[hs->len] = '\0';
+
+    /*  As with read_line(), an overlong line is truncated.
+     */
+    if (p || (hs->len >= MAX_SOCK_LINE - 1)) {
+        return(1);
+    }
+    return(0);
+}
+
+
+static int write_handshake_rsp(handshake_t *hs)
+{
+/*  Writes what the socket will accept of the handshake's response.
+ *  Returns 1 if the response has been written, 0 if more remains,
+ *    or -1 on error.
+ */
+    int sd = hs->req->sd;
+    int n;
+
+    while (hs->rspDone < hs->rspLen) {
+        n = write(sd, hs->rsp + hs->rspDone, hs->rspLen - hs->rspDone);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return(0);
+            }
+            log_msg(LOG_NOTICE, "Unable to write to <%s:%d>: %s",
+                hs->req->fqdn, hs->req->port, strerror(errno));
+            return(-1);
+        }
+        hs->rspDone += n;
+    }
+    hs->rspLen = 0;
+    hs->rspDone = 0;
+    return(1);
+}
+
+
+static void * client_worker(server_conf_t *conf)
+{
+/*  The worker thread processing the handshakes queued by the main thread.
+ */
+    handshake_t *hs;
+    int rc;
+
+    for (;;) {
+        x_pthread_mutex_lock(&hsQueueLock);
+        while (!hsQueueDone && list_is_empty(hsQueue)) {
+            if ((rc = pthread_cond_wait(&hsQueueCond, &hsQueueLock)) != 0) {
+                log_err(rc, "Unable to wait on client queue condition");
+            }
+        }
+        hs = hsQueueDone ? NULL : list_dequeue(hsQueue);
+        x_pthread_mutex_unlock(&hsQueueLock);
+        if (!hs) {
+            break;
+        }
+        process_handshake(hs);
+    }
+    return(NULL);
+}
+
+
+static void process_handshake(handshake_t *hs)
+{
+/*  Processes the line just read for the handshake (hs), composing the
+ *    response that is passed back to the main thread to be written.
+ *  The handshake of a QUERY log/tail or SEARCH request is instead handed
+ *    off to a thread of its own.
+ */
+    server_conf_t *conf = hs->conf;
+    req_t *req = hs->req;
+
+    if (hs->state == CONMAN_HS_GREETING) {
+        DPRINTF((5, "Processing new client.\n"));
+        if ((resolve_addr(conf, req) < 0) || (recv_greeting(hs) < 0)) {
+            hs->gotError = 1;
+        }
+    }
+    else if (recv_req(req, hs->buf) < 0) {
+        hs->gotError = 1;
+    }
+    else if (process_req(hs) > 0) {
+        return;
+    }
+    if (tpoll_timeout_relative(conf->tp,
+            (callback_f) reply_handshake, hs, 0) < 0) {
+        log_msg(LOG_WARNING, "Unable to create timer for client <%s:%d>",
+            req->fqdn, req->port);
+        destroy_handshake(hs);
+    }
+    return;
+}
+
+
+static int process_req(handshake_t *hs)
+{
+/*  Processes the client's request, composing the response in (hs).
+ *  The QUERY (w/o log/tail) cmd is answered entirely by its response.
+ *    The client objs for the MONITOR and CONNECT cmds are created by the
+ *    main thread once the response has been written (in finish_handshake()).
+ *  The QUERY log/tail and SEARCH cmds are handed off to their own thread.
+ *  Returns 1 if the handshake has been handed off, or 0 if its response
+ *    is to be written by the main thread.
+ */
+    server_conf_t *conf = hs->conf;
+    req_t *req = hs->req;
+    char buf[MAX_LINE];
+
+    /*  A QUERY of every console is answered from the cached response
+     *    without matching the consoles.
+     */
+    if ((req->command == CONMAN_CMD_QUERY) && list_is_empty(req->consoles)
+      && (conf->queryRsp != NULL)
+      && (req->tailLines <= 0)
+      && (req->timeSince == 0) && (req->timeUntil == 0)) {
+        if (perform_query_cmd(hs, conf) < 0)
+            goto err;
+        return(0);
+    }
+    if (query_consoles(conf, req, buf, sizeof(buf)) < 0) {
+        send_rsp(hs, CONMAN_ERR_BAD_REGEX, buf);
         goto err;
-    if (validate_req(req) < 0)
+    }
+    if (validate_req(hs) < 0)
         goto err;
 
     /*  send_rsp() needs to know if the reset command is supported.
@@ -132,67 +873,165 @@ void process_client(client_arg_t *args)
 
     switch(req->command) {
     case CONMAN_CMD_CONNECT:
-        if (perform_connect_cmd(req, conf) < 0)
-            goto err;
-        break;
     case CONMAN_CMD_MONITOR:
-        if (perform_monitor_cmd(req, conf) < 0)
+        if (send_rsp(hs, CONMAN_ERR_NONE, NULL) < 0)
             goto err;
         break;
     case CONMAN_CMD_QUERY:
-        if (perform_query_cmd(req) < 0)
+        if ((req->tailLines <= 0)
+          && (req->timeSince == 0) && (req->timeUntil == 0)) {
+            if (perform_query_cmd(hs, conf) < 0)
+                goto err;
+            break;
+        }
+        /* fall-through */
+    case CONMAN_CMD_SEARCH:
+        if (start_stream_cmd(hs) < 0)
             goto err;
-        break;
+        return(1);
     default:
         log_msg(LOG_WARNING, "Received invalid command=%d from <%s@%s:%d>",
             req->command, req->user, req->fqdn, req->port);
         goto err;
     }
-    return;
+    return(0);
+
+err:
+    hs->gotError = 1;
+    return(0);
+}
+
+
+static int start_stream_cmd(handshake_t *hs)
+{
+/*  Starts the thread performing the QUERY log/tail or SEARCH cmd of the
+ *    handshake (hs), unless CLIENT_STREAM_THREADS are already running.
+ *  Returns 0 if the thread has been started, or -1 on error.
+ */
+    req_t *req = hs->req;
+    pthread_t tid;
+    int isBusy;
+    int rc;
+
+    x_pthread_mutex_lock(&hsQueueLock);
+    isBusy = (numStreams >= CLIENT_STREAM_THREADS);
+    if (!isBusy) {
+        numStreams++;
+    }
+    x_pthread_mutex_unlock(&hsQueueLock);
+
+    if (isBusy) {
+        send_rsp(hs, CONMAN_ERR_BAD_REQUEST,
+            "Too many log queries in progress; try again later");
+        return(-1);
+    }
+    if ((rc = pthread_create(&tid, NULL,
+            (PthreadFunc) perform_stream_cmd, hs)) != 0) {
+        log_msg(LOG_WARNING, "Unable to create thread for <%s:%d>: %s",
+            req->fqdn, req->port, strerror(rc));
+        x_pthread_mutex_lock(&hsQueueLock);
+        numStreams--;
+        x_pthread_mutex_unlock(&hsQueueLock);
+        return(-1);
+    }
+    return(0);
+}
 
-err:
-    destroy_req(req);
-    return;
+
+static void * perform_stream_cmd(handshake_t *hs)
+{
+/*  The thread responsible for performing a QUERY log/tail or SEARCH cmd.
+ *  Since this thread has nothing else to do, the socket is made blocking
+ *    while the response and data are written to it; but a client that stops
+ *    reading for CLIENT_HANDSHAKE_TIMEOUT seconds is dropped so it cannot
+ *    hold one of the CLIENT_STREAM_THREADS indefinitely.
+ */
+    req_t *req = hs->req;
+    struct timeval tv;
+
+    x_pthread_detach(pthread_self());
+
+    set_fd_blocking(req->sd);
+    tv.tv_sec = CLIENT_HANDSHAKE_TIMEOUT;
+    tv.tv_usec = 0;
+    if (setsockopt(req->sd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0) {
+        log_msg(LOG_WARNING, "Unable to set send timeout for <%s:%d>: %s",
+            req->fqdn, req->port, strerror(errno));
+    }
+    if (req->command == CONMAN_CMD_SEARCH)
+        (void) perform_search_cmd(hs);
+    else if (req->tailLines > 0)
+        (void) perform_query_tail_cmd(hs);
+    else
+        (void) perform_query_log_cmd(hs);
+
+    /*  Write the error response if the cmd failed.
+     */
+    (void) flush_rsp(hs);
+    destroy_handshake(hs);
+
+    x_pthread_mutex_lock(&hsQueueLock);
+    numStreams--;
+    x_pthread_mutex_unlock(&hsQueueLock);
+    return(NULL);
 }
 
 
-static int resolve_addr(server_conf_t *conf, req_t *req, int sd)
+static int get_peer_addr(req_t *req)
 {
-/*  Resolves the network information associated with the
- *    peer at the other end of the socket connection.
- *  Returns 0 if the remote client address is valid, or -1 on error.
+/*  Gets the address of the peer at the other end of the request's socket.
+ *  The fqdn and host are set to the IP address string until resolved
+ *    by resolve_addr(); the lookup of its host name is started here.
+ *  Returns 0 on success, or -1 on error.
  */
     struct sockaddr_in addr;
     socklen_t addrlen = sizeof(addr);
     char buf[MAX_LINE];
-    char *p;
-    int gotHostName = 0;
 
-    assert(sd >= 0);
+    assert(req->sd >= 0);
 
-    req->sd = sd;
-    if (getpeername(sd, (struct sockaddr *) &addr, &addrlen) < 0)
-        log_err(errno, "Unable to get address of remote peer");
+    if (getpeername(req->sd, (struct sockaddr *) &addr, &addrlen) < 0) {
+        log_msg(LOG_NOTICE, "Unable to get address of remote peer: %s",
+            strerror(errno));
+        return(-1);
+    }
     if (!inet_ntop(AF_INET, &addr.sin_addr, buf, sizeof(buf)))
         log_err(errno, "Unable to convert network address into string");
     req->port = ntohs(addr.sin_port);
     req->ip = create_string(buf);
+    req->fqdn = create_string(buf);
+    req->host = create_string(buf);
+    prefetch_addr_name(&addr.sin_addr);
+    return(0);
+}
+
+
+static int resolve_addr(server_conf_t *conf, req_t *req)
+{
+/*  Resolves the network information associated with the
+ *    peer at the other end of the socket connection.
+ *  Returns 0 if the remote client address is valid, or -1 on error.
+ */
+    struct in_addr addr;
+    char buf[MAX_LINE];
+    char *p;
+    int gotHostName = 0;
+
+    assert(req->ip != NULL);
+
+    if (inet_pton(AF_INET, req->ip, &addr) <= 0)
+        log_err(errno, "Unable to convert string into network address");
     /*
-     *  Attempt to resolve IP address.  If it succeeds, buf contains
-     *    host string; if it fails, buf is unchanged with IP addr string.
-     *    Either way, copy buf to prevent having to code everything as
-     *    (req->host ? req->host : req->ip).
+     *  Attempt to resolve IP address.  If it succeeds, replace the fqdn and
+     *    host strings (which hold the IP addr string) with the host name.
+     *  This waits a bounded time on the lookup started by get_peer_addr().
      */
-    if ((host_addr4_to_name(&addr.sin_addr, buf, sizeof(buf)))) {
+    if ((resolve_addr_name(&addr, buf, sizeof(buf)))) {
         gotHostName = 1;
-        req->fqdn = create_string(buf);
+        replace_string(&req->fqdn, buf);
         if ((p = strchr(buf, '.')))
             *p = '\0';
-        req->host = create_string(buf);
-    }
-    else {
-        req->fqdn = create_string(buf);
-        req->host = create_string(buf);
+        replace_string(&req->host, buf);
     }
 
 #if WITH_TCP_WRAPPERS
@@ -217,34 +1056,23 @@ static int resolve_addr(server_conf_t *conf, req_t *req, int sd)
 }
 
 
-static int recv_greeting(req_t *req)
+static int recv_greeting(handshake_t *hs)
 {
 /*  Performs the initial handshake with the client
- *    (SOMEDAY including authentication & encryption, if needed).
+ *    (SOMEDAY including authentication & encryption, if needed)
+ *    given the greeting line received from it in the handshake (hs).
  *  Returns 0 if the greeting is valid, or -1 on error.
  */
-    int n;
-    char buf[MAX_SOCK_LINE];
+    req_t *req = hs->req;
     Lex l;
     int done = 0;
     int tok;
 
     assert(req->sd >= 0);
 
-    if ((n = read_line(req->sd, buf, sizeof(buf))) < 0) {
-        log_msg(LOG_NOTICE, "Unable to read greeting from <%s:%d>: %s",
-            req->fqdn, req->port, strerror(errno));
-        return(-1);
-    }
-    else if (n == 0) {
-        log_msg(LOG_NOTICE, "Connection terminated by <%s:%d>",
-            req->fqdn, req->port);
-        return(-1);
-    }
-
-    DPRINTF((5, "Received greeting: %s", buf));
+    DPRINTF((5, "Received greeting: %s", hs->buf));
 
-    l = lex_create(buf, proto_strs);
+    l = lex_create(hs->buf, proto_strs);
     while (!done) {
         tok = lex_next(l);
         switch(tok) {
@@ -265,21 +1093,21 @@ static int recv_greeting(req_t *req)
      */
     if (!req->user) {
         req->user = create_string("unknown");
-        send_rsp(req, CONMAN_ERR_BAD_REQUEST,
+        send_rsp(hs, CONMAN_ERR_BAD_REQUEST,
             "Invalid greeting: no user specified");
         return(-1);
     }
 
     /*  Send response to greeting.
      */
-    return(send_rsp(req, CONMAN_ERR_NONE, NULL));
+    return(send_rsp(hs, CONMAN_ERR_NONE, NULL));
 }
 
 
 static void parse_greeting(Lex l, req_t *req)
 {
 /*  Parses the "HELLO" command from the client:
- *    HELLO USER='<str>' TTY='<str>'
+ *    HELLO USER='<str>' TTY='<str>' [PROTOCOL=<int>]
  */
     int done = 0;
     int tok;
@@ -303,6 +1131,12 @@ static void parse_greeting(Lex l, req_t *req)
                 req->tty = lex_decode(create_string(lex_text(l)));
             }
             break;
+        case CONMAN_TOK_PROTOCOL:
+            if ((lex_next(l) == '=') && (lex_next(l) == LEX_INT)
+              && (strtol(lex_text(l), NULL, 10) >= CONMAN_PROTOCOL_MUX)) {
+                req->protocol = CONMAN_PROTOCOL_MUX;
+            }
+            break;
         case LEX_EOF:
         case LEX_EOL:
             done = 1;
@@ -315,30 +1149,16 @@ static void parse_greeting(Lex l, req_t *req)
 }
 
 
-static int recv_req(req_t *req)
+static int recv_req(req_t *req, char *buf)
 {
-/*  Receives the request from the client after the greeting has completed.
+/*  Receives the request line (buf) from the client
+ *    after the greeting has completed (or in an OPEN frame).
  *  Returns 0 if the request is read OK, or -1 on error.
  */
-    int n;
-    char buf[MAX_SOCK_LINE];
     Lex l;
     int done = 0;
     int tok;
 
-    assert(req->sd >= 0);
-
-    if ((n = read_line(req->sd, buf, sizeof(buf))) < 0) {
-        log_msg(LOG_NOTICE, "Unable to read request from <%s:%d>: %s",
-            req->fqdn, req->port, strerror(errno));
-        return(-1);
-    }
-    else if (n == 0) {
-        log_msg(LOG_NOTICE, "Connection terminated by <%s:%d>",
-            req->fqdn, req->port);
-        return(-1);
-    }
-
     DPRINTF((5, "Received request: %s", buf));
 
     l = lex_create(buf, proto_strs);
@@ -357,6 +1177,10 @@ static int recv_req(req_t *req)
             req->command = CONMAN_CMD_QUERY;
             parse_cmd_opts(l, req);
             break;
+        case CONMAN_TOK_SEARCH:
+            req->command = CONMAN_CMD_SEARCH;
+            parse_cmd_opts(l, req);
+            break;
         case LEX_EOF:
         case LEX_EOL:
             done = 1;
@@ -397,12 +1221,38 @@ static void parse_cmd_opts(Lex l, req_t *req)
                     req->enableForce = 1;
                 else if (lex_prev(l) == CONMAN_TOK_JOIN)
                     req->enableJoin = 1;
+                else if (lex_prev(l) == CONMAN_TOK_LITERAL)
+                    req->enableLiteral = 1;
                 else if (lex_prev(l) == CONMAN_TOK_QUIET)
                     req->enableQuiet = 1;
                 else if (lex_prev(l) == CONMAN_TOK_REGEX)
                     req->enableRegex = 1;
             }
             break;
+        case CONMAN_TOK_SINCE:
+            if ((lex_next(l) == '=') && (lex_next(l) == LEX_INT))
+                req->timeSince = strtol(lex_text(l), NULL, 10);
+            break;
+        case CONMAN_TOK_UNTIL:
+            if ((lex_next(l) == '=') && (lex_next(l) == LEX_INT))
+                req->timeUntil = strtol(lex_text(l), NULL, 10);
+            break;
+        case CONMAN_TOK_REPLAY:
+            if ((lex_next(l) == '=') && (lex_next(l) == LEX_INT))
+                req->replayLines = strtol(lex_text(l), NULL, 10);
+            break;
+        case CONMAN_TOK_TAIL:
+            if ((lex_next(l) == '=') && (lex_next(l) == LEX_INT))
+                req->tailLines = strtol(lex_text(l), NULL, 10);
+            break;
+        case CONMAN_TOK_PATTERN:
+            if ((lex_next(l) == '=') && (lex_next(l) == LEX_STR)
+              && (*lex_text(l) != '\0')) {
+                if (req->pattern)
+                    free(req->pattern);
+                req->pattern = lex_decode(create_string(lex_text(l)));
+            }
+            break;
         case LEX_EOF:
         case LEX_EOL:
             done = 1;
@@ -415,18 +1265,20 @@ static void parse_cmd_opts(Lex l, req_t *req)
 }
 
 
-static int query_consoles(server_conf_t *conf, req_t *req)
+static int query_consoles(server_conf_t *conf, req_t *req,
+    char *errbuf, int errlen)
 {
 /*  Queries the server's conf to resolve the console names specified
  *    in the client's request.
- *  Returns 0 on success, or -1 on error.
+ *  Returns 0 on success, or -1 on error (with a message in errbuf).
  *    Upon a successful return, the req->consoles list of strings
  *    is replaced with a list of console obj_t's.
  */
     List matches;
     int rc;
 
-    if (list_is_empty(req->consoles) && (req->command != CONMAN_CMD_QUERY))
+    if (list_is_empty(req->consoles) && (req->command != CONMAN_CMD_QUERY)
+      && (req->command != CONMAN_CMD_SEARCH))
         return(0);
 
     /*  The NULL destructor is used for 'matches' because the matches list
@@ -436,15 +1288,15 @@ static int query_consoles(server_conf_t *conf, req_t *req)
     matches = list_create(NULL);
 
     if (req->enableRegex)
-        rc = query_consoles_via_regex(conf, req, matches);
+        rc = query_consoles_via_regex(conf, req, matches, errbuf, errlen);
     else
         rc = query_consoles_via_globbing(conf, req, matches);
 
     /*  Replace original list of strings with list of obj_t's.
+     *    The matches are already sorted in compare_objs() order.
      */
     list_destroy(req->consoles);
     req->consoles = matches;
-    list_sort(req->consoles, (ListCmpF) compare_objs);
 
     /*  If only one console was selected for a broadcast, then
      *    the session is placed into R/W mode instead of W/O mode.
@@ -461,44 +1313,70 @@ static int query_consoles_via_globbing(
     server_conf_t *conf, req_t *req, List matches)
 {
 /*  Match request patterns against console names using shell-style globbing.
- *  This is less efficient than matching via regular expressions
- *    since the console list must be traversed for each pattern, and the
- *    matches list must be traversed for each match to prevent duplicates.
+ *  A pattern without any glob metacharacters can only match the console
+ *    of that name, so it is looked up via the conf's console index.
+ *    Otherwise, the pattern is only matched against the range of consoles
+ *    whose names begin with the pattern's literal prefix.
+ *  Matches are recorded in a bitmap indexed by console id, which both
+ *    discards duplicates and yields the matches in compare_objs() order.
  */
     char *p;
-    ListIterator i, j;
+    ListIterator i;
     char *pat;
     obj_t *obj;
+    unsigned char *seen;
+    int first;
+    int n;
+    int k;
 
-    /*  An empty list for the QUERY command matches all consoles.
+    /*  An empty list for the QUERY or SEARCH command matches all consoles.
      */
     if (list_is_empty(req->consoles)) {
         p = create_string("*");
         list_append(req->consoles, p);
     }
+    if (!(seen = calloc((conf->numConsoles / 8) + 1, 1))) {
+        out_of_memory();
+    }
 
     /*  Search objs for console names matching console patterns in the request.
      */
     i = list_iterator_create(req->consoles);
-    j = list_iterator_create(conf->objs);
     while ((pat = list_next(i))) {
-        list_iterator_reset(j);
-        while ((obj = list_next(j))) {
-            if (!is_console_obj(obj))
-                continue;
-            if (!fnmatch(pat, obj->name, 0)
-              && !list_find_first(matches, (ListFindF) find_obj, obj))
-                list_append(matches, obj);
+        n = strcspn(pat, "*?[\\");
+        if (pat[n] == '\0') {
+            if ((obj = find_console_obj(conf, pat))) {
+                seen[obj->id / 8] |= 1 << (obj->id % 8);
+            }
+            continue;
+        }
+        n = find_console_range(conf, pat, n, &first);
+        while (n-- > 0) {
+            obj = conf->consoleNames[first++];
+            if (!(seen[obj->id / 8] & (1 << (obj->id % 8)))
+              && !fnmatch(pat, obj->name, 0)) {
+                seen[obj->id / 8] |= 1 << (obj->id % 8);
+            }
         }
     }
     list_iterator_destroy(i);
-    list_iterator_destroy(j);
+
+    for (k = 0; k < conf->numConsoles; k++) {
+        if (!seen[k / 8]) {
+            k |= 7;                     /* skip the rest of an empty byte */
+            continue;
+        }
+        if (seen[k / 8] & (1 << (k % 8))) {
+            list_append(matches, conf->consoleTable[k]);
+        }
+    }
+    free(seen);
     return(0);
 }
 
 
 static int query_consoles_via_regex(
-    server_conf_t *conf, req_t *req, List matches)
+    server_conf_t *conf, req_t *req, List matches, char *errbuf, int errlen)
 {
 /*  Match request patterns against console names using regular expressions.
  */
@@ -509,8 +1387,9 @@ static int query_consoles_via_regex(
     regex_t rex;
     regmatch_t match;
     obj_t *obj;
+    int k;
 
-    /*  An empty list for the QUERY command matches all consoles.
+    /*  An empty list for the QUERY or SEARCH command matches all consoles.
      */
     if (list_is_empty(req->consoles)) {
         p = create_string(".*");
@@ -535,63 +1414,69 @@ static int query_consoles_via_regex(
      */
     rc = regcomp(&rex, buf, REG_EXTENDED | REG_ICASE);
     if (rc != 0) {
-        if (regerror(rc, &rex, buf, sizeof(buf)) > sizeof(buf))
+        if (regerror(rc, &rex, errbuf, errlen) > (size_t) errlen)
             log_msg(LOG_WARNING, "Got regerror() buffer overrun");
         regfree(&rex);
-        send_rsp(req, CONMAN_ERR_BAD_REGEX, buf);
         return(-1);
     }
 
-    /*  Search objs for console names matching console patterns in the request.
+    /*  Search the console table for names matching the combined regex.
+     *    Since each console appears in the table once (in compare_objs()
+     *    order), the matches need neither be checked for duplicates
+     *    nor be re-sorted.
      */
-    i = list_iterator_create(conf->objs);
-    while ((obj = list_next(i))) {
-        if (!is_console_obj(obj))
-            continue;
+    for (k = 0; k < conf->numConsoles; k++) {
+        obj = conf->consoleTable[k];
         if (!regexec(&rex, obj->name, 1, &match, 0)
           && (match.rm_so == 0)
           && (match.rm_eo == (int) strlen(obj->name)))
             list_append(matches, obj);
     }
-    list_iterator_destroy(i);
     regfree(&rex);
     return(0);
 }
 
 
-static int validate_req(req_t *req)
+static int validate_req(handshake_t *hs)
 {
-/*  Validates the given request.
+/*  Validates the handshake's request.
  *  Returns 0 if the request is valid, or -1 on error.
  */
-    if (list_is_empty(req->consoles)) {
-        send_rsp(req, CONMAN_ERR_NO_CONSOLES, "Found no matching consoles");
+    if (list_is_empty(hs->req->consoles)) {
+        send_rsp(hs, CONMAN_ERR_NO_CONSOLES, "Found no matching consoles");
         return(-1);
     }
-    if (check_too_many_consoles(req) < 0)
+    if (check_too_many_consoles(hs) < 0)
         return(-1);
-    if (check_busy_consoles(req) < 0)
+    if (check_busy_consoles(hs) < 0)
         return(-1);
 
     return(0);
 }
 
 
-static int check_too_many_consoles(req_t *req)
+static int check_too_many_consoles(handshake_t *hs)
 {
 /*  Checks to see if the request matches too many consoles
  *    for the given command.
  *  A MONITOR command can only affect a single console, as can a
- *    CONNECT command unless the broadcast option is enabled.
+ *    CONNECT command unless the broadcast option is enabled,
+ *    and a QUERY command for a range or the tail of a console's log.
+ *  A SEARCH command can affect any number of consoles.
  *  Returns 0 if the request is valid, or -1 on error.
  */
+    req_t *req = hs->req;
     ListIterator i;
     obj_t *obj;
     char buf[MAX_SOCK_LINE];
 
     assert(!list_is_empty(req->consoles));
 
-    if (req->command == CONMAN_CMD_QUERY)
+    if ((req->command == CONMAN_CMD_QUERY)
+      && (req->timeSince == 0) && (req->timeUntil == 0)
+      && (req->tailLines <= 0))
+        return(0);
+    if (req->command == CONMAN_CMD_SEARCH)
         return(0);
     if (list_count(req->consoles) == 1)
         return(0);
@@ -600,31 +1485,25 @@ static int check_too_many_consoles(req_t *req)
 
     snprintf(buf, sizeof(buf), "Found %d matching consoles",
         list_count(req->consoles));
-    send_rsp(req, CONMAN_ERR_TOO_MANY_CONSOLES, buf);
+    send_rsp(hs, CONMAN_ERR_TOO_MANY_CONSOLES, buf);
 
-    /*  FIXME? Replace with single write_n()?
-     */
     i = list_iterator_create(req->consoles);
     while ((obj = list_next(i))) {
-        strlcpy(buf, obj->name, sizeof(buf));
-        strlcat(buf, "\n", sizeof(buf));
-        if (write_n(req->sd, buf, strlen(buf)) < 0) {
-            log_msg(LOG_NOTICE, "Unable to write to <%s:%d>: %s",
-                req->fqdn, req->port, strerror(errno));
-            break;
-        }
+        append_rsp(hs, obj->name, strlen(obj->name));
+        append_rsp(hs, "\n", 1);
     }
     list_iterator_destroy(i);
     return(-1);
 }
 
 
-static int check_busy_consoles(req_t *req)
+static int check_busy_consoles(handshake_t *hs)
 {
 /*  Checks to see if a "writable" request affects any consoles
  *    that are currently busy (unless the force or join option is enabled).
  *  Returns 0 if the request is valid, or -1 on error.
  */
+    req_t *req = hs->req;
     List busy;
     ListIterator i;
     obj_t *console;
@@ -638,7 +1517,8 @@ static int check_busy_consoles(req_t *req)
     assert(!list_is_empty(req->consoles));
 
     if ((req->command == CONMAN_CMD_QUERY)
-      || (req->command == CONMAN_CMD_MONITOR))
+      || (req->command == CONMAN_CMD_MONITOR)
+      || (req->command == CONMAN_CMD_SEARCH))
         return(0);
     if (req->enableForce || req->enableJoin)
         return(0);
@@ -664,7 +1544,7 @@ static int check_busy_consoles(req_t *req)
         snprintf(buf, sizeof(buf), "Found %d consoles already in use",
             list_count(busy));
     }
-    send_rsp(req, CONMAN_ERR_BUSY_CONSOLES, buf);
+    send_rsp(hs, CONMAN_ERR_BUSY_CONSOLES, buf);
 
     /*  Note: the "busy" list contains object references,
      *    so they DO NOT get destroyed here when removed from the list.
@@ -692,11 +1572,7 @@ static int check_busy_consoles(req_t *req)
             buf[sizeof(buf) - 1] = '\0';
             if (delta)
                 free(delta);
-            if (write_n(req->sd, buf, strlen(buf)) < 0) {
-                log_msg(LOG_NOTICE, "Unable to write to <%s:%d>: %s",
-                    req->fqdn, req->port, strerror(errno));
-                break;
-            }
+            append_rsp(hs, buf, strlen(buf));
         }
         list_iterator_destroy(i);
     }
@@ -705,17 +1581,21 @@ static int check_busy_consoles(req_t *req)
 }
 
 
-static int send_rsp(req_t *req, int errnum, char *errmsg)
+static int send_rsp(handshake_t *hs, int errnum, char *errmsg)
 {
-/*  Sends a response to the given request (req).
+/*  Composes a response to the handshake's request in (hs).
  *  If the request is valid and there are no errors,
  *    errnum = CONMAN_ERR_NONE and an "OK" response is sent.
  *  Otherwise, (errnum) identifies the err_type enumeration (in common.h)
  *    and (errmsg) is a string describing the error in more detail.
- *  Returns 0 if the response is sent OK, or -1 on error.
+ *  An "OK" response listing more consoles than fit in (buf) is appended
+ *    in pieces as (buf) fills, so its length is not limited.
+ *  Returns 0 if the response is composed OK, or -1 on error.
  */
-    char buf[MAX_SOCK_LINE] = "";       /* init buf for appending with NUL */
+    req_t *req = hs->req;
+    char buf[MAX_SOCK_LINE];
     char tmp[MAX_LINE];                 /* tmp buffer for lex-encoding strs */
+    int len;
     int n;
     ListIterator i;
     obj_t *console;
@@ -725,68 +1605,61 @@ static int send_rsp(req_t *req, int errnum, char *errmsg)
 
     if (errnum == CONMAN_ERR_NONE) {
 
-        n = append_format_string(buf, sizeof(buf), "%s",
+        len = snprintf(buf, sizeof(buf), "%s",
             LEX_TOK2STR(proto_strs, CONMAN_TOK_OK));
-        if (n == -1) {
-            goto overrun;
-        }
+
         /*  If consoles have been defined by this point, the "response"
          *    is to the request as opposed to the greeting.
          */
         if (list_count(req->consoles) > 0) {
 
             if (req->enableReset) {
-                n = append_format_string(buf, sizeof(buf), " %s=%s",
+                len += snprintf(buf + len, sizeof(buf) - len, " %s=%s",
                     LEX_TOK2STR(proto_strs, CONMAN_TOK_OPTION),
                     LEX_TOK2STR(proto_strs, CONMAN_TOK_RESET));
-                if (n == -1) {
-                    goto overrun;
-                }
             }
             i = list_iterator_create(req->consoles);
             while ((console = list_next(i))) {
                 n = strlcpy(tmp, console->name, sizeof(tmp));
                 if ((size_t) n >= sizeof(tmp)) {
+                    list_iterator_destroy(i);
                     goto overrun;
                 }
-                n = append_format_string(buf, sizeof(buf), " %s='%s'",
+                /*  Leave room for the console, newline, and NUL.
+                 */
+                n = strlen(LEX_TOK2STR(proto_strs, CONMAN_TOK_CONSOLE))
+                    + strlen(tmp) + 4;
+                if (len + n + 2 > (int) sizeof(buf)) {
+                    append_rsp(hs, buf, len);
+                    len = 0;
+                }
+                len += snprintf(buf + len, sizeof(buf) - len, " %s='%s'",
                     LEX_TOK2STR(proto_strs, CONMAN_TOK_CONSOLE),
                     lex_encode(tmp));
-                if (n == -1) {
-                    goto overrun;
-                }
             }
             list_iterator_destroy(i);
         }
-
-        n = append_format_string(buf, sizeof(buf), "\n");
-        if (n == -1) {
-            goto overrun;
+        /*  Otherwise, acknowledge the multiplexed protocol if negotiated.
+         */
+        else if (req->protocol >= CONMAN_PROTOCOL_MUX) {
+            len += snprintf(buf + len, sizeof(buf) - len, " %s=%d",
+                LEX_TOK2STR(proto_strs, CONMAN_TOK_PROTOCOL),
+                CONMAN_PROTOCOL_MUX);
         }
+        buf[len++] = '\n';
+        buf[len] = '\0';
     }
     else {
-        n = strlcpy(tmp, (errmsg ? errmsg : "unspecified error"), sizeof(tmp));
-        if ((size_t) n >= sizeof(tmp)) {
-            goto overrun;
-        }
-        n = snprintf(buf, sizeof(buf), "%s %s=%d %s='%s'\n",
-            LEX_TOK2STR(proto_strs, CONMAN_TOK_ERROR),
-            LEX_TOK2STR(proto_strs, CONMAN_TOK_CODE), errnum,
-            LEX_TOK2STR(proto_strs, CONMAN_TOK_MESSAGE), lex_encode(tmp));
-        if ((n < 0) || ((size_t) n >= sizeof(buf))) {
+        if ((len = format_err_rsp(buf, sizeof(buf), errnum, errmsg)) < 0) {
             goto overrun;
         }
         log_msg(LOG_NOTICE, "Client <%s@%s:%d> request failed: %s",
             req->user, req->fqdn, req->port, errmsg);
     }
 
-    /*  Write response to client.
+    /*  Append (the remainder of the) response.
      */
-    if (write_n(req->sd, buf, strlen(buf)) < 0) {
-        log_msg(LOG_NOTICE, "Unable to write to <%s:%d>: %s",
-            req->fqdn, req->port, strerror(errno));
-        return(-1);
-    }
+    append_rsp(hs, buf, len);
 
     DPRINTF((5, "Sent response: %s", buf));
     return(0);
@@ -799,34 +1672,252 @@ overrun:
 }
 
 
-static int perform_query_cmd(req_t *req)
+static void append_rsp(handshake_t *hs, const char *src, int len)
+{
+/*  Appends (len) bytes of (src) to the response being composed in (hs).
+ */
+    int n;
+
+    assert(len >= 0);
+
+    if (hs->rspLen + len > hs->rspSize) {
+        n = (hs->rspSize > 0) ? hs->rspSize : MAX_SOCK_LINE;
+        while (n < hs->rspLen + len) {
+            n *= 2;
+        }
+        if (!(hs->rsp = realloc(hs->rsp, n))) {
+            out_of_memory();
+        }
+        hs->rspSize = n;
+    }
+    memcpy(hs->rsp + hs->rspLen, src, len);
+    hs->rspLen += len;
+    return;
+}
+
+
+static int flush_rsp(handshake_t *hs)
+{
+/*  Writes the rest of the response composed in (hs) to its blocking socket.
+ *  This is only used by the threads performing QUERY log/tail and SEARCH
+ *    cmds since their data must follow the response.
+ *  Returns 0 if the response is written OK, or -1 on error.
+ */
+    int rc = 0;
+
+    if (hs->rspDone < hs->rspLen) {
+        if (write_n(hs->req->sd, hs->rsp + hs->rspDone,
+                hs->rspLen - hs->rspDone) < 0) {
+            log_msg(LOG_NOTICE, "Unable to write to <%s:%d>: %s",
+                hs->req->fqdn, hs->req->port, strerror(errno));
+            rc = -1;
+        }
+    }
+    hs->rspLen = 0;
+    hs->rspDone = 0;
+    return(rc);
+}
+
+
+static int format_err_rsp(char *buf, int buflen, int errnum, char *errmsg)
+{
+/*  Formats the "ERROR" response for (errnum) and (errmsg) into (buf)
+ *    of length (buflen).
+ *  Returns the length of the response, or -1 if (buf) was too small.
+ */
+    char tmp[MAX_LINE];                 /* tmp buffer for lex-encoding strs */
+    int len;
+
+    len = strlcpy(tmp, (errmsg ? errmsg : "unspecified error"), sizeof(tmp));
+    if ((size_t) len >= sizeof(tmp)) {
+        return(-1);
+    }
+    len = snprintf(buf, buflen, "%s %s=%d %s='%s'\n",
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_ERROR),
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_CODE), errnum,
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_MESSAGE), lex_encode(tmp));
+    if ((len < 0) || (len >= buflen)) {
+        return(-1);
+    }
+    return(len);
+}
+
+
+static int perform_query_cmd(handshake_t *hs, server_conf_t *conf)
 {
 /*  Performs the QUERY command, returning a list of consoles that
  *    matches the console patterns given in the client's request.
+ *  If the request matches every console (or names none), the cached
+ *    response is sent instead of serializing the list.
  *  Returns 0 if the command succeeds, or -1 on error.
- *  Since this cmd is processed entirely by this thread,
- *    the client socket connection is closed once it is finished.
+ *  Since this cmd is answered entirely by its response,
+ *    the client socket connection is closed once it is written.
  */
+    req_t *req = hs->req;
+
     assert(req->sd >= 0);
     assert(req->command == CONMAN_CMD_QUERY);
-    assert(!list_is_empty(req->consoles));
+    assert(req->tailLines <= 0);
+    assert((req->timeSince == 0) && (req->timeUntil == 0));
 
     log_msg(LOG_INFO, "Client <%s@%s:%d> issued query",
         req->user, req->fqdn, req->port);
 
-    if (send_rsp(req, CONMAN_ERR_NONE, NULL) < 0) {
+    if (conf->queryRsp && (list_is_empty(req->consoles)
+            || (list_count(req->consoles) == conf->numConsoles))) {
+        append_rsp(hs, conf->queryRsp, conf->queryRspLen);
+    }
+    else if (send_rsp(hs, CONMAN_ERR_NONE, NULL) < 0) {
         return(-1);
     }
-    destroy_req(req);
     return(0);
 }
 
 
-static int perform_monitor_cmd(req_t *req, server_conf_t *conf)
+static int perform_query_log_cmd(handshake_t *hs)
+{
+/*  Performs the QUERY command for a time range of a console's log,
+ *    writing the data logged between the SINCE and UNTIL times
+ *    after the response.
+ *  Returns 0 if the command succeeds, or -1 on error.
+ *  Since the logfiles are read by this thread, the console reactors
+ *    are not delayed regardless of the size of the range.
+ */
+    req_t *req = hs->req;
+    obj_t *console;
+    obj_t *logfile;
+    char buf[MAX_LINE];
+
+    assert(list_count(req->consoles) == 1);
+
+    console = list_peek(req->consoles);
+    assert(is_console_obj(console));
+
+    if ((req->timeUntil != 0) && (req->timeUntil < req->timeSince)) {
+        send_rsp(hs, CONMAN_ERR_BAD_REQUEST, "Invalid log time range");
+        return(-1);
+    }
+    if (!(logfile = get_console_logfile_obj(console))) {
+        snprintf(buf, sizeof(buf), "Console [%s] is not being logged",
+            console->name);
+        send_rsp(hs, CONMAN_ERR_NO_LOGFILE, buf);
+        return(-1);
+    }
+    log_msg(LOG_INFO, "Client <%s@%s:%d> issued query for [%s] log",
+        req->user, req->fqdn, req->port, console->name);
+
+    if ((send_rsp(hs, CONMAN_ERR_NONE, NULL) < 0) || (flush_rsp(hs) < 0)) {
+        return(-1);
+    }
+    if (write_logfile_range(logfile, req->sd,
+            req->timeSince, req->timeUntil) < 0) {
+        log_msg(LOG_NOTICE, "Unable to write to <%s:%d>: %s",
+            req->fqdn, req->port, strerror(errno));
+    }
+    return(0);
+}
+
+
+static int perform_query_tail_cmd(handshake_t *hs)
+{
+/*  Performs the QUERY command for the tail of a console's output,
+ *    writing the last TAIL lines after the response.
+ *  The lines are served from the console's scrollback history when it
+ *    holds enough of them, so the logfile is not read in the common case.
+ *  Returns 0 if the command succeeds, or -1 on error.
+ */
+    req_t *req = hs->req;
+    obj_t *console;
+    log_reader_t *r;
+    char buf[MAX_BUF_SIZE];
+    int n;
+
+    assert(list_count(req->consoles) == 1);
+
+    console = list_peek(req->consoles);
+    assert(is_console_obj(console));
+
+    if (!(r = create_console_reader(console, req->tailLines, 0))) {
+        snprintf(buf, sizeof(buf), "Console [%s] has no history or log",
+            console->name);
+        send_rsp(hs, CONMAN_ERR_NO_LOGFILE, buf);
+        return(-1);
+    }
+    log_msg(LOG_INFO, "Client <%s@%s:%d> issued tail query for [%s]",
+        req->user, req->fqdn, req->port, console->name);
+
+    if ((send_rsp(hs, CONMAN_ERR_NONE, NULL) < 0) || (flush_rsp(hs) < 0)) {
+        destroy_log_reader(r);
+        return(-1);
+    }
+    while ((n = read_log_reader(r, buf, sizeof(buf))) > 0) {
+        if (write_n(req->sd, buf, n) < 0) {
+            log_msg(LOG_NOTICE, "Unable to write to <%s:%d>: %s",
+                req->fqdn, req->port, strerror(errno));
+            break;
+        }
+    }
+    destroy_log_reader(r);
+    return(0);
+}
+
+
+static int perform_search_cmd(handshake_t *hs)
+{
+/*  Performs the SEARCH command, writing the lines of the matching consoles'
+ *    logs (or histories) that match the PATTERN after the response.
+ *    The search is limited to the data logged between the SINCE and UNTIL
+ *    times if either is given.
+ *  Returns 0 if the command succeeds, or -1 on error.
+ *  Since the logfiles are searched by this thread (along with the search
+ *    threads it creates), the console reactors are not delayed.
+ */
+    req_t *req = hs->req;
+    log_search_t *s;
+    char buf[MAX_LINE];
+    int n;
+
+    assert(req->sd >= 0);
+    assert(req->command == CONMAN_CMD_SEARCH);
+    assert(!list_is_empty(req->consoles));
+
+    if (!req->pattern) {
+        send_rsp(hs, CONMAN_ERR_BAD_REQUEST, "No search pattern specified");
+        return(-1);
+    }
+    if ((req->timeUntil != 0) && (req->timeUntil < req->timeSince)) {
+        send_rsp(hs, CONMAN_ERR_BAD_REQUEST, "Invalid log time range");
+        return(-1);
+    }
+    if (!(s = create_log_search(req->pattern, req->enableLiteral,
+            buf, sizeof(buf)))) {
+        send_rsp(hs, CONMAN_ERR_BAD_REGEX, buf);
+        return(-1);
+    }
+    n = list_count(req->consoles);
+    log_msg(LOG_INFO,
+        "Client <%s@%s:%d> issued search for \"%s\" across %d console%s",
+        req->user, req->fqdn, req->port, req->pattern, n, (n == 1) ? "" : "s");
+
+    if ((send_rsp(hs, CONMAN_ERR_NONE, NULL) < 0) || (flush_rsp(hs) < 0)) {
+        destroy_log_search(s);
+        return(-1);
+    }
+    if (run_log_search(s, req->consoles, req->sd,
+            req->timeSince, req->timeUntil) < 0) {
+        log_msg(LOG_NOTICE, "Unable to write to <%s:%d>: %s",
+            req->fqdn, req->port, strerror(errno));
+    }
+    destroy_log_search(s);
+    return(0);
+}
+
+
+static void perform_monitor_cmd(req_t *req, server_conf_t *conf)
 {
 /*  Performs the MONITOR command, placing the client in a
  *    "read-only" session with a single console.
- *  Returns 0 if the command succeeds, or -1 on error.
+ *  This is invoked by the main thread once the response has been written.
  */
     obj_t *client;
     obj_t *console;
@@ -835,9 +1926,6 @@ static int perform_monitor_cmd(req_t *req, server_conf_t *conf)
     assert(req->command == CONMAN_CMD_MONITOR);
     assert(list_count(req->consoles) == 1);
 
-    if (send_rsp(req, CONMAN_ERR_NONE, NULL) < 0) {
-        return(-1);
-    }
     client = create_client_obj(conf, req);
     console = list_peek(req->consoles);
     assert(is_console_obj(console));
@@ -847,17 +1935,21 @@ static int perform_monitor_cmd(req_t *req, server_conf_t *conf)
     log_msg(LOG_INFO, "Client <%s@%s:%d> connected to [%s] (read-only)",
         req->user, req->fqdn, req->port, console->name);
 
-    return(0);
+    if ((req->replayLines > 0) || (req->timeSince > 0)) {
+        (void) start_log_replay(client, console,
+            req->replayLines, req->timeSince);
+    }
+    return;
 }
 
 
-static int perform_connect_cmd(req_t *req, server_conf_t *conf)
+static void perform_connect_cmd(req_t *req, server_conf_t *conf)
 {
 /*  Performs the CONNECT command.  If a single console is specified,
  *    the client is placed in a "read-write" session with that console.
  *    Otherwise, the client is placed in a "write-only" broadcast session
  *    affecting multiple consoles.
- *  Returns 0 if the command succeeds, or -1 on error.
+ *  This is invoked by the main thread once the response has been written.
  */
     obj_t *client;
     obj_t *console;
@@ -866,9 +1958,6 @@ static int perform_connect_cmd(req_t *req, server_conf_t *conf)
     assert(req->sd >= 0);
     assert(req->command == CONMAN_CMD_CONNECT);
 
-    if (send_rsp(req, CONMAN_ERR_NONE, NULL) < 0) {
-        return(-1);
-    }
     client = create_client_obj(conf, req);
 
     if (list_count(req->consoles) == 1) {
@@ -883,6 +1972,11 @@ static int perform_connect_cmd(req_t *req, server_conf_t *conf)
 
         log_msg(LOG_INFO, "Client <%s@%s:%d> connected to [%s]",
             req->user, req->fqdn, req->port, console->name);
+
+        if ((req->replayLines > 0) || (req->timeSince > 0)) {
+            (void) start_log_replay(client, console,
+                req->replayLines, req->timeSince);
+        }
     }
     else {
         /*
@@ -900,7 +1994,7 @@ static int perform_connect_cmd(req_t *req, server_conf_t *conf)
             "Client <%s@%s:%d> connected to %d consoles (broadcast)",
             req->user, req->fqdn, req->port, list_count(req->consoles));
     }
-    return(0);
+    return;
 }
 
 
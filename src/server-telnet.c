@@ -57,7 +57,6 @@ static void reset_telnet_delay(obj_t *telnet);
 static int process_telnet_cmd(obj_t *telnet, int cmd, int opt);
 static char * opt2str(int opt, char *buf, int buflen);
 
-extern tpoll_t tp_global;               /* defined in server.c */
 
 
 int is_telnet_dev(const char *dev, char **host_ref, int *port_ref)
@@ -99,7 +98,6 @@ obj_t * create_telnet_obj(server_conf_t *conf, char *name,
  *    by main:open_objs:reopen_obj:open_telnet_obj:connect_telnet_obj().
  *  Returns the new object, or NULL on error.
  */
-    ListIterator i;
     obj_t *telnet;
 
     assert(conf != NULL);
@@ -115,18 +113,11 @@ obj_t * create_telnet_obj(server_conf_t *conf, char *name,
     }
     /*  Check for duplicate console names.
      */
-    i = list_iterator_create(conf->objs);
-    while ((telnet = list_next(i))) {
-        if (is_console_obj(telnet) && !strcmp(telnet->name, name)) {
-            if ((errbuf != NULL) && (errlen > 0)) {
-                snprintf(errbuf, errlen,
-                    "console [%s] specifies duplicate console name", name);
-            }
-            break;
+    if (find_console_obj(conf, name)) {
+        if ((errbuf != NULL) && (errlen > 0)) {
+            snprintf(errbuf, errlen,
+                "console [%s] specifies duplicate console name", name);
         }
-    }
-    list_iterator_destroy(i);
-    if (telnet != NULL) {
         return(NULL);
     }
     telnet = create_obj(conf, name, -1, CONMAN_OBJ_TELNET);
@@ -143,9 +134,11 @@ obj_t * create_telnet_obj(server_conf_t *conf, char *name,
      */
     telnet->aux.telnet.enableKeepAlive = conf->enableKeepAlive;
 
-    /*  Add obj to the master conf->objs list.
+    /*  Add obj to the master conf->objs list
+     *    and index it by name.
      */
     list_append(conf->objs, telnet);
+    insert_obj_index(&conf->consoleIndex, name, telnet);
 
     return(telnet);
 }
@@ -181,11 +174,12 @@ static int connect_telnet_obj(obj_t *telnet)
  */
     struct sockaddr_in saddr;
     const int on = 1;
+    int fd;
 
     assert(telnet->aux.telnet.state != CONMAN_TELNET_UP);
 
     if (telnet->aux.telnet.timer >= 0) {
-        (void) tpoll_timeout_cancel(tp_global, telnet->aux.telnet.timer);
+        (void) tpoll_timeout_cancel(telnet->tp, telnet->aux.telnet.timer);
         telnet->aux.telnet.timer = -1;
     }
     if (telnet->aux.telnet.state == CONMAN_TELNET_DOWN) {
@@ -198,14 +192,15 @@ static int connect_telnet_obj(obj_t *telnet)
         if (host_name_to_addr4(telnet->aux.telnet.host, &saddr.sin_addr) < 0) {
             log_msg(LOG_WARNING, "Unable to resolve hostname \"%s\" for [%s]",
                 telnet->aux.telnet.host, telnet->name);
-            telnet->aux.telnet.timer = tpoll_timeout_relative(tp_global,
+            telnet->aux.telnet.timer = tpoll_timeout_relative(telnet->tp,
                 (callback_f) connect_telnet_obj, telnet,
                 RESOLVE_RETRY_TIMEOUT * 1000);
             return(-1);
         }
-        if ((telnet->fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
             log_err(errno, "Unable to create socket for [%s]", telnet->name);
         }
+        set_obj_fd(telnet, fd);
         if (setsockopt(telnet->fd, SOL_SOCKET, SO_OOBINLINE,
                 (const void *) &on, sizeof(on)) < 0) {
             log_err(errno, "Unable to set OOBINLINE socket option");
@@ -226,7 +221,7 @@ static int connect_telnet_obj(obj_t *telnet)
                 (struct sockaddr *) &saddr, sizeof(saddr)) < 0) {
             if (errno == EINPROGRESS) {
                 telnet->aux.telnet.state = CONMAN_TELNET_PENDING;
-                tpoll_set(tp_global, telnet->fd, POLLIN | POLLOUT);
+                tpoll_set(telnet->tp, telnet->fd, POLLIN | POLLOUT);
             }
             else {
                 disconnect_telnet_obj(telnet);
@@ -256,7 +251,7 @@ static int connect_telnet_obj(obj_t *telnet)
             disconnect_telnet_obj(telnet);
             return(-1);
         }
-        tpoll_clear(tp_global, telnet->fd, POLLOUT);
+        tpoll_clear(telnet->tp, telnet->fd, POLLOUT);
         DPRINTF((10, "Completing connection to <%s:%d> for [%s].\n",
             telnet->aux.telnet.host, telnet->aux.telnet.port, telnet->name));
     }
@@ -266,7 +261,7 @@ static int connect_telnet_obj(obj_t *telnet)
     }
     telnet->gotEOF = 0;
     telnet->aux.telnet.state = CONMAN_TELNET_UP;
-    tpoll_set(tp_global, telnet->fd, POLLIN);
+    tpoll_set(telnet->tp, telnet->fd, POLLIN);
 
     /*  Notify linked objs when transitioning into an UP state.
      */
@@ -281,7 +276,7 @@ static int connect_telnet_obj(obj_t *telnet)
      *    disconnect_telnet_obj() will cancel the timer and the
      *    exponential backoff will continue.
      */
-    telnet->aux.telnet.timer = tpoll_timeout_relative(tp_global,
+    telnet->aux.telnet.timer = tpoll_timeout_relative(telnet->tp,
         (callback_f) reset_telnet_delay, telnet, TELNET_MIN_TIMEOUT * 1000);
 
     send_telnet_cmd(telnet, DO, TELOPT_BINARY);
@@ -299,21 +294,22 @@ static void disconnect_telnet_obj(obj_t *telnet)
 /*  Closes the existing connection with the specified (telnet) obj
  *    and sets a timer for establishing a new connection.
  */
+    int fd;
+
     DPRINTF((10, "Disconnecting from <%s:%d> for [%s].\n",
         telnet->aux.telnet.host, telnet->aux.telnet.port, telnet->name));
 
     if (telnet->aux.telnet.timer >= 0) {
-        (void) tpoll_timeout_cancel(tp_global, telnet->aux.telnet.timer);
+        (void) tpoll_timeout_cancel(telnet->tp, telnet->aux.telnet.timer);
         telnet->aux.telnet.timer = -1;
     }
     if (telnet->fd >= 0) {
-        tpoll_clear(tp_global, telnet->fd, POLLIN | POLLOUT);
-        if (close(telnet->fd) < 0)
+        fd = detach_obj_fd(telnet);
+        if (close(fd) < 0)
             log_msg(LOG_WARNING,
                 "Unable to close connection to <%s:%d> for [%s]: %s",
                 telnet->aux.telnet.host, telnet->aux.telnet.port,
                 telnet->name, strerror(errno));
-        telnet->fd = -1;
     }
     /*  Notify linked objs when transitioning from an UP state.
      */
@@ -326,7 +322,7 @@ static void disconnect_telnet_obj(obj_t *telnet)
     /*
      *  Set timer for establishing new connection using exponential backoff.
      */
-    telnet->aux.telnet.timer = tpoll_timeout_relative(tp_global,
+    telnet->aux.telnet.timer = tpoll_timeout_relative(telnet->tp,
         (callback_f) connect_telnet_obj, telnet,
         telnet->aux.telnet.delay * 1000);
     if (telnet->aux.telnet.delay == 0) {
@@ -42,7 +42,6 @@
 #include "util-str.h"
 #include "util.h"
 
-extern tpoll_t tp_global;               /* defined in server.c */
 
 
 #define TEST_CONSOLE_DEFAULT_BYTES              1024
@@ -187,7 +186,6 @@ obj_t * create_test_obj(server_conf_t *conf, char *name,
 /*  Creates a new test console device and adds it to the master objs list.
  *  Returns the new object, or NULL on error.
  */
-    ListIterator i;
     obj_t *test;
 
     assert(conf != NULL);
@@ -196,18 +194,11 @@ obj_t * create_test_obj(server_conf_t *conf, char *name,
 
     /*  Check for duplicate console names.
      */
-    i = list_iterator_create(conf->objs);
-    while ((test = list_next(i))) {
-        if (is_console_obj(test) && !strcmp(test->name, name)) {
-            if ((errbuf != NULL) && (errlen > 0)) {
-                snprintf(errbuf, errlen,
-                    "console [%s] specifies duplicate console name", name);
-            }
-            break;
+    if (find_console_obj(conf, name)) {
+        if ((errbuf != NULL) && (errlen > 0)) {
+            snprintf(errbuf, errlen,
+                "console [%s] specifies duplicate console name", name);
         }
-    }
-    list_iterator_destroy(i);
-    if (test != NULL) {
         return(NULL);
     }
     test = create_obj(conf, name, -1, CONMAN_OBJ_TEST);
@@ -217,9 +208,11 @@ obj_t * create_test_obj(server_conf_t *conf, char *name,
     test->aux.test.numLeft = 0;
     test->aux.test.lastChar = TEST_CONSOLE_FIRST_CHAR;
     /*
-     *  Add obj to the master conf->objs list.
+     *  Add obj to the master conf->objs list
+     *    and index it by name.
      */
     list_append(conf->objs, test);
+    insert_obj_index(&conf->consoleIndex, name, test);
 
     return(test);
 }
@@ -233,6 +226,7 @@ int open_test_obj(obj_t *test)
  */
     test_obj_t *auxp;
     test_opt_t *opts;
+    int         fd;
 
     assert(test != NULL);
     assert(is_test_obj(test));
@@ -241,29 +235,29 @@ int open_test_obj(obj_t *test)
     opts = &test->aux.test.opts;
 
     if (auxp->timer >= 0) {
-        (void) tpoll_timeout_cancel(tp_global, auxp->timer);
+        (void) tpoll_timeout_cancel(test->tp, auxp->timer);
         auxp->timer = -1;
     }
     if (test->fd >= 0) {
-        tpoll_clear(tp_global, test->fd, POLLOUT);
-        if (close(test->fd) < 0) {
+        fd = detach_obj_fd(test);
+        if (close(fd) < 0) {
             log_msg(LOG_WARNING,
                 "Unable to close test [%s]: %s", test->name, strerror(errno));
         }
-        test->fd = -1;
     }
-    test->fd = open("/dev/null", O_WRONLY | O_NONBLOCK);
-    if (test->fd < 0) {
+    fd = open("/dev/null", O_WRONLY | O_NONBLOCK);
+    if (fd < 0) {
         log_msg(LOG_WARNING,
             "Unable to open test [%s]: %s", test->name, strerror(errno));
         return(-1);
     }
+    set_obj_fd(test, fd);
     set_fd_nonblocking(test->fd);
     set_fd_closed_on_exec(test->fd);
 
     /*  Schedule immediate timer to perform initial read once in mux_io().
      */
-    auxp->timer = tpoll_timeout_relative(tp_global,
+    auxp->timer = tpoll_timeout_relative(test->tp,
         (callback_f) read_test_obj, test, 0);
 
     (void) opts;                /* suppress unused-but-set-variable warning */
@@ -276,11 +270,11 @@ int open_test_obj(obj_t *test)
 
 int read_test_obj(obj_t *test)
 {
-/*  Simulates a read from the 'test' console device, and writes it out to the
- *    circular-buffer of each 'reader' obj.  If the current read does not fit
- *    within the local buffer, a timer with a delay of 0 will be scheduled to
- *    continue reading from where it left off; otherwise, a timer will be
- *    scheduled to start reading a new burst within the specified min & max.
+/*  Simulates a read from the 'test' console device, and forwards it to
+ *    each 'reader' obj.  If the current read does not fit within the local
+ *    buffer, a timer with a delay of 0 will be scheduled to continue reading
+ *    from where it left off; otherwise, a timer will be scheduled to start
+ *    reading a new burst within the specified min & max.
  *  Returns the number of bytes read.
  */
     test_obj_t *auxp;
@@ -288,8 +282,6 @@ int read_test_obj(obj_t *test)
     unsigned char buf[(OBJ_BUF_SIZE / 2) - 1];
     int n = 0;
     int m;
-    ListIterator i;
-    obj_t *reader;
     int delay;
     int interval;
 
@@ -300,7 +292,7 @@ int read_test_obj(obj_t *test)
     opts = &test->aux.test.opts;
 
     if (auxp->timer >= 0) {
-        (void) tpoll_timeout_cancel(tp_global, auxp->timer);
+        (void) tpoll_timeout_cancel(test->tp, auxp->timer);
         auxp->timer = -1;
     }
     /*  Pseudorandomly perform a read at the start of a new burst.
@@ -321,17 +313,7 @@ int read_test_obj(obj_t *test)
         }
         auxp->numLeft -= n;
 
-        i = list_iterator_create(test->readers);
-        while ((reader = list_next(i))) {
-
-            if (is_logfile_obj(reader)) {
-                write_log_data(reader, buf, n);
-            }
-            else {
-                write_obj_data(reader, buf, n, 0);
-            }
-        }
-        list_iterator_destroy(i);
+        forward_obj_data(test, buf, n);
     }
     /*  Schedule the next timer.
      */
@@ -348,7 +330,7 @@ int read_test_obj(obj_t *test)
         interval = opts->msecMax - opts->msecMin + 1;
         delay = opts->msecMin + (rand() % interval);
     }
-    auxp->timer = tpoll_timeout_relative(tp_global,
+    auxp->timer = tpoll_timeout_relative(test->tp,
         (callback_f) read_test_obj, test, delay);
 
     return(n);
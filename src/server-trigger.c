@@ -0,0 +1,312 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "acmatch.h"
+#include "common.h"
+#include "list.h"
+#include "log.h"
+#include "server.h"
+#include "util-str.h"
+#include "util.h"
+
+
+/*  A console's output is matched against the patterns of all triggers by
+ *    a single matcher compiled once the configuration has been read.  Each
+ *    console keeps its own matcher state, so a pattern is matched even when
+ *    split across reads.  A trigger's console glob is only checked once its
+ *    pattern has matched, and a trigger is not fired again for the same
+ *    console within TRIGGER_HOLDOFF seconds (such as for each line of a
+ *    multi-line oops).
+ */
+
+
+static void fire_obj_trigger(obj_t *console, int id);
+static void exec_trigger_cmd(obj_t *console, trigger_t *trig);
+
+
+trigger_t * create_trigger(const char *pattern, const char *consoles,
+    const char *actions, const char *cmd, char *errbuf, int errlen)
+{
+/*  Creates a trigger fired by console output containing the text (pattern)
+ *    for consoles whose names match the glob (consoles), or all consoles
+ *    if NULL.  The (actions) string is a comma-separated list of "syslog"
+ *    and "notify"; the command (cmd) is exec'd if not NULL.  If neither is
+ *    given, the trigger defaults to "syslog".
+ *  Returns the new trigger, or NULL on error (in which case a message is
+ *    written into (errbuf) of length (errlen)).
+ */
+    trigger_t *trig;
+    char buf[MAX_LINE];
+    char *tok;
+    char *p;
+
+    assert(errbuf != NULL);
+
+    if (!pattern || (*pattern == '\0')) {
+        snprintf(errbuf, errlen, "trigger has no pattern");
+        return(NULL);
+    }
+    if (!(trig = malloc(sizeof(trigger_t)))) {
+        out_of_memory();
+    }
+    memset(trig, 0, sizeof(trigger_t));
+
+    if (actions) {
+        if (strlcpy(buf, actions, sizeof(buf)) >= sizeof(buf)) {
+            snprintf(errbuf, errlen, "trigger action string too long");
+            goto err;
+        }
+        for (tok = strtok_r(buf, ",", &p); tok;
+                tok = strtok_r(NULL, ",", &p)) {
+            if (!strcasecmp(tok, "syslog")) {
+                trig->doSyslog = 1;
+            }
+            else if (!strcasecmp(tok, "notify")) {
+                trig->doNotify = 1;
+            }
+            else {
+                snprintf(errbuf, errlen, "invalid trigger action \"%s\"",
+                    tok);
+                goto err;
+            }
+        }
+    }
+    if (!trig->doSyslog && !trig->doNotify && !cmd) {
+        trig->doSyslog = 1;
+    }
+    trig->pattern = create_string(pattern);
+    trig->consoles = consoles ? create_string(consoles) : NULL;
+    trig->cmd = cmd ? create_string(cmd) : NULL;
+    return(trig);
+
+err:
+    free(trig);
+    return(NULL);
+}
+
+
+void destroy_trigger(trigger_t *trig)
+{
+/*  Destroys the trigger (trig).
+ */
+    if (!trig) {
+        return;
+    }
+    destroy_string(trig->pattern);
+    destroy_string(trig->consoles);
+    destroy_string(trig->cmd);
+    free(trig);
+    return;
+}
+
+
+void create_trigger_set(server_conf_t *conf)
+{
+/*  Compiles the triggers in the configuration (conf) into a single matcher,
+ *    and attaches it to each console obj matched by at least one trigger.
+ *  This is invoked once the configuration has been read.
+ */
+    trigger_set_t *set;
+    ListIterator i;
+    trigger_t *trig;
+    obj_t *obj;
+    int id;
+
+    assert(conf != NULL);
+
+    if (list_is_empty(conf->triggers)) {
+        return;
+    }
+    if (!(set = malloc(sizeof(trigger_set_t)))) {
+        out_of_memory();
+    }
+    set->acm = acm_create();
+    set->numTriggers = list_count(conf->triggers);
+    if (!(set->triggers = malloc(set->numTriggers * sizeof(trigger_t *)))) {
+        out_of_memory();
+    }
+    id = 0;
+    i = list_iterator_create(conf->triggers);
+    while ((trig = list_next(i))) {
+        set->triggers[id] = trig;
+        (void) acm_add(set->acm, trig->pattern, strlen(trig->pattern), id);
+        id++;
+    }
+    (void) acm_compile(set->acm);
+    conf->trigSet = set;
+
+    list_iterator_destroy(i);
+    i = list_iterator_create(conf->objs);
+    while ((obj = list_next(i))) {
+        if (!is_console_obj(obj)) {
+            continue;
+        }
+        for (id = 0; id < set->numTriggers; id++) {
+            trig = set->triggers[id];
+            if (!trig->consoles || !fnmatch(trig->consoles, obj->name, 0)) {
+                obj->trigSet = set;
+                obj->trigState = 0;
+                if (!(obj->trigTimes = calloc(set->numTriggers,
+                        sizeof(time_t)))) {
+                    out_of_memory();
+                }
+                break;
+            }
+        }
+    }
+    list_iterator_destroy(i);
+
+    log_msg(LOG_INFO, "Compiled %d trigger%s into %d states (%ldKB)",
+        set->numTriggers, (set->numTriggers == 1) ? "" : "s",
+        acm_num_states(set->acm), (acm_size(set->acm) + 1023) / 1024);
+    return;
+}
+
+
+void destroy_trigger_set(server_conf_t *conf)
+{
+/*  Destroys the compiled triggers of the configuration (conf).
+ *  The triggers themselves are destroyed along with the conf's list.
+ */
+    trigger_set_t *set;
+
+    assert(conf != NULL);
+
+    if (!(set = conf->trigSet)) {
+        return;
+    }
+    acm_destroy(set->acm);
+    free(set->triggers);
+    free(set);
+    conf->trigSet = NULL;
+    return;
+}
+
+
+void match_obj_triggers(obj_t *console, const void *src, int len)
+{
+/*  Matches the data (src) of length (len) read from the console obj
+ *    against its triggers, firing each trigger whose pattern it completes.
+ *  This is invoked from the console's reactor for each chunk of data read.
+ */
+    assert(is_console_obj(console));
+    assert(console->trigSet != NULL);
+
+    (void) acm_scan(console->trigSet->acm, &console->trigState, src, len,
+        (acm_match_f) fire_obj_trigger, console);
+    return;
+}
+
+
+static void fire_obj_trigger(obj_t *console, int id)
+{
+/*  Fires the trigger (id) for the console obj, unless it does not apply to
+ *    this console or was just fired for it.
+ */
+    trigger_t *trig;
+    time_t now;
+
+    assert(id >= 0);
+    assert(id < console->trigSet->numTriggers);
+
+    trig = console->trigSet->triggers[id];
+    if (trig->consoles && fnmatch(trig->consoles, console->name, 0)) {
+        return;
+    }
+    now = time(NULL);
+    if ((now - console->trigTimes[id] < TRIGGER_HOLDOFF)
+            && (now >= console->trigTimes[id])) {
+        return;
+    }
+    console->trigTimes[id] = now;
+
+    /*  A notification is also written to the daemon's log.
+     */
+    if (trig->doNotify) {
+        write_notify_msg(console, LOG_NOTICE,
+            "Console [%s] matched trigger \"%s\"",
+            console->name, trig->pattern);
+    }
+    else if (trig->doSyslog) {
+        log_msg(LOG_NOTICE, "Console [%s] matched trigger \"%s\"",
+            console->name, trig->pattern);
+    }
+    if (trig->cmd) {
+        exec_trigger_cmd(console, trig);
+    }
+    return;
+}
+
+
+static void exec_trigger_cmd(obj_t *console, trigger_t *trig)
+{
+/*  Execs the command of the trigger (trig) fired for the console obj
+ *    in the background via "/bin/sh -c", after expanding its conversion
+ *    specifiers.  It is reaped by the daemon's SIGCHLD handler.
+ */
+    char cmd[MAX_LINE];
+    pid_t pid;
+    int fd;
+
+    if (format_obj_string(cmd, sizeof(cmd), console, trig->cmd) < 0) {
+        log_msg(LOG_WARNING,
+            "Unable to exec trigger \"%s\" for console [%s]: "
+            "command too long", trig->pattern, console->name);
+        return;
+    }
+    if ((pid = fork()) < 0) {
+        log_msg(LOG_WARNING,
+            "Unable to exec trigger \"%s\" for console [%s]: %s",
+            trig->pattern, console->name, strerror(errno));
+        return;
+    }
+    else if (pid == 0) {
+        (void) setpgid(0, 0);
+        if ((fd = open("/dev/null", O_RDWR)) >= 0) {
+            (void) dup2(fd, STDIN_FILENO);
+            (void) dup2(fd, STDOUT_FILENO);
+            (void) dup2(fd, STDERR_FILENO);
+            if (fd > STDERR_FILENO) {
+                (void) close(fd);
+            }
+        }
+        execl("/bin/sh", "sh", "-c", cmd, (char *) NULL);
+        _exit(127);                     /* execl() error */
+    }
+    log_msg(LOG_INFO, "Console [%s] trigger \"%s\" invoked \"%s\" (pid %d)",
+        console->name, trig->pattern, cmd, (int) pid);
+    return;
+}
@@ -45,13 +45,13 @@
 #include "util-str.h"
 
 
+static void defer_unixsock_obj_via_inotify(obj_t *unixsock);
 static int open_unixsock_obj_via_inotify(obj_t *unixsock);
 static size_t max_unixsock_dev_strlen(void);
 static int connect_unixsock_obj(obj_t *unixsock);
 static int disconnect_unixsock_obj(obj_t *unixsock);
 static void reset_unixsock_delay(obj_t *unixsock);
 
-extern tpoll_t tp_global;               /* defined in server.c */
 
 
 int is_unixsock_dev(const char *dev, const char *cwd, char **path_ref)
@@ -90,7 +90,6 @@ obj_t * create_unixsock_obj(server_conf_t *conf, char *name, char *dev,
  *  Returns the new objects, or NULL on error.
  */
     size_t        n;
-    ListIterator  i;
     obj_t        *unixsock;
     int           rv;
 
@@ -113,27 +112,19 @@ obj_t * create_unixsock_obj(server_conf_t *conf, char *name, char *dev,
     }
     /*  Check for duplicate console and device names.
      */
-    i = list_iterator_create(conf->objs);
-    while ((unixsock = list_next(i))) {
-        if (is_console_obj(unixsock) && !strcmp(unixsock->name, name)) {
-            if ((errbuf != NULL) && (errlen > 0)) {
-                snprintf(errbuf, errlen,
-                    "console [%s] specifies duplicate console name", name);
-            }
-            break;
-        }
-        if (is_unixsock_obj(unixsock)
-                && !strcmp(unixsock->aux.unixsock.dev, dev)) {
-            if ((errbuf != NULL) && (errlen > 0)) {
-                snprintf(errbuf, errlen,
-                    "console [%s] specifies duplicate device \"%s\"",
-                    name, dev);
-            }
-            break;
+    if (find_console_obj(conf, name)) {
+        if ((errbuf != NULL) && (errlen > 0)) {
+            snprintf(errbuf, errlen,
+                "console [%s] specifies duplicate console name", name);
         }
+        return(NULL);
     }
-    list_iterator_destroy(i);
-    if (unixsock != NULL) {
+    if (find_obj_index(&conf->deviceIndex, dev, CONMAN_OBJ_UNIXSOCK)) {
+        if ((errbuf != NULL) && (errlen > 0)) {
+            snprintf(errbuf, errlen,
+                "console [%s] specifies duplicate device \"%s\"",
+                name, dev);
+        }
         return(NULL);
     }
     unixsock = create_obj(conf, name, -1, CONMAN_OBJ_UNIXSOCK);
@@ -144,12 +135,15 @@ obj_t * create_unixsock_obj(server_conf_t *conf, char *name, char *dev,
     unixsock->aux.unixsock.isViaInotify = 0;
     unixsock->aux.unixsock.delay = UNIXSOCK_MIN_TIMEOUT;
     /*
-     *  Add obj to the master conf->objs list.
+     *  Add obj to the master conf->objs list
+     *    and index it by name and device.
      */
     list_append(conf->objs, unixsock);
+    insert_obj_index(&conf->consoleIndex, name, unixsock);
+    insert_obj_index(&conf->deviceIndex, unixsock->aux.unixsock.dev, unixsock);
 
     rv = inevent_add(unixsock->aux.unixsock.dev,
-        (inevent_cb_f) open_unixsock_obj_via_inotify, unixsock);
+        (inevent_cb_f) defer_unixsock_obj_via_inotify, unixsock);
     if (rv < 0) {
         log_msg(LOG_INFO,
             "Console [%s] unable to register device \"%s\" for inotify events",
@@ -179,6 +173,20 @@ int open_unixsock_obj(obj_t *unixsock)
 }
 
 
+static void defer_unixsock_obj_via_inotify(obj_t *unixsock)
+{
+/*  Schedules the specified 'unixsock' obj to be opened via an inotify
+ *    callback by the reactor servicing it.
+ *  The inotify events are processed by the main thread.
+ */
+    assert(unixsock != NULL);
+    assert(is_unixsock_obj(unixsock));
+
+    defer_obj_callback(unixsock, (callback_f) open_unixsock_obj_via_inotify);
+    return;
+}
+
+
 static int open_unixsock_obj_via_inotify(obj_t *unixsock)
 {
 /*  Opens the specified 'unixsock' obj via an inotify callback.
@@ -222,6 +230,7 @@ static int connect_unixsock_obj(obj_t *unixsock)
     struct stat         st;
     struct sockaddr_un  saddr;
     size_t              n;
+    int                 fd;
 
     assert(unixsock != NULL);
     assert(is_unixsock_obj(unixsock));
@@ -234,7 +243,7 @@ static int connect_unixsock_obj(obj_t *unixsock)
     auxp->isViaInotify = 0;
 
     if (auxp->timer >= 0) {
-        (void) tpoll_timeout_cancel(tp_global, auxp->timer);
+        (void) tpoll_timeout_cancel(unixsock->tp, auxp->timer);
         auxp->timer = -1;
     }
 
@@ -265,11 +274,12 @@ static int connect_unixsock_obj(obj_t *unixsock)
             unixsock->name, (unsigned long) sizeof(saddr.sun_path) - 1);
         return(disconnect_unixsock_obj(unixsock));
     }
-    if ((unixsock->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
         log_msg(LOG_INFO, "Console [%s] cannot create socket: %s",
             unixsock->name, strerror(errno));
         return(disconnect_unixsock_obj(unixsock));
     }
+    set_obj_fd(unixsock, fd);
     set_fd_nonblocking(unixsock->fd);
     set_fd_closed_on_exec(unixsock->fd);
 
@@ -298,12 +308,12 @@ static int connect_unixsock_obj(obj_t *unixsock)
      */
     unixsock->gotEOF = 0;
     auxp->state = CONMAN_UNIXSOCK_UP;
-    tpoll_set(tp_global, unixsock->fd, POLLIN);
+    tpoll_set(unixsock->tp, unixsock->fd, POLLIN);
 
     /*  Require the connection to be up for a minimum length of time before
      *    resetting the reconnect-delay back to the minimum.
      */
-    auxp->timer = tpoll_timeout_relative(tp_global,
+    auxp->timer = tpoll_timeout_relative(unixsock->tp,
         (callback_f) reset_unixsock_delay, unixsock, MIN_CONNECT_SECS * 1000);
 
     /*  Notify linked objs when transitioning into an UP state.
@@ -324,6 +334,7 @@ static int disconnect_unixsock_obj(obj_t *unixsock)
  *  Always returns -1.
  */
     unixsock_obj_t *auxp;
+    int fd;
 
     assert(unixsock != NULL);
     assert(is_unixsock_obj(unixsock));
@@ -331,16 +342,15 @@ static int disconnect_unixsock_obj(obj_t *unixsock)
     auxp = &(unixsock->aux.unixsock);
 
     if (auxp->timer >= 0) {
-        (void) tpoll_timeout_cancel(tp_global, auxp->timer);
+        (void) tpoll_timeout_cancel(unixsock->tp, auxp->timer);
         auxp->timer = -1;
     }
     if (unixsock->fd >= 0) {
-        tpoll_clear(tp_global, unixsock->fd, POLLIN | POLLOUT);
-        if (close(unixsock->fd) < 0) {
+        fd = detach_obj_fd(unixsock);
+        if (close(fd) < 0) {
             log_msg(LOG_WARNING, "Console [%s] cannot close device \"%s\": %s",
                 unixsock->name, auxp->dev, strerror(errno));
         }
-        unixsock->fd = -1;
     }
     /*  Notify linked objs when transitioning from an UP state.
      */
@@ -352,7 +362,7 @@ static int disconnect_unixsock_obj(obj_t *unixsock)
     }
     /*  Set timer for establishing new connection.
      */
-    auxp->timer = tpoll_timeout_relative(tp_global,
+    auxp->timer = tpoll_timeout_relative(unixsock->tp,
         (callback_f) connect_unixsock_obj, unixsock, auxp->delay * 1000);
 
     if (auxp->delay < UNIXSOCK_MAX_TIMEOUT) {
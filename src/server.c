@@ -72,6 +72,8 @@ static void mux_io(server_conf_t *conf);
 static void open_daemon_logfile(server_conf_t *conf);
 static void reopen_logfiles(server_conf_t *conf);
 static void accept_client(server_conf_t *conf);
+static void pause_accept(server_conf_t *conf, int errnum);
+static void resume_accept(server_conf_t *conf);
 
 /*  Signal handler flags and whatnot.
  */
@@ -80,6 +82,12 @@ static volatile sig_atomic_t reconfig = 0;
 static int coredump = 0;
 static char coredumpdir[PATH_MAX];
 
+/*  Time accept() last failed for lack of fds, and the number of failures
+ *    since the last warning was logged.
+ */
+static time_t acceptErrTime = 0;
+static int numAcceptErrs = 0;
+
 /*  The 'tp_global' var is to allow timers to be set or canceled
  *    without having to pass the conf's tp var through the call stack.
  */
@@ -119,6 +127,7 @@ int main(int argc, char *argv[])
         log_err(0, "Configuration \"%s\" has no consoles defined",
             conf->confFileName);
     }
+    create_reactors(conf);
     if (conf->enableVerbose) {
         display_configuration(conf);
     }
@@ -154,7 +163,13 @@ int main(int argc, char *argv[])
 
     setup_nofile_limit(conf);
     open_objs(conf);
+    start_reactors(conf);
+    start_resolver();
+    start_client_workers(conf);
     mux_io(conf);
+    stop_client_workers(conf);
+    stop_resolver();
+    stop_reactors(conf);
 
 #if WITH_FREEIPMI
     ipmi_fini();
@@ -536,6 +551,10 @@ static void display_configuration(server_conf_t *conf)
         fprintf(stderr, " TCP-Wrappers");
         gotOptions++;
     }
+    if (conf->numThreads > 1) {
+        fprintf(stderr, " Threads=%d", conf->numThreads);
+        gotOptions++;
+    }
     if (conf->tStampMinutes > 0) {
         fprintf(stderr, " TimeStamp=%dm", conf->tStampMinutes);
         gotOptions++;
@@ -666,7 +685,7 @@ static void create_listen_socket(server_conf_t *conf)
     if (bind(ld, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
         log_err(errno, "Unable to bind to port %d", conf->port);
     }
-    if (listen(ld, 10) < 0) {
+    if (listen(ld, SOMAXCONN) < 0) {
         log_err(errno, "Unable to listen on port %d", conf->port);
     }
     /* Retrieve the ephemeral port number bound to the listen socket.
@@ -751,11 +770,11 @@ static void mux_io(server_conf_t *conf)
 /*  Multiplexes I/O between all of the objs in the configuration.
  *  This routine is the heart of ConMan.
  */
-    ListIterator i;
+    List dead;
     int n;
-    obj_t *obj;
+    int k;
+    int fd;
     int inevent_fd;
-    int rvr, rvw;
 
     assert(conf->tp != NULL);
     assert(!list_is_empty(conf->objs));
@@ -764,7 +783,7 @@ static void mux_io(server_conf_t *conf)
     if (inevent_fd >= 0) {
         tpoll_set(conf->tp, inevent_get_fd(), POLLIN);
     }
-    i = list_iterator_create(conf->objs);
+    dead = list_create(NULL);
 
     while (!done) {
 
@@ -775,9 +794,15 @@ static void mux_io(server_conf_t *conf)
              */
             log_msg(LOG_NOTICE, "Performing reconfig on signal=%d", reconfig);
             reopen_logfiles(conf);
+            log_resolver_stats();
             reconfig = 0;
         }
-        while ((n = tpoll(conf->tp, -1)) < 0) {
+        /*  The timeout bounds how long an exit or reconfig signal can go
+         *    unnoticed if it arrives while tpoll() is dispatching timers
+         *    (instead of blocked in poll) and no fds on this reactor become
+         *    ready (eg, when only the logfile reactor has I/O to perform).
+         */
+        while ((n = tpoll(conf->tp, 1000)) < 0) {
             if (errno != EINTR) {
                 log_err(errno, "Unable to multiplex I/O");
             }
@@ -785,43 +810,38 @@ static void mux_io(server_conf_t *conf)
                 break;
             }
         }
-        if ((n > 0) &&
-                (tpoll_is_set(conf->tp, conf->ld, POLLIN) > 0)) {
-            n--;
-            accept_client(conf);
-        }
-        if ((inevent_fd >= 0) &&
-                (n > 0) &&
-                (tpoll_is_set(conf->tp, inevent_fd, POLLIN) > 0)) {
-            n--;
-            inevent_process();
-        }
-        /*  If read_from_obj() or write_to_obj() returns -1,
+        /*  Only the fds reported ready by tpoll() are examined; each is
+         *    dispatched to its obj via the fd-to-obj table.
+         *  If read_from_obj() or write_to_obj() returns -1,
          *    the obj's buffer has been flushed.  If it is a console obj,
          *    retain it and attempt to re-establish the connection;
-         *    o/w, give up and remove it from the master objs list.
+         *    o/w, give up and queue it for removal from the master objs list
+         *    once all of the ready fds have been dispatched (and the other
+         *    reactors can no longer be referencing it).
          */
-        list_iterator_reset(i);
-        while ((n > 0) &&
-                ((obj = list_next(i)) != NULL)) {
-
-            rvr = tpoll_is_set(conf->tp, obj->fd, POLLIN | POLLHUP | POLLERR);
-            rvw = tpoll_is_set(conf->tp, obj->fd, POLLOUT);
-            if ((rvr > 0) || (rvw > 0)) {
-                n--;
+        for (k = 0; (n > 0) && ((fd = tpoll_ready(conf->tp, k)) >= 0); k++) {
+
+            if (fd == conf->ld) {
+                if (tpoll_is_set(conf->tp, conf->ld, POLLIN) > 0) {
+                    accept_client(conf);
+                }
+                continue;
             }
-            if ((rvr > 0) && (read_from_obj(obj) < 0)) {
-                list_delete(i);
+            if (fd == inevent_fd) {
+                if (tpoll_is_set(conf->tp, inevent_fd, POLLIN) > 0) {
+                    inevent_process();
+                }
                 continue;
             }
-            if ((rvw > 0) && (write_to_obj(obj) < 0)) {
-                list_delete(i);
+            if (dispatch_client_handshake(conf, fd)) {
                 continue;
             }
+            dispatch_obj_io(conf->tp, fd, dead);
         }
+        reclaim_objs(conf, dead);
     }
     log_msg(LOG_NOTICE, "Exiting on signal=%d", done);
-    list_iterator_destroy(i);
+    list_destroy(dead);
     return;
 }
 
@@ -933,6 +953,8 @@ err:
 static void reopen_logfiles(server_conf_t *conf)
 {
 /*  Reopens the daemon logfile and all of the logfiles in the 'objs' list.
+ *  Each console logfile is reopened by the logfile reactor so a slow
+ *    filesystem does not block mux_io().
  */
     ListIterator i;
     obj_t *logfile;
@@ -942,7 +964,7 @@ static void reopen_logfiles(server_conf_t *conf)
         if (!is_logfile_obj(logfile)) {
             continue;
         }
-        open_logfile_obj(logfile);
+        defer_obj_callback(logfile, (callback_f) open_logfile_obj);
     }
     list_iterator_destroy(i);
 
@@ -955,64 +977,92 @@ static void reopen_logfiles(server_conf_t *conf)
 
 static void accept_client(server_conf_t *conf)
 {
-/*  Accepts a new client connection on the listening socket.
- *  The new socket connection must be accept()'d within the poll() loop.
- *    O/w, the following scenario could occur:  Read activity would be
- *    poll()'d on the listen socket.  A new thread would be created to
- *    process this request.  Before this new thread is scheduled and the
- *    socket connection is accept()'d, the poll() loop begins its next
- *    iteration.  It notices read activity on the listen socket from the
- *    client that has not yet been accepted, so a new thread is created.
- *    Since the listen socket is set non-blocking, this new thread would
- *    receive an EAGAIN/EWOULDBLOCK on the accept() and terminate, but still...
+/*  Accepts new client connections on the listening socket.
+ *  The new socket connections must be accept()'d within the poll() loop.
+ *    Each is then handed to start_client_handshake() which reads the
+ *    client's greeting and request as they arrive without blocking,
+ *    and passes them on to the fixed pool of client worker threads.
+ *  All pending connections are accepted at once so a burst of clients
+ *    does not overflow the listen backlog.
  */
     int sd;
     const int on = 1;
-    client_arg_t *args;
-    int rc;
-    pthread_t tid;
 
-    while ((sd = accept(conf->ld, NULL, NULL)) < 0) {
-        if (errno == EINTR) {
-            continue;
-        }
-        if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
-            return;
+    for (;;) {
+        while ((sd = accept(conf->ld, NULL, NULL)) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                return;
+            }
+            if (errno == ECONNABORTED) {
+                return;
+            }
+            if ((errno == EMFILE) || (errno == ENFILE)) {
+                pause_accept(conf, errno);
+                return;
+            }
+            log_err(errno, "Unable to accept new connection");
         }
-        if (errno == ECONNABORTED) {
-            return;
+        DPRINTF((5, "Accepted new client on fd=%d.\n", sd));
+
+        /*  While the listen fd is non-blocking, new fds that are accept()d
+         *    from it can be either blocking or non-blocking depending on the
+         *    platform.  The handshake is driven by the poll() loop,
+         *    so the new fd is forced to be non-blocking here for portability.
+         */
+        set_fd_nonblocking(sd);
+        set_fd_closed_on_exec(sd);
+
+        if (conf->enableKeepAlive) {
+            if (setsockopt(sd, SOL_SOCKET, SO_KEEPALIVE,
+              (const void *) &on, sizeof(on)) < 0) {
+                log_err(errno, "Unable to set KEEPALIVE socket option");
+            }
         }
-        log_err(errno, "Unable to accept new connection");
+        start_client_handshake(conf, sd);
     }
-    DPRINTF((5, "Accepted new client on fd=%d.\n", sd));
+}
 
-    /*  While the listen fd is non-blocking, new fds that are accept()d from
-     *    it can be either blocking or non-blocking depending on the platform.
-     *  The current model spawns a thread to handle a new client with
-     *    blocking I/O.  Once the client request has been processed,
-     *    this fd is set non-blocking and moved to the main fd set.
-     *  Consequently, we force the new fd to be blocking here for portability.
-     */
-    set_fd_blocking(sd);
 
-    if (conf->enableKeepAlive) {
-        if (setsockopt(sd, SOL_SOCKET, SO_KEEPALIVE,
-          (const void *) &on, sizeof(on)) < 0) {
-            log_err(errno, "Unable to set KEEPALIVE socket option");
-        }
+static void pause_accept(server_conf_t *conf, int errnum)
+{
+/*  Stops polling the listening socket after accept() has run out of fds.
+ *  Since the pending connection remains queued on the (level-triggered)
+ *    listening socket, it would otherwise be reported ready on every pass
+ *    through the poll() loop.  Polling resumes after CLIENT_ACCEPT_RETRY
+ *    seconds, by which time some fds may have been closed.
+ *  The warning is logged at most once every CLIENT_ACCEPT_WARN_INTERVAL
+ *    seconds along with the number of failures since the last one.
+ */
+    time_t now;
+
+    tpoll_clear(conf->tp, conf->ld, POLLIN);
+    if (tpoll_timeout_relative(conf->tp, (callback_f) resume_accept, conf,
+            CLIENT_ACCEPT_RETRY * 1000) < 0) {
+        log_msg(LOG_WARNING,
+            "Unable to create timer for accepting new connections");
+        tpoll_set(conf->tp, conf->ld, POLLIN);
     }
-    /*  Create a tmp struct to hold two args to pass to the thread.
-     *  Note that the thread is responsible for freeing this memory.
-     */
-    if (!(args = malloc(sizeof(client_arg_t)))) {
-        out_of_memory();
+    numAcceptErrs++;
+    now = time(NULL);
+    if ((now - acceptErrTime >= CLIENT_ACCEPT_WARN_INTERVAL)
+            || (now < acceptErrTime)) {
+        log_msg(LOG_WARNING,
+            "Unable to accept new connection: %s (%d time%s)",
+            strerror(errnum), numAcceptErrs, (numAcceptErrs == 1) ? "" : "s");
+        acceptErrTime = now;
+        numAcceptErrs = 0;
     }
-    args->sd = sd;
-    args->conf = conf;
+    return;
+}
 
-    if ((rc = pthread_create(&tid, NULL,
-      (PthreadFunc) process_client, args)) != 0) {
-        log_err(rc, "Unable to create new thread");
-    }
+
+static void resume_accept(server_conf_t *conf)
+{
+/*  Resumes polling the listening socket for new connections.
+ */
+    tpoll_set(conf->tp, conf->ld, POLLIN);
     return;
 }
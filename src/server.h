@@ -40,14 +40,20 @@
 #include <termios.h>                    /* for struct termios, speed_t       */
 #include <time.h>                       /* for time_t                        */
 #include <unistd.h>                     /* for pid_t                         */
+#include "acmatch.h"
 #include "common.h"
 #include "list.h"
 #include "tpoll.h"
 
 
+#define DEFAULT_LOGOPT_BUFSIZE          OBJ_BUF_SIZE
 #define DEFAULT_LOGOPT_LOCK             1
 #define DEFAULT_LOGOPT_SANITIZE         0
 #define DEFAULT_LOGOPT_TIMESTAMP        0
+#define DEFAULT_LOGOPT_COMPRESS         0
+#define DEFAULT_LOGOPT_TSFORMAT         CONMAN_TS_SEC
+#define DEFAULT_LOGOPT_ROTATE_KEEP      5
+#define MAX_LOGOPT_ROTATE_KEEP          999
 
 #define DEFAULT_SEROPT_BPS              B9600
 #define DEFAULT_SEROPT_DATABITS         8
@@ -56,6 +62,19 @@
 
 #define MIN_CONNECT_SECS                60
 
+#define CLIENT_ACCEPT_RETRY             1
+#define CLIENT_ACCEPT_WARN_INTERVAL     60
+#define CLIENT_HANDSHAKE_TIMEOUT        30
+#define CLIENT_MUX_BUF_LEN              65536
+#define CLIENT_STREAM_THREADS           16
+#define CLIENT_WORKER_THREADS           4
+
+#define RESOLVE_CACHE_SIZE              4096
+#define RESOLVE_NEGATIVE_TTL            60
+#define RESOLVE_POSITIVE_TTL            300
+#define RESOLVE_TIMEOUT                 2
+#define RESOLVER_THREADS                8
+
 #if WITH_FREEIPMI
 #define IPMI_ENGINE_CONSOLES_PER_THREAD 128
 #define IPMI_MAX_USER_LEN               IPMI_MAX_USER_NAME_LENGTH
@@ -73,6 +92,8 @@
 
 #define RESOLVE_RETRY_TIMEOUT           1800
 
+#define TRIGGER_HOLDOFF                 10
+
 #define TELNET_MAX_TIMEOUT              1800
 #define TELNET_MIN_TIMEOUT              15
 
@@ -96,17 +117,93 @@ enum obj_type {                         /* type of auxiliary obj             */
     CONMAN_OBJ_LAST_ENTRY
 };
 
+typedef struct obj_chunk {              /* CHUNK OF DATA READ FROM CONSOLE:  */
+    struct obj_chunk *next;             /*  next (newer) chunk in chain      */
+    unsigned long    seq;               /*  chain offset of 1st byte in chunk*/
+    int              len;               /*  num bytes of data in chunk       */
+    int              numRefs;           /*  num cursors positioned in chunk  */
+    unsigned char    data[OBJ_CHUNK_SIZE];
+} obj_chunk_t;
+
+typedef struct obj_cursor {             /* READER CURSOR INTO A CHAIN:       */
+    struct obj_cursor *next;            /*  next cursor reading same chain   */
+    struct obj_chain *chain;            /*  chain being read                 */
+    struct base_obj  *obj;              /*  obj writing chain data to its fd */
+    obj_chunk_t      *chunk;            /*  chunk containing next byte       */
+    int               offset;           /*  offset of next byte within chunk */
+} obj_cursor_t;
+
+typedef struct obj_chain {              /* SHARED CHAIN OF CONSOLE DATA:     */
+    obj_chunk_t     *head;              /*  oldest chunk still referenced    */
+    obj_chunk_t     *tail;              /*  newest chunk being appended to   */
+    obj_cursor_t    *cursors;           /*  list of cursors reading chain    */
+    unsigned long    seq;               /*  chain offset of next byte append */
+    int              numRefs;           /*  num refs (console + cursors)     */
+    int              gotWake;           /*  true if readers' wake is pending */
+    pthread_mutex_t  lock;              /*  lock protecting chain & cursors  */
+} obj_chain_t;
+
+typedef struct obj_history {            /* CONSOLE SCROLLBACK HISTORY:       */
+    unsigned char   *buf;               /*  ring within the history arena    */
+    int              size;              /*  size of ring in bytes            */
+    int              len;               /*  num bytes of data in ring        */
+    int              in;                /*  offset at which next byte goes   */
+    pthread_mutex_t  lock;              /*  lock protecting access to ring   */
+} obj_history_t;
+
+typedef struct obj_index_entry {        /* ENTRY IN AN OBJ HASH INDEX:       */
+    struct obj_index_entry *next;       /*  next entry in hash bucket        */
+    struct base_obj  *obj;              /*  obj indexed by key               */
+    char            *key;               /*  key string                       */
+    unsigned         hash;              /*  hash value of key                */
+} obj_index_entry_t;
+
+typedef struct obj_index {              /* OBJ HASH INDEX KEYED BY STRING:   */
+    obj_index_entry_t **buckets;        /*  hash buckets (power of 2)        */
+    int              numBuckets;        /*  num hash buckets allocated       */
+    int              numEntries;        /*  num entries in index             */
+} obj_index_t;
+
+typedef struct trigger {                /* CONSOLE OUTPUT TRIGGER:           */
+    char            *pattern;           /*  text whose output fires trigger  */
+    char            *consoles;          /*  glob of console names, or NULL   */
+    char            *cmd;               /*  cmd to exec when fired, or NULL  */
+    unsigned         doNotify:1;        /*  true if notifying console objs   */
+    unsigned         doSyslog:1;        /*  true if logging a message        */
+} trigger_t;
+
+typedef struct trigger_set {            /* COMPILED TRIGGERS:                */
+    acm_t            acm;               /*  matcher for all trigger patterns */
+    trigger_t      **triggers;          /*  triggers indexed by pattern id   */
+    int              numTriggers;       /*  num triggers in array            */
+} trigger_set_t;
+
+typedef struct log_reader log_reader_t; /* opaque; see server-logindex.c   */
+typedef struct log_search log_search_t; /* opaque; see server-search.c     */
+typedef struct mux_conn mux_conn_t;     /* opaque; see server-mux.c        */
+
 typedef struct client_obj {             /* CLIENT AUX OBJ DATA:              */
     req_t           *req;               /*  client request info              */
+    obj_cursor_t    *cursor;            /*  cursor into console's data chain */
+    log_reader_t    *replay;            /*  deep log replay, or NULL if none */
     time_t           timeLastRead;      /*  time last data was read from fd  */
+    mux_conn_t      *mux;               /*  channels if multiplexed, or NULL */
+    struct base_obj *conn;              /*  mux conn obj if channel, or NULL */
+    int              credit;            /*  num bytes channel may yet send   */
     unsigned         gotEscape:1;       /*  true if last char rcvd was esc   */
     unsigned         gotSuspend:1;      /*  true if suspending client output */
 } client_obj_t;
 
 typedef struct logfile_opt {            /* LOGFILE OBJ OPTIONS:              */
+    int              bufSize;           /*  max size of circular-buf in bytes*/
+    off_t            rotateSize;        /*  rotate at this size, or 0 if not */
+    int              rotateSecs;        /*  rotate at this age, or 0 if not  */
+    int              rotateKeep;        /*  num of rotated logfiles to keep  */
     unsigned         enableLock:1;      /*  true if logfile being locked     */
     unsigned         enableSanitize:1;  /*  true if logfile being sanitized  */
     unsigned         enableTimestamp:1; /*  true if timestamping each line   */
+    unsigned         enableCompress:1;  /*  true if logfile being compressed */
+    unsigned         tsFormat:3;        /*  timestamp_fmt_t of line stamps   */
 } logopt_t;
 
 typedef enum logfile_line_state {       /* log CR/LF newline state (2 bits)  */
@@ -120,7 +217,21 @@ typedef struct logfile_obj {            /* LOGFILE AUX OBJ DATA:             */
     struct base_obj *console;           /*  con obj ref for name expansion   */
     char            *fmtName;           /*  name with conversion specifiers  */
     logopt_t         opts;              /*  local options                    */
+    unsigned char   *outBuf;            /*  buf data being written to file   */
+    int              outLen;            /*  num bytes in outBuf to write     */
+    int              outSize;           /*  size of outBuf in bytes          */
+    int              flushTimer;        /*  timer id for coalesced write     */
+    unsigned char   *zBuf;              /*  compressed frame being written   */
+    int              zLen;              /*  num bytes in zBuf to write       */
+    int              zSize;             /*  size of zBuf in bytes            */
+    int              frameTimer;        /*  timer id for compressing frame   */
+    off_t            fileSize;          /*  bytes written to current file    */
+    time_t           timeRotate;        /*  time due for rotation, or 0      */
+    int              idxFd;             /*  fd of sidecar time index, or -1  */
+    off_t            idxOffset;         /*  file offset of last index entry  */
+    time_t           idxTime;           /*  time of last index entry, or 0   */
     unsigned         gotProcessing:1;   /*  true if input processing req'd   */
+    unsigned         gotFrameFlush:1;   /*  true if frame is to be written   */
     unsigned         gotTruncate:1;     /*  true if ZeroLogs is enabled      */
     unsigned         lineState:2;       /*  log_line_state_t CR/LF state     */
 } logfile_obj_t;
@@ -253,22 +364,46 @@ typedef union aux_obj {
 
 typedef struct base_obj {               /* BASE OBJ:                         */
     char            *name;              /*  obj name                         */
+    int              id;                /*  index in conf's consoleTable     */
     int              fd;                /*  file descriptor                  */
-    unsigned char    buf[OBJ_BUF_SIZE]; /*  circular-buf to be written to fd */
+    tpoll_t          tp;                /*  tpoll obj of reactor servicing me*/
+    unsigned char   *buf;               /*  circular-buf to be written to fd */
+    int              bufSize;           /*  size of buf (0 if not yet alloc) */
+    int              bufMaxSize;        /*  size limit to which buf can grow */
     unsigned char   *bufInPtr;          /*  ptr for data written in to buf   */
     unsigned char   *bufOutPtr;         /*  ptr for data written out to fd   */
     pthread_mutex_t  bufLock;           /*  lock protecting access to buf    */
+    obj_chain_t     *chain;             /*  chain of data read (consoles)    */
+    obj_history_t   *history;           /*  scrollback history (consoles)    */
+    trigger_set_t   *trigSet;           /*  triggers matched against output  */
+    int              trigState;         /*  matcher state, or -1 if unused   */
+    time_t          *trigTimes;         /*  time each trigger was last fired */
+    unsigned long    numReadBytes;      /*  num bytes read from fd           */
+    unsigned long    numReadCalls;      /*  num read() calls on fd           */
+    unsigned long    numReadWakeups;    /*  num times fd was found readable  */
     List             readers;           /*  list of objs that read from me   */
+    struct base_obj **readerArray;      /*  flat copy of readers for fan-out */
+    int              numReaders;        /*  num of objs in readerArray       */
+    int              maxReaders;        /*  num of slots alloc'd in array    */
+    pthread_mutex_t  readersLock;       /*  lock protecting readerArray      */
     List             writers;           /*  list of objs that write to me    */
     char            *resetCmdRef;       /*  console reset cmd string ref     */
     pid_t            resetCmdPid;       /*  console reset cmd active pid     */
     int              resetCmdTimer;     /*  console reset cmd timer id       */
+    int              gotReclaim;        /*  true if obj is being reclaimed   */
     unsigned         type;              /*  enum obj_type of auxiliary obj   */
     unsigned         gotBufWrap:1;      /*  true if circular-buf has wrapped */
     unsigned         gotEOF:1;          /*  true if obj got EOF on last read */
     aux_obj_t        aux;               /*  auxiliary obj data union         */
 } obj_t;
 
+typedef struct reactor {                /* REACTOR THREAD:                   */
+    tpoll_t          tp;                /*  tpoll obj for muxing i/o & timers*/
+    pthread_t        tid;               /*  thread id (unused for reactor 0) */
+    int              fd_pipe[2];        /*  pipe for waking the reactor      */
+    int              gotDone;           /*  true if reactor should exit      */
+} reactor_t;
+
 typedef struct server_conf {
     char            *confFileName;      /* configuration file name           */
     char            *coreDumpDir;       /* dir where core dumps are written  */
@@ -290,8 +425,24 @@ typedef struct server_conf {
     int              port;              /* port number on which to listen    */
     int              ld;                /* listening socket descriptor       */
     List             objs;              /* list of all server obj_t's        */
+    ListIterator     objsCursor;        /* cursor into objs while parsing    */
+    obj_index_t      consoleIndex;      /* console objs indexed by name      */
+    obj_index_t      logfileIndex;      /* logfile objs indexed by pathname  */
+    obj_index_t      deviceIndex;       /* console objs indexed by device    */
+    struct base_obj **consoleTable;     /* console objs in compare_objs order*/
+    struct base_obj **consoleNames;     /* console objs in strcmp order      */
+    int              numConsoles;       /* num console objs in each table    */
+    char            *queryRsp;          /* cached rsp to QUERY all consoles  */
+    int              queryRspLen;       /* length of cached query rsp        */
     tpoll_t          tp;                /* tpoll obj for muxing i/o & timers */
+    int              numThreads;        /* number of i/o reactor threads     */
+    reactor_t       *reactors;          /* numThreads reactors + logfile one */
     char            *globalLogName;     /* global log name (must contain &)  */
+    int              globalHistSize;    /* global console history size       */
+    unsigned char   *histArena;         /* arena of console history rings    */
+    size_t           histArenaSize;     /* size of history arena in bytes    */
+    List             triggers;          /* list of trigger_t's in config     */
+    trigger_set_t   *trigSet;           /* compiled triggers, or NULL        */
     logopt_t         globalLogOpts;     /* global opts for logfile objects   */
     seropt_t         globalSerOpts;     /* global opts for serial objects    */
 #if WITH_FREEIPMI
@@ -308,11 +459,6 @@ typedef struct server_conf {
     unsigned         enableForeground:1;/* true if daemon should not fork    */
 } server_conf_t;
 
-typedef struct client_args {
-    int              sd;                /* socket descriptor of new client   */
-    server_conf_t   *conf;              /* server's configuration            */
-} client_arg_t;
-
 
 /*  Concering object READERS and WRITERS:
  *
@@ -368,6 +514,13 @@ typedef struct client_args {
 #define is_unixsock_obj(OBJ) (OBJ->type == CONMAN_OBJ_UNIXSOCK)
 #define is_console_obj(OBJ)  (OBJ->type &  CONMAN_OBJ_IS_CONSOLE)
 
+/*  A client's output is held while it is suspended, or while a channel
+ *    of a multiplexed connection has exhausted its flow-control credit.
+ */
+#define is_client_held(OBJ)  (OBJ->aux.client.gotSuspend || \
+                              (OBJ->aux.client.conn &&       \
+                               (OBJ->aux.client.credit <= 0)))
+
 
 /*  server-conf.c
  */
@@ -384,6 +537,29 @@ void process_config(server_conf_t *conf);
  */
 int process_client_escapes(obj_t *client, void *src, int len);
 
+int start_log_replay(obj_t *client, obj_t *console, int lines, time_t since);
+
+void feed_log_replay(obj_t *client, int len);
+
+
+/*  server-history.c
+ */
+int parse_history_size(int *sizep, const char *str);
+
+void create_obj_history(obj_t *console, int size);
+
+void destroy_obj_history(obj_t *console);
+
+void create_history_arena(server_conf_t *conf);
+
+void destroy_history_arena(server_conf_t *conf);
+
+void append_obj_history(obj_t *console, const void *src, int len);
+
+int copy_obj_history(obj_t *console, void *dst, int len);
+
+log_reader_t * create_console_reader(obj_t *console, int lines, time_t since);
+
 
 /* server-ipmi.c
  */
@@ -410,6 +586,26 @@ int send_ipmi_break(obj_t *ipmi);
 #endif /* WITH_FREEIPMI */
 
 
+/*  server-index.c
+ */
+void init_obj_index(obj_index_t *idx);
+
+void destroy_obj_index(obj_index_t *idx);
+
+void insert_obj_index(obj_index_t *idx, const char *key, obj_t *obj);
+
+obj_t * find_obj_index(obj_index_t *idx, const char *key, int type);
+
+obj_t * find_console_obj(server_conf_t *conf, const char *name);
+
+void create_console_table(server_conf_t *conf);
+
+void destroy_console_table(server_conf_t *conf);
+
+int find_console_range(server_conf_t *conf, const char *prefix, int len,
+    int *firstp);
+
+
 /*  server-logfile.c
  */
 int parse_logfile_opts(logopt_t *opts, const char *str,
@@ -420,11 +616,72 @@ obj_t * create_logfile_obj(server_conf_t *conf, char *name,
 
 int open_logfile_obj(obj_t *logfile);
 
+int is_logfile_rotate_due(obj_t *logfile);
+
+int rotate_logfile_obj(obj_t *logfile);
+
+int compress_logfile_frame(obj_t *logfile);
+
 obj_t * get_console_logfile_obj(obj_t *console);
 
 int write_log_data(obj_t *log, const void *src, int len);
 
 
+/*  server-logindex.c
+ */
+int open_logfile_index(obj_t *logfile, int doTruncate);
+
+void close_logfile_index(obj_t *logfile);
+
+void update_logfile_index(obj_t *logfile, off_t offset);
+
+void rename_logfile_index(const char *src, const char *dst);
+
+void remove_logfile_index(const char *name);
+
+log_reader_t * create_log_time_reader(obj_t *logfile,
+    time_t since, time_t until);
+
+log_reader_t * create_log_line_reader(obj_t *logfile, int lines);
+
+log_reader_t * create_log_buffer_reader(unsigned char *buf, int len,
+    int lines, int *numLinesp);
+
+int read_log_reader(log_reader_t *r, void *dst, int len);
+
+time_t get_log_reader_time(log_reader_t *r);
+
+void destroy_log_reader(log_reader_t *r);
+
+int write_logfile_range(obj_t *logfile, int sd, time_t since, time_t until);
+
+
+/*  server-mux.c
+ */
+mux_conn_t * create_mux_conn(server_conf_t *conf);
+
+void destroy_mux_conn(mux_conn_t *mux);
+
+obj_t * create_mux_channel(obj_t *conn, obj_t *console, req_t *req);
+
+int is_mux_channel_open(obj_t *conn, obj_t *console);
+
+int write_mux_frame(obj_t *conn, int type, int flags, int id,
+    const void *src, int len);
+
+int process_mux_frames(obj_t *conn, const void *src, int len);
+
+void queue_mux_channel(obj_t *chan);
+
+int frame_mux_channels(obj_t *conn);
+
+void idle_mux_conn(obj_t *conn);
+
+void close_mux_channels(obj_t *conn);
+
+void reap_mux_channels(obj_t *conn, List dead);
+
+
 /*  server-obj.c
  */
 obj_t * create_obj(server_conf_t *conf, char *name,
@@ -432,6 +689,12 @@ obj_t * create_obj(server_conf_t *conf, char *name,
 
 obj_t * create_client_obj(server_conf_t *conf, req_t *req);
 
+void wake_client_obj(obj_t *client);
+
+int drain_client_obj(obj_t *client, void *dst, int len, int *numLeftp);
+
+int get_obj_buf_len(obj_t *obj);
+
 void destroy_obj(obj_t *obj);
 
 void reopen_obj(obj_t *obj);
@@ -442,6 +705,12 @@ int compare_objs(obj_t *obj1, obj_t *obj2);
 
 int find_obj(obj_t *obj, obj_t *key);
 
+void set_obj_fd(obj_t *obj, int fd);
+
+int detach_obj_fd(obj_t *obj);
+
+obj_t * find_obj_by_fd(int fd);
+
 int write_notify_msg(obj_t *console, int priority, char *fmt, ...);
 
 void notify_console_objs(obj_t *console, char *msg);
@@ -456,11 +725,43 @@ int shutdown_obj(obj_t *obj);
 
 int read_from_obj(obj_t *obj);
 
+void forward_obj_data(obj_t *obj, const void *src, int len);
+
 int write_obj_data(obj_t *obj, const void *src, int len, int isInfo);
 
 int write_to_obj(obj_t *obj);
 
 
+/*  server-reactor.c
+ */
+void create_reactors(server_conf_t *conf);
+
+void start_reactors(server_conf_t *conf);
+
+void stop_reactors(server_conf_t *conf);
+
+void destroy_reactors(server_conf_t *conf);
+
+void dispatch_obj_io(tpoll_t tp, int fd, List dead);
+
+void reclaim_objs(server_conf_t *conf, List dead);
+
+void defer_obj_callback(obj_t *obj, callback_f cb);
+
+
+/*  server-resolve.c
+ */
+void start_resolver(void);
+
+void stop_resolver(void);
+
+void prefetch_addr_name(const struct in_addr *addr);
+
+char * resolve_addr_name(const struct in_addr *addr, char *dst, int dstlen);
+
+void log_resolver_stats(void);
+
+
 /*  server-process.c
  */
 int is_process_dev(const char *dev, const char *cwd,
@@ -472,6 +773,17 @@ obj_t * create_process_obj(server_conf_t *conf, char *name, List args,
 int open_process_obj(obj_t *process);
 
 
+/*  server-search.c
+ */
+log_search_t * create_log_search(const char *pattern, int isLiteral,
+    char *errbuf, int errlen);
+
+void destroy_log_search(log_search_t *s);
+
+int run_log_search(log_search_t *s, List consoles, int sd,
+    time_t since, time_t until);
+
+
 /*  server-serial.c
  */
 int is_serial_dev(const char *dev, const char *cwd, char **path_ref);
@@ -489,7 +801,19 @@ int open_serial_obj(obj_t *serial);
 
 /*  server-sock.c
  */
-void process_client(client_arg_t *args);
+void start_client_workers(server_conf_t *conf);
+
+void stop_client_workers(server_conf_t *conf);
+
+void start_client_handshake(server_conf_t *conf, int sd);
+
+int dispatch_client_handshake(server_conf_t *conf, int fd);
+
+void create_query_rsp(server_conf_t *conf);
+
+void destroy_query_rsp(server_conf_t *conf);
+
+int open_mux_channels(obj_t *conn, server_conf_t *conf, char *buf);
 
 
 /*  server-telnet.c
@@ -523,6 +847,20 @@ int open_test_obj(obj_t *test);
 int read_test_obj(obj_t *test);
 
 
+/*  server-trigger.c
+ */
+trigger_t * create_trigger(const char *pattern, const char *consoles,
+    const char *actions, const char *cmd, char *errbuf, int errlen);
+
+void destroy_trigger(trigger_t *trig);
+
+void create_trigger_set(server_conf_t *conf);
+
+void destroy_trigger_set(server_conf_t *conf);
+
+void match_obj_triggers(obj_t *console, const void *src, int len);
+
+
 /*  server-unixsock.c
  */
 int is_unixsock_dev(const char *dev, const char *cwd, char **path_ref);
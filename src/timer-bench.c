@@ -0,0 +1,206 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The timer-bench utility measures the cost of tpoll's timer operations
+ *    with many timers active, as with one reset timer per console.
+ *  It sets N timers at random expiration times (half of which have already
+ *    expired and half of which lie an hour or more in the future), cancels
+ *    and re-arms each of the future timers at a new random time, and then
+ *    dispatches the expired timers with a single non-blocking tpoll().
+ *  Only the public tpoll API is used, so the same source can be linked
+ *    against other tpoll implementations for comparison.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "log.h"
+#include "tpoll.h"
+#include "util.h"
+
+
+#define BENCH_RANGE_SECS        3600
+
+
+static void display_help(const char *prog);
+static void get_random_time(struct timeval *tvp, const struct timeval *now,
+    int isExpired);
+static void count_dispatch(void *arg);
+static double get_secs(void);
+
+
+int main(int argc, char *argv[])
+{
+    int c;
+    int numTimers = 50000;
+    tpoll_t tp;
+    struct timeval now;
+    struct timeval tv;
+    int *ids;
+    long numDispatched = 0;
+    double t0, t1, t2, t3;
+    int i;
+
+    log_set_file(stderr, LOG_WARNING, 0);
+
+    opterr = 0;
+    while ((c = getopt(argc, argv, "hn:")) != -1) {
+        switch(c) {
+        case 'h':
+            display_help(argv[0]);
+            exit(0);
+        case 'n':
+            if ((numTimers = atoi(optarg)) <= 1) {
+                log_err(0, "CMDLINE: invalid count \"%s\"", optarg);
+            }
+            break;
+        case '?':                       /* invalid option */
+            log_err(0, "CMDLINE: invalid option \"%c\"", optopt);
+            exit(1);
+        default:
+            log_err(0, "CMDLINE: option \"%c\" not implemented", c);
+            exit(1);
+        }
+    }
+    if (optind != argc) {
+        display_help(argv[0]);
+        exit(1);
+    }
+    srandom(1);
+
+    if (!(ids = malloc(numTimers * sizeof(int)))) {
+        out_of_memory();
+    }
+    if (!(tp = tpoll_create(0))) {
+        log_err(errno, "Unable to create tpoll object");
+    }
+    if (gettimeofday(&now, NULL) < 0) {
+        log_err(errno, "Unable to get time of day");
+    }
+    /*  Even-numbered timers have expired; odd-numbered timers have not.
+     */
+    t0 = get_secs();
+    for (i = 0; i < numTimers; i++) {
+        get_random_time(&tv, &now, !(i & 1));
+        if ((ids[i] = tpoll_timeout_absolute(tp, count_dispatch,
+                &numDispatched, &tv)) < 0) {
+            log_err(errno, "Unable to set timer");
+        }
+    }
+    t1 = get_secs();
+    for (i = 1; i < numTimers; i += 2) {
+        if (tpoll_timeout_cancel(tp, ids[i]) != 1) {
+            log_err(0, "Unable to cancel timer %d", ids[i]);
+        }
+        get_random_time(&tv, &now, 0);
+        if ((ids[i] = tpoll_timeout_absolute(tp, count_dispatch,
+                &numDispatched, &tv)) < 0) {
+            log_err(errno, "Unable to set timer");
+        }
+    }
+    t2 = get_secs();
+    if (tpoll(tp, 0) < 0) {
+        log_err(errno, "Unable to multiplex timers");
+    }
+    t3 = get_secs();
+    if (numDispatched != (numTimers + 1) / 2) {
+        log_err(0, "Dispatched %ld timers instead of %d",
+            numDispatched, (numTimers + 1) / 2);
+    }
+    printf("timers:        %d\n", numTimers);
+    printf("insert:        %.3f s (%d)\n", t1 - t0, numTimers);
+    printf("cancel+rearm:  %.3f s (%d)\n", t2 - t1, numTimers / 2);
+    printf("dispatch:      %.3f s (%ld)\n", t3 - t2, numDispatched);
+
+    tpoll_destroy(tp);
+    free(ids);
+    return(0);
+}
+
+
+static void display_help(const char *prog)
+{
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("\n");
+    printf("  -h        Display this help message.\n");
+    printf("  -n N      Specify number of timers (default: 50000).\n");
+    printf("\n");
+    return;
+}
+
+
+static void get_random_time(struct timeval *tvp, const struct timeval *now,
+    int isExpired)
+{
+/*  Sets (tvp) to a random time up to BENCH_RANGE_SECS before (now) if
+ *    (isExpired); o/w, sets it to a random time between one and two
+ *    BENCH_RANGE_SECS after (now), so it cannot expire while the benchmark
+ *    is running, even against a slow implementation.
+ */
+    long usecs;
+
+    usecs = random() % ((long) BENCH_RANGE_SECS * 1000000) + 1;
+    if (isExpired) {
+        usecs = -usecs;
+    }
+    else {
+        usecs += (long) BENCH_RANGE_SECS * 1000000;
+    }
+    tvp->tv_sec = now->tv_sec + (usecs / 1000000);
+    tvp->tv_usec = now->tv_usec + (usecs % 1000000);
+    if (tvp->tv_usec < 0) {
+        tvp->tv_sec--;
+        tvp->tv_usec += 1000000;
+    }
+    else if (tvp->tv_usec >= 1000000) {
+        tvp->tv_sec++;
+        tvp->tv_usec -= 1000000;
+    }
+    return;
+}
+
+
+static void count_dispatch(void *arg)
+{
+    (*(long *) arg)++;
+    return;
+}
+
+
+static double get_secs(void)
+{
+    struct timeval tv;
+
+    if (gettimeofday(&tv, NULL) < 0) {
+        log_err(errno, "Unable to get time of day");
+    }
+    return(tv.tv_sec + tv.tv_usec / 1e6);
+}
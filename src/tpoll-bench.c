@@ -0,0 +1,235 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The tpoll-bench utility measures the per-iteration cost of tpoll's I/O
+ *    multiplexing with whichever backend it was built with (configure with
+ *    --enable-io-uring to use io_uring, or --disable-epoll to use poll()).
+ *  It mimics the daemon's main loop over many sockets: each iteration,
+ *    a few random sockets receive data, and each socket found readable is
+ *    read and then has POLLOUT set until it is found writable, at which point
+ *    POLLOUT is cleared again (as when a client's buffer has been flushed).
+ *  It reports the wall-clock and CPU time taken per iteration.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "log.h"
+#include "tpoll.h"
+#include "util-file.h"
+#include "util.h"
+
+
+static void display_help(const char *prog);
+static double get_secs(void);
+static double get_cpu_secs(void);
+
+
+int main(int argc, char *argv[])
+{
+    int c;
+    int numSockets = 1000;
+    int numActive = 16;
+    int numIters = 200000;
+    struct rlimit limit;
+    tpoll_t tp;
+    int *fds;
+    int *peers;
+    int numPeers;
+    int sv[2];
+    char buf[256];
+    double t0, t1, c0, c1;
+    unsigned long numReady = 0;
+    int fd;
+    int i, j, k, n;
+
+    log_set_file(stderr, LOG_WARNING, 0);
+
+    opterr = 0;
+    while ((c = getopt(argc, argv, "a:hn:s:")) != -1) {
+        switch(c) {
+        case 'a':
+            if ((numActive = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid count \"%s\"", optarg);
+            }
+            break;
+        case 'h':
+            display_help(argv[0]);
+            exit(0);
+        case 'n':
+            if ((numIters = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid count \"%s\"", optarg);
+            }
+            break;
+        case 's':
+            if ((numSockets = atoi(optarg)) <= 0) {
+                log_err(0, "CMDLINE: invalid count \"%s\"", optarg);
+            }
+            break;
+        case '?':                       /* invalid option */
+            log_err(0, "CMDLINE: invalid option \"%c\"", optopt);
+            exit(1);
+        default:
+            log_err(0, "CMDLINE: option \"%c\" not implemented", c);
+            exit(1);
+        }
+    }
+    if (optind != argc) {
+        display_help(argv[0]);
+        exit(1);
+    }
+    srandom(1);
+
+    /*  Each socket needs two fds.
+     */
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+        log_err(errno, "Unable to get open file limit");
+    }
+    if (limit.rlim_cur < (rlim_t) numSockets * 2 + 16) {
+        limit.rlim_cur = (rlim_t) numSockets * 2 + 16;
+        if (limit.rlim_max < limit.rlim_cur) {
+            limit.rlim_max = limit.rlim_cur;
+        }
+        if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+            log_err(errno, "Unable to set open file limit to %d",
+                numSockets * 2 + 16);
+        }
+    }
+    if (!(fds = malloc(numSockets * sizeof(int)))) {
+        out_of_memory();
+    }
+    numPeers = numSockets * 2 + 16;
+    if (!(peers = malloc(numPeers * sizeof(int)))) {
+        out_of_memory();
+    }
+    if (!(tp = tpoll_create(0))) {
+        log_err(errno, "Unable to create tpoll object");
+    }
+    for (i = 0; i < numSockets; i++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+            log_err(errno, "Unable to create socketpair");
+        }
+        if (sv[0] >= numPeers) {
+            log_err(0, "Unexpected fd=%d for socket %d", sv[0], i);
+        }
+        set_fd_nonblocking(sv[0]);
+        set_fd_nonblocking(sv[1]);
+        fds[i] = sv[0];
+        peers[sv[0]] = sv[1];
+        if (tpoll_set(tp, sv[0], POLLIN) < 0) {
+            log_err(errno, "Unable to set fd=%d", sv[0]);
+        }
+    }
+    t0 = get_secs();
+    c0 = get_cpu_secs();
+    for (i = 0; i < numIters; i++) {
+        for (j = 0; j < numActive; j++) {
+            fd = fds[random() % numSockets];
+            if (write(peers[fd], "x", 1) < 0) {
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                    log_err(errno, "Unable to write to fd=%d", peers[fd]);
+                }
+            }
+        }
+        if ((n = tpoll(tp, -1)) < 0) {
+            log_err(errno, "Unable to multiplex I/O");
+        }
+        for (k = 0; (n > 0) && ((fd = tpoll_ready(tp, k)) >= 0); k++) {
+            numReady++;
+            if (tpoll_is_set(tp, fd, POLLIN)) {
+                if (read(fd, buf, sizeof(buf)) < 0) {
+                    log_err(errno, "Unable to read from fd=%d", fd);
+                }
+                tpoll_set(tp, fd, POLLOUT);
+            }
+            else if (tpoll_is_set(tp, fd, POLLOUT)) {
+                tpoll_clear(tp, fd, POLLOUT);
+            }
+        }
+    }
+    t1 = get_secs();
+    c1 = get_cpu_secs();
+
+    printf("sockets:     %d (%d written per iteration)\n",
+        numSockets, numActive);
+    printf("iterations:  %d (%.1f ready fds per iteration)\n",
+        numIters, (double) numReady / numIters);
+    printf("wall:        %.2f us/iteration\n", (t1 - t0) * 1e6 / numIters);
+    printf("cpu:         %.2f us/iteration\n", (c1 - c0) * 1e6 / numIters);
+
+    tpoll_destroy(tp);
+    for (i = 0; i < numSockets; i++) {
+        (void) close(peers[fds[i]]);
+        (void) close(fds[i]);
+    }
+    free(fds);
+    free(peers);
+    return(0);
+}
+
+
+static void display_help(const char *prog)
+{
+    printf("Usage: %s [OPTIONS]\n", prog);
+    printf("\n");
+    printf("  -a N      Specify number of sockets written per iteration "
+        "(default: 16).\n");
+    printf("  -h        Display this help message.\n");
+    printf("  -n N      Specify number of iterations (default: 200000).\n");
+    printf("  -s N      Specify number of sockets (default: 1000).\n");
+    printf("\n");
+    return;
+}
+
+
+static double get_secs(void)
+{
+    struct timeval tv;
+
+    if (gettimeofday(&tv, NULL) < 0) {
+        log_err(errno, "Unable to get time of day");
+    }
+    return(tv.tv_sec + tv.tv_usec / 1e6);
+}
+
+
+static double get_cpu_secs(void)
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru) < 0) {
+        log_err(errno, "Unable to get resource usage");
+    }
+    return(ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6
+        + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6);
+}
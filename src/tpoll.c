@@ -36,6 +36,15 @@
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <unistd.h>
+#if WITH_EPOLL
+#  include <sys/epoll.h>
+#endif /* WITH_EPOLL */
+#if WITH_IO_URING
+#  include <linux/io_uring.h>
+#  include <stdint.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#endif /* WITH_IO_URING */
 #include "bool.h"
 #include "log.h"
 #include "tpoll.h"
@@ -57,15 +66,40 @@
  *  descriptors to the first empty slot in fd_array[], and maintaining a hash
  *  to map file descriptors onto the corresponding fd_array[] index.
  *
- *  This implementation assumes the number of concurrent active timers is
- *  moderate; as such, active timers are stored in a linked-list in order of
- *  increasing timevals (ie, the head of the list (timers_active) is the next
- *  timer to expire).  It does not scale well to a large number of timers
- *  because insertion and deletion are O(n), although dispatching is O(1).
- *  Other possible implementations are heaps [Sedgewick 1998] which are
- *  O(log n) for insertion, deletion, and dispatch; or hashed timing wheels
- *  [Varghese and Lauck 1996] which can be as efficient as O(1) for insertion,
- *  deletion, and dispatch.
+ *  When built WITH_EPOLL, the fd_array[] only records the events of interest
+ *  and the events returned; the kernel maintains the set of file descriptors
+ *  being monitored, so waiting for I/O is proportional to the number of file
+ *  descriptors that are ready instead of the maximum file descriptor.  If the
+ *  epoll instance cannot be created, poll() is used instead.  Since epoll
+ *  rejects regular files (which poll() always reports as ready), those file
+ *  descriptors are kept in a separate "nopoll" array and reported as ready
+ *  whenever they have events of interest.
+ *
+ *  When built WITH_IO_URING, an io_uring instance is tried first (falling
+ *  back to epoll or poll() if it cannot be created).  Each fd of interest has
+ *  a one-shot poll request armed in the kernel; changes to the events of
+ *  interest (eg, the frequent setting & clearing of POLLOUT) only mark the fd
+ *  as "dirty" instead of making a syscall for each change.  The dirty fds are
+ *  re-armed in a batch that is submitted by the same io_uring_enter() that
+ *  waits for completions.  A poll request is re-armed after it completes,
+ *  thereby preserving poll()'s level-triggered semantics.  Each request is
+ *  tagged with the fd and a per-fd generation number so completions for
+ *  requests that have since been removed or replaced are discarded.
+ *
+ *  Either way, the file descriptors with I/O ready after a call to tpoll()
+ *  are recorded in the fd_ready[] array so the caller can iterate over them
+ *  via tpoll_ready() instead of testing every file descriptor of interest.
+ *
+ *  Active timers are stored in a 4-ary min-heap [Sedgewick 1998] ordered by
+ *  increasing timevals (ie, the root of the heap (timers_heap[0]) is the next
+ *  timer to expire), with ties broken by the order in which the timers were
+ *  set.  Each timer records its heap index, and timers are hashed by ID into
+ *  the timers_hash[] table (sized to the number of active timers) so a timer
+ *  can be found for cancellation without searching the heap.  As such,
+ *  insertion, deletion, and dispatch are O(log n).  A 4-ary heap is used
+ *  instead of a binary heap since it is shallower and more cache-friendly.
+ *  Hashed timing wheels [Varghese and Lauck 1996] could be as efficient as
+ *  O(1), but require the timer resolution and range to be fixed in advance.
  */
 
 
@@ -74,6 +108,32 @@
  *****************************************************************************/
 
 #define TPOLL_ALLOC     256
+#define TPOLL_HEAP_D    4
+
+#if WITH_IO_URING
+#define TPOLL_URING_SQ_ENTRIES  256
+#define TPOLL_URING_CQ_ENTRIES  4096
+#define TPOLL_URING_NOP         ((__u64) -1)
+#endif /* WITH_IO_URING */
+
+
+/*****************************************************************************
+ *  Macros
+ *****************************************************************************/
+
+/*  Returns the io_uring user_data tag for the poll request on [fd] of
+ *    generation [gen], and the fd & generation of a tag [ud].
+ */
+#define _TPOLL_URING_TAG(fd,gen) \
+    ((((__u64) (gen)) << 32) | ((__u64) (unsigned int) (fd)))
+#define _TPOLL_URING_FD(ud)     ((int) ((ud) & 0xffffffff))
+#define _TPOLL_URING_GEN(ud)    ((unsigned int) ((ud) >> 32))
+
+/*  Returns true if timer [a] expires before timer [b].
+ */
+#define _TPOLL_TIMER_LT(a,b) \
+    (timercmp (&(a)->tv, &(b)->tv, <) \
+        || (timercmp (&(a)->tv, &(b)->tv, ==) && ((a)->seq < (b)->seq)))
 
 
 /*****************************************************************************
@@ -82,14 +142,47 @@
 
 typedef struct tpoll_timer * _tpoll_timer_t;
 
+#if WITH_IO_URING
+typedef struct tpoll_uring * _tpoll_uring_t;
+
+typedef struct tpoll_uring_fd {
+    unsigned int     gen;               /* gen of most recent poll request   */
+    short int        events;            /* events armed in kernel, or 0      */
+    bool             is_dirty;          /* true if on the fd_dirty[] array   */
+    bool             is_dropped;        /* true if fd cleared since armed    */
+} _tpoll_uring_fd_t;
+#endif /* WITH_IO_URING */
+
 struct tpoll {
     struct pollfd   *fd_array;          /* poll fd array                     */
+    int             *fd_ready;          /* fds w/ I/O ready after tpoll()    */
     int              fd_pipe[ 2 ];      /* signal pipe for unblocking poll() */
     int              num_fds_alloc;     /* num pollfd structs allocated      */
     int              num_fds_used;      /* num pollfd structs in use         */
+    int              num_fds_ready;     /* num fds in fd_ready[]             */
     int              max_fd;            /* max fd in array in use            */
-    _tpoll_timer_t   timers_active;     /* sorted list of active timers      */
+#if WITH_EPOLL
+    int              ep_fd;             /* epoll fd, or -1 if using poll()   */
+    struct epoll_event *ep_array;       /* epoll event array                 */
+    int              num_eps_alloc;     /* num epoll_event structs allocated */
+    int             *fd_nopoll;         /* fds epoll cannot monitor          */
+    int             *fd_nopoll_index;   /* fd_nopoll[] index by fd, or -1    */
+    int              num_fds_nopoll;    /* num fds in fd_nopoll[]            */
+#endif /* WITH_EPOLL */
+#if WITH_IO_URING
+    _tpoll_uring_t   ur;                /* io_uring, or NULL if not in use   */
+    _tpoll_uring_fd_t *ur_fds;          /* io_uring poll state indexed by fd */
+    int             *fd_dirty;          /* fds w/ poll requests to update    */
+    int              num_fds_dirty;     /* num fds in fd_dirty[]             */
+#endif /* WITH_IO_URING */
+    _tpoll_timer_t  *timers_heap;       /* min-heap of active timers         */
+    _tpoll_timer_t  *timers_hash;       /* active timers hashed by id        */
+    int              num_timers;        /* num active timers in heap         */
+    int              num_timers_alloc;  /* num heap slots allocated          */
+    int              num_timers_hash;   /* num hash buckets (power of 2)     */
     int              timers_next_id;    /* next id to be assigned to a timer */
+    unsigned long    timers_next_seq;   /* next seq to be assigned to timer  */
+    unsigned long    num_syscalls;      /* num poll/epoll/io_uring syscalls  */
     pthread_mutex_t  mutex;             /* locking primitive                 */
     bool             is_blocked;        /* flag set when blocking on poll()  */
     bool             is_realloced;      /* flag set after fd_array[] realloc */
@@ -97,12 +190,34 @@ struct tpoll {
     bool             is_mutex_inited;   /* flag set when mutex initialized   */
 };
 
+#if WITH_IO_URING
+struct tpoll_uring {
+    int              fd;                /* io_uring fd                       */
+    void            *ring;              /* mmap'd SQ & CQ rings              */
+    size_t           ring_len;          /* length of ring mmap               */
+    struct io_uring_sqe *sqes;          /* mmap'd SQ entries                 */
+    size_t           sqes_len;          /* length of sqes mmap               */
+    unsigned        *sq_head;           /* SQ head (advanced by the kernel)  */
+    unsigned        *sq_tail;           /* SQ tail (advanced by tpoll)       */
+    unsigned        *sq_array;          /* SQ index array                    */
+    unsigned         sq_mask;           /* SQ ring mask                      */
+    unsigned         sq_entries;        /* num SQ entries                    */
+    unsigned         sq_tail_local;     /* SQ tail incl. sqes not yet posted */
+    unsigned        *cq_head;           /* CQ head (advanced by tpoll)       */
+    unsigned        *cq_tail;           /* CQ tail (advanced by the kernel)  */
+    unsigned         cq_mask;           /* CQ ring mask                      */
+    struct io_uring_cqe *cqes;          /* CQ entries                        */
+};
+#endif /* WITH_IO_URING */
+
 struct tpoll_timer {
     int              id;                /* timer ID                          */
     callback_f       fnc;               /* callback function                 */
     void            *arg;               /* callback function arg             */
     struct timeval   tv;                /* expiration time                   */
-    _tpoll_timer_t   next;              /* next timer in list                */
+    unsigned long    seq;               /* seq for ordering equal timevals   */
+    int              index;             /* index into timers_heap[]          */
+    _tpoll_timer_t   next;              /* next timer in hash bucket         */
 };
 
 
@@ -118,6 +233,53 @@ static void _tpoll_signal_recv (tpoll_t tp);
 
 static int _tpoll_grow (tpoll_t tp, int num_fds_req);
 
+static int _tpoll_timer_insert (tpoll_t tp, _tpoll_timer_t t);
+
+static void _tpoll_timer_remove (tpoll_t tp, _tpoll_timer_t t);
+
+static _tpoll_timer_t _tpoll_timer_find (tpoll_t tp, int id);
+
+static void _tpoll_timer_sift_up (tpoll_t tp, int i);
+
+static void _tpoll_timer_sift_down (tpoll_t tp, int i);
+
+static int _tpoll_timer_grow (tpoll_t tp);
+
+static void _tpoll_scan_ready (tpoll_t tp);
+
+#if WITH_EPOLL
+static int _tpoll_epoll_ctl (tpoll_t tp, int fd, short int events,
+    bool is_new);
+
+static void _tpoll_epoll_enter (tpoll_t tp, int *timeout);
+
+static int _tpoll_epoll_leave (tpoll_t tp, int n);
+
+static uint32_t _tpoll_poll_to_epoll (short int events);
+
+static short int _tpoll_epoll_to_poll (uint32_t events);
+#endif /* WITH_EPOLL */
+
+#if WITH_IO_URING
+static int _tpoll_uring_create (tpoll_t tp, int n);
+
+static void _tpoll_uring_destroy (tpoll_t tp);
+
+static int _tpoll_uring_grow (tpoll_t tp, int num_fds_old, int num_fds_new);
+
+static void _tpoll_uring_mark (tpoll_t tp, int fd, bool is_dropped);
+
+static struct io_uring_sqe * _tpoll_uring_get_sqe (tpoll_t tp);
+
+static void _tpoll_uring_enter (tpoll_t tp, int *timeout);
+
+static int _tpoll_uring_wait (tpoll_t tp, int timeout);
+
+static int _tpoll_uring_leave (tpoll_t tp);
+#endif /* WITH_IO_URING */
+
+static bool _tpoll_is_scanned (tpoll_t tp);
+
 static void _tpoll_get_timeval (struct timeval *tvp, int ms);
 
 static int _tpoll_diff_timeval (struct timeval *tvp1, struct timeval *tvp0);
@@ -147,8 +309,32 @@ tpoll_create (int n)
     if (!(tp = malloc (sizeof (struct tpoll)))) {
         goto err;
     }
+    tp->fd_array = NULL;
+    tp->fd_ready = NULL;
     tp->fd_pipe[ 0 ] = tp->fd_pipe[ 1 ] = -1;
-    tp->timers_active = NULL;
+    tp->num_fds_ready = 0;
+    tp->max_fd = -1;
+#if WITH_EPOLL
+    tp->ep_fd = -1;
+    tp->ep_array = NULL;
+    tp->num_eps_alloc = 0;
+    tp->fd_nopoll = NULL;
+    tp->fd_nopoll_index = NULL;
+    tp->num_fds_nopoll = 0;
+#endif /* WITH_EPOLL */
+#if WITH_IO_URING
+    tp->ur = NULL;
+    tp->ur_fds = NULL;
+    tp->fd_dirty = NULL;
+    tp->num_fds_dirty = 0;
+#endif /* WITH_IO_URING */
+    tp->timers_heap = NULL;
+    tp->timers_hash = NULL;
+    tp->num_timers = 0;
+    tp->num_timers_alloc = 0;
+    tp->num_timers_hash = 0;
+    tp->timers_next_seq = 0;
+    tp->num_syscalls = 0;
     tp->is_blocked = false;
     tp->is_realloced = false;
     tp->is_signaled = false;
@@ -157,6 +343,9 @@ tpoll_create (int n)
     if (!(tp->fd_array = malloc (n * sizeof (struct pollfd)))) {
         goto err;
     }
+    if (!(tp->fd_ready = malloc (n * sizeof (int)))) {
+        goto err;
+    }
     tp->num_fds_alloc = n;
 
     if (pipe (tp->fd_pipe) < 0) {
@@ -179,6 +368,56 @@ tpoll_create (int n)
     }
     tp->is_mutex_inited = true;
 
+#if WITH_IO_URING
+    /*  Fall back to epoll or poll() if the io_uring instance cannot be
+     *    created (eg, if the kernel does not support it or it is disabled).
+     */
+    if (_tpoll_uring_create (tp, n) < 0) {
+        DPRINTF((21, "tpoll io_uring setup failed: %s.\n", strerror (errno)));
+        _tpoll_uring_destroy (tp);
+    }
+#endif /* WITH_IO_URING */
+
+#if WITH_EPOLL
+    /*  Fall back to poll() if the epoll instance cannot be created
+     *    (eg, if the kernel does not support it).
+     */
+#if WITH_IO_URING
+    if (tp->ur != NULL) {
+        /*  The epoll instance is not needed when io_uring is in use.
+         */
+    }
+    else
+#endif /* WITH_IO_URING */
+    if ((tp->ep_fd = epoll_create1 (EPOLL_CLOEXEC)) < 0) {
+        DPRINTF((21, "tpoll epoll_create1 failed: %s.\n", strerror (errno)));
+    }
+    else {
+        struct epoll_event ev;
+
+        if (!(tp->ep_array = malloc (n * sizeof (struct epoll_event)))) {
+            goto err;
+        }
+        tp->num_eps_alloc = n;
+        if (!(tp->fd_nopoll = malloc (n * sizeof (int)))) {
+            goto err;
+        }
+        if (!(tp->fd_nopoll_index = malloc (n * sizeof (int)))) {
+            goto err;
+        }
+        for (i = 0; i < n; i++) {
+            tp->fd_nopoll_index[ i ] = -1;
+        }
+        memset (&ev, 0, sizeof (ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = tp->fd_pipe[ 0 ];
+        tp->num_syscalls++;
+        if (epoll_ctl (tp->ep_fd, EPOLL_CTL_ADD, tp->fd_pipe[ 0 ], &ev) < 0) {
+            goto err;
+        }
+    }
+#endif /* WITH_EPOLL */
+
     /*  The mutex is not locked here before calling _tpoll_init() because the
      *    object handle (tp) has not yet been returned.
      */
@@ -197,7 +436,6 @@ tpoll_destroy (tpoll_t tp)
 /*  Destroys the tpoll object [tp] and cancels all of its associated timers.
  */
     int            i;
-    _tpoll_timer_t t;
     int            e;
 
     if (!tp) {
@@ -212,16 +450,47 @@ tpoll_destroy (tpoll_t tp)
         free (tp->fd_array);
         tp->fd_array = NULL;
     }
+    if (tp->fd_ready) {
+        free (tp->fd_ready);
+        tp->fd_ready = NULL;
+    }
+#if WITH_EPOLL
+    if (tp->ep_fd > -1) {
+        (void) close (tp->ep_fd);
+        tp->ep_fd = -1;
+    }
+    if (tp->ep_array) {
+        free (tp->ep_array);
+        tp->ep_array = NULL;
+    }
+    if (tp->fd_nopoll) {
+        free (tp->fd_nopoll);
+        tp->fd_nopoll = NULL;
+    }
+    if (tp->fd_nopoll_index) {
+        free (tp->fd_nopoll_index);
+        tp->fd_nopoll_index = NULL;
+    }
+#endif /* WITH_EPOLL */
+#if WITH_IO_URING
+    _tpoll_uring_destroy (tp);
+#endif /* WITH_IO_URING */
     for (i = 0; i < 2; i++) {
         if (tp->fd_pipe[ i ] > -1) {
             (void) close (tp->fd_pipe[ i ]);
             tp->fd_pipe[ i ] = -1;
         }
     }
-    while (tp->timers_active) {
-        t = tp->timers_active;
-        tp->timers_active = t->next;
-        free (t);
+    if (tp->timers_heap) {
+        for (i = 0; i < tp->num_timers; i++) {
+            free (tp->timers_heap[ i ]);
+        }
+        free (tp->timers_heap);
+        tp->timers_heap = NULL;
+    }
+    if (tp->timers_hash) {
+        free (tp->timers_hash);
+        tp->timers_hash = NULL;
     }
     if (tp->is_mutex_inited) {
         if ((e = pthread_mutex_unlock (&tp->mutex)) != 0) {
@@ -303,6 +572,16 @@ tpoll_clear (tpoll_t tp, int fd, short int events)
         if (tp->fd_array[ fd ].events != events_new) {
 
             tp->fd_array[ fd ].events = events_new;
+#if WITH_EPOLL
+            if (tp->ep_fd > -1) {
+                (void) _tpoll_epoll_ctl (tp, fd, events_new, false);
+            }
+#endif /* WITH_EPOLL */
+#if WITH_IO_URING
+            if (tp->ur != NULL) {
+                _tpoll_uring_mark (tp, fd, (events_new == 0));
+            }
+#endif /* WITH_IO_URING */
 
             if (events_new == 0) {
                 tp->fd_array[ fd ].revents = 0;
@@ -381,6 +660,7 @@ tpoll_set (tpoll_t tp, int fd, short int events)
  */
     int       rc;
     short int events_new = 0;
+    bool      is_new;
     int       e;
 
     if (!tp) {
@@ -401,24 +681,39 @@ tpoll_set (tpoll_t tp, int fd, short int events)
         rc = -1;
     }
     else {
-        if (tp->fd_array[ fd ].fd < 0) {
+        is_new = (tp->fd_array[ fd ].fd < 0);
+        if (is_new) {
             assert (tp->fd_array[ fd ].events == 0);
             assert (tp->fd_array[ fd ].revents == 0);
-            tp->fd_array[ fd ].fd = fd;
-            tp->num_fds_used++;
-            if (fd > tp->max_fd) {
-                tp->max_fd = fd;
-            }
             events_new = events;
         }
         else {
             events_new = tp->fd_array[ fd ].events | events;
         }
+        rc = 0;
         if (tp->fd_array[ fd ].events != events_new) {
-            tp->fd_array[ fd ].events = events_new;
-            _tpoll_signal_send (tp);
+#if WITH_EPOLL
+            if (tp->ep_fd > -1) {
+                rc = _tpoll_epoll_ctl (tp, fd, events_new, is_new);
+            }
+#endif /* WITH_EPOLL */
+#if WITH_IO_URING
+            if (tp->ur != NULL) {
+                _tpoll_uring_mark (tp, fd, false);
+            }
+#endif /* WITH_IO_URING */
+            if (rc == 0) {
+                if (is_new) {
+                    tp->fd_array[ fd ].fd = fd;
+                    tp->num_fds_used++;
+                    if (fd > tp->max_fd) {
+                        tp->max_fd = fd;
+                    }
+                }
+                tp->fd_array[ fd ].events = events_new;
+                _tpoll_signal_send (tp);
+            }
         }
-        rc = 0;
     }
     DPRINTF((21, "tpoll_set fd=%d e=0x%02x r=0x%02x.\n",
         fd, events, events_new));
@@ -439,7 +734,6 @@ tpoll_timeout_absolute (tpoll_t tp, callback_f cb, void *arg,
  *  Returns a timer ID > 0 for use with tpoll_timeout_cancel(), or -1 on error.
  */
     _tpoll_timer_t  t;
-    _tpoll_timer_t *t_ptr;
     int             rc;
     int             e;
 
@@ -465,21 +759,28 @@ tpoll_timeout_absolute (tpoll_t tp, callback_f cb, void *arg,
     if ((e = pthread_mutex_lock (&tp->mutex)) != 0) {
         log_err (errno = e, "Unable to lock tpoll mutex");
     }
-    rc = t->id = tp->timers_next_id++;
-    if (tp->timers_next_id <= 0) {
-        tp->timers_next_id = 1;
-    }
-    t_ptr = &tp->timers_active;
-    while (*t_ptr && !timercmp (tvp, &(*t_ptr)->tv, <)) {
-        t_ptr = &((*t_ptr)->next);
+    /*  Skip over IDs still in use after the ID counter wraps around.
+     */
+    do {
+        t->id = tp->timers_next_id++;
+        if (tp->timers_next_id <= 0) {
+            tp->timers_next_id = 1;
+        }
+    } while (_tpoll_timer_find (tp, t->id) != NULL);
+
+    t->seq = tp->timers_next_seq++;
+
+    if (_tpoll_timer_insert (tp, t) < 0) {
+        free (t);
+        rc = -1;
     }
-    if (*t_ptr == tp->timers_active) {
-        _tpoll_signal_send (tp);
+    else {
+        if (t->index == 0) {
+            _tpoll_signal_send (tp);
+        }
+        rc = t->id;
+        DPRINTF((22, "tpoll timer set id=%d.\n", t->id));
     }
-    t->next = *t_ptr;
-    *t_ptr = t;
-
-    DPRINTF((22, "tpoll timer set id=%d.\n", t->id));
     if ((e = pthread_mutex_unlock (&tp->mutex)) != 0) {
         log_err (errno = e, "Unable to unlock tpoll mutex");
     }
@@ -510,7 +811,6 @@ tpoll_timeout_cancel (tpoll_t tp, int id)
  *    or -1 on error.
  */
     _tpoll_timer_t  t;
-    _tpoll_timer_t *t_ptr;
     int             rc;
     int             e;
 
@@ -525,20 +825,16 @@ tpoll_timeout_cancel (tpoll_t tp, int id)
     if ((e = pthread_mutex_lock (&tp->mutex)) != 0) {
         log_err (errno = e, "Unable to lock tpoll mutex");
     }
-    t_ptr = &tp->timers_active;
-    while (*t_ptr && (id != (*t_ptr)->id)) {
-        t_ptr = &((*t_ptr)->next);
-    }
-    if (!*t_ptr) {
+    t = _tpoll_timer_find (tp, id);
+    if (!t) {
         rc = 0;
     }
     else {
-        DPRINTF((22, "tpoll timer cancel id=%d.\n", (*t_ptr)->id));
-        if (*t_ptr == tp->timers_active) {
+        DPRINTF((22, "tpoll timer cancel id=%d.\n", t->id));
+        if (t->index == 0) {
             _tpoll_signal_send (tp);
         }
-        t = *t_ptr;
-        *t_ptr = t->next;
+        _tpoll_timer_remove (tp, t);
         free (t);
         rc = 1;
     }
@@ -591,11 +887,11 @@ tpoll (tpoll_t tp, int ms)
         /*
          *  Dispatch timer events that have expired.
          */
-        while (tp->timers_active
-                && !timercmp (&tp->timers_active->tv, &tv_now, >)) {
+        while ((tp->num_timers > 0)
+                && !timercmp (&tp->timers_heap[ 0 ]->tv, &tv_now, >)) {
 
-            t = tp->timers_active;
-            tp->timers_active = t->next;
+            t = tp->timers_heap[ 0 ];
+            _tpoll_timer_remove (tp, t);
             DPRINTF((22, "tpoll timer dispatch id=%d.\n", t->id));
             /*
              *  Release the mutex while performing the callback function
@@ -616,7 +912,7 @@ tpoll (tpoll_t tp, int ms)
         if (ms == 0) {
             timeout = 0;
         }
-        else if ((ms < 0) && !tp->timers_active) {
+        else if ((ms < 0) && (tp->num_timers == 0)) {
             if (tp->num_fds_used > 0) {
                 timeout = -1;           /* fd events but no more timers */
             }
@@ -628,19 +924,19 @@ tpoll (tpoll_t tp, int ms)
             _tpoll_get_timeval (&tv_now, 0);
 
             if (ms < 0) {
-                assert (tp->timers_active != NULL);
+                assert (tp->num_timers > 0);
                 ms_diff =
-                    _tpoll_diff_timeval (&tp->timers_active->tv, &tv_now);
+                    _tpoll_diff_timeval (&tp->timers_heap[ 0 ]->tv, &tv_now);
             }
-            else if (!tp->timers_active) {
+            else if (tp->num_timers == 0) {
                 assert (ms > 0);
                 ms_diff =
                     _tpoll_diff_timeval (&tv_timeout, &tv_now);
             }
-            else if (!timercmp (&tp->timers_active->tv, &tv_timeout, >)) {
+            else if (!timercmp (&tp->timers_heap[ 0 ]->tv, &tv_timeout, >)) {
                 assert (ms > 0);
                 ms_diff =
-                    _tpoll_diff_timeval (&tp->timers_active->tv, &tv_now);
+                    _tpoll_diff_timeval (&tp->timers_heap[ 0 ]->tv, &tv_now);
             }
             else {
                 assert (ms > 0);
@@ -651,12 +947,38 @@ tpoll (tpoll_t tp, int ms)
         }
         /*  Poll for events, discarding any on the "signaling pipe".
          */
+#if WITH_IO_URING
+        if (tp->ur != NULL) {
+            _tpoll_uring_enter (tp, &timeout);
+        }
+        else
+#endif /* WITH_IO_URING */
+#if WITH_EPOLL
+        if (tp->ep_fd > -1) {
+            _tpoll_epoll_enter (tp, &timeout);
+        }
+        else
+#endif /* WITH_EPOLL */
+        tp->num_fds_ready = 0;
         tp->is_blocked = true;
 
         if ((e = pthread_mutex_unlock (&tp->mutex)) != 0) {
             log_err (errno = e, "Unable to unlock tpoll mutex");
         }
         DPRINTF((25, "tpoll poll enter ms=%d mfd=%d.\n", timeout, tp->max_fd));
+#if WITH_IO_URING
+        if (tp->ur != NULL) {
+            n = _tpoll_uring_wait (tp, timeout);
+        }
+        else
+#endif /* WITH_IO_URING */
+#if WITH_EPOLL
+        if (tp->ep_fd > -1) {
+            n = epoll_wait (tp->ep_fd, tp->ep_array, tp->num_eps_alloc,
+                timeout);
+        }
+        else
+#endif /* WITH_EPOLL */
         n = poll (tp->fd_array, tp->max_fd + 1, timeout);
         DPRINTF((25, "tpoll poll return n=%d.\n", n));
 
@@ -664,10 +986,21 @@ tpoll (tpoll_t tp, int ms)
             log_err (errno = e, "Unable to lock tpoll mutex");
         }
         tp->is_blocked = false;
+        tp->num_syscalls++;
 
         if (n < 0) {
             break;
         }
+#if WITH_IO_URING
+        if (tp->ur != NULL) {
+            n = _tpoll_uring_leave (tp);
+        }
+#endif /* WITH_IO_URING */
+#if WITH_EPOLL
+        if (tp->ep_fd > -1) {
+            n = _tpoll_epoll_leave (tp, n);
+        }
+#endif /* WITH_EPOLL */
         if (tp->is_realloced) {
             DPRINTF((25, "tpoll is_realloced.\n"));
             tp->is_realloced = false;
@@ -680,10 +1013,13 @@ tpoll (tpoll_t tp, int ms)
         }
         if (n > 0) {
             assert (tp->num_fds_used > 0);
+            if (_tpoll_is_scanned (tp)) {
+                _tpoll_scan_ready (tp);
+            }
             break;
         }
         if ((ms == 0)
-                || ((ms < 0) && !tp->num_fds_used && !tp->timers_active)) {
+                || ((ms < 0) && !tp->num_fds_used && !tp->num_timers)) {
             break;
         }
         _tpoll_get_timeval (&tv_now, 0);
@@ -699,6 +1035,93 @@ tpoll (tpoll_t tp, int ms)
 }
 
 
+int
+tpoll_ready (tpoll_t tp, int i)
+{
+/*  Returns the [i]th file descriptor with I/O ready from the most recent call
+ *    to tpoll() on the tpoll object [tp], or -1 if [i] is out of range.
+ *  This allows the caller to iterate over only those file descriptors that
+ *    are ready for I/O instead of testing every file descriptor of interest:
+ *
+ *    for (i = 0; (fd = tpoll_ready (tp, i)) >= 0; i++) { ... }
+ *
+ *  An fd may have been cleared since tpoll() returned, so its events should
+ *    still be checked via tpoll_is_set().
+ */
+    int fd;
+    int e;
+
+    if (!tp) {
+        errno = EINVAL;
+        return (-1);
+    }
+    if (i < 0) {
+        errno = EINVAL;
+        return (-1);
+    }
+    if ((e = pthread_mutex_lock (&tp->mutex)) != 0) {
+        log_err (errno = e, "Unable to lock tpoll mutex");
+    }
+    fd = (i < tp->num_fds_ready) ? tp->fd_ready[ i ] : -1;
+
+    if ((e = pthread_mutex_unlock (&tp->mutex)) != 0) {
+        log_err (errno = e, "Unable to unlock tpoll mutex");
+    }
+    return (fd);
+}
+
+
+const char *
+tpoll_backend (tpoll_t tp)
+{
+/*  Returns the name of the mechanism used by the tpoll object [tp] to
+ *    multiplex I/O ("io_uring", "epoll", or "poll"), or NULL on error.
+ */
+    if (!tp) {
+        errno = EINVAL;
+        return (NULL);
+    }
+#if WITH_IO_URING
+    if (tp->ur != NULL) {
+        return ("io_uring");
+    }
+#endif /* WITH_IO_URING */
+#if WITH_EPOLL
+    if (tp->ep_fd > -1) {
+        return ("epoll");
+    }
+#endif /* WITH_EPOLL */
+    return ("poll");
+}
+
+
+unsigned long
+tpoll_num_syscalls (tpoll_t tp)
+{
+/*  Returns the number of syscalls made by the tpoll object [tp] to wait for
+ *    I/O (poll, epoll_wait, or io_uring_enter) and to update the kernel's
+ *    interest set (epoll_ctl, or io_uring_enter when the SQ fills up).
+ *  Reads & writes on the signaling pipe are not included.
+ */
+    unsigned long n;
+    int e;
+
+    if (!tp) {
+        errno = EINVAL;
+        return (0);
+    }
+    if ((e = pthread_mutex_lock (&tp->mutex)) != 0) {
+        log_err (errno = e, "Unable to lock tpoll mutex");
+    }
+    n = tp->num_syscalls;
+
+    if ((e = pthread_mutex_unlock (&tp->mutex)) != 0) {
+        log_err (errno = e, "Unable to unlock tpoll mutex");
+    }
+    return (n);
+}
+
+
 /*****************************************************************************
  *  Internal Functions
  *****************************************************************************/
@@ -710,7 +1133,6 @@ _tpoll_init (tpoll_t tp, tpoll_zero_t how)
  *  This routine assumes the [tp] mutex is already locked.
  */
     int            i;
-    _tpoll_timer_t t;
 
     assert (tp != NULL);
     assert (tp->fd_pipe[ 0 ] > -1);
@@ -718,6 +1140,30 @@ _tpoll_init (tpoll_t tp, tpoll_zero_t how)
     assert ((how & ~TPOLL_ZERO_ALL) == 0);
 
     if (how & TPOLL_ZERO_FDS) {
+#if WITH_EPOLL
+        if (tp->ep_fd > -1) {
+            for (i = 0; i <= tp->max_fd; i++) {
+                if ((tp->fd_array[ i ].fd > -1) && (i != tp->fd_pipe[ 0 ])) {
+                    (void) _tpoll_epoll_ctl (tp, i, 0, false);
+                }
+            }
+            assert (tp->num_fds_nopoll == 0);
+        }
+#endif /* WITH_EPOLL */
+#if WITH_IO_URING
+        /*  Fds with poll requests armed are marked so those requests are
+         *    removed by the next call to tpoll(); the "signaling pipe" is
+         *    marked so its request is (re)armed.
+         */
+        if (tp->ur != NULL) {
+            for (i = 0; i < tp->num_fds_alloc; i++) {
+                if (tp->ur_fds[ i ].events != 0) {
+                    _tpoll_uring_mark (tp, i, (i != tp->fd_pipe[ 0 ]));
+                }
+            }
+            _tpoll_uring_mark (tp, tp->fd_pipe[ 0 ], false);
+        }
+#endif /* WITH_IO_URING */
         memset (tp->fd_array, 0, tp->num_fds_alloc * sizeof (struct pollfd));
         for (i = 0; i < tp->num_fds_alloc; i++) {
             tp->fd_array[ i ].fd = -1;
@@ -726,12 +1172,15 @@ _tpoll_init (tpoll_t tp, tpoll_zero_t how)
         tp->fd_array[ tp->fd_pipe[ 0 ] ].events = POLLIN;
         tp->max_fd = tp->fd_pipe[ 0 ];
         tp->num_fds_used = 0;
+        tp->num_fds_ready = 0;
     }
     if (how & TPOLL_ZERO_TIMERS) {
-        while (tp->timers_active) {
-            t = tp->timers_active;
-            tp->timers_active = t->next;
-            free (t);
+        for (i = 0; i < tp->num_timers; i++) {
+            free (tp->timers_heap[ i ]);
+        }
+        tp->num_timers = 0;
+        for (i = 0; i < tp->num_timers_hash; i++) {
+            tp->timers_hash[ i ] = NULL;
         }
         tp->timers_next_id = 1;
     }
@@ -828,6 +1277,7 @@ _tpoll_grow (tpoll_t tp, int num_fds_req)
  */
     struct pollfd *fd_array_tmp;
     struct pollfd *fd_array_new;
+    int           *fd_ready_tmp;
     int            num_fds_tmp;
     int            num_fds_new;
     int            i;
@@ -862,11 +1312,918 @@ _tpoll_grow (tpoll_t tp, int num_fds_req)
     }
     tp->is_realloced = true;
     tp->fd_array = fd_array_tmp;
+
+    if (!(fd_ready_tmp = realloc (tp->fd_ready, num_fds_tmp * sizeof (int)))) {
+        return (-1);
+    }
+    tp->fd_ready = fd_ready_tmp;
+
+#if WITH_EPOLL
+    /*  The ep_array is not grown here since epoll_wait() may be using it
+     *    while the mutex is released; it is grown by _tpoll_epoll_enter().
+     */
+    if (tp->ep_fd > -1) {
+        int *fd_nopoll_tmp;
+
+        if (!(fd_nopoll_tmp =
+                realloc (tp->fd_nopoll, num_fds_tmp * sizeof (int)))) {
+            return (-1);
+        }
+        tp->fd_nopoll = fd_nopoll_tmp;
+
+        if (!(fd_nopoll_tmp =
+                realloc (tp->fd_nopoll_index, num_fds_tmp * sizeof (int)))) {
+            return (-1);
+        }
+        tp->fd_nopoll_index = fd_nopoll_tmp;
+
+        for (i = tp->num_fds_alloc; i < num_fds_tmp; i++) {
+            tp->fd_nopoll_index[ i ] = -1;
+        }
+    }
+#endif /* WITH_EPOLL */
+
+#if WITH_IO_URING
+    if ((tp->ur != NULL)
+            && (_tpoll_uring_grow (tp, tp->num_fds_alloc, num_fds_tmp) < 0)) {
+        return (-1);
+    }
+#endif /* WITH_IO_URING */
+
     tp->num_fds_alloc = num_fds_tmp;
     return (0);
 }
 
 
+static void
+_tpoll_scan_ready (tpoll_t tp)
+{
+/*  Records the file descriptors with I/O ready after poll() in [tp]'s
+ *    fd_ready array, excluding the "signaling pipe".
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    int fd;
+
+    assert (tp != NULL);
+
+    tp->num_fds_ready = 0;
+    for (fd = 0; fd <= tp->max_fd; fd++) {
+        if ((tp->fd_array[ fd ].revents != 0) && (fd != tp->fd_pipe[ 0 ])) {
+            tp->fd_ready[ tp->num_fds_ready++ ] = fd;
+        }
+    }
+    return;
+}
+
+
+static bool
+_tpoll_is_scanned (tpoll_t tp)
+{
+/*  Returns true if [tp] uses poll(), and thus its fd_array must be scanned
+ *    for the ready fds after each call.
+ */
+    assert (tp != NULL);
+
+#if WITH_IO_URING
+    if (tp->ur != NULL) {
+        return (false);
+    }
+#endif /* WITH_IO_URING */
+#if WITH_EPOLL
+    if (tp->ep_fd > -1) {
+        return (false);
+    }
+#endif /* WITH_EPOLL */
+    return (true);
+}
+
+
+static int
+_tpoll_timer_insert (tpoll_t tp, _tpoll_timer_t t)
+{
+/*  Inserts the timer [t] into [tp]'s heap and hash table.
+ *  Returns 0 on success, or -1 on error.
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    int h;
+
+    assert (tp != NULL);
+    assert (t != NULL);
+
+    if ((tp->num_timers >= tp->num_timers_alloc)
+            && (_tpoll_timer_grow (tp) < 0)) {
+        return (-1);
+    }
+    h = t->id & (tp->num_timers_hash - 1);
+    t->next = tp->timers_hash[ h ];
+    tp->timers_hash[ h ] = t;
+
+    t->index = tp->num_timers++;
+    tp->timers_heap[ t->index ] = t;
+    _tpoll_timer_sift_up (tp, t->index);
+    return (0);
+}
+
+
+static void
+_tpoll_timer_remove (tpoll_t tp, _tpoll_timer_t t)
+{
+/*  Removes the timer [t] from [tp]'s heap and hash table.
+ *  The timer itself is not freed.
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    _tpoll_timer_t *t_ptr;
+    _tpoll_timer_t  t_last;
+    int             i;
+
+    assert (tp != NULL);
+    assert (t != NULL);
+    assert ((t->index >= 0) && (t->index < tp->num_timers));
+    assert (tp->timers_heap[ t->index ] == t);
+
+    t_ptr = &tp->timers_hash[ t->id & (tp->num_timers_hash - 1) ];
+    while (*t_ptr != t) {
+        assert (*t_ptr != NULL);
+        t_ptr = &((*t_ptr)->next);
+    }
+    *t_ptr = t->next;
+
+    i = t->index;
+    t_last = tp->timers_heap[ --tp->num_timers ];
+    if (t_last != t) {
+        tp->timers_heap[ i ] = t_last;
+        t_last->index = i;
+        _tpoll_timer_sift_up (tp, i);
+        _tpoll_timer_sift_down (tp, t_last->index);
+    }
+    t->index = -1;
+    t->next = NULL;
+    return;
+}
+
+
+static _tpoll_timer_t
+_tpoll_timer_find (tpoll_t tp, int id)
+{
+/*  Returns the active timer [id] within [tp], or NULL if not found.
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    _tpoll_timer_t t;
+
+    assert (tp != NULL);
+
+    if (tp->num_timers_hash == 0) {
+        return (NULL);
+    }
+    t = tp->timers_hash[ id & (tp->num_timers_hash - 1) ];
+    while (t && (t->id != id)) {
+        t = t->next;
+    }
+    return (t);
+}
+
+
+static void
+_tpoll_timer_sift_up (tpoll_t tp, int i)
+{
+/*  Restores the heap property by moving the timer at index [i] of [tp]'s heap
+ *    towards the root.
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    _tpoll_timer_t t;
+    int            parent;
+
+    assert (tp != NULL);
+    assert ((i >= 0) && (i < tp->num_timers));
+
+    t = tp->timers_heap[ i ];
+    while (i > 0) {
+        parent = (i - 1) / TPOLL_HEAP_D;
+        if (!_TPOLL_TIMER_LT (t, tp->timers_heap[ parent ])) {
+            break;
+        }
+        tp->timers_heap[ i ] = tp->timers_heap[ parent ];
+        tp->timers_heap[ i ]->index = i;
+        i = parent;
+    }
+    tp->timers_heap[ i ] = t;
+    t->index = i;
+    return;
+}
+
+
+static void
+_tpoll_timer_sift_down (tpoll_t tp, int i)
+{
+/*  Restores the heap property by moving the timer at index [i] of [tp]'s heap
+ *    away from the root.
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    _tpoll_timer_t t;
+    int            child;
+    int            child_min;
+    int            child_end;
+
+    assert (tp != NULL);
+    assert ((i >= 0) && (i < tp->num_timers));
+
+    t = tp->timers_heap[ i ];
+    for (;;) {
+        child = (i * TPOLL_HEAP_D) + 1;
+        if (child >= tp->num_timers) {
+            break;
+        }
+        child_end = child + TPOLL_HEAP_D;
+        if (child_end > tp->num_timers) {
+            child_end = tp->num_timers;
+        }
+        child_min = child;
+        for (child++; child < child_end; child++) {
+            if (_TPOLL_TIMER_LT (tp->timers_heap[ child ],
+                    tp->timers_heap[ child_min ])) {
+                child_min = child;
+            }
+        }
+        if (!_TPOLL_TIMER_LT (tp->timers_heap[ child_min ], t)) {
+            break;
+        }
+        tp->timers_heap[ i ] = tp->timers_heap[ child_min ];
+        tp->timers_heap[ i ]->index = i;
+        i = child_min;
+    }
+    tp->timers_heap[ i ] = t;
+    t->index = i;
+    return;
+}
+
+
+static int
+_tpoll_timer_grow (tpoll_t tp)
+{
+/*  Doubles the size of [tp]'s timer heap, and rehashes the active timers
+ *    into a hash table with as many buckets as heap slots.
+ *  Returns 0 if the request is successful, -1 if not.
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    _tpoll_timer_t *heap_tmp;
+    _tpoll_timer_t *hash_tmp;
+    _tpoll_timer_t  t;
+    int             num_tmp;
+    int             i;
+    int             h;
+
+    assert (tp != NULL);
+
+    num_tmp = (tp->num_timers_alloc > 0) ? tp->num_timers_alloc * 2 : 64;
+    if (num_tmp <= 0) {
+        errno = ENOMEM;
+        return (-1);
+    }
+    if (!(heap_tmp =
+            realloc (tp->timers_heap, num_tmp * sizeof (_tpoll_timer_t)))) {
+        return (-1);
+    }
+    tp->timers_heap = heap_tmp;
+
+    if (!(hash_tmp = calloc (num_tmp, sizeof (_tpoll_timer_t)))) {
+        return (-1);
+    }
+    for (i = 0; i < tp->num_timers; i++) {
+        t = tp->timers_heap[ i ];
+        h = t->id & (num_tmp - 1);
+        t->next = hash_tmp[ h ];
+        hash_tmp[ h ] = t;
+    }
+    free (tp->timers_hash);
+    tp->timers_hash = hash_tmp;
+    tp->num_timers_hash = num_tmp;
+    tp->num_timers_alloc = num_tmp;
+    return (0);
+}
+
+
+#if WITH_EPOLL
+
+static int
+_tpoll_epoll_ctl (tpoll_t tp, int fd, short int events, bool is_new)
+{
+/*  Updates the epoll instance of [tp] to monitor [events] on file descriptor
+ *    [fd].  If [events] is 0, [fd] is removed from the epoll instance.
+ *    [is_new] is true if [fd] is not yet known to the tpoll object.
+ *  Since epoll does not support regular files, a file descriptor rejected
+ *    with EPERM is placed on the "nopoll" array; such fds are always
+ *    considered ready for the events of interest (as with poll()).
+ *  Returns 0 on success, or -1 on error.
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    struct epoll_event ev;
+    int                op;
+    int                k;
+
+    assert (tp != NULL);
+    assert (tp->ep_fd > -1);
+    assert ((fd >= 0) && (fd < tp->num_fds_alloc));
+
+    if (tp->fd_nopoll_index[ fd ] > -1) {
+        if (events == 0) {
+            k = tp->fd_nopoll_index[ fd ];
+            tp->fd_nopoll[ k ] = tp->fd_nopoll[ --tp->num_fds_nopoll ];
+            tp->fd_nopoll_index[ tp->fd_nopoll[ k ] ] = k;
+            tp->fd_nopoll_index[ fd ] = -1;
+        }
+        return (0);
+    }
+    if (events == 0) {
+        /*
+         *  The fd may already have been closed (which removes it from the
+         *    epoll instance), so errors are ignored here.
+         */
+        tp->num_syscalls++;
+        (void) epoll_ctl (tp->ep_fd, EPOLL_CTL_DEL, fd, NULL);
+        return (0);
+    }
+    memset (&ev, 0, sizeof (ev));
+    ev.events = _tpoll_poll_to_epoll (events);
+    ev.data.fd = fd;
+    op = is_new ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+
+    tp->num_syscalls++;
+    if (epoll_ctl (tp->ep_fd, op, fd, &ev) == 0) {
+        return (0);
+    }
+    /*  A previously-known fd may have been closed and reopened without being
+     *    cleared, or a new fd may still be registered from a prior life.
+     */
+    if ((op == EPOLL_CTL_MOD) && (errno == ENOENT)) {
+        tp->num_syscalls++;
+        if (epoll_ctl (tp->ep_fd, EPOLL_CTL_ADD, fd, &ev) == 0) {
+            return (0);
+        }
+    }
+    else if ((op == EPOLL_CTL_ADD) && (errno == EEXIST)) {
+        tp->num_syscalls++;
+        if (epoll_ctl (tp->ep_fd, EPOLL_CTL_MOD, fd, &ev) == 0) {
+            return (0);
+        }
+    }
+    if (errno == EPERM) {
+        DPRINTF((21, "tpoll fd=%d not supported by epoll.\n", fd));
+        tp->fd_nopoll_index[ fd ] = tp->num_fds_nopoll;
+        tp->fd_nopoll[ tp->num_fds_nopoll++ ] = fd;
+        return (0);
+    }
+    return (-1);
+}
+
+
+static void
+_tpoll_epoll_enter (tpoll_t tp, int *timeout)
+{
+/*  Prepares [tp] for calling epoll_wait() with the given [timeout].
+ *  The revents from the previous call are cleared since, unlike poll(),
+ *    epoll_wait() only reports the fds that are ready.  If any "nopoll" fds
+ *    are present, the [timeout] is set to 0 since those are always ready.
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    struct epoll_event *ep_array_tmp;
+    int                 i;
+
+    assert (tp != NULL);
+    assert (tp->ep_fd > -1);
+    assert (timeout != NULL);
+
+    for (i = 0; i < tp->num_fds_ready; i++) {
+        tp->fd_array[ tp->fd_ready[ i ] ].revents = 0;
+    }
+    tp->fd_array[ tp->fd_pipe[ 0 ] ].revents = 0;
+    tp->num_fds_ready = 0;
+
+    if (tp->num_eps_alloc < tp->num_fds_alloc) {
+        ep_array_tmp = realloc (tp->ep_array,
+            tp->num_fds_alloc * sizeof (struct epoll_event));
+        if (ep_array_tmp != NULL) {
+            tp->ep_array = ep_array_tmp;
+            tp->num_eps_alloc = tp->num_fds_alloc;
+        }
+    }
+    if (tp->num_fds_nopoll > 0) {
+        *timeout = 0;
+    }
+    return;
+}
+
+
+static int
+_tpoll_epoll_leave (tpoll_t tp, int n)
+{
+/*  Translates the [n] events returned by epoll_wait() into the revents of
+ *    [tp]'s fd_array, and records the ready fds in the fd_ready array.
+ *    Events for fds cleared while epoll_wait() was blocked are discarded.
+ *    The "nopoll" fds are reported as ready for their events of interest.
+ *  Returns the number of fds with I/O ready (including the "signaling pipe"
+ *    in the same manner as poll()).
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    int       i;
+    int       fd;
+    int       num_ready = 0;
+    short int revents;
+
+    assert (tp != NULL);
+    assert (tp->ep_fd > -1);
+
+    for (i = 0; i < n; i++) {
+        fd = tp->ep_array[ i ].data.fd;
+        if ((fd < 0) || (fd >= tp->num_fds_alloc)
+                || (tp->fd_array[ fd ].fd < 0)) {
+            continue;
+        }
+        revents = _tpoll_epoll_to_poll (tp->ep_array[ i ].events)
+            & (tp->fd_array[ fd ].events | POLLERR | POLLHUP);
+        if (revents == 0) {
+            continue;
+        }
+        tp->fd_array[ fd ].revents = revents;
+        if (fd != tp->fd_pipe[ 0 ]) {
+            tp->fd_ready[ tp->num_fds_ready++ ] = fd;
+        }
+        num_ready++;
+    }
+    for (i = 0; i < tp->num_fds_nopoll; i++) {
+        fd = tp->fd_nopoll[ i ];
+        revents = tp->fd_array[ fd ].events & (POLLIN | POLLOUT);
+        if (revents == 0) {
+            continue;
+        }
+        tp->fd_array[ fd ].revents = revents;
+        tp->fd_ready[ tp->num_fds_ready++ ] = fd;
+        num_ready++;
+    }
+    return (num_ready);
+}
+
+
+static uint32_t
+_tpoll_poll_to_epoll (short int events)
+{
+/*  Returns the epoll event mask corresponding to the poll [events].
+ */
+    uint32_t ep_events = 0;
+
+    if (events & POLLIN) {
+        ep_events |= EPOLLIN;
+    }
+    if (events & POLLPRI) {
+        ep_events |= EPOLLPRI;
+    }
+    if (events & POLLOUT) {
+        ep_events |= EPOLLOUT;
+    }
+    return (ep_events);
+}
+
+
+static short int
+_tpoll_epoll_to_poll (uint32_t ep_events)
+{
+/*  Returns the poll event mask corresponding to the epoll [ep_events].
+ */
+    short int events = 0;
+
+    if (ep_events & EPOLLIN) {
+        events |= POLLIN;
+    }
+    if (ep_events & EPOLLPRI) {
+        events |= POLLPRI;
+    }
+    if (ep_events & EPOLLOUT) {
+        events |= POLLOUT;
+    }
+    if (ep_events & EPOLLERR) {
+        events |= POLLERR;
+    }
+    if (ep_events & EPOLLHUP) {
+        events |= POLLHUP;
+    }
+    return (events);
+}
+
+#endif /* WITH_EPOLL */
+
+#if WITH_IO_URING
+
+static int
+_tpoll_uring_create (tpoll_t tp, int n)
+{
+/*  Creates an io_uring instance for [tp] to track [n] fds.
+ *  The ring must support a single mmap for the SQ & CQ rings, retain
+ *    completions on CQ overflow, and accept a timeout argument when waiting;
+ *    otherwise, the caller falls back to epoll or poll().
+ *  Returns 0 on success, or -1 on error (with errno set).
+ *  On error, the caller is responsible for calling _tpoll_uring_destroy().
+ */
+    struct io_uring_params p;
+    _tpoll_uring_t         ur;
+    unsigned int           features;
+    size_t                 sq_len;
+    size_t                 cq_len;
+    int                    i;
+
+    assert (tp != NULL);
+    assert (tp->ur == NULL);
+    assert (n > 0);
+
+    if (!(ur = malloc (sizeof (struct tpoll_uring)))) {
+        return (-1);
+    }
+    memset (ur, 0, sizeof (*ur));
+    ur->fd = -1;
+    ur->ring = MAP_FAILED;
+    ur->sqes = MAP_FAILED;
+    tp->ur = ur;
+
+    if (!(tp->ur_fds = malloc (n * sizeof (_tpoll_uring_fd_t)))) {
+        return (-1);
+    }
+    memset (tp->ur_fds, 0, n * sizeof (_tpoll_uring_fd_t));
+    if (!(tp->fd_dirty = malloc (n * sizeof (int)))) {
+        return (-1);
+    }
+    tp->num_fds_dirty = 0;
+
+    memset (&p, 0, sizeof (p));
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    p.cq_entries = TPOLL_URING_CQ_ENTRIES;
+    ur->fd = syscall (__NR_io_uring_setup, TPOLL_URING_SQ_ENTRIES, &p);
+    if (ur->fd < 0) {
+        return (-1);
+    }
+    features = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP
+        | IORING_FEAT_EXT_ARG;
+    if ((p.features & features) != features) {
+        errno = ENOSYS;
+        return (-1);
+    }
+    sq_len = p.sq_off.array + (p.sq_entries * sizeof (unsigned));
+    cq_len = p.cq_off.cqes + (p.cq_entries * sizeof (struct io_uring_cqe));
+    ur->ring_len = (sq_len > cq_len) ? sq_len : cq_len;
+    ur->ring = mmap (NULL, ur->ring_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ur->fd, IORING_OFF_SQ_RING);
+    if (ur->ring == MAP_FAILED) {
+        return (-1);
+    }
+    ur->sqes_len = p.sq_entries * sizeof (struct io_uring_sqe);
+    ur->sqes = mmap (NULL, ur->sqes_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ur->fd, IORING_OFF_SQES);
+    if (ur->sqes == MAP_FAILED) {
+        return (-1);
+    }
+    ur->sq_head = (unsigned *) ((char *) ur->ring + p.sq_off.head);
+    ur->sq_tail = (unsigned *) ((char *) ur->ring + p.sq_off.tail);
+    ur->sq_array = (unsigned *) ((char *) ur->ring + p.sq_off.array);
+    ur->sq_mask = *(unsigned *) ((char *) ur->ring + p.sq_off.ring_mask);
+    ur->sq_entries = p.sq_entries;
+    ur->sq_tail_local = *ur->sq_tail;
+    ur->cq_head = (unsigned *) ((char *) ur->ring + p.cq_off.head);
+    ur->cq_tail = (unsigned *) ((char *) ur->ring + p.cq_off.tail);
+    ur->cq_mask = *(unsigned *) ((char *) ur->ring + p.cq_off.ring_mask);
+    ur->cqes = (struct io_uring_cqe *) ((char *) ur->ring + p.cq_off.cqes);
+
+    /*  Each SQ slot maps to the SQ entry of the same index.
+     */
+    for (i = 0; i < (int) ur->sq_entries; i++) {
+        ur->sq_array[ i ] = i;
+    }
+    DPRINTF((21, "tpoll io_uring sq=%u cq=%u.\n", p.sq_entries, p.cq_entries));
+    return (0);
+}
+
+
+static void
+_tpoll_uring_destroy (tpoll_t tp)
+{
+/*  Destroys [tp]'s io_uring instance (if any), thereby cancelling all of its
+ *    outstanding poll requests.
+ */
+    _tpoll_uring_t ur;
+
+    assert (tp != NULL);
+
+    if ((ur = tp->ur) != NULL) {
+        if (ur->sqes != MAP_FAILED) {
+            (void) munmap (ur->sqes, ur->sqes_len);
+        }
+        if (ur->ring != MAP_FAILED) {
+            (void) munmap (ur->ring, ur->ring_len);
+        }
+        if (ur->fd > -1) {
+            (void) close (ur->fd);
+        }
+        free (ur);
+        tp->ur = NULL;
+    }
+    if (tp->ur_fds) {
+        free (tp->ur_fds);
+        tp->ur_fds = NULL;
+    }
+    if (tp->fd_dirty) {
+        free (tp->fd_dirty);
+        tp->fd_dirty = NULL;
+    }
+    tp->num_fds_dirty = 0;
+    return;
+}
+
+
+static int
+_tpoll_uring_grow (tpoll_t tp, int num_fds_old, int num_fds_new)
+{
+/*  Grows [tp]'s io_uring fd state from [num_fds_old] to [num_fds_new] fds.
+ *  Returns 0 on success, or -1 on error.
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    _tpoll_uring_fd_t *ur_fds_tmp;
+    int               *fd_dirty_tmp;
+
+    assert (tp != NULL);
+    assert (tp->ur != NULL);
+    assert (num_fds_new > num_fds_old);
+
+    if (!(ur_fds_tmp = realloc (tp->ur_fds,
+            num_fds_new * sizeof (_tpoll_uring_fd_t)))) {
+        return (-1);
+    }
+    memset (ur_fds_tmp + num_fds_old, 0,
+        (num_fds_new - num_fds_old) * sizeof (_tpoll_uring_fd_t));
+    tp->ur_fds = ur_fds_tmp;
+
+    if (!(fd_dirty_tmp = realloc (tp->fd_dirty, num_fds_new * sizeof (int)))) {
+        return (-1);
+    }
+    tp->fd_dirty = fd_dirty_tmp;
+    return (0);
+}
+
+
+static void
+_tpoll_uring_mark (tpoll_t tp, int fd, bool is_dropped)
+{
+/*  Marks [fd] within [tp] as needing its poll request updated to match its
+ *    events of interest.  The update is deferred until the next tpoll().
+ *  If [is_dropped] is true, the fd has been cleared of all events (and may
+ *    since have been closed and reused for another file), so any poll request
+ *    armed for it must be replaced even if its events end up unchanged.
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    assert (tp != NULL);
+    assert (tp->ur != NULL);
+    assert ((fd >= 0) && (fd < tp->num_fds_alloc));
+
+    if (is_dropped) {
+        tp->ur_fds[ fd ].is_dropped = true;
+    }
+    if (!tp->ur_fds[ fd ].is_dirty) {
+        tp->ur_fds[ fd ].is_dirty = true;
+        tp->fd_dirty[ tp->num_fds_dirty++ ] = fd;
+    }
+    return;
+}
+
+
+static struct io_uring_sqe *
+_tpoll_uring_get_sqe (tpoll_t tp)
+{
+/*  Returns the next (zeroed) submission queue entry for [tp]'s io_uring.
+ *  If the SQ is full, the pending entries are submitted to make room.
+ *  Returns NULL if no entry is available.
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    _tpoll_uring_t       ur;
+    struct io_uring_sqe *sqe;
+    unsigned             head;
+    int                  n;
+
+    assert (tp != NULL);
+    assert (tp->ur != NULL);
+
+    ur = tp->ur;
+    head = __atomic_load_n (ur->sq_head, __ATOMIC_ACQUIRE);
+    if (ur->sq_tail_local - head >= ur->sq_entries) {
+        __atomic_store_n (ur->sq_tail, ur->sq_tail_local, __ATOMIC_RELEASE);
+        tp->num_syscalls++;
+        n = syscall (__NR_io_uring_enter, ur->fd, ur->sq_tail_local - head,
+            0, 0, NULL, 0);
+        if (n < 0) {
+            DPRINTF((21, "tpoll io_uring submit failed: %s.\n",
+                strerror (errno)));
+        }
+        head = __atomic_load_n (ur->sq_head, __ATOMIC_ACQUIRE);
+        if (ur->sq_tail_local - head >= ur->sq_entries) {
+            return (NULL);
+        }
+    }
+    sqe = &ur->sqes[ ur->sq_tail_local & ur->sq_mask ];
+    memset (sqe, 0, sizeof (*sqe));
+    ur->sq_tail_local++;
+    return (sqe);
+}
+
+
+static void
+_tpoll_uring_enter (tpoll_t tp, int *timeout)
+{
+/*  Prepares [tp] for waiting on its io_uring.
+ *  The revents from the previous call are cleared, and the poll requests of
+ *    the "dirty" fds are queued for removal and/or (re)arming.  These are
+ *    submitted by the same io_uring_enter() that waits for completions.
+ *  A poll request is bound to the file open on the fd when it was armed,
+ *    so the request of an fd that was dropped is always replaced: the fd
+ *    may have been closed and reopened (with the same events) in between.
+ *  If an fd's poll request cannot be queued, it remains dirty and the
+ *    [timeout] is set to 0 so another attempt is made shortly.
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    _tpoll_uring_t       ur;
+    _tpoll_uring_fd_t   *uf;
+    struct io_uring_sqe *sqe;
+    short int            events;
+    int                  fd;
+    int                  i;
+    int                  j;
+
+    assert (tp != NULL);
+    assert (tp->ur != NULL);
+    assert (timeout != NULL);
+
+    ur = tp->ur;
+
+    for (i = 0; i < tp->num_fds_ready; i++) {
+        tp->fd_array[ tp->fd_ready[ i ] ].revents = 0;
+    }
+    tp->fd_array[ tp->fd_pipe[ 0 ] ].revents = 0;
+    tp->num_fds_ready = 0;
+
+    for (i = 0, j = 0; i < tp->num_fds_dirty; i++) {
+        fd = tp->fd_dirty[ i ];
+        uf = &tp->ur_fds[ fd ];
+        events = (tp->fd_array[ fd ].fd > -1) ? tp->fd_array[ fd ].events : 0;
+        if ((uf->events == events) && !uf->is_dropped) {
+            uf->is_dirty = false;
+            continue;
+        }
+        if (uf->events != 0) {
+            if (!(sqe = _tpoll_uring_get_sqe (tp))) {
+                tp->fd_dirty[ j++ ] = fd;
+                continue;
+            }
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = _TPOLL_URING_TAG (fd, uf->gen);
+            sqe->user_data = TPOLL_URING_NOP;
+            uf->events = 0;
+        }
+        if (events != 0) {
+            if (!(sqe = _tpoll_uring_get_sqe (tp))) {
+                tp->fd_dirty[ j++ ] = fd;
+                continue;
+            }
+            uf->gen++;
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = fd;
+            sqe->poll_events = events;
+            sqe->user_data = _TPOLL_URING_TAG (fd, uf->gen);
+            uf->events = events;
+        }
+        uf->is_dirty = false;
+        uf->is_dropped = false;
+    }
+    tp->num_fds_dirty = j;
+    if (j > 0) {
+        *timeout = 0;
+    }
+    __atomic_store_n (ur->sq_tail, ur->sq_tail_local, __ATOMIC_RELEASE);
+    return;
+}
+
+
+static int
+_tpoll_uring_wait (tpoll_t tp, int timeout)
+{
+/*  Submits [tp]'s queued poll requests and waits up to [timeout] ms for a
+ *    completion (blocking indefinitely if [timeout] < 0).
+ *  Returns 0 on success or timeout, or -1 on error (with errno set).
+ *  This routine is called without the [tp] mutex locked; only the thread
+ *    calling tpoll() modifies the ring.
+ */
+    _tpoll_uring_t                 ur;
+    struct io_uring_getevents_arg  arg;
+    struct __kernel_timespec       ts;
+    unsigned                       to_submit;
+    unsigned                       min_complete;
+    int                            n;
+
+    assert (tp != NULL);
+    assert (tp->ur != NULL);
+
+    ur = tp->ur;
+    to_submit = ur->sq_tail_local
+        - __atomic_load_n (ur->sq_head, __ATOMIC_ACQUIRE);
+    min_complete = (timeout != 0) ? 1 : 0;
+
+    memset (&arg, 0, sizeof (arg));
+    if (timeout > 0) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000;
+        arg.ts = (__u64) (uintptr_t) &ts;
+    }
+    n = syscall (__NR_io_uring_enter, ur->fd, to_submit, min_complete,
+        IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof (arg));
+    if (n < 0) {
+        if ((errno == ETIME) || (errno == EBUSY) || (errno == EAGAIN)) {
+            return (0);
+        }
+        return (-1);
+    }
+    return (0);
+}
+
+
+static int
+_tpoll_uring_leave (tpoll_t tp)
+{
+/*  Reaps the completions from [tp]'s io_uring, translating them into the
+ *    revents of [tp]'s fd_array, and records the ready fds in the fd_ready
+ *    array.  Completions for poll requests that have since been removed or
+ *    replaced are discarded.  Each fd whose poll request completed is marked
+ *    so that request is re-armed by the next tpoll().
+ *  Returns the number of fds with I/O ready (including the "signaling pipe"
+ *    in the same manner as poll()).
+ *  This routine assumes the [tp] mutex is already locked.
+ */
+    _tpoll_uring_t       ur;
+    _tpoll_uring_fd_t   *uf;
+    struct io_uring_cqe *cqe;
+    unsigned             head;
+    unsigned             tail;
+    int                  fd;
+    int                  num_ready = 0;
+    short int            revents;
+
+    assert (tp != NULL);
+    assert (tp->ur != NULL);
+
+    ur = tp->ur;
+    head = *ur->cq_head;
+    tail = __atomic_load_n (ur->cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++) {
+        cqe = &ur->cqes[ head & ur->cq_mask ];
+        if (cqe->user_data == TPOLL_URING_NOP) {
+            continue;
+        }
+        fd = _TPOLL_URING_FD (cqe->user_data);
+        if ((fd < 0) || (fd >= tp->num_fds_alloc)) {
+            continue;
+        }
+        uf = &tp->ur_fds[ fd ];
+        if ((uf->events == 0)
+                || (uf->gen != _TPOLL_URING_GEN (cqe->user_data))) {
+            continue;
+        }
+        uf->events = 0;
+        _tpoll_uring_mark (tp, fd, false);
+
+        if (cqe->res == -ECANCELED) {
+            continue;
+        }
+        else if (cqe->res == -EBADF) {
+            revents = POLLNVAL;
+        }
+        else if (cqe->res < 0) {
+            revents = POLLERR;
+        }
+        else {
+            revents = cqe->res
+                & (tp->fd_array[ fd ].events | POLLERR | POLLHUP);
+        }
+        if ((revents == 0) || (tp->fd_array[ fd ].fd < 0)) {
+            continue;
+        }
+        if (tp->fd_array[ fd ].revents == 0) {
+            if (fd != tp->fd_pipe[ 0 ]) {
+                tp->fd_ready[ tp->num_fds_ready++ ] = fd;
+            }
+            num_ready++;
+        }
+        tp->fd_array[ fd ].revents |= revents;
+    }
+    __atomic_store_n (ur->cq_head, head, __ATOMIC_RELEASE);
+    return (num_ready);
+}
+
+#endif /* WITH_IO_URING */
+
+
 static void
 _tpoll_get_timeval (struct timeval *tvp, int ms)
 {
@@ -78,5 +78,11 @@ int tpoll_timeout_cancel (tpoll_t tp, int id);
 
 int tpoll (tpoll_t tp, int ms);
 
+int tpoll_ready (tpoll_t tp, int i);
+
+const char * tpoll_backend (tpoll_t tp);
+
+unsigned long tpoll_num_syscalls (tpoll_t tp);
+
 
 #endif /* !_TPOLL_H */
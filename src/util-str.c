@@ -36,6 +36,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include <time.h>
 #include "log.h"
 #include "util-str.h"
@@ -43,6 +44,18 @@
 #include "wrapper.h"
 
 
+static char * write_timestamp_fraction(char *dst, unsigned long n, int digits);
+
+
+/*  The date & time of the most recent second rendered by
+ *    write_timestamp_string(), shared by all threads.
+ */
+static pthread_mutex_t timestampLock = PTHREAD_MUTEX_INITIALIZER;
+static time_t timestampSec = (time_t) -1;
+static char timestampDate[20];          /* "YYYY-MM-DD HH:MM:SS" + NUL */
+static char timestampZone[7];           /* "+hh:mm" + NUL */
+
+
 #define MAX_STR_SIZE 1024
 
 
@@ -362,6 +375,111 @@ int write_time_string(time_t t, char *dst, size_t dstlen)
 }
 
 
+int write_timestamp_string(timestamp_fmt_t fmt, char *dst, size_t dstlen)
+{
+/*  Writes a timestamp of the current time in the format (fmt) into the
+ *    buffer (dst) of size (dstlen):
+ *      CONMAN_TS_SEC:        "YYYY-MM-DD HH:MM:SS "
+ *      CONMAN_TS_MSEC:       "YYYY-MM-DD HH:MM:SS.mmm "
+ *      CONMAN_TS_USEC:       "YYYY-MM-DD HH:MM:SS.uuuuuu "
+ *      CONMAN_TS_ISO8601:    "YYYY-MM-DDTHH:MM:SS.uuuuuu+hh:mm "
+ *      CONMAN_TS_MONOTONIC:  "[sssss.uuuuuu] "
+ *  The timestamp is never truncated: if (dstlen) cannot hold one of
+ *    TIMESTAMP_MAX_LEN characters plus the NUL, nothing is written.
+ *  Returns the number of characters written (not including the NUL),
+ *    or 0 if (dstlen) is too small.
+ */
+    struct timeval tv;
+    time_t t;
+    struct tm tm;
+    char zone[6];                       /* "+hhmm" + NUL */
+    char *p;
+    int n;
+
+    assert(dst != NULL);
+
+    if (dstlen <= TIMESTAMP_MAX_LEN) {
+        return(0);
+    }
+    if (fmt == CONMAN_TS_MONOTONIC) {
+#ifdef CLOCK_MONOTONIC
+        struct timespec ts;
+
+        if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+            log_err(errno, "clock_gettime() failed");
+        }
+        tv.tv_sec = ts.tv_sec;
+        tv.tv_usec = ts.tv_nsec / 1000;
+#else /* !CLOCK_MONOTONIC */
+        if (gettimeofday(&tv, NULL) < 0) {
+            log_err(errno, "gettimeofday() failed");
+        }
+#endif /* !CLOCK_MONOTONIC */
+        n = snprintf(dst, dstlen, "[%5lu.%06lu] ",
+            (unsigned long) tv.tv_sec, (unsigned long) tv.tv_usec);
+        assert((n > 0) && ((size_t) n < dstlen));
+        return(n);
+    }
+    if (gettimeofday(&tv, NULL) < 0) {
+        log_err(errno, "gettimeofday() failed");
+    }
+    /*  The date & time are only re-rendered when the second changes.
+     */
+    x_pthread_mutex_lock(&timestampLock);
+    if (tv.tv_sec != timestampSec) {
+        t = tv.tv_sec;
+        get_localtime(&t, &tm);
+        if (strftime(timestampDate, sizeof(timestampDate),
+                "%Y-%m-%d %H:%M:%S", &tm) != sizeof(timestampDate) - 1) {
+            log_err(0, "strftime() failed");
+        }
+        if (strftime(zone, sizeof(zone), "%z", &tm) != sizeof(zone) - 1) {
+            log_err(0, "strftime() failed");
+        }
+        snprintf(timestampZone, sizeof(timestampZone), "%.3s:%.2s",
+            zone, zone + 3);
+        timestampSec = tv.tv_sec;
+    }
+    memcpy(dst, timestampDate, sizeof(timestampDate) - 1);
+    p = dst + sizeof(timestampDate) - 1;
+    if (fmt == CONMAN_TS_ISO8601) {
+        dst[10] = 'T';
+        p = write_timestamp_fraction(p, tv.tv_usec, 6);
+        memcpy(p, timestampZone, sizeof(timestampZone) - 1);
+        p += sizeof(timestampZone) - 1;
+    }
+    x_pthread_mutex_unlock(&timestampLock);
+
+    if (fmt == CONMAN_TS_MSEC) {
+        p = write_timestamp_fraction(p, tv.tv_usec / 1000, 3);
+    }
+    else if (fmt == CONMAN_TS_USEC) {
+        p = write_timestamp_fraction(p, tv.tv_usec, 6);
+    }
+    *p++ = ' ';
+    *p = '\0';
+    assert((size_t) (p - dst) <= TIMESTAMP_MAX_LEN);
+    return(p - dst);
+}
+
+
+static char * write_timestamp_fraction(char *dst, unsigned long n, int digits)
+{
+/*  Writes the fractional seconds (n) as a '.' followed by (digits) digits
+ *    into the buffer (dst).
+ *  Returns a ptr to the character following the last one written.
+ */
+    char *p;
+
+    *dst++ = '.';
+    for (p = dst + digits - 1; p >= dst; p--) {
+        *p = '0' + (n % 10);
+        n /= 10;
+    }
+    return(dst + digits);
+}
+
+
 struct tm * get_localtime(time_t *tPtr, struct tm *tmPtr)
 {
 #if ! HAVE_LOCALTIME_R
@@ -33,6 +33,20 @@
 #include <unistd.h>
 
 
+/*  Maximum length of a timestamp written by write_timestamp_string(),
+ *    including the trailing space but not the NUL.
+ */
+#define TIMESTAMP_MAX_LEN       33
+
+typedef enum timestamp_fmt {            /* write_timestamp_string() fmts     */
+    CONMAN_TS_SEC,                      /*  "YYYY-MM-DD HH:MM:SS "           */
+    CONMAN_TS_MSEC,                     /*  "YYYY-MM-DD HH:MM:SS.mmm "       */
+    CONMAN_TS_USEC,                     /*  "YYYY-MM-DD HH:MM:SS.uuuuuu "    */
+    CONMAN_TS_ISO8601,                  /*  ISO-8601 w/ usecs & UTC offset   */
+    CONMAN_TS_MONOTONIC                 /*  "[sssss.uuuuuu] "                */
+} timestamp_fmt_t;
+
+
 char * create_string(const char *str);
 /*
  *  Duplicates string (str) and returns a new string
@@ -136,6 +150,18 @@ int write_time_string(time_t t, char *dst, size_t dstlen);
  *  Returns the number of characters written (not including the NUL).
  */
 
+int write_timestamp_string(timestamp_fmt_t fmt, char *dst, size_t dstlen);
+/*
+ *  Writes a timestamp of the current time in the format (fmt), followed by
+ *    a space, into the buffer (dst) of size (dstlen).
+ *  The date & time are rendered into a cache shared by all threads that is
+ *    only updated when the second changes, so this does not incur the cost of
+ *    a localtime() & strftime() for each call.  CONMAN_TS_MONOTONIC is the
+ *    time elapsed on the monotonic clock (ie, since boot on Linux).
+ *  Returns the number of characters written (not including the NUL),
+ *    or 0 if (dstlen) is too small.
+ */
+
 struct tm * get_localtime(time_t *tPtr, struct tm *tmPtr);
 /*
  *  Gets the local time in a thread-safe manner.
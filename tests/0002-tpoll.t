@@ -0,0 +1,37 @@
+#!/bin/sh
+
+test_description="Check tpoll fd handling"
+
+: "${SHARNESS_TEST_SRCDIR:=$(cd "$(dirname "$0")" && pwd)}"
+. "${SHARNESS_TEST_SRCDIR}/sharness.sh"
+
+TPOLL_TEST="${CONMAN_BUILD_DIR}/tests/tpoll-test"
+
+# Require the test utility to be built (via "make check").
+#
+if test ! -x "${TPOLL_TEST}"; then
+    skip_all="skipping tpoll tests; ${TPOLL_TEST} not built"
+    test_done
+fi
+
+# Verify I/O is reported on a file reopened on the same fd number (with the
+#   same events) between two calls to tpoll().
+#
+test_expect_success 'check fd closed and reused before next tpoll' '
+    "${TPOLL_TEST}" reuse
+'
+
+# Verify I/O is reported on an fd cleared and set again between two calls
+#   to tpoll().
+#
+test_expect_success 'check fd cleared and set before next tpoll' '
+    "${TPOLL_TEST}" rearm
+'
+
+# Verify POLLIN is reported while POLLOUT is being toggled on the same fd.
+#
+test_expect_success 'check POLLOUT toggled while POLLIN set' '
+    "${TPOLL_TEST}" toggle
+'
+
+test_done
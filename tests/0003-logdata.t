@@ -0,0 +1,31 @@
+#!/bin/sh
+
+test_description="Check processing of console data written to logfiles"
+
+: "${SHARNESS_TEST_SRCDIR:=$(cd "$(dirname "$0")" && pwd)}"
+. "${SHARNESS_TEST_SRCDIR}/sharness.sh"
+
+LOGDATA_TEST="${CONMAN_BUILD_DIR}/tests/logdata-test"
+LOGDATA_CORPUS="${SHARNESS_TEST_SRCDIR}/logdata-corpus"
+
+# Require the test utility to be built (via "make check").
+#
+if test ! -x "${LOGDATA_TEST}"; then
+    skip_all="skipping logdata tests; ${LOGDATA_TEST} not built"
+    test_done
+fi
+
+# Verify sanitized and timestamped logfile data matches that of the original
+#   per-byte newline state machine for each file in the corpus.
+#
+test_expect_success 'check logfile data processing of corpus' '
+    "${LOGDATA_TEST}" "${LOGDATA_CORPUS}"/*.bin
+'
+
+# Verify the same for pseudo-random data weighted towards CR/LF/NUL bytes.
+#
+test_expect_success 'check logfile data processing of random data' '
+    "${LOGDATA_TEST}" -n 25 -s 1
+'
+
+test_done
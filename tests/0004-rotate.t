@@ -0,0 +1,91 @@
+#!/bin/sh
+
+test_description="Check native logfile rotation"
+
+: "${SHARNESS_TEST_SRCDIR:=$(cd "$(dirname "$0")" && pwd)}"
+. "${SHARNESS_TEST_SRCDIR}/sharness.sh"
+
+# Set up the environment with test consoles writing ~50KB/s so each logfile
+#   reaches its 4KB rotation size several times a second.
+# Provide [LOG] for the logfile of console test1.
+#
+test_expect_success 'setup' '
+    conmand_setup \
+            "global testopts=\"b:512,m:10,n:10,p:100\"" \
+            "global logopts=\"rotate-size:4k,rotate-keep:3\"" &&
+    LOG=$(conmand_console_log test1) &&
+    test "x${LOG}" != x
+'
+
+# Start the daemon.
+#
+test_expect_success 'start conmand' '
+    conmand_start
+'
+
+# Wait until the logfile has been rotated more times than are kept.
+#
+test_expect_success 'wait for logfile rotation' '
+    conmand_wait test -f "${LOG}.3" &&
+    conmand_wait grep "${LOG}\" rotated" "${CONMAND_LOGFILE}" &&
+    sleep 1
+'
+
+# Stop the daemon.
+#
+test_expect_success 'stop conmand' '
+    conmand_stop
+'
+
+# Verify the rotated logfiles have been kept up to the rotate-keep limit.
+#
+test_expect_success 'check rotated logfiles' '
+    ls -l "${LOG}"* &&
+    test -f "${LOG}" &&
+    test -f "${LOG}.1" &&
+    test -f "${LOG}.2" &&
+    test -f "${LOG}.3" &&
+    test ! -e "${LOG}.4"
+'
+
+# Verify each rotated logfile reached the rotation size and was written by
+#   a separate open of the logfile.
+#
+test_expect_success 'check rotated logfile contents' '
+    for f in "${LOG}.1" "${LOG}.2" "${LOG}.3"; do
+        test "$(wc -c <"$f")" -ge 4096 &&
+        test "$(grep -c "Console \[test1\] log opened" "$f")" -eq 1 ||
+                return 1
+    done
+'
+
+# Verify the index of each logfile has been rotated along with it.
+#
+test_expect_success 'check rotated logfile indexes' '
+    test -f "${LOG}.idx" &&
+    test -f "${LOG}.1.idx" &&
+    test -f "${LOG}.2.idx" &&
+    test -f "${LOG}.3.idx" &&
+    test ! -e "${LOG}.4.idx"
+'
+
+# Verify the daemon logged each rotation.
+#
+test_expect_success 'check logfile for rotation messages' '
+    test "$(grep -c "Console \[test1\] logfile \"${LOG}\" rotated" \
+            "${CONMAND_LOGFILE}")" -ge 4
+'
+
+# Check the logfile for errors.
+#
+test_expect_success 'check logfile for errors' '
+    ! grep -E -i "(EMERGENCY|ALERT|CRITICAL|ERROR):" "${CONMAND_LOGFILE}"
+'
+
+# Perform housekeeping to clean up afterwards.
+#
+test_expect_success 'cleanup' '
+    conmand_cleanup
+'
+
+test_done
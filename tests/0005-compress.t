@@ -0,0 +1,101 @@
+#!/bin/sh
+
+test_description="Check compressed console logfiles"
+
+: "${SHARNESS_TEST_SRCDIR:=$(cd "$(dirname "$0")" && pwd)}"
+. "${SHARNESS_TEST_SRCDIR}/sharness.sh"
+
+# Require conmanlog to be built (which requires zlib, as does the compress
+#   logopt).
+#
+if test ! -x "${CONMANLOG}"; then
+    skip_all="skipping compress tests; ${CONMANLOG} not built"
+    test_done
+fi
+
+if command -v zcat >/dev/null 2>&1; then
+    test_set_prereq ZCAT
+fi
+
+# Set up the environment with compressed logfiles.
+# Provide [LOG] for the logfile of console test1.
+#
+test_expect_success 'setup' '
+    conmand_setup \
+            "global testopts=\"b:64,m:10,n:10,p:100\"" \
+            "global logopts=\"compress\"" &&
+    LOG=$(conmand_console_log test1) &&
+    test "x${LOG}" != x
+'
+
+# Start the daemon.
+#
+test_expect_success 'start conmand' '
+    conmand_start
+'
+
+# Run long enough for several frames (each flushed a second after its first
+#   byte) to be written.
+#
+test_expect_success 'wait for compressed frames' '
+    conmand_wait test -s "${LOG}" &&
+    sleep 3
+'
+
+# Stop the daemon, which flushes the final partial frame.
+#
+test_expect_success 'stop conmand' '
+    conmand_stop
+'
+
+# Verify the logfile begins with a gzip member header.
+#
+test_expect_success 'check logfile is gzip-compressed' '
+    test "$(od -A n -t x1 -N 3 "${LOG}" | tr -d " ")" = "1f8b08"
+'
+
+# Verify conmanlog decompresses the logfile.
+#
+test_expect_success 'check conmanlog output' '
+    "${CONMANLOG}" "${LOG}" >conmanlog.out &&
+    test "$(grep -c "Console \[test1\] log opened" conmanlog.out)" -eq 1 &&
+    grep "0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ" conmanlog.out &&
+    test "$(wc -c <conmanlog.out)" -gt "$(wc -c <"${LOG}")"
+'
+
+# Verify zcat decompresses the logfile to the same output as conmanlog.
+#
+test_expect_success ZCAT 'check zcat output matches conmanlog' '
+    zcat "${LOG}" >zcat.out &&
+    cmp zcat.out conmanlog.out
+'
+
+# Verify conmanlog -t outputs a tail of the log starting at a frame boundary.
+#
+test_expect_success 'check conmanlog tail output' '
+    "${CONMANLOG}" -t 1 "${LOG}" >tail.out &&
+    test -s tail.out &&
+    test "$(wc -c <tail.out)" -lt "$(wc -c <conmanlog.out)" &&
+    tail -c "$(wc -c <tail.out)" conmanlog.out | cmp - tail.out
+'
+
+# Verify an uncompressed logfile is copied as-is by conmanlog.
+#
+test_expect_success 'check conmanlog output of plain file' '
+    "${CONMANLOG}" "${CONMAND_CONFIG}" >plain.out &&
+    cmp "${CONMAND_CONFIG}" plain.out
+'
+
+# Check the logfile for errors.
+#
+test_expect_success 'check logfile for errors' '
+    ! grep -E -i "(EMERGENCY|ALERT|CRITICAL|ERROR):" "${CONMAND_LOGFILE}"
+'
+
+# Perform housekeeping to clean up afterwards.
+#
+test_expect_success 'cleanup' '
+    conmand_cleanup
+'
+
+test_done
@@ -0,0 +1,130 @@
+#!/bin/sh
+
+test_description="Check console log time index and time-range query"
+
+: "${SHARNESS_TEST_SRCDIR:=$(cd "$(dirname "$0")" && pwd)}"
+. "${SHARNESS_TEST_SRCDIR}/sharness.sh"
+
+# Output the 8-byte little-endian encoding of the integer [n].
+#
+le64()
+{
+    local n="$1" i
+    for i in 1 2 3 4 5 6 7 8; do
+        printf "\\$(printf "%o" $((n & 255)))"
+        n=$((n >> 8))
+    done
+}
+
+# Output an index entry for data logged at time [t] at logfile offset [off].
+#
+index_entry()
+{
+    le64 "$1" && le64 "$2"
+}
+
+# Set up the environment.
+# Provide [LOG] for the logfile of console test1, and [NOW].
+#
+test_expect_success 'setup' '
+    conmand_setup &&
+    LOG=$(conmand_console_log test1) &&
+    test "x${LOG}" != x &&
+    NOW=$(date +%s) &&
+    test "x${NOW}" != x
+'
+
+# Create a rotated logfile holding data logged a week ago, and a current
+#   logfile holding data logged a day ago and an hour ago, each with its
+#   index.  The daemon appends to the current logfile and its index.
+#
+test_expect_success 'create logfiles with indexes' '
+    printf "week-old data\r\n" >"${LOG}.1" &&
+    index_entry $((NOW - 7 * 86400)) 0 >"${LOG}.1.idx" &&
+    printf "day-old data\r\nhour-old data\r\n" >"${LOG}" &&
+    { index_entry $((NOW - 86400)) 0 &&
+      index_entry $((NOW - 3600)) 14; } >"${LOG}.idx" &&
+    test "$(wc -c <"${LOG}.idx")" -eq 32
+'
+
+# Start the daemon.
+#
+test_expect_success 'start conmand' '
+    conmand_start
+'
+
+# Wait for the daemon to write to the logfile and add an index entry.
+#
+test_expect_success 'check index entry appended' '
+    conmand_wait grep "Console \[test1\] log opened" "${LOG}" &&
+    conmand_wait test "$(wc -c <"${LOG}.idx")" -eq 48
+'
+
+# Query the data logged a week ago from the rotated logfile.
+#
+test_expect_success 'check query of rotated logfile' '
+    "${CONMAN}" -d "127.0.0.1:${CONMAND_PORT}" \
+            -T "@$((NOW - 8 * 86400)),@$((NOW - 6 * 86400))" test1 >week.out &&
+    grep "week-old data" week.out &&
+    ! grep "day-old data" week.out &&
+    ! grep "hour-old data" week.out
+'
+
+# Query the data logged an hour ago, which lies between two index entries.
+#
+test_expect_success 'check query of bounded range' '
+    "${CONMAN}" -d "127.0.0.1:${CONMAND_PORT}" -T "-2h,-30m" test1 >hour.out &&
+    grep "hour-old data" hour.out &&
+    ! grep "week-old data" hour.out &&
+    ! grep "day-old data" hour.out &&
+    ! grep "log opened" hour.out
+'
+
+# Query the data logged up to 2 hours ago across both logfiles.
+#
+test_expect_success 'check query with open start' '
+    "${CONMAN}" -d "127.0.0.1:${CONMAND_PORT}" -T ",-2h" test1 >old.out &&
+    grep "week-old data" old.out &&
+    grep "day-old data" old.out &&
+    ! grep "hour-old data" old.out &&
+    ! grep "log opened" old.out
+'
+
+# Query the data logged in the last half hour by the daemon.
+#
+test_expect_success 'check query with open end' '
+    "${CONMAN}" -d "127.0.0.1:${CONMAND_PORT}" -T "-30m" test1 >new.out &&
+    grep "Console \[test1\] log opened" new.out &&
+    ! grep "week-old data" new.out &&
+    ! grep "day-old data" new.out &&
+    ! grep "hour-old data" new.out
+'
+
+# Query a range before any data was logged.
+#
+test_expect_success 'check query of empty range' '
+    "${CONMAN}" -d "127.0.0.1:${CONMAND_PORT}" \
+            -T "@$((NOW - 30 * 86400)),@$((NOW - 20 * 86400))" test1 \
+            >empty.out &&
+    ! grep "data" empty.out
+'
+
+# Stop the daemon.
+#
+test_expect_success 'stop conmand' '
+    conmand_stop
+'
+
+# Check the logfile for errors.
+#
+test_expect_success 'check logfile for errors' '
+    ! grep -E -i "(EMERGENCY|ALERT|CRITICAL|ERROR):" "${CONMAND_LOGFILE}"
+'
+
+# Perform housekeeping to clean up afterwards.
+#
+test_expect_success 'cleanup' '
+    conmand_cleanup
+'
+
+test_done
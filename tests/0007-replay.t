@@ -0,0 +1,98 @@
+#!/bin/sh
+
+test_description="Check deep log replay"
+
+: "${SHARNESS_TEST_SRCDIR:=$(cd "$(dirname "$0")" && pwd)}"
+. "${SHARNESS_TEST_SRCDIR}/sharness.sh"
+
+# The client requires a terminal, which is provided by script(1) from
+#   util-linux.
+#
+if script -qfec true /dev/null >/dev/null 2>&1; then
+    test_set_prereq SCRIPT
+fi
+
+# Monitor console [name] with the client options [opts] until the escape
+#   sequence to close the connection is sent after ~2secs.
+#
+conman_monitor()
+{
+    local opts="$1" name="$2"
+    { sleep 2; printf "&."; } | script -qfec \
+            "\"${CONMAN}\" -d 127.0.0.1:${CONMAND_PORT} -m ${opts} ${name}" \
+            /dev/null
+}
+
+# Set up the environment with test consoles that produce no output.
+# Provide [LOG] for the logfile of console test1.
+#
+test_expect_success 'setup' '
+    conmand_setup "global testopts=\"p:0\"" &&
+    LOG=$(conmand_console_log test1) &&
+    test "x${LOG}" != x
+'
+
+# Create a rotated logfile and a current logfile of 10000 lines each, far
+#   more than is retained in the console's replay buffer.
+#
+test_expect_success 'create logfiles' '
+    seq -f "line %g" 1 10000 | sed -e "s/\$/\r/" >"${LOG}.1" &&
+    seq -f "line %g" 10001 20000 | sed -e "s/\$/\r/" >"${LOG}" &&
+    test "$(wc -l <"${LOG}")" -eq 10000
+'
+
+# Start the daemon.
+#
+test_expect_success 'start conmand' '
+    conmand_start &&
+    conmand_wait grep "Console \[test1\] log opened" "${LOG}"
+'
+
+# Replay the last 15000 lines spanning both logfiles: 14998 lines from the
+#   logfiles followed by the blank line and message written by the daemon
+#   when it opened the logfile.
+#
+test_expect_success SCRIPT 'check replay of lines' '
+    conman_monitor "-R 15000" test1 >lines.out &&
+    test "$(grep -c "^line " lines.out)" -eq 14998 &&
+    test "$(grep "^line " lines.out | head -n 1)" = "line 5003$(printf "\r")" &&
+    test "$(grep "^line " lines.out | tail -n 1)" = "line 20000$(printf "\r")" &&
+    grep "Console \[test1\] log opened" lines.out
+'
+
+# Replay more lines than have been logged.
+#
+test_expect_success SCRIPT 'check replay of entire log' '
+    conman_monitor "-R 100000" test1 >all.out &&
+    test "$(grep -c "^line " all.out)" -eq 20000 &&
+    test "$(grep "^line " all.out | head -n 1)" = "line 1$(printf "\r")"
+'
+
+# Replay the data logged within the last 10 minutes, which only includes
+#   that written by the daemon since the logfiles created above have no index.
+#
+test_expect_success SCRIPT 'check replay of time range' '
+    conman_monitor "-R 10m" test1 >time.out &&
+    grep "Console \[test1\] log opened" time.out &&
+    ! grep "^line " time.out
+'
+
+# Stop the daemon.
+#
+test_expect_success 'stop conmand' '
+    conmand_stop
+'
+
+# Check the logfile for errors.
+#
+test_expect_success 'check logfile for errors' '
+    ! grep -E -i "(EMERGENCY|ALERT|CRITICAL|ERROR):" "${CONMAND_LOGFILE}"
+'
+
+# Perform housekeeping to clean up afterwards.
+#
+test_expect_success 'cleanup' '
+    conmand_cleanup
+'
+
+test_done
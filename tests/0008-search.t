@@ -0,0 +1,154 @@
+#!/bin/sh
+
+test_description="Check server-side search of console logs"
+
+: "${SHARNESS_TEST_SRCDIR:=$(cd "$(dirname "$0")" && pwd)}"
+. "${SHARNESS_TEST_SRCDIR}/sharness.sh"
+
+if date -d @0 >/dev/null 2>&1; then
+    test_set_prereq GNUDATE
+fi
+
+# Output the 8-byte little-endian encoding of the integer [n].
+#
+le64()
+{
+    local n="$1" i
+    for i in 1 2 3 4 5 6 7 8; do
+        printf "\\$(printf "%o" $((n & 255)))"
+        n=$((n >> 8))
+    done
+}
+
+# Output an index entry for data logged at time [t] at logfile offset [off].
+#
+index_entry()
+{
+    le64 "$1" && le64 "$2"
+}
+
+# Search the consoles via the client with the arguments given.
+#
+conman_search()
+{
+    "${CONMAN}" -d "127.0.0.1:${CONMAND_PORT}" "$@"
+}
+
+# Set up the environment with test consoles that produce no output.
+# Provide [LOG1] and [LOG2] for the logfiles of consoles test1 and test2,
+#   and [NOW].
+#
+test_expect_success 'setup' '
+    conmand_setup "global testopts=\"p:0\"" &&
+    LOG1=$(conmand_console_log test1) &&
+    LOG2=$(conmand_console_log test2) &&
+    test "x${LOG1}" != x &&
+    test "x${LOG2}" != x &&
+    NOW=$(date +%s) &&
+    test "x${NOW}" != x
+'
+
+# Create a rotated logfile logged a week ago for test1, and current logfiles
+#   logged an hour ago for test1 and test2, each with its index.
+#
+test_expect_success 'create logfiles with indexes' '
+    printf "fault: old failure\r\n" >"${LOG1}.1" &&
+    index_entry $((NOW - 7 * 86400)) 0 >"${LOG1}.1.idx" &&
+    printf "alpha\r\nfault: disk failure\r\nx.y literal\r\nxzy\r\n" \
+            >"${LOG1}" &&
+    index_entry $((NOW - 3600)) 0 >"${LOG1}.idx" &&
+    printf "fault: fan failure\r\nFAULT: caps\r\n" >"${LOG2}" &&
+    index_entry $((NOW - 3600)) 0 >"${LOG2}.idx"
+'
+
+# Start the daemon.
+#
+test_expect_success 'start conmand' '
+    conmand_start &&
+    conmand_wait grep "Console \[test1\] log opened" "${LOG1}" &&
+    conmand_wait grep "Console \[test2\] log opened" "${LOG2}"
+'
+
+# Search all consoles (including the rotated logfile) with a regex.
+#
+test_expect_success 'check regex search of all consoles' '
+    conman_search -s "fault: [a-z]+" >all.out &&
+    cat all.out &&
+    test "$(wc -l <all.out)" -eq 3 &&
+    grep "^\[test1\] .* fault: old failure$" all.out &&
+    grep "^\[test1\] .* fault: disk failure$" all.out &&
+    grep "^\[test2\] .* fault: fan failure$" all.out
+'
+
+# Verify each match is timestamped with the time of its index entry.
+#
+test_expect_success GNUDATE 'check timestamps of matches' '
+    grep "^\[test1\] $(date -d @$((NOW - 7 * 86400)) "+%Y-%m-%d %H:%M:%S") fault: old failure$" all.out &&
+    grep "^\[test2\] $(date -d @$((NOW - 3600)) "+%Y-%m-%d %H:%M:%S") fault: fan failure$" all.out
+'
+
+# Search a single console.
+#
+test_expect_success 'check search of selected console' '
+    conman_search -s "fault" test2 >test2.out &&
+    cat test2.out &&
+    test "$(wc -l <test2.out)" -eq 1 &&
+    grep "^\[test2\] .* fault: fan failure$" test2.out
+'
+
+# Verify a literal search does not treat its text as a regex.
+#
+test_expect_success 'check literal search' '
+    conman_search -S "x.y" >literal.out &&
+    conman_search -s "x.y" >regex.out &&
+    test "$(wc -l <literal.out)" -eq 1 &&
+    grep "x\.y literal$" literal.out &&
+    test "$(wc -l <regex.out)" -eq 2 &&
+    grep "xzy$" regex.out
+'
+
+# Search the data logged up to a day ago, which is only in the rotated
+#   logfile.
+#
+test_expect_success 'check search with time range' '
+    conman_search -s "fault" -T ",-1d" >old.out &&
+    cat old.out &&
+    test "$(wc -l <old.out)" -eq 1 &&
+    grep "^\[test1\] .* fault: old failure$" old.out
+'
+
+# Search the data logged in the last half hour by the daemon.
+#
+test_expect_success 'check search of recent data' '
+    conman_search -S "log opened" -T "-30m" >new.out &&
+    cat new.out &&
+    test "$(wc -l <new.out)" -eq 2 &&
+    ! grep "fault" new.out
+'
+
+# Verify a search without matches outputs nothing.
+#
+test_expect_success 'check search without matches' '
+    conman_search -S "no such text" >none.out &&
+    test ! -s none.out
+'
+
+# Stop the daemon.
+#
+test_expect_success 'stop conmand' '
+    conmand_stop
+'
+
+# Check the logfile for errors.
+#
+test_expect_success 'check logfile for errors' '
+    ! grep -E -i "(EMERGENCY|ALERT|CRITICAL|ERROR):" "${CONMAND_LOGFILE}"
+'
+
+# Perform housekeeping to clean up afterwards.
+#
+test_expect_success 'cleanup' '
+    conmand_cleanup
+'
+
+test_done
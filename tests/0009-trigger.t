@@ -0,0 +1,91 @@
+#!/bin/sh
+
+test_description="Check console output triggers"
+
+: "${SHARNESS_TEST_SRCDIR:=$(cd "$(dirname "$0")" && pwd)}"
+. "${SHARNESS_TEST_SRCDIR}/sharness.sh"
+
+# Set up the environment with triggers on the output of the test consoles,
+#   which repeatedly cycle through the printable ASCII characters one byte
+#   per read, so each pattern is split across many reads.
+# Provide [LOG1] and [LOG2] for the logfiles of consoles test1 and test2.
+#
+test_expect_success 'setup' '
+    conmand_setup \
+            "trigger pattern=\"0123456789\" exec=\"touch '"'"'$(pwd)/exec.%N'"'"'\"" \
+            "trigger pattern=\"ABCDEFGHIJ\" console=\"test1\" action=\"notify\"" \
+            "trigger pattern=\"pqrstuvwxyz\" console=\"test[0-9]\"" \
+            "trigger pattern=\"zyx\"" &&
+    LOG1=$(conmand_console_log test1) &&
+    LOG2=$(conmand_console_log test2) &&
+    test "x${LOG1}" != x &&
+    test "x${LOG2}" != x
+'
+
+# Start the daemon.
+#
+test_expect_success 'start conmand' '
+    conmand_start
+'
+
+# Verify the exec trigger runs its command for each console.
+#
+test_expect_success 'check exec trigger' '
+    conmand_wait test -f exec.test1 &&
+    conmand_wait test -f exec.test2 &&
+    grep "Console \[test1\] trigger \"0123456789\" invoked \"touch .*/exec.test1.\"" \
+            "${CONMAND_LOGFILE}"
+'
+
+# Verify the syslog trigger (the default action) is logged for each console
+#   matching its glob.
+#
+test_expect_success 'check syslog trigger' '
+    conmand_wait grep "Console \[test1\] matched trigger \"pqrstuvwxyz\"" \
+            "${CONMAND_LOGFILE}" &&
+    conmand_wait grep "Console \[test2\] matched trigger \"pqrstuvwxyz\"" \
+            "${CONMAND_LOGFILE}"
+'
+
+# Verify the notify trigger is written to the console logfile, and only for
+#   the console matching its glob.
+#
+test_expect_success 'check notify trigger' '
+    conmand_wait grep "Console \[test1\] matched trigger \"ABCDEFGHIJ\"" \
+            "${LOG1}" &&
+    grep "Console \[test1\] matched trigger \"ABCDEFGHIJ\"" \
+            "${CONMAND_LOGFILE}" &&
+    ! grep "matched trigger \"ABCDEFGHIJ\"" "${LOG2}" &&
+    ! grep "Console \[test2\] matched trigger \"ABCDEFGHIJ\"" \
+            "${CONMAND_LOGFILE}"
+'
+
+# Stop the daemon.
+#
+test_expect_success 'stop conmand' '
+    conmand_stop
+'
+
+# Verify the trigger on text that never appears has not fired, and that the
+#   holdoff has kept each trigger from firing on every (~1sec) cycle of the
+#   output even though other triggers fire for the console in between.
+#
+test_expect_success 'check unmatched trigger and holdoff' '
+    ! grep "matched trigger \"zyx\"" "${CONMAND_LOGFILE}" &&
+    test "$(grep -c "Console \[test1\] matched trigger \"pqrstuvwxyz\"" \
+            "${CONMAND_LOGFILE}")" -le 2
+'
+
+# Check the logfile for errors.
+#
+test_expect_success 'check logfile for errors' '
+    ! grep -E -i "(EMERGENCY|ALERT|CRITICAL|ERROR):" "${CONMAND_LOGFILE}"
+'
+
+# Perform housekeeping to clean up afterwards.
+#
+test_expect_success 'cleanup' '
+    conmand_cleanup
+'
+
+test_done
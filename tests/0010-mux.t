@@ -0,0 +1,76 @@
+#!/bin/sh
+
+test_description="Check channels of the multiplexed protocol"
+
+: "${SHARNESS_TEST_SRCDIR:=$(cd "$(dirname "$0")" && pwd)}"
+. "${SHARNESS_TEST_SRCDIR}/sharness.sh"
+
+MUX_TEST="${CONMAN_BUILD_DIR}/tests/mux-test"
+
+# Require the test utility to be built (via "make check").
+#
+if test ! -x "${MUX_TEST}"; then
+    skip_all="skipping mux tests; ${MUX_TEST} not built"
+    test_done
+fi
+
+# Set up the environment with test consoles chatty enough to exhaust a
+#   channel's window within a fraction of a second, and a "quiet" console
+#   that produces no output at all.
+#
+test_expect_success 'setup' '
+    conmand_setup \
+            "global testopts=\"b:512,m:1,n:1,p:100\"" \
+            "console name=\"quiet\" dev=\"test:\" testopts=\"p:0\""
+'
+
+# Start the daemon.
+#
+test_expect_success 'start conmand' '
+    conmand_start
+'
+
+# Verify OPEN frames open a channel for each console matched by the request,
+#   and an ERROR response is returned when none match.
+#
+test_expect_success 'check OPEN' '
+    "${MUX_TEST}" "127.0.0.1:${CONMAND_PORT}" open
+'
+
+# Verify console output is limited to the credit granted via WINDOW frames.
+#
+test_expect_success 'check WINDOW' '
+    "${MUX_TEST}" "127.0.0.1:${CONMAND_PORT}" window
+'
+
+# Verify DATA frames are processed as client input, including escapes.
+#
+test_expect_success 'check DATA' '
+    "${MUX_TEST}" "127.0.0.1:${CONMAND_PORT}" data
+'
+
+# Verify CLOSE frames are acknowledged and the console can be reconnected.
+#
+test_expect_success 'check CLOSE' '
+    "${MUX_TEST}" "127.0.0.1:${CONMAND_PORT}" close
+'
+
+# Stop the daemon.
+#
+test_expect_success 'stop conmand' '
+    conmand_stop
+'
+
+# Check the logfile for errors.
+#
+test_expect_success 'check logfile for errors' '
+    ! grep -E -i "(EMERGENCY|ALERT|CRITICAL|ERROR):" "${CONMAND_LOGFILE}"
+'
+
+# Perform housekeeping to clean up afterwards.
+#
+test_expect_success 'cleanup' '
+    conmand_cleanup
+'
+
+test_done
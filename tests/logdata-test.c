@@ -0,0 +1,571 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The logdata-test utility is a differential test of write_log_data().
+ *  Each input (a corpus file named on the command-line, or a pseudo-random
+ *    buffer) is written into a logfile obj by write_log_data() and also
+ *    processed by a reference copy of the original per-byte newline state
+ *    machine; the outputs and the resulting newline states must match.
+ *  Every input is run with each combination of the sanitize & timestamp
+ *    logopts, each timestamp format, each initial newline state, and several
+ *    ways of splitting the input into chunks (as it would be read from the
+ *    console).
+ *  Since timestamps differ from one call to the next, digits are masked
+ *    before comparing output with timestamps enabled; digits within the data
+ *    are still compared exactly when timestamps are disabled.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "common.h"
+#include "log.h"
+#include "server.h"
+#include "tpoll.h"
+#include "util-str.h"
+#include "util.h"
+#include "wrapper.h"
+
+
+/*  Required by the server objs for setting timers.
+ */
+tpoll_t tp_global = NULL;
+
+
+#define TEST_MAX_CHUNK          65536
+#define TEST_RANDOM_MAX_LEN     20000
+
+
+typedef struct test_buf {
+    unsigned char   *data;
+    int              len;
+    int              size;
+} test_buf_t;
+
+typedef struct test_case {
+    const char      *name;              /*  name of input                    */
+    int              enableSanitize;
+    int              enableTimestamp;
+    timestamp_fmt_t  tsFormat;
+    int              lineState;         /*  initial newline state            */
+    int              chunking;          /*  index into chunkings[]           */
+} test_case_t;
+
+
+static void display_help(const char *prog);
+static int test_input(obj_t *log, const char *name,
+    const unsigned char *src, int len);
+static int test_case(obj_t *log, test_case_t *tc, test_buf_t *out,
+    test_buf_t *ref, const unsigned char *src, int len);
+static int get_chunk_len(int chunking, int offset, int remaining);
+static void drain_log(obj_t *log, test_buf_t *out);
+static void write_ref_data(test_case_t *tc, int *lineState, test_buf_t *ref,
+    const unsigned char *src, int len);
+static void append_buf(test_buf_t *b, const void *src, int len);
+static void mask_digits(test_buf_t *b);
+static int compare_bufs(test_case_t *tc, test_buf_t *out, test_buf_t *ref,
+    int outState, int refState);
+static unsigned char * read_file(const char *path, int *lenp);
+static void fill_random(unsigned char *buf, int len);
+
+
+static const char *chunkings[] = {
+    "whole", "bytes", "primes", "random"
+};
+
+static const char *states[] = {
+    "init", "data", "cr", "lf"
+};
+
+
+int main(int argc, char *argv[])
+{
+    int c;
+    int numRandom = 0;
+    unsigned int seed = 1;
+    server_conf_t *conf;
+    obj_t *console;
+    obj_t *log;
+    char errbuf[MAX_LINE];
+    char name[MAX_LINE];
+    unsigned char *buf;
+    int len;
+    int numFailed = 0;
+    int i;
+
+    log_set_file(stderr, LOG_WARNING, 0);
+
+    opterr = 0;
+    while ((c = getopt(argc, argv, "hn:s:")) != -1) {
+        switch(c) {
+        case 'h':
+            display_help(argv[0]);
+            exit(0);
+        case 'n':
+            if ((numRandom = atoi(optarg)) < 0) {
+                log_err(0, "CMDLINE: invalid count \"%s\"", optarg);
+            }
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+        case '?':                       /* invalid option */
+            log_err(0, "CMDLINE: invalid option \"%c\"", optopt);
+            exit(1);
+        default:
+            log_err(0, "CMDLINE: option \"%c\" not implemented", c);
+            exit(1);
+        }
+    }
+    if ((optind == argc) && (numRandom == 0)) {
+        display_help(argv[0]);
+        exit(1);
+    }
+    srandom(seed);
+
+    conf = create_server_conf();
+    tp_global = conf->tp;
+
+    if (!(console = create_test_obj(conf, "logdata", &conf->globalTestOpts,
+            errbuf, sizeof(errbuf)))) {
+        log_err(0, "Unable to create console: %s", errbuf);
+    }
+    /*  The logfile is never opened; its buffer is drained by the test.
+     *  Its buffer limit is raised so a single chunk's output (which can be
+     *    many times the length of the chunk when timestamping blank lines)
+     *    is never overwritten.
+     */
+    if (!(log = create_logfile_obj(conf, "/dev/null",
+            console, &conf->globalLogOpts, errbuf, sizeof(errbuf)))) {
+        log_err(0, "Unable to create logfile: %s", errbuf);
+    }
+    log->bufMaxSize = OBJ_BUF_MAX_SIZE;
+
+    for (i = optind; i < argc; i++) {
+        buf = read_file(argv[i], &len);
+        if (test_input(log, argv[i], buf, len) < 0) {
+            numFailed++;
+        }
+        free(buf);
+    }
+    if (!(buf = malloc(TEST_RANDOM_MAX_LEN))) {
+        out_of_memory();
+    }
+    for (i = 0; i < numRandom; i++) {
+        len = random() % TEST_RANDOM_MAX_LEN + 1;
+        fill_random(buf, len);
+        snprintf(name, sizeof(name), "random#%d (seed=%u, len=%d)",
+            i, seed, len);
+        if (test_input(log, name, buf, len) < 0) {
+            numFailed++;
+        }
+    }
+    free(buf);
+
+    destroy_server_conf(conf);
+    tp_global = NULL;
+
+    printf("%d of %d input%s failed\n", numFailed, argc - optind + numRandom,
+        ((argc - optind + numRandom) == 1 ? "" : "s"));
+    return(numFailed ? 1 : 0);
+}
+
+
+static void display_help(const char *prog)
+{
+    printf("Usage: %s [OPTIONS] [FILE...]\n", prog);
+    printf("\n");
+    printf("  -h        Display this help message.\n");
+    printf("  -n N      Specify number of random inputs (default: 0).\n");
+    printf("  -s N      Specify seed for random inputs (default: 1).\n");
+    printf("\n");
+    return;
+}
+
+
+static int test_input(obj_t *log, const char *name,
+    const unsigned char *src, int len)
+{
+/*  Runs every test case for the input (src) of length (len).
+ *  Returns 0 if all cases pass; o/w, returns -1 after the first failure.
+ */
+    test_case_t tc;
+    test_buf_t out = { NULL, 0, 0 };
+    test_buf_t ref = { NULL, 0, 0 };
+    int lastFormat;
+    int rc = -1;
+
+    tc.name = name;
+
+    for (tc.enableSanitize = 0; tc.enableSanitize <= 1;
+            tc.enableSanitize++) {
+        for (tc.enableTimestamp = 0; tc.enableTimestamp <= 1;
+                tc.enableTimestamp++) {
+            /*
+             *  The timestamp format only matters with timestamps enabled.
+             */
+            lastFormat = tc.enableTimestamp
+                ? CONMAN_TS_MONOTONIC : CONMAN_TS_SEC;
+            for (tc.tsFormat = CONMAN_TS_SEC;
+                    (int) tc.tsFormat <= lastFormat; tc.tsFormat++) {
+                for (tc.lineState = CONMAN_LOG_LINE_INIT;
+                        tc.lineState <= CONMAN_LOG_LINE_LF;
+                        tc.lineState++) {
+                    for (tc.chunking = 0; (size_t) tc.chunking
+                            < sizeof(chunkings) / sizeof(chunkings[0]);
+                            tc.chunking++) {
+                        if (test_case(log, &tc, &out, &ref, src, len) < 0) {
+                            goto end;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    rc = 0;
+
+end:
+    free(out.data);
+    free(ref.data);
+    return(rc);
+}
+
+
+static int test_case(obj_t *log, test_case_t *tc, test_buf_t *out,
+    test_buf_t *ref, const unsigned char *src, int len)
+{
+/*  Writes (src) of length (len) into the logfile obj (log) via
+ *    write_log_data() and into the reference buffer (ref) via
+ *    write_ref_data(), using the settings in the test case (tc).
+ *  Returns 0 if the output & newline states match; o/w, returns -1.
+ */
+    int refState = tc->lineState;
+    int i, m, n;
+    int outLen;
+
+    drain_log(log, NULL);
+    out->len = 0;
+    ref->len = 0;
+
+    log->aux.logfile.opts.enableSanitize = tc->enableSanitize;
+    log->aux.logfile.opts.enableTimestamp = tc->enableTimestamp;
+    log->aux.logfile.opts.tsFormat = tc->tsFormat;
+    log->aux.logfile.gotProcessing =
+        (tc->enableSanitize || tc->enableTimestamp);
+    log->aux.logfile.lineState = tc->lineState;
+
+    for (i = 0; i < len; i += m) {
+        m = get_chunk_len(tc->chunking, i, len - i);
+        outLen = out->len;
+        n = write_log_data(log, src + i, m);
+        drain_log(log, out);
+        if (n != out->len - outLen) {
+            log_msg(LOG_ERR, "%s: wrote %d bytes but returned %d",
+                tc->name, out->len - outLen, n);
+            return(-1);
+        }
+        write_ref_data(tc, &refState, ref, src + i, m);
+    }
+    return(compare_bufs(tc, out, ref, log->aux.logfile.lineState, refState));
+}
+
+
+static int get_chunk_len(int chunking, int offset, int remaining)
+{
+/*  Returns the length of the chunk at (offset) for the given (chunking),
+ *    with (remaining) bytes left in the input.
+ */
+    static const int primes[] = { 1, 2, 3, 5, 7, 11, 13, 4093, 4099, 16381 };
+    static int k = 0;
+    int n;
+
+    if (chunkings[chunking][0] == 'w') {        /* whole */
+        n = TEST_MAX_CHUNK;
+    }
+    else if (chunkings[chunking][0] == 'b') {   /* bytes */
+        n = 1;
+    }
+    else if (chunkings[chunking][0] == 'p') {   /* primes */
+        if (offset == 0) {
+            k = 0;
+        }
+        n = primes[k++ % (sizeof(primes) / sizeof(primes[0]))];
+    }
+    else {                                      /* random */
+        n = random() % 512 + 1;
+    }
+    return(MIN(n, remaining));
+}
+
+
+static void drain_log(obj_t *log, test_buf_t *out)
+{
+/*  Removes all data from the logfile obj's (log) circular-buffer,
+ *    appending it to (out) if non-NULL.
+ */
+    unsigned char *end;
+
+    x_pthread_mutex_lock(&log->bufLock);
+    if (log->bufOutPtr != log->bufInPtr) {
+        if (log->bufOutPtr > log->bufInPtr) {
+            end = &log->buf[log->bufSize];
+            if (out) {
+                append_buf(out, log->bufOutPtr, end - log->bufOutPtr);
+            }
+            log->bufOutPtr = log->buf;
+        }
+        if (out) {
+            append_buf(out, log->bufOutPtr, log->bufInPtr - log->bufOutPtr);
+        }
+        log->bufOutPtr = log->bufInPtr;
+    }
+    x_pthread_mutex_unlock(&log->bufLock);
+    return;
+}
+
+
+static void write_ref_data(test_case_t *tc, int *lineState, test_buf_t *ref,
+    const unsigned char *src, int len)
+{
+/*  Reference implementation of write_log_data() from before it copied runs
+ *    of data: every byte goes through the newline state machine.
+ *  The processed data is appended to (ref); (lineState) holds the newline
+ *    state across calls.
+ */
+    unsigned char buf[TIMESTAMP_MAX_LEN + 1];
+    unsigned char *q;
+    const unsigned char *p;
+
+    if (!tc->enableSanitize && !tc->enableTimestamp) {
+        append_buf(ref, src, len);
+        return;
+    }
+    for (p=src; len>0; p++, len--) {
+        q = buf;
+        if (*p == '\r') {
+            if (*lineState == CONMAN_LOG_LINE_DATA) {
+                *lineState = CONMAN_LOG_LINE_CR;
+            }
+            else if (*lineState == CONMAN_LOG_LINE_INIT) {
+                if (tc->enableTimestamp)
+                    q += write_timestamp_string(tc->tsFormat,
+                        (char *) q, sizeof(buf));
+                *lineState = CONMAN_LOG_LINE_CR;
+            }
+            else {
+                ; /* ignore */
+            }
+            append_buf(ref, buf, q - buf);
+        }
+        else if (*p == '\n') {
+            if (  (*lineState == CONMAN_LOG_LINE_INIT)
+               || (*lineState == CONMAN_LOG_LINE_LF) ) {
+                if (tc->enableTimestamp)
+                    q += write_timestamp_string(tc->tsFormat,
+                        (char *) q, sizeof(buf));
+            }
+            append_buf(ref, buf, q - buf);
+            append_buf(ref, "\r\n", 2);
+            *lineState = CONMAN_LOG_LINE_LF;
+        }
+        else if (  (*p == '\0')
+                && (  (*lineState == CONMAN_LOG_LINE_CR)
+                   || (*lineState == CONMAN_LOG_LINE_LF) ) ) {
+            ; /* ignore */
+        }
+        else {
+            if (*lineState == CONMAN_LOG_LINE_CR) {
+                append_buf(ref, "\r\n", 2);
+            }
+            if (*lineState != CONMAN_LOG_LINE_DATA) {
+                if (tc->enableTimestamp)
+                    q += write_timestamp_string(tc->tsFormat,
+                        (char *) q, sizeof(buf));
+            }
+            *lineState = CONMAN_LOG_LINE_DATA;
+
+            if (tc->enableSanitize) {
+
+                int c = *p & 0x7F;      /* strip data to 7-bit ASCII */
+
+                if (c < 0x20) {         /* ASCII ctrl-chars */
+                    *q++ = (*p & 0x80) ? '~' : '^';
+                    *q++ = c + '@';
+                }
+                else if (c == 0x7F) {   /* ASCII DEL char */
+                    *q++ = (*p & 0x80) ? '~' : '^';
+                    *q++ = '?';
+                }
+                else {
+                    if (*p & 0x80)
+                        *q++ = '`';
+                    *q++ = c;
+                }
+            }
+            else {
+                *q++ = *p;
+            }
+            append_buf(ref, buf, q - buf);
+        }
+    }
+    return;
+}
+
+
+static void append_buf(test_buf_t *b, const void *src, int len)
+{
+    if (len <= 0) {
+        return;
+    }
+    if (b->len + len > b->size) {
+        b->size = MAX(b->size * 2, b->len + len);
+        if (!(b->data = realloc(b->data, b->size))) {
+            out_of_memory();
+        }
+    }
+    memcpy(b->data + b->len, src, len);
+    b->len += len;
+    return;
+}
+
+
+static void mask_digits(test_buf_t *b)
+{
+    int i;
+
+    for (i = 0; i < b->len; i++) {
+        if ((b->data[i] >= '0') && (b->data[i] <= '9')) {
+            b->data[i] = '0';
+        }
+    }
+    return;
+}
+
+
+static int compare_bufs(test_case_t *tc, test_buf_t *out, test_buf_t *ref,
+    int outState, int refState)
+{
+/*  Compares the write_log_data() output (out) & newline state (outState)
+ *    against the reference output (ref) & newline state (refState).
+ *  Returns 0 if they match; o/w, logs the first difference and returns -1.
+ */
+    int i;
+
+    if (tc->enableTimestamp) {
+        mask_digits(out);
+        mask_digits(ref);
+    }
+    for (i = 0; (i < out->len) && (i < ref->len); i++) {
+        if (out->data[i] != ref->data[i]) {
+            break;
+        }
+    }
+    if ((i == out->len) && (i == ref->len) && (outState == refState)) {
+        return(0);
+    }
+    log_msg(LOG_ERR, "%s: sanitize=%d timestamp=%d format=%d state=%s "
+        "chunks=%s", tc->name, tc->enableSanitize, tc->enableTimestamp,
+        tc->tsFormat, states[tc->lineState], chunkings[tc->chunking]);
+    if ((i < out->len) || (i < ref->len)) {
+        log_msg(LOG_ERR, "Output differs at byte %d of %d (expected %d):"
+            " 0x%02x vs 0x%02x", i, out->len, ref->len,
+            (i < out->len ? out->data[i] : 0),
+            (i < ref->len ? ref->data[i] : 0));
+    }
+    else {
+        log_msg(LOG_ERR, "Newline state is %s (expected %s)",
+            states[outState], states[refState]);
+    }
+    return(-1);
+}
+
+
+static unsigned char * read_file(const char *path, int *lenp)
+{
+/*  Reads the file at (path) into a newly-allocated buffer, setting (lenp)
+ *    to its length.
+ */
+    FILE *fp;
+    unsigned char *buf = NULL;
+    int size = 0;
+    int len = 0;
+    size_t n;
+
+    if (!(fp = fopen(path, "r"))) {
+        log_err(errno, "Unable to open \"%s\"", path);
+    }
+    do {
+        if (len == size) {
+            size = MAX(size * 2, 4096);
+            if (!(buf = realloc(buf, size))) {
+                out_of_memory();
+            }
+        }
+        n = fread(buf + len, 1, size - len, fp);
+        len += n;
+    } while (n > 0);
+
+    if (ferror(fp)) {
+        log_err(errno, "Unable to read \"%s\"", path);
+    }
+    (void) fclose(fp);
+    *lenp = len;
+    return(buf);
+}
+
+
+static void fill_random(unsigned char *buf, int len)
+{
+/*  Fills (buf) with (len) pseudo-random bytes weighted towards the bytes
+ *    handled by the newline state machine, and with runs of printable text
+ *    of various lengths in between.
+ */
+    static const unsigned char special[] = { '\r', '\n', '\0' };
+    int i, n;
+
+    for (i = 0; i < len; ) {
+        switch (random() % 4) {
+        case 0:
+            buf[i++] = special[random() % sizeof(special)];
+            break;
+        case 1:
+            buf[i++] = random() % 256;
+            break;
+        default:
+            n = MIN(len - i, random() % 200);
+            while (n-- > 0) {
+                buf[i++] = ' ' + random() % 95;
+            }
+            break;
+        }
+    }
+    return;
+}
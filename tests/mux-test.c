@@ -0,0 +1,533 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The mux-test utility checks a running daemon's handling of the
+ *    multiplexed (v2) protocol.  Each test named on the command-line is run
+ *    in turn over a connection of its own; the exit status is non-zero if
+ *    any of them fail.  The daemon is expected to have the consoles "test1"
+ *    and "test2" producing output continuously, and the console "quiet"
+ *    producing none.
+ *
+ *  open:     A MONITOR of "test*" must open a R/O channel for each console
+ *              via OPEN frames followed by an OK RSP frame, and a MONITOR of
+ *              a nonexistent console must be answered by an ERROR RSP frame.
+ *  window:   A CONNECT of "test1" must open a R/W channel which then receives
+ *              exactly MUX_WINDOW_SIZE bytes of DATA until granted more
+ *              credit via a WINDOW frame, and exactly that credit thereafter.
+ *  data:     DATA sent on a channel to "quiet" must be processed as client
+ *              input: the escape toggling quiet-mode must be answered by
+ *              its informational message.
+ *  close:    A CLOSE sent on a channel to "quiet" must be acknowledged by a
+ *              CLOSE frame, after which the console can be connected again.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <sys/types.h>                  /* include before in.h for bsd */
+#include <netinet/in.h>                 /* include before inet.h for bsd */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "common.h"
+#include "lex.h"
+#include "log.h"
+#include "util-file.h"
+#include "util-net.h"
+#include "util.h"
+
+
+#define TEST_TIMEOUT_MSECS      5000
+#define TEST_SILENCE_MSECS      1000
+#define TEST_WINDOW_CREDIT      1000
+
+
+typedef struct frame {
+    int              type;              /* frame type (CONMAN_FRAME_*)       */
+    int              flags;             /* flags (CONMAN_FRAME_FLAG_*)       */
+    int              id;                /* channel id                        */
+    int              len;               /* payload length                    */
+    char             data[MUX_FRAME_MAX_LEN + 1];   /* payload (NUL-term'd)  */
+} frame_t;
+
+
+static int test_open(struct sockaddr_in *addr);
+static int test_window(struct sockaddr_in *addr);
+static int test_data(struct sockaddr_in *addr);
+static int test_close(struct sockaddr_in *addr);
+static int connect_mux(struct sockaddr_in *addr);
+static int open_channels(int sd, const char *req, int *idp, long *numData);
+static int read_data(int sd, int id, long numBytes);
+static int find_data(int sd, int id, const char *msg);
+static int check_silence(int sd, int id);
+static int read_frame(int sd, frame_t *f, int msecs);
+static int read_rsp_line(int sd, char *buf, int len);
+static void write_frame(int sd, int type, int id, const void *src, int len);
+static void write_window(int sd, int id, unsigned long credit);
+
+
+int main(int argc, char *argv[])
+{
+    char *host = "127.0.0.1";
+    int port;
+    char *p;
+    struct sockaddr_in addr;
+    int i;
+    int rc = -1;
+    int numFailed = 0;
+
+    log_set_file(stderr, LOG_WARNING, 0);
+
+    if (argc < 3) {
+        printf("Usage: %s [HOST:]PORT TEST...\n", argv[0]);
+        printf("\n");
+        printf("  Tests: open, window, data, close\n");
+        printf("\n");
+        exit(1);
+    }
+    if ((p = strchr(argv[1], ':'))) {
+        *p++ = '\0';
+        host = argv[1];
+    }
+    else {
+        p = argv[1];
+    }
+    if ((port = atoi(p)) <= 0) {
+        log_err(0, "Invalid port \"%s\"", p);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (host_name_to_addr4(host, &addr.sin_addr) < 0) {
+        log_err(0, "Unable to resolve \"%s\"", host);
+    }
+    for (i = 2; i < argc; i++) {
+        if (!strcmp(argv[i], "open")) {
+            rc = test_open(&addr);
+        }
+        else if (!strcmp(argv[i], "window")) {
+            rc = test_window(&addr);
+        }
+        else if (!strcmp(argv[i], "data")) {
+            rc = test_data(&addr);
+        }
+        else if (!strcmp(argv[i], "close")) {
+            rc = test_close(&addr);
+        }
+        else {
+            log_err(0, "Unknown test \"%s\"", argv[i]);
+        }
+        printf("%s: %s\n", argv[i], (rc < 0 ? "FAILED" : "ok"));
+        if (rc < 0) {
+            numFailed++;
+        }
+    }
+    return(numFailed ? 1 : 0);
+}
+
+
+static int test_open(struct sockaddr_in *addr)
+{
+    int sd;
+    int id;
+    int rc = 0;
+
+    sd = connect_mux(addr);
+    if (open_channels(sd, "MONITOR CONSOLE='test*'", &id, NULL) != 2) {
+        rc = -1;
+    }
+    else if (open_channels(sd, "MONITOR CONSOLE='nosuch'", &id, NULL) != -1) {
+        log_msg(LOG_ERR, "Expected ERROR response for nonexistent console");
+        rc = -1;
+    }
+    (void) close(sd);
+    return(rc);
+}
+
+
+static int test_window(struct sockaddr_in *addr)
+{
+    int sd;
+    int id;
+    long n = 0;
+    int rc = -1;
+
+    sd = connect_mux(addr);
+    if (open_channels(sd, "CONNECT CONSOLE='test1'", &id, &n) != 1) {
+        goto end;
+    }
+    /*  The channel starts out with MUX_WINDOW_SIZE bytes of credit.
+     */
+    if (read_data(sd, id, MUX_WINDOW_SIZE - n) < 0) {
+        goto end;
+    }
+    if (check_silence(sd, id) < 0) {
+        goto end;
+    }
+    write_window(sd, id, TEST_WINDOW_CREDIT);
+    if (read_data(sd, id, TEST_WINDOW_CREDIT) < 0) {
+        goto end;
+    }
+    if (check_silence(sd, id) < 0) {
+        goto end;
+    }
+    rc = 0;
+end:
+    (void) close(sd);
+    return(rc);
+}
+
+
+static int test_data(struct sockaddr_in *addr)
+{
+    int sd;
+    int id;
+    unsigned char esc[2] = { ESC_CHAR, ESC_CHAR_QUIET };
+    int rc = -1;
+
+    sd = connect_mux(addr);
+    if (open_channels(sd, "CONNECT CONSOLE='quiet'", &id, NULL) != 1) {
+        goto end;
+    }
+    write_frame(sd, CONMAN_FRAME_DATA, id, esc, sizeof(esc));
+    if (find_data(sd, id, "Quiet-mode enabled") < 0) {
+        goto end;
+    }
+    rc = 0;
+end:
+    (void) close(sd);
+    return(rc);
+}
+
+
+static int test_close(struct sockaddr_in *addr)
+{
+    int sd;
+    int id;
+    int id2;
+    frame_t f;
+    int rc = -1;
+
+    sd = connect_mux(addr);
+    if (open_channels(sd, "CONNECT CONSOLE='quiet'", &id, NULL) != 1) {
+        goto end;
+    }
+    write_frame(sd, CONMAN_FRAME_CLOSE, id, NULL, 0);
+    do {
+        if (read_frame(sd, &f, TEST_TIMEOUT_MSECS) <= 0) {
+            log_msg(LOG_ERR, "Timed-out waiting for CLOSE of id=%d", id);
+            goto end;
+        }
+    } while (f.type == CONMAN_FRAME_DATA);
+
+    if ((f.type != CONMAN_FRAME_CLOSE) || (f.id != id)) {
+        log_msg(LOG_ERR, "Expected CLOSE of id=%d but received type=%d id=%d",
+            id, f.type, f.id);
+        goto end;
+    }
+    if (open_channels(sd, "CONNECT CONSOLE='quiet'", &id2, NULL) != 1) {
+        goto end;
+    }
+    if (id2 != id) {
+        log_msg(LOG_ERR, "Expected id=%d on reopen but received id=%d",
+            id, id2);
+        goto end;
+    }
+    rc = 0;
+end:
+    (void) close(sd);
+    return(rc);
+}
+
+
+static int connect_mux(struct sockaddr_in *addr)
+{
+/*  Connects to the daemon at (addr) and negotiates the multiplexed protocol.
+ *  Returns the (blocking) socket.
+ */
+    int sd;
+    char buf[MAX_SOCK_LINE];
+
+    if ((sd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        log_err(errno, "Unable to create socket");
+    }
+    if (connect(sd, (struct sockaddr *) addr, sizeof(*addr)) < 0) {
+        log_err(errno, "Unable to connect to daemon");
+    }
+    snprintf(buf, sizeof(buf), "%s %s='test' %s=%d\n",
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_HELLO),
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_USER),
+        LEX_TOK2STR(proto_strs, CONMAN_TOK_PROTOCOL), CONMAN_PROTOCOL_MUX);
+    if ((write_n(sd, buf, strlen(buf)) < 0)
+            || (read_rsp_line(sd, buf, sizeof(buf)) < 0)
+            || strncmp(buf, LEX_TOK2STR(proto_strs, CONMAN_TOK_OK), 2)
+            || !strstr(buf, LEX_TOK2STR(proto_strs, CONMAN_TOK_PROTOCOL))) {
+        log_err(0, "Daemon does not support the multiplexed protocol");
+    }
+    return(sd);
+}
+
+
+static int open_channels(int sd, const char *req, int *idp, long *numData)
+{
+/*  Sends an OPEN frame with the request line (req), and reads the OPEN
+ *    frames of the channels opened through the RSP frame answering it.
+ *    The id of the last channel opened is stored in (idp).
+ *  DATA frames received in the meantime are skipped, but their payload
+ *    length is added to (numData) if not NULL.
+ *  Returns the number of channels opened, or -1 on error (including an
+ *    ERROR response).
+ */
+    frame_t f;
+    int isWrite;
+    int n = 0;
+
+    isWrite = !strncmp(req, "CONNECT", 7);
+    write_frame(sd, CONMAN_FRAME_OPEN, 0, req, strlen(req));
+
+    for (;;) {
+        if (read_frame(sd, &f, TEST_TIMEOUT_MSECS) <= 0) {
+            log_msg(LOG_ERR, "Timed-out waiting for response to \"%s\"", req);
+            return(-1);
+        }
+        if (f.type == CONMAN_FRAME_RSP) {
+            break;
+        }
+        if (f.type == CONMAN_FRAME_DATA) {
+            if (numData) {
+                *numData += f.len;
+            }
+            continue;
+        }
+        if (f.type != CONMAN_FRAME_OPEN) {
+            log_msg(LOG_ERR, "Received unexpected frame type=%d", f.type);
+            return(-1);
+        }
+        if (!(f.flags & CONMAN_FRAME_FLAG_WRITE) != !isWrite) {
+            log_msg(LOG_ERR, "Received channel [%s] with flags=0x%x",
+                f.data, f.flags);
+            return(-1);
+        }
+        *idp = f.id;
+        n++;
+    }
+    if (strncmp(f.data, LEX_TOK2STR(proto_strs, CONMAN_TOK_OK), 2)) {
+        DPRINTF((5, "Received response: %s", f.data));
+        return(-1);
+    }
+    return(n);
+}
+
+
+static int read_data(int sd, int id, long numBytes)
+{
+/*  Reads exactly (numBytes) bytes of DATA on channel (id).
+ *  Returns 0 on success, or -1 on error.
+ */
+    frame_t f;
+    long n = 0;
+
+    while (n < numBytes) {
+        if (read_frame(sd, &f, TEST_TIMEOUT_MSECS) <= 0) {
+            log_msg(LOG_ERR, "Timed-out after %ld of %ld bytes of DATA",
+                n, numBytes);
+            return(-1);
+        }
+        if ((f.type != CONMAN_FRAME_DATA) || (f.id != id)) {
+            log_msg(LOG_ERR, "Received unexpected frame type=%d id=%d",
+                f.type, f.id);
+            return(-1);
+        }
+        n += f.len;
+    }
+    if (n > numBytes) {
+        log_msg(LOG_ERR, "Received %ld bytes of DATA exceeding %ld of credit",
+            n, numBytes);
+        return(-1);
+    }
+    return(0);
+}
+
+
+static int find_data(int sd, int id, const char *msg)
+{
+/*  Reads DATA on channel (id) until the string (msg) has been received.
+ *  Returns 0 on success, or -1 on error.
+ */
+    frame_t f;
+    char buf[(2 * MUX_FRAME_MAX_LEN) + 1];
+    int n = 0;
+
+    buf[0] = '\0';
+    while (!strstr(buf, msg)) {
+        if (read_frame(sd, &f, TEST_TIMEOUT_MSECS) <= 0) {
+            log_msg(LOG_ERR, "Timed-out waiting for \"%s\" in DATA", msg);
+            return(-1);
+        }
+        if ((f.type != CONMAN_FRAME_DATA) || (f.id != id)) {
+            log_msg(LOG_ERR, "Received unexpected frame type=%d id=%d",
+                f.type, f.id);
+            return(-1);
+        }
+        /*  Discard the oldest data once the buffer is full.
+         */
+        if (n + f.len > 2 * MUX_FRAME_MAX_LEN) {
+            n = 0;
+        }
+        memcpy(&buf[n], f.data, f.len);
+        n += f.len;
+        buf[n] = '\0';
+    }
+    return(0);
+}
+
+
+static int check_silence(int sd, int id)
+{
+/*  Checks that no frame is received for TEST_SILENCE_MSECS
+ *    since channel (id) has exhausted its credit.
+ *  Returns 0 if so; o/w, returns -1.
+ */
+    frame_t f;
+    int rc;
+
+    if ((rc = read_frame(sd, &f, TEST_SILENCE_MSECS)) < 0) {
+        return(-1);
+    }
+    if (rc > 0) {
+        log_msg(LOG_ERR,
+            "Received frame type=%d id=%d with %d bytes beyond credit",
+            f.type, f.id, f.len);
+        return(-1);
+    }
+    return(0);
+}
+
+
+static int read_frame(int sd, frame_t *f, int msecs)
+{
+/*  Reads the next frame from the socket (sd) into (f), waiting up to (msecs)
+ *    for it to arrive.
+ *  Returns 1 if a frame was read, 0 if timed-out, or -1 on EOF or error.
+ */
+    struct pollfd pfd;
+    unsigned char hdr[MUX_FRAME_HDR_LEN];
+    int n;
+
+    pfd.fd = sd;
+    pfd.events = POLLIN;
+    while ((n = poll(&pfd, 1, msecs)) < 0) {
+        if (errno != EINTR) {
+            log_err(errno, "Unable to poll socket");
+        }
+    }
+    if (n == 0) {
+        return(0);
+    }
+    if (recv(sd, hdr, sizeof(hdr), MSG_WAITALL) != sizeof(hdr)) {
+        log_msg(LOG_ERR, "Unable to read frame header from daemon");
+        return(-1);
+    }
+    f->type = hdr[0];
+    f->flags = hdr[1];
+    f->len = (hdr[2] << 8) | hdr[3];
+    f->id = (hdr[4] << 24) | (hdr[5] << 16) | (hdr[6] << 8) | hdr[7];
+    if (f->len > MUX_FRAME_MAX_LEN) {
+        log_msg(LOG_ERR, "Received oversized frame of %d bytes", f->len);
+        return(-1);
+    }
+    if ((f->len > 0)
+            && (recv(sd, f->data, f->len, MSG_WAITALL) != f->len)) {
+        log_msg(LOG_ERR, "Unable to read frame payload from daemon");
+        return(-1);
+    }
+    f->data[f->len] = '\0';
+    return(1);
+}
+
+
+static int read_rsp_line(int sd, char *buf, int len)
+{
+/*  Reads a line from the blocking socket (sd) into (buf) of length (len)
+ *    a byte at a time, so nothing following the line is consumed.
+ *  Returns the length of the line, or -1 on EOF or error.
+ */
+    int n = 0;
+
+    while (n < len - 1) {
+        if (read(sd, &buf[n], 1) != 1) {
+            return(-1);
+        }
+        if (buf[n++] == '\n') {
+            break;
+        }
+    }
+    buf[n] = '\0';
+    return(n);
+}
+
+
+static void write_frame(int sd, int type, int id, const void *src, int len)
+{
+/*  Writes a frame of (type) for channel (id) carrying the payload (src)
+ *    of length (len) to the blocking socket (sd).
+ */
+    unsigned char hdr[MUX_FRAME_HDR_LEN];
+
+    hdr[0] = type;
+    hdr[1] = 0;
+    hdr[2] = (len >> 8) & 0xFF;
+    hdr[3] = len & 0xFF;
+    hdr[4] = (id >> 24) & 0xFF;
+    hdr[5] = (id >> 16) & 0xFF;
+    hdr[6] = (id >> 8) & 0xFF;
+    hdr[7] = id & 0xFF;
+    if ((write_n(sd, hdr, sizeof(hdr)) < 0)
+            || ((len > 0) && (write_n(sd, (void *) src, len) < 0))) {
+        log_err(errno, "Unable to write frame to daemon");
+    }
+    return;
+}
+
+
+static void write_window(int sd, int id, unsigned long credit)
+{
+/*  Grants (credit) more bytes to channel (id) via a WINDOW frame.
+ */
+    unsigned char win[4];
+
+    win[0] = (credit >> 24) & 0xFF;
+    win[1] = (credit >> 16) & 0xFF;
+    win[2] = (credit >> 8) & 0xFF;
+    win[3] = credit & 0xFF;
+    write_frame(sd, CONMAN_FRAME_WINDOW, id, win, sizeof(win));
+    return;
+}
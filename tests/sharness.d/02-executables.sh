@@ -4,6 +4,7 @@
 #
 CONMAN="${CONMAN_BUILD_DIR}/conman"
 CONMAND="${CONMAN_BUILD_DIR}/conmand"
+CONMANLOG="${CONMAN_BUILD_DIR}/conmanlog"
 
 # Require executables to be built before tests can proceed.
 #
@@ -5,12 +5,14 @@
 #   which can cause problems with advisory lockfiles.  It is not necessary to
 #   relocate the pidfile, but not doing so could make it lonely since
 #   everything else is potentially moved.
+# Any arguments are added as config lines before the consoles are defined,
+#   thereby overriding the global defaults above.
 # Provide [CONMAND_CONFIG], [CONMAND_LOGFILE], [CONMAND_PIDFILE],
 #   [CONMAND_CONSOLE_GLOB], and [CONMAND_CONSOLE_COUNT].
 #
 conmand_setup()
 {
-    local prefix
+    local prefix line
 
     if test "x${root}" = x; then
         prefix="${TMPDIR:-"/tmp"}/"
@@ -32,6 +34,11 @@ conmand_setup()
 	server port=0
 	global log="${prefix}console.%N.log.$$"
 	global testopts="b:1,m:10,n:10,p:100"
+	EOF
+    for line in "$@"; do
+        echo "${line}" >> "${CONMAND_CONFIG}"
+    done
+    cat >> "${CONMAND_CONFIG}" <<-EOF
 	console name="test1" dev="test:"
 	console name="test2" dev="test:"
 	EOF
@@ -55,6 +62,26 @@ conmand_start()
     test "x${CONMAND_PORT}" != x
 }
 
+# Output the name of the logfile for console [name].
+#
+conmand_console_log()
+{
+    local name="$1"
+    echo "${CONMAND_CONSOLE_GLOB}" | sed -e "s/\*/${name}/"
+}
+
+# Wait for up to ~10secs for the command given by the arguments to succeed.
+#
+conmand_wait()
+{
+    local i
+    for i in $(test_seq 1 100); do
+        "$@" >/dev/null 2>&1 && return 0
+        sleep 0.1
+    done
+    return 1
+}
+
 # Stop the daemon process.
 # The for-loop is necessary since conmand returns immediately after sending a
 #   SIGTERM to the running daemon process and before that target process has
@@ -106,12 +133,13 @@ conmand_kill()
 #   process.  It must be at the start of any &&-chain to ensure it cannot be
 #   prevented from running by a preceding failure in the chain.
 # Remove files outside the sharness trash directory unless [debug] is set.
+#   This includes the index and any rotated files of each console log.
 #
 conmand_cleanup()
 {
     conmand_kill
     if test "x${root}" = x && test "x${debug}" != xt; then
         rm -f "${CONMAND_CONFIG}" "${CONMAND_LOGFILE}" "${CONMAND_PIDFILE}" \
-                ${CONMAND_CONSOLE_GLOB}
+                ${CONMAND_CONSOLE_GLOB} ${CONMAND_CONSOLE_GLOB}.*
     fi
 }
@@ -0,0 +1,260 @@
+/*****************************************************************************
+ *  Written by Chris Dunlap <cdunlap@llnl.gov>.
+ *  Copyright (C) 2007-2023 Lawrence Livermore National Security, LLC.
+ *  Copyright (C) 2001-2007 The Regents of the University of California.
+ *  UCRL-CODE-2002-009.
+ *
+ *  This file is part of ConMan: The Console Manager.
+ *  For details, see <https://dun.github.io/conman/>.
+ *
+ *  ConMan is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  ConMan is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ *  for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with ConMan.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+
+/*  The tpoll-test utility checks tpoll's handling of fds with whichever
+ *    backend (poll, epoll, or io_uring) it was built with.  Each test named
+ *    on the command-line is run in turn; the exit status is non-zero if any
+ *    of them fail.
+ *
+ *  reuse:    An fd is cleared, closed, and reopened as a different file with
+ *              the same fd number and the same events, all between two calls
+ *              to tpoll().  I/O ready on the new file must be reported.
+ *  rearm:    An fd is cleared and set again with the same events between two
+ *              calls to tpoll().  I/O ready on it must still be reported.
+ *  toggle:   POLLOUT is repeatedly set and cleared on an fd with POLLIN set,
+ *              as the daemon does while writing to a client.  Each POLLIN
+ *              event must still be reported.
+ */
+
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "log.h"
+#include "tpoll.h"
+
+
+#define TEST_TIMEOUT_MSECS      1000
+
+
+static int test_reuse(tpoll_t tp);
+static int test_rearm(tpoll_t tp);
+static int test_toggle(tpoll_t tp);
+static int check_ready(tpoll_t tp, int fd, short int events);
+static void open_pipe(int fds[2], int fd);
+
+
+int main(int argc, char *argv[])
+{
+    tpoll_t tp;
+    int i;
+    int rc = -1;
+    int numFailed = 0;
+
+    log_set_file(stderr, LOG_WARNING, 0);
+
+    if (argc < 2) {
+        printf("Usage: %s TEST...\n", argv[0]);
+        printf("\n");
+        printf("  Tests: reuse, rearm, toggle\n");
+        printf("\n");
+        exit(1);
+    }
+    for (i = 1; i < argc; i++) {
+        if (!(tp = tpoll_create(0))) {
+            log_err(errno, "Unable to create tpoll object");
+        }
+        if (!strcmp(argv[i], "reuse")) {
+            rc = test_reuse(tp);
+        }
+        else if (!strcmp(argv[i], "rearm")) {
+            rc = test_rearm(tp);
+        }
+        else if (!strcmp(argv[i], "toggle")) {
+            rc = test_toggle(tp);
+        }
+        else {
+            log_err(0, "Unknown test \"%s\"", argv[i]);
+        }
+        printf("%s: %s\n", argv[i], (rc < 0 ? "FAILED" : "ok"));
+        if (rc < 0) {
+            numFailed++;
+        }
+        tpoll_destroy(tp);
+    }
+    return(numFailed ? 1 : 0);
+}
+
+
+static int test_reuse(tpoll_t tp)
+{
+    int a[2];
+    int b[2];
+
+    open_pipe(a, -1);
+    if (tpoll_set(tp, a[0], POLLIN) < 0) {
+        log_err(errno, "Unable to set fd=%d", a[0]);
+    }
+    /*  Arm the poll request for the first pipe.
+     */
+    if (tpoll(tp, 0) != 0) {
+        log_msg(LOG_ERR, "Unexpected I/O ready on idle pipe");
+        return(-1);
+    }
+    /*  Replace the first pipe with a second pipe on the same fd number.
+     */
+    (void) tpoll_clear(tp, a[0], POLLIN);
+    (void) close(a[0]);
+    (void) close(a[1]);
+    open_pipe(b, a[0]);
+    if (tpoll_set(tp, b[0], POLLIN) < 0) {
+        log_err(errno, "Unable to set fd=%d", b[0]);
+    }
+    if (write(b[1], "x", 1) != 1) {
+        log_err(errno, "Unable to write to pipe");
+    }
+    if (check_ready(tp, b[0], POLLIN) < 0) {
+        return(-1);
+    }
+    (void) close(b[0]);
+    (void) close(b[1]);
+    return(0);
+}
+
+
+static int test_rearm(tpoll_t tp)
+{
+    int a[2];
+
+    open_pipe(a, -1);
+    if (tpoll_set(tp, a[0], POLLIN) < 0) {
+        log_err(errno, "Unable to set fd=%d", a[0]);
+    }
+    if (tpoll(tp, 0) != 0) {
+        log_msg(LOG_ERR, "Unexpected I/O ready on idle pipe");
+        return(-1);
+    }
+    (void) tpoll_clear(tp, a[0], POLLIN);
+    if (tpoll_set(tp, a[0], POLLIN) < 0) {
+        log_err(errno, "Unable to set fd=%d", a[0]);
+    }
+    if (write(a[1], "x", 1) != 1) {
+        log_err(errno, "Unable to write to pipe");
+    }
+    if (check_ready(tp, a[0], POLLIN) < 0) {
+        return(-1);
+    }
+    (void) close(a[0]);
+    (void) close(a[1]);
+    return(0);
+}
+
+
+static int test_toggle(tpoll_t tp)
+{
+    int sv[2];
+    char c;
+    int i;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+        log_err(errno, "Unable to create socketpair");
+    }
+    if (tpoll_set(tp, sv[0], POLLIN) < 0) {
+        log_err(errno, "Unable to set fd=%d", sv[0]);
+    }
+    for (i = 0; i < 100; i++) {
+        if (tpoll_set(tp, sv[0], POLLOUT) < 0) {
+            log_err(errno, "Unable to set fd=%d", sv[0]);
+        }
+        if (check_ready(tp, sv[0], POLLOUT) < 0) {
+            return(-1);
+        }
+        (void) tpoll_clear(tp, sv[0], POLLOUT);
+        if (write(sv[1], "x", 1) != 1) {
+            log_err(errno, "Unable to write to socket");
+        }
+        if (check_ready(tp, sv[0], POLLIN) < 0) {
+            return(-1);
+        }
+        if (read(sv[0], &c, 1) != 1) {
+            log_err(errno, "Unable to read from socket");
+        }
+    }
+    (void) close(sv[0]);
+    (void) close(sv[1]);
+    return(0);
+}
+
+
+static int check_ready(tpoll_t tp, int fd, short int events)
+{
+/*  Checks that a call to tpoll() reports (events) ready on (fd) (and only on
+ *    that fd) within TEST_TIMEOUT_MSECS.
+ *  Returns 0 if so; o/w, returns -1.
+ */
+    int n;
+
+    n = tpoll(tp, TEST_TIMEOUT_MSECS);
+    if (n < 0) {
+        log_err(errno, "Unable to multiplex I/O");
+    }
+    if (n == 0) {
+        log_msg(LOG_ERR, "Timed-out waiting for I/O on fd=%d", fd);
+        return(-1);
+    }
+    if ((n != 1) || (tpoll_ready(tp, 0) != fd)) {
+        log_msg(LOG_ERR, "Expected I/O on fd=%d but found fd=%d (n=%d)",
+            fd, tpoll_ready(tp, 0), n);
+        return(-1);
+    }
+    if (tpoll_is_set(tp, fd, events) <= 0) {
+        log_msg(LOG_ERR, "Expected events 0x%x on fd=%d", events, fd);
+        return(-1);
+    }
+    return(0);
+}
+
+
+static void open_pipe(int fds[2], int fd)
+{
+/*  Opens a pipe in (fds).  If (fd) >= 0, the read end of the pipe is moved
+ *    to that fd number.
+ */
+    int tmp;
+
+    if (pipe(fds) < 0) {
+        log_err(errno, "Unable to create pipe");
+    }
+    if ((fd >= 0) && (fds[0] != fd)) {
+        if (fds[1] == fd) {
+            if ((tmp = dup(fds[1])) < 0) {
+                log_err(errno, "Unable to dup fd=%d", fds[1]);
+            }
+            fds[1] = tmp;
+        }
+        if (dup2(fds[0], fd) < 0) {
+            log_err(errno, "Unable to dup fd=%d", fds[0]);
+        }
+        (void) close(fds[0]);
+        fds[0] = fd;
+    }
+    return;
+}